@@ -63,7 +63,6 @@ protected:
     // cFileSystem non-public methods
     virtual int FileCount ( int ) const;
     virtual const sFileDescriptorRecord * GetFileDescriptor ( int, int ) const;
-    virtual int FreeSectors () const;
     virtual int TotalSectors () const;
     virtual const char *VerboseHeader ( int ) const;
     virtual void PrintVerboseInformation ( FILE *, const sFileDescriptorRecord *, int ) const;
@@ -81,6 +80,7 @@ public:
     virtual bool GetName ( char *, size_t ) const;
     virtual bool IsValid () const;
     virtual bool IsCollection () const;
+    virtual int FreeSectors () const;
     virtual cFile *OpenFile ( const char *, int );
     virtual cFile *CreateFile ( const char *, UINT8, int, int );
     virtual bool AddFile ( cFile *, int );
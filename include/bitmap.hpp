@@ -49,33 +49,40 @@ struct sBitMapInfo {
     int          ColorShift [3];
 };
 
+enum eScaleMethod {
+    SCALE_SCALAR,
+    SCALE_SSE2,
+    SCALE_AVX2
+};
+
+struct sScaleWorker;
+
 class cBitMap {
 
-private:
+    static eScaleMethod sm_ScaleMethod;
+    static int          sm_ScaleThreads;
 
-    bool         m_Scale2x;
-    int          m_Width;
-    int          m_Height;
-    int          m_Pitch;
-    SDL_Surface *m_pSurface;
+    bool          m_Scale2x;
+    int           m_Width;
+    int           m_Height;
+    int           m_Pitch;
+    SDL_Surface  *m_pSurface;
 
-    template<class T> void Scale ( cBitMap *, int, UINT8 * );
+    int           m_WorkerCount;
+    sScaleWorker *m_Worker;
 
-    // Routines for Scale2x
-    void CalculateNewPixels ( int, int, int, int, int, UINT8 *, UINT8 * );
-    void CalculateNewPixels ( int, int, int, int, int, UINT16 *, UINT16 * );
-    void CalculateNewPixels ( int, int, int, int, int, UINT32 *, UINT32 * );
+    template<class T> void Scale ( cBitMap *, int, UINT8 *, const sRECT & );
 
-    // Routines for Scale2x
-    void CalculateNewPixels ( int, int, int, int, int, UINT8 *, UINT8 *, UINT8 * );
-    void CalculateNewPixels ( int, int, int, int, int, UINT16 *, UINT16 *, UINT16 * );
-    void CalculateNewPixels ( int, int, int, int, int, UINT32 *, UINT32 *, UINT32 * );
+    template<class T> void Scale2xImp ( cBitMap *, UINT8 *, int, int, int, int );
+    template<class T> void Scale3xImp ( cBitMap *, UINT8 *, int, int, int, int );
 
-    template<class T> void Scale2xImp ( cBitMap *, UINT8 * );
-    template<class T> void Scale3xImp ( cBitMap *, UINT8 * );
+    void ScaleBand ( cBitMap *, UINT8 *, int, const sRECT & );
+    void ScaleBands ( cBitMap *, UINT8 *, int, const sRECT & );
 
-    void Scale2X ( cBitMap * );
-    void Scale3X ( cBitMap * );
+    void StartWorkers ();
+    void StopWorkers ();
+
+    static int _ScaleThreadProc ( void * );
 
 public:
 
@@ -93,6 +100,12 @@ public:
     SDL_Surface *GetSurface () const    { return m_pSurface; }
 
     void  Copy ( cBitMap * );
+    int   Copy ( cBitMap *, const sRECT *, int, SDL_Rect * );
+
+    static eScaleMethod BestScaleMethod ();
+    static void SetScaleMethod ( eScaleMethod, int = 0 );
+
+    static void Benchmark ();
 
 private:
 
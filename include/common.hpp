@@ -96,6 +96,15 @@ template <typename T, size_t N> char ( &ArraySizeHelper ( T (&array) [N] )) [N];
 
 #endif
 
+// Make sure data written to a lock-free queue is visible before the index that publishes it
+#if defined ( __GNUC__ )
+    #define MEMORY_BARRIER()	__sync_synchronize ()
+#elif defined ( OS_WINDOWS )
+    #define MEMORY_BARRIER()	MemoryBarrier ()
+#else
+    #define MEMORY_BARRIER()
+#endif
+
 #if defined ( OS_WINDOWS ) || defined ( OS_AMIGAOS )
 
     // Undo any previous definitions
@@ -32,6 +32,7 @@
 #include "tms9900.hpp"
 
 class cTMS9900;
+class cTMS9918A;
 class cCartridge;
 
 class cDevice {
@@ -42,6 +43,7 @@ protected:
     int         m_CRU;
     cCartridge *m_pROM;
     cTMS9900   *m_pCPU;
+    cTMS9918A  *m_pVDP;
 
 public:
 
@@ -49,6 +51,7 @@ public:
     virtual ~cDevice ();
 
     void SetCPU ( cTMS9900 *cpu )	{ m_pCPU = cpu; }
+    void SetVDP ( cTMS9918A *vdp )	{ m_pVDP = vdp; }
 
     int GetCRU () const			{ return m_CRU; }
     cCartridge *GetROM () const		{ return m_pROM; }
@@ -56,6 +59,9 @@ public:
     virtual void Activate ()		{}
     virtual void DeActivate ()		{}
 
+    // Called from the CPU thread at the VDP refresh rate
+    virtual void Update ( UINT32 )	{}
+
     virtual void WriteCRU ( ADDRESS, int ) = 0;
     virtual int  ReadCRU ( ADDRESS ) = 0;
 
@@ -48,11 +48,16 @@ protected:
     cDiskFileSystem ( const char * );
     ~cDiskFileSystem ();
 
+    int AllocationLimit () const;
     int FindFreeSector ( int start = 0 ) const;
+    int FindFreeSectors ( int start, int max, int *count ) const;
     void SetSectorAllocation ( int index, bool bUsed );
+    void SetSectorAllocation ( int index, int count, bool bUsed );
 
     int FindLastSector ( const sFileDescriptorRecord *FDR ) const;
-    bool AddFileSector ( sFileDescriptorRecord *FDR, int );
+    bool AddFileSectors ( sFileDescriptorRecord *FDR, int, int );
+
+    bool GetSectorLocation ( int, int *, int *, int * ) const;
 
     const sSector *FindSector ( int index ) const;
     sSector *FindSector ( int index );
@@ -71,7 +76,6 @@ protected:
     virtual const char *DirectoryName ( int ) const;
     virtual int FileCount ( int ) const;
     virtual const sFileDescriptorRecord * GetFileDescriptor ( int, int ) const;
-    virtual int FreeSectors () const;
     virtual int TotalSectors () const;
     virtual const char *VerboseHeader ( int ) const;
     virtual void PrintVerboseInformation ( FILE *, const sFileDescriptorRecord *, int ) const;
@@ -88,12 +92,20 @@ public:
 
     cDiskMedia *GetMedia ( iBaseObject * ) const;
 
+    // Raw sector access by sector index
+    bool ReadSector ( int, void * ) const;
+    bool WriteSector ( int, const void * );
+
+    // Follow a file's data chain without trusting the FDR
+    static bool GetDataChain ( const sFileDescriptorRecord *, int, int * );
+
     // cFileSystem public methods
-    virtual bool CheckDisk () const;
+    virtual bool CheckDisk ( bool = true ) const;
     virtual bool GetPath ( char *, size_t ) const;
     virtual bool GetName ( char *, size_t ) const;
     virtual bool IsValid () const;
     virtual bool IsCollection () const;
+    virtual int FreeSectors () const;
     virtual cFile *OpenFile ( const char *, int );
     virtual cFile *CreateFile ( const char *, UINT8, int, int );
     virtual bool AddFile ( cFile *, int );
@@ -58,6 +58,12 @@
 #define EOT_FILLER_FM           276
 #define EOT_FILLER_MFM          736
 
+// Size of each volume on a CF7+/nanoPEB card
+#define CF7_DISK_SIZE           ( 0x0640L * 512 )
+
+// Changes are written back through a journal kept beside the disk image
+#define JOURNAL_SUFFIX          ".jnl"
+
 /*
 	35	1	S	9	315		80640
 	35	1	D	16	560		143360
@@ -169,6 +175,8 @@ enum eDiskFormat {
     FORMAT_RAW_SECTOR,      // Image is an array of sectors - v9t9
     FORMAT_ANADISK,         // Image is an array of headers+sectors
     FORMAT_CF7,             // Image is a Compact Flash disk from CF7+/nanoPEB
+    FORMAT_DIRECTORY,       // Host directory of TIFILES/FIAD files
+    FORMAT_COMPRESSED,      // Image is an array of individually compressed tracks
     FORMAT_MAX
 };
 
@@ -198,13 +206,31 @@ struct sSector {
     UINT8         *Data;
 };
 
+// SectorIndex entries: 0 = not on this track, 1..MAX_SECTORS = Sector [n-1]
+#define SECTOR_NOT_FOUND        0
+#define SECTOR_DUPLICATED       0xFF
+
 struct sTrack {
     eDiskDensity   Density;
     sSector        Sector [ MAX_SECTORS ];
+    UINT8          SectorIndex [ 256 ];     // Logical sector # -> Sector slot
     size_t         Size;
     UINT8         *Data;
 };
 
+// A host file that's part of a directory disk (see ReadDiskDirectory)
+struct sHostFile;
+
+// A journal being written back to the disk image on its own thread (see StartWriteBack)
+struct sWriteBack;
+
+// Where an as yet unparsed track lives in the disk image
+struct sTrackSource {
+    bool           Pending;
+    const UINT8   *Data;
+    size_t         Size;        // Raw/compressed track: # of bytes, otherwise # of sectors present
+};
+
 class cDiskMedia : public cBaseObject {
 
     bool           m_HasChanged;
@@ -217,32 +243,72 @@ class cDiskMedia : public cBaseObject {
     int            m_NumHeads;
     int            m_NumTracks;
     int            m_LastSectorIndex;
-    UINT8         *m_RawData;
     sTrack         m_Track [ 2 ][ MAX_TRACKS ];
 
-    static UINT8 *FindAddressMark ( UINT8, UINT8, eDiskDensity, UINT8 *, const UINT8 * );
-    static UINT8 *FindEndOfTrack ( eDiskDensity, UINT8, int, UINT8 *, const UINT8 * );
+    // The disk image is mapped into memory and tracks are parsed when first used
+    const UINT8   *m_ImageData;
+    size_t         m_ImageSize;
+    bool           m_ImageMapped;
+    sTrackSource   m_Source [ 2 ][ MAX_TRACKS ];
+    int            m_PendingTracks;
+    int            m_SourceSectors;
+    eDiskDensity   m_SourceDensity;
+
+    // What's changed since the last save and where it lives in the image file
+    UINT64         m_DirtySectors [ 2 ][ MAX_TRACKS ];
+    bool           m_DirtyTrack [ 2 ][ MAX_TRACKS ];
+    long           m_TrackOffset [ 2 ][ MAX_TRACKS ];
+    size_t         m_TrackLength [ 2 ][ MAX_TRACKS ];
+    bool           m_UntrackedChanges;      // Sector data was changed behind our back (see DiskModified)
+    sWriteBack    *m_WriteBack;
 
-    eDiskFormat DetermineFormat ( FILE * );
+    // The host files a directory disk was built from
+    sHostFile     *m_HostFile;
+    int            m_HostFiles;
+
+    static const UINT8 *FindAddressMark ( UINT8, UINT8, eDiskDensity, const UINT8 *, const UINT8 * );
+    static const UINT8 *FindEndOfTrack ( eDiskDensity, UINT8, int, const UINT8 *, const UINT8 * );
+
+    eDiskFormat DetermineFormat ( const UINT8 *, size_t );
+
+    void ReleaseImage ();
 
     void AllocateTracks ( int, int );
+    UINT8 *AllocateTrackData ( sTrack * );
 
     void FormatTrack ( int, int, eDiskDensity, int, const sSector * );
-    void FormatDisk ( int, int, int, eDiskDensity );
+    static void IndexTrack ( sTrack * );
+
+    void SetSource ( int, int, const UINT8 *, size_t );
+    void LoadTrack ( int, int );
+    void LoadAllTracks ();
 
-    bool ReadDiskRawTrack ( FILE * );
-    bool ReadDiskRawSector ( FILE * );
-    bool ReadDiskAnadisk ( FILE * );
-    bool ReadDiskCF7 ( FILE * );
+    bool ReadDiskRawTrack ();
+    bool ReadDiskRawSector ();
+    bool ReadDiskAnadisk ();
+    bool ReadDiskCF7 ();
+    bool ReadDiskDirectory ();
+    bool ReadDiskCompressed ();
 
     bool LoadFile ();
 
+    void ClearChanges ();
+    void ForgetLayout ();
+
     bool IsValidRawSector ();
 
+    size_t CollectChanges ( UINT8 *, int * ) const;
+    bool CanWriteBack () const;
+    bool WriteBack ( bool );
+
     bool SaveDiskRawTrack ( FILE * );
     bool SaveDiskRawSector ( FILE * );
     bool SaveDiskAnadisk ( FILE * );
-    bool SaveDiskCF7 ( FILE * );
+    bool SaveDiskCF7 ();
+    bool SaveDiskDirectory ();
+    bool SaveDiskCompressed ( FILE * );
+
+    void ForgetHostFiles ();
 
 protected:
 
@@ -253,7 +319,7 @@ public:
     cDiskMedia ( const char *, int = 0 );
     cDiskMedia ( int = MAX_TRACKS, int = 2 );
 
-    void DiskModified ()            { m_HasChanged = true; }
+    void DiskModified ()            { m_HasChanged = m_UntrackedChanges = true; }
     bool HasChanged () const        { return m_HasChanged; }
     bool IsWriteProtected () const  { return m_IsWriteProtected; }
 
@@ -270,6 +336,9 @@ public:
     bool LoadFile ( const char * );
     bool SaveFile ( eDiskFormat = FORMAT_UNKNOWN, bool = false );
 
+    bool StartWriteBack ();
+    bool FinishWriteBack ();
+
     sTrack  *GetTrack ( int, int );
     sSector *GetSector ( int, int, int, int = -1 );
 
@@ -108,7 +108,6 @@ protected:
     virtual const char *DirectoryName ( int ) const;
     virtual int FileCount ( int ) const = 0;
     virtual const sFileDescriptorRecord * GetFileDescriptor ( int, int ) const = 0;
-    virtual int FreeSectors () const = 0;
     virtual int TotalSectors () const = 0;
     virtual const char *VerboseHeader ( int ) const;
     virtual void PrintVerboseInformation ( FILE *, const sFileDescriptorRecord *, int ) const;
@@ -120,7 +119,7 @@ public:
     static bool IsValidName ( const char *name );
     static bool IsValidFDR ( const sFileDescriptorRecord *fdr );
 
-    virtual bool CheckDisk () const;
+    virtual bool CheckDisk ( bool = true ) const;
     virtual void ShowDirectory ( FILE *, bool ) const;
     virtual int  GetFilenames ( char *names[], int = -1 ) const;
 
@@ -135,6 +134,7 @@ public:
     virtual bool GetName ( char *, size_t ) const = 0;
     virtual bool IsValid () const = 0;
     virtual bool IsCollection () const = 0;
+    virtual int FreeSectors () const = 0;
     virtual cFile *OpenFile ( const char *, int = -1 ) = 0;
     virtual cFile *CreateFile ( const char *, UINT8, int, int = -1 ) = 0;
     virtual bool AddFile ( cFile *, int = -1 ) = 0;
@@ -31,6 +31,12 @@
 
 #include "fs.hpp"
 
+// Host files start with either a TIFILES header or a copy of the FDR (FIAD)
+#define HOST_HEADER_SIZE        128
+
+// The part of an FDR that describes the file (everything but the data chain)
+#define FDR_INFO_SIZE           offsetof ( sFileDescriptorRecord, reserved2 )
+
 /*
 > - 1) The first, the most common one, uses just the first 16 bytes:
 >
@@ -121,7 +127,6 @@ protected:
     // cFileSystem methods
     virtual int FileCount ( int ) const;
     virtual const sFileDescriptorRecord * GetFileDescriptor ( int, int ) const;
-    virtual int FreeSectors () const;
     virtual int TotalSectors () const;
     virtual sSector *GetFileSector ( sFileDescriptorRecord *FDR, int index );
     virtual int ExtendFile ( sFileDescriptorRecord *FDR, int count );
@@ -132,11 +137,16 @@ public:
 
     static cPseudoFileSystem *Open ( const char *, const char * );
 
+    // Build a new TIFILES header, or bring an existing host file header up to date
+    static void MakeHeader ( const sFileDescriptorRecord *, UINT8 * );
+    static void UpdateHeader ( const sFileDescriptorRecord *, UINT8 * );
+
     // cFileSystem public methods
     virtual bool GetPath ( char *, size_t ) const;
     virtual bool GetName ( char *, size_t ) const;
     virtual bool IsValid () const;
     virtual bool IsCollection () const;
+    virtual int FreeSectors () const;
     virtual cFile *OpenFile ( const char *, int );
     virtual cFile *CreateFile ( const char *, UINT8, int, int );
     virtual bool AddFile ( cFile *, int );
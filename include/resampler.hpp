@@ -0,0 +1,78 @@
+//----------------------------------------------------------------------------
+//
+// File:        resampler.hpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: Polyphase FIR sample rate converter
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef RESAMPLER_HPP_
+#define RESAMPLER_HPP_
+
+// Windowed sinc kernel: RESAMPLER_PHASES sub-sample positions, RESAMPLER_TAPS long
+#define RESAMPLER_PHASE_BITS	8
+#define RESAMPLER_PHASES	( 1 << RESAMPLER_PHASE_BITS )
+#define RESAMPLER_TAPS		16
+#define RESAMPLER_SHIFT		14
+
+class cResampler {
+
+    int                 m_InputRate;
+    int                 m_OutputRate;
+
+    // Input samples per output sample in 32.32 fixed-point
+    UINT32              m_StepWhole;
+    UINT32              m_StepFraction;
+
+    INT16               m_Kernel [ RESAMPLER_PHASES ][ RESAMPLER_TAPS ];
+
+    // Unused input from previous calls followed by the new input
+    int                 m_MaxInput;
+    INT16              *m_History;
+    int                 m_Length;
+    int                 m_Position;
+    UINT32              m_Fraction;
+
+    void BuildKernel ();
+
+public:
+
+    cResampler ( int, int, int );
+    ~cResampler ();
+
+    int  GetInputRate () const			{ return m_InputRate; }
+    int  GetOutputRate () const			{ return m_OutputRate; }
+
+    int  GetMaxOutput ( int ) const;
+
+    void Reset ();
+    int  Process ( const INT16 *, int, INT16 * );
+
+private:
+
+    cResampler ( const cResampler & );     // no implementation
+    void operator = ( const cResampler & ); // no implementation
+
+};
+
+#endif
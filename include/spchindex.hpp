@@ -0,0 +1,77 @@
+//----------------------------------------------------------------------------
+//
+// File:        spchindex.hpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: Phrase lookup table for a TMS5220 speech ROM
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef SPCHINDEX_HPP_
+#define SPCHINDEX_HPP_
+
+#define SPEECH_ROM_SIZE		0x8000
+
+// Every node in the phrase tree takes at least 8 bytes of the ROM
+#define MAX_SPEECH_PHRASES	( SPEECH_ROM_SIZE / 8 )
+
+struct sSpeechPhrase {
+    const char   *Text;
+    size_t        Length;
+    UINT16        Address;
+    int           DataLength;
+};
+
+class cSpeechIndex {
+
+    // Phrases in the order they appear in the tree (alphabetical)
+    sSpeechPhrase      *m_Phrase;
+    int                 m_Count;
+    char               *m_TextPool;
+
+    // Open-addressed hash table of indices into m_Phrase (-1 = empty)
+    int                *m_Table;
+    UINT32              m_TableMask;
+
+    static UINT32 Hash ( const char *, size_t );
+
+    int  CollectNodes ( const UINT8 *, int, UINT8 *, int *, int );
+
+public:
+
+    cSpeechIndex ( const UINT8 * );
+    ~cSpeechIndex ();
+
+    int  GetCount () const			{ return m_Count; }
+    const sSpeechPhrase *GetPhrase ( int index ) const	{ return &m_Phrase [ index ]; }
+
+    const sSpeechPhrase *Find ( const char *, size_t ) const;
+    const sSpeechPhrase *Find ( const char * ) const;
+
+private:
+
+    cSpeechIndex ( const cSpeechIndex & );      // no implementation
+    void operator = ( const cSpeechIndex & );  // no implementation
+
+};
+
+#endif
@@ -35,6 +35,25 @@ extern const char *COMMON_PATH;
 
 bool IsWriteable ( const char *filename );
 const char *LocateFile ( const char *filename, const char *path = NULL );
+int GetProcessorCount ();
+
+// FNV-1a hashes - pass the last result back in to hash data a piece at a time
+#define FNV1A32_INITIAL     0x811C9DC5
+#define FNV1A64_INITIAL     0xCBF29CE484222325ULL
+
+UINT32 HashFNV1a32 ( const void *data, size_t size, UINT32 hash = FNV1A32_INITIAL );
+UINT64 HashFNV1a64 ( const void *data, size_t size, UINT64 hash = FNV1A64_INITIAL );
+
+// A list of host file names (see FindFiles)
+struct sPathList {
+    char         **path;
+    int            count;
+    int            size;
+};
+
+void AddPath ( sPathList *, const char * );
+void FreePaths ( sPathList * );
+void FindFiles ( const char *, sPathList *, bool = true );
 
 #if defined ( OS_AMIGAOS )
     char *strdup ( const char *string );
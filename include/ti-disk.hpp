@@ -62,10 +62,29 @@
 
 #define STATUS_NOT_FOUND	( STATUS_CRC_ERROR | STATUS_LOST_DATA )
 
+#define MAX_ENTRY_POINTS	8
+
+// Disk timing - any other value speeds the drive up by that factor
+#define DISK_SPEED_INSTANT	0		// Commands finish as soon as the status is read
+#define DISK_SPEED_ACCURATE	1		// 300 RPM
+
+class cDiskFileSystem;
+
 class cDiskDevice : public cDevice {
 
     enum TRAP_TYPE_E {
-        TRAP_DISK
+        TRAP_DISK,
+        TRAP_DSR_ENTRY
+    };
+
+    enum ENTRY_TYPE_E {
+        ENTRY_SECTOR_IO,
+        ENTRY_FILE
+    };
+
+    struct sEntryPoint {
+        ADDRESS        Address;
+        ENTRY_TYPE_E   Type;
     };
 
     enum CMD_STATE_E {
@@ -81,6 +100,14 @@ class cDiskDevice : public cDevice {
     UINT32         m_ClocksPerRev;
     UINT32         m_ClockStart;
 
+    // Timing model for each drive (see SetSpeed)
+    int            m_Speed [3];
+    bool           m_IndexPulse;
+
+    // Changes are written back to the disk images once the DSR has been idle for a while
+    bool           m_WriteBackPending;
+    UINT32         m_LastAccess;
+
     // CRU bits
     int            m_HardwareBits;
     UINT8          m_DriveSelect;
@@ -109,6 +136,12 @@ class cDiskDevice : public cDevice {
     CMD_STATE_E    m_CmdInProgress;
     UINT8          m_TrapIndex;
 
+    // DSR calls that can be serviced without running the ROM (see SetHighLevel)
+    bool           m_HighLevel;
+    int            m_EntryPoints;
+    sEntryPoint    m_EntryPoint [MAX_ENTRY_POINTS];
+    UINT8          m_EntryTrapIndex;
+
 public:
 
     cDiskDevice ( const char * );
@@ -119,6 +152,7 @@ public:
     //
     virtual void Activate ();
     virtual void DeActivate ();
+    virtual void Update ( UINT32 );
 
     virtual void WriteCRU ( ADDRESS, int );
     virtual int  ReadCRU ( ADDRESS );
@@ -129,6 +163,14 @@ public:
     void LoadDisk ( int, const char * );
     void UnLoadDisk ( int );
 
+    void SetHighLevel ( bool enable )	{ m_HighLevel = enable; }
+    bool IsHighLevel () const		{ return m_HighLevel; }
+
+    void SetSpeed ( int, int );
+    int  GetSpeed ( int ) const;
+
+    static bool ParseSpeed ( const char *, int [ 3 ] );
+
 private:
 
     // Disable the copy constructor and assignment operator defaults
@@ -139,6 +181,9 @@ private:
 
     void FindSector ();
 
+    UINT32 GetRevolutionTime () const;
+    bool   IsIndexPulse ();
+
     void CompleteCommand ();
 
     UINT8 ReadByte ();
@@ -162,6 +207,20 @@ private:
     UINT8 WriteMemory ( ADDRESS, UINT8 );
     UINT8 ReadMemory ( ADDRESS, UINT8 );
 
+    UINT8  GetRomByte ( ADDRESS ) const;
+    UINT16 GetRomWord ( ADDRESS ) const;
+
+    void FindEntryPoints ();
+    void AddEntryPoint ( ADDRESS, ENTRY_TYPE_E );
+
+    UINT8 CallEntryPoint ( ADDRESS, UINT8 );
+
+    bool SectorIO ();
+    bool FileIO ();
+    bool LoadProgram ( cDiskFileSystem *, const char *, const UINT8 * );
+    bool SaveProgram ( cDiskMedia *, cDiskFileSystem *, const char *, const UINT8 * );
+    bool DeleteFile ( cDiskMedia *, cDiskFileSystem *, const char * );
+
 };
 
 #endif
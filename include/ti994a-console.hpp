@@ -46,7 +46,7 @@ class cConsoleTI994A : public cTI994A {
 
 public:
 
-    cConsoleTI994A ( cCartridge *ctg, cTMS9918A * = NULL );
+    cConsoleTI994A ( cCartridge *ctg, cTMS9918A * = NULL, cTMS9919 * = NULL, cTMS5220 * = NULL );
     ~cConsoleTI994A ();
 
     // cTI994A virtual functions
@@ -57,6 +57,8 @@ public:
     virtual bool Step ();
     virtual void Refresh ( bool );
 
+    void RunFrames ( int );
+
 protected:
 
     void KeyPressed ( int ch );
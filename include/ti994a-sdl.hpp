@@ -33,10 +33,15 @@
 
 struct SDL_Thread;
 
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+    typedef SDL_Keysym SDL_keysym;
+#endif
+
 class cCartridge;
 class cTMS9918A;
 class cTMS9919;
 class cTMS5220;
+class cSdlTMS9919;
 
 class cSdlTI994A : public cTI994A {
 
@@ -50,6 +55,9 @@ class cSdlTI994A : public cTI994A {
 
     UINT32              m_StartTime;
     UINT32              m_StartClock;
+    int                 m_SpeedAdjust;
+
+    cSdlTMS9919        *m_AudioClock;
 
     SDL_Thread         *m_pThread;
     SDL_sem            *m_SleepSem;
@@ -108,6 +116,8 @@ protected:
     void GK_ToggleBASIC ();
     void GK_ToggleLoader ();
 
+    void ToggleDiskSpeed ();
+
     virtual int TimerHookProc ();
 
     static int _RunThreadProc ( void * );
@@ -129,7 +129,7 @@ public:
     ADDRESS  GetGromAddress () const		{ return m_GromAddress; }
     void     SetGromAddress ( ADDRESS addr )	{ m_GromAddress = addr; m_GromPtr = m_GromMemory + addr; }
 
-    virtual void Sleep ( int, UINT32 )		{}
+    virtual void Sleep ( int, UINT32 );
     virtual void WakeCPU ( UINT32 )		{}
 
     virtual int  ReadCRU ( ADDRESS );
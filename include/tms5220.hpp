@@ -29,6 +29,8 @@
 #ifndef TMS5220_HPP_
 #define TMS5220_HPP_
 
+#include <setjmp.h>
+
 #define TMS5220_TS  0x80    // Talk Status
 #define TMS5220_BL  0x40    // Buffer Low
 #define TMS5220_BE  0x20    // Buffer Empty
@@ -64,8 +66,14 @@ const int RC_ORDER               = 10;      // # of Reflection Coefficients
 const int SAMPLE_RATE            = 8000;    // 8 KHz
 const int INTERPOLATION_INTERVAL = 25;      // 3.125 ms
 
+// Rendered 3.125 ms blocks queued between the CPU thread and the audio thread
+#define SPEECH_RING_BLOCKS      64
+#define SPEECH_PREFILL_BLOCKS   4
+
 class cTI994A;
 class cTMS9919;
+class cResampler;
+class cSpeechIndex;
 
 class cTMS5220 {
 
@@ -76,8 +84,7 @@ protected:
         int        Pitch;
         bool       Repeat;
         bool       Stop;
-        double     Reflection [ RC_ORDER ];
-        double     Gain;
+        INT16      Reflection [ RC_ORDER ];
     };
 
     union sReadState {
@@ -94,6 +101,7 @@ protected:
     };
 
     UINT8         *m_SpeechRom;
+    cSpeechIndex  *m_PhraseIndex;
 
     // ROM address information
     int            m_LoadPointer;
@@ -111,6 +119,7 @@ protected:
     // State variables
     bool           m_ReadByte;
     bool           m_SpeakExternal;
+    jmp_buf        m_JumpBuffer;
 
     // Hardware registers
     bool           m_BufferEmpty;
@@ -122,22 +131,36 @@ protected:
     sSpeechParams  m_StartParams;
     sSpeechParams  m_TargetParams;
     int            m_InterpolationStage;
+    bool           m_Inhibit;
 
     cTI994A       *m_Computer;
     cTMS9919      *m_SoundChip;
 
     // 8 KHz speech buffer
     int            m_PitchIndex;
-    double         m_NonVoicedLevel;
-    double         m_FilterHistory [ 2 ][ RC_ORDER + 1 ];
-    double         m_RawDataBuffer [ INTERPOLATION_INTERVAL ];
-
-    // Resampled synthesized speech buffer
+    UINT16         m_RNG;
+    bool           m_ReferenceFilter;
+    int            m_ReferenceOverflows;
+    INT32          m_FilterHistory [ 2 ][ RC_ORDER + 1 ];
+    double         m_ReferenceHistory [ 2 ][ RC_ORDER + 1 ];
+    INT16          m_RawDataBuffer [ INTERPOLATION_INTERVAL ];
+
+    // CPU clock up to which speech has been synthesized
+    UINT32         m_SynthClock;
+
+    // Synthesized blocks waiting for playback (filled by the CPU thread, drained by the audio thread)
+    INT16          m_Ring [ SPEECH_RING_BLOCKS ][ INTERPOLATION_INTERVAL ];
+    volatile int   m_RingGetIndex;
+    volatile int   m_RingPutIndex;
+
+    // Resampled synthesized speech buffer (used by the audio thread only)
     int            m_PlaybackFrequency;
     int            m_PlaybackInterval;
-    double        *m_PlaybackBuffer;
+    bool           m_Playing;
+    cResampler    *m_Resampler;
+    INT16         *m_PlaybackBuffer;
     int            m_PlaybackSamplesLeft;
-    double        *m_PlaybackDataPtr;
+    INT16         *m_PlaybackDataPtr;
 
     void LoadAddress ( UINT8 data );
 
@@ -151,25 +174,34 @@ protected:
     void StoreDataFIFO ( UINT8 data );
 
     bool CreateNextBuffer ();
-    bool ConvertBuffer ();
+    INT32 LatticeFilter ( const sSpeechParams &, int );
+    INT32 ReferenceFilter ( const sSpeechParams &, int );
+    void QueueBuffer ();
     bool GetNextBuffer ();
 
     static char *FormatParameters ( const sSpeechParams &, bool );
-    static void InterpolateParameters ( int,  sSpeechParams &, const sSpeechParams &, sSpeechParams * );
+    static void InterpolateParameters ( int, bool, sSpeechParams &, const sSpeechParams &, sSpeechParams * );
 
     bool ReadFrame ( sSpeechParams *, bool );
 
 public:
 
-    cTMS5220 ( cTMS9919 * );
+    cTMS5220 ( cTMS9919 *, const UINT8 * = NULL );
     virtual ~cTMS5220 ();
 
     void SetComputer ( cTI994A * );
+    void SetReferenceFilter ( bool );
 
-    virtual bool AudioCallback ( UINT8 *, int );
+    const cSpeechIndex *GetPhraseIndex () const	{ return m_PhraseIndex; }
+
+    virtual bool AudioCallback ( INT16 *, int );
 
     virtual void Reset ();
 
+    void Update ( UINT32 );
+
+    bool IsTalking () const		{ return m_TalkStatus; }
+
     UINT8 WriteData ( UINT8 );
     UINT8 ReadData ( UINT8 );
 
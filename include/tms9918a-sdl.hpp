@@ -30,10 +30,21 @@
 #define TMS9918A_SDL_HPP_
 
 #include "tms9918a.hpp"
-
-class cBitMap;
+#include "bitmap.hpp"
 
 #define FILL_SIZE		256
+#define MAX_DIRTY_RECTS		64
+
+#define TILE_CACHE_SIZE		2048
+#define TILE_HASH_SIZE		1024
+
+struct sPatternTile {
+    UINT8         Pattern [8];
+    UINT8         Color [8];
+    int           RefCount;
+    int           Next;
+    bool          Valid;
+};
 
 typedef SDL_Color  sRGBQUAD;
 typedef SDL_mutex *MUTEX;
@@ -50,9 +61,18 @@ class cSdlTMS9918A : public cTMS9918A {
     bool          m_ColorsChanged;
     bool          m_SpritesChanged;
     bool          m_NeedsUpdate;
+    bool          m_FullRefresh;
+    bool          m_SpriteScreenValid;
 
     bool          m_ScreenChanged [ 0x03C0 ];
 
+    bool          m_DirtyAll;
+    int           m_DirtyCount;
+    sRECT         m_DirtyRect [ MAX_DIRTY_RECTS ];
+
+    int           m_SpriteRectCount;
+    sRECT         m_SpriteRect [ 32 ];
+
     bool          m_PatternChanged [ 256 * 3 ];
     int           m_CharUse        [ 256 * 3 ];
     int           m_SpriteCharUse  [ 256 ];
@@ -61,9 +81,14 @@ class cSdlTMS9918A : public cTMS9918A {
     cBitMap      *m_Screen;
     cBitMap      *m_BitmapScreen;
     cBitMap      *m_BitmapSpriteScreen;
-    UINT8        *m_CharacterPattern;
     int           m_BytesPerPixel;
 
+    sPatternTile *m_Tile;
+    UINT8        *m_TileData;
+    int           m_TileHash [ TILE_HASH_SIZE ];
+    int           m_CharTile [ 256 * 3 ];
+    int           m_TileVictim;
+
     SDL_mutex    *m_Mutex;
 
     bool          m_FullScreen;
@@ -81,6 +106,11 @@ class cSdlTMS9918A : public cTMS9918A {
     void DrawSprite ( int );
     cBitMap *UpdateSprites ();
 
+    void FlushTileCache ();
+    int  FindTile ( const UINT8 *, const UINT8 * );
+    void ExpandTile ( int );
+    void SetCharacterTile ( int, const UINT8 *, const UINT8 * );
+
     void UpdateCharacterPatternGraphics ( int, UINT8, UINT8, UINT8 * );
     void UpdateCharacterPatternBitMap ( int, UINT8 * );
 
@@ -95,6 +125,10 @@ class cSdlTMS9918A : public cTMS9918A {
 
     void MarkScreenChanges ( int );
 
+    void AddDirtyRect ( int, int, int, int );
+    void FindDirtyRects ();
+    bool GetSpriteRect ( int, sRECT * );
+
     bool RefreshGraphics ();
     bool RefreshBitMap ();
     bool RefreshMultiColor ();
@@ -0,0 +1,104 @@
+//----------------------------------------------------------------------------
+//
+// File:        tms9918a-sdl2.hpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description:
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef TMS9918A_SDL2_HPP_
+#define TMS9918A_SDL2_HPP_
+
+#include "tms9918a.hpp"
+
+// SDL_USEREVENT code used to ask the main thread to present a new frame
+#define VDP_EVENT_PRESENT	1
+
+typedef SDL_Color  sRGBQUAD;
+
+class cSdl2TMS9918A : public cTMS9918A {
+
+    sRGBQUAD      m_RawColorTable [17];
+    UINT32        m_PixelColor [17];
+
+    bool          m_TextMode;
+    bool          m_ChangesMade;
+    volatile bool m_FramePending;
+
+    UINT8         m_Frame [ VDP_HEIGHT ][ VDP_WIDTH ];
+
+    SDL_Window   *m_Window;
+    SDL_Renderer *m_Renderer;
+    SDL_Texture  *m_Texture;
+
+    SDL_mutex    *m_Mutex;
+
+    bool          m_FullScreen;
+
+    int           m_OnFrames;
+    int           m_OffFrames;
+    int           m_FrameCycle;
+
+    void DrawPattern ( int, int, int, const UINT8 *, const UINT8 *, int );
+
+    void DrawGraphics ();
+    void DrawText ();
+    void DrawBitMap ();
+    void DrawMultiColor ();
+    void DrawSprites ();
+
+    void RequestPresent ();
+
+    // cTMS9918A protected methods
+    virtual bool SetMode ( int );
+    virtual void Refresh ( bool );
+
+public:
+
+    cSdl2TMS9918A ( sRGBQUAD [17], int = 60, bool = false, bool = false, int = 0, int = 0 );
+    ~cSdl2TMS9918A ();
+
+    static int GetFullScreenResolutions ( int *x, int *y, int n );
+
+    void SetCaption ( const char * );
+    void SetColorTable ( sRGBQUAD [17] );
+    void SetFrameRate ( int, int );
+
+    void ResizeWindow ( int x, int y );
+
+    void Present ();
+
+    // cTMS9918A public methods
+    virtual void Reset ();
+    virtual void WriteData ( UINT8 );
+    virtual void WriteRegister ( size_t, UINT8 );
+    virtual bool LoadImage ( FILE * );
+
+private:
+
+    cSdl2TMS9918A ( const cSdl2TMS9918A & );   // no implementation
+    void operator = ( const cSdl2TMS9918A & ); // no implementation
+
+};
+
+#endif
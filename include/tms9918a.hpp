@@ -155,6 +155,14 @@ protected:
     bool                m_FifthSpriteFlag;
     int                 m_FifthSpriteIndex;
 
+    // Coincidence is only evaluated when the status register is actually read
+    bool                m_CoincidencePending;
+    bool                m_CoincidenceStale;
+    bool                m_SpriteCheck [32];
+    int                 m_LastSprite;
+    UINT32              m_CoincidenceChecks;
+    UINT32              m_CoincidenceSkipped;
+
     int                 m_RefreshRate;
 
     virtual bool SetMode ( int );
@@ -169,6 +177,7 @@ protected:
     bool CheckCoincidence ( const bool [32] );
 
     void CheckSprites ();
+    void UpdateCoincidence ();
 
 public:
 
@@ -188,6 +197,9 @@ public:
     virtual UINT8 ReadRegister ( size_t reg )	{ return m_Register [ reg ]; }
     virtual UINT8 ReadStatus ();
 
+    void ReadMemory ( ADDRESS, void *, size_t ) const;
+    void WriteMemory ( ADDRESS, const void *, size_t );
+
     virtual bool BlankEnabled ()		{ return ( m_Register [1] & VDP_BLANK_MASK ) ? false : true; }
     virtual bool InterruptsEnabled ()		{ return ( m_Register [1] & VDP_INTERRUPT_MASK ) ? true : false; }
 
@@ -198,6 +210,9 @@ public:
 
     int    GetRefreshRate ()			{ return m_RefreshRate; }
 
+    UINT32 GetCoincidenceChecks () const	{ return m_CoincidenceChecks; }
+    UINT32 GetCoincidenceSkipped () const	{ return m_CoincidenceSkipped; }
+
     int    GetMode () const			{ return m_Mode; }
     UINT8  *GetMemory () const			{ return m_Memory; }
 
@@ -29,44 +29,38 @@
 #ifndef TMS9919_SDL_HPP_
 #define TMS9919_SDL_HPP_
 
-#include "tms9919.hpp"
+#include "tms9919-synth.hpp"
 
-class cSdlTMS9919 : public cTMS9919 {
+class cSdlTMS9919 : public cSynthTMS9919 {
 
-    struct sVoiceInfo {
-        float  period;
-        float  toggle;
-        int    setting;
-    };
-
-    int                 m_VolumeTable [16];
-
-    bool                m_Initialized;
     int                 m_MasterVolume;
 
     SDL_AudioSpec       m_AudioSpec;
-    sVoiceInfo          m_Info [4];
-    int                 m_ShiftRegister;
-    int                 m_NoiseGenerator;
-    Uint8              *m_MixBuffer;
+    INT16              *m_MixBuffer;
+    UINT32              m_SampleClock;
+    bool                m_ClockValid;
+
+    INT32               m_TargetLead;
+    INT32               m_AverageLead;
+    volatile int        m_SpeedAdjust;
 
     static void _AudioCallback ( void *, Uint8 *, int );
     void AudioCallback ( Uint8 *, int );
 
-    virtual void SetNoise ( NOISE_COLOR_E, int );
-    virtual void SetFrequency ( int, int );
-    virtual void SetAttenuation ( int, int );
+    void WriteOutput ( Uint8 *, int );
+    void UpdateSpeedAdjust ( INT32 );
 
 public:
 
     cSdlTMS9919 ( int = 44100 );
     ~cSdlTMS9919 ();
 
-    virtual int SetSpeechSynthesizer ( cTMS5220 * );
-
     int  GetMasterVolume () const		{ return m_MasterVolume; }
     void SetMasterVolume ( int );
 
+    // Speed correction for the CPU in parts per million (+ is faster)
+    int  GetSpeedAdjust () const		{ return m_SpeedAdjust; }
+
 private:
 
     cSdlTMS9919 ( const cSdlTMS9919 & );     // no implementation
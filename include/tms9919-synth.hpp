@@ -0,0 +1,123 @@
+//----------------------------------------------------------------------------
+//
+// File:        tms9919-synth.hpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description:
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef TMS9919_SYNTH_HPP_
+#define TMS9919_SYNTH_HPP_
+
+#include "tms9919.hpp"
+
+#define SOUND_QUEUE_SIZE	4096
+
+// Band-limited step kernel: BLEP_PHASES sub-sample positions, BLEP_TAPS long
+#define BLEP_PHASES		32
+#define BLEP_TAPS		16
+#define BLEP_SHIFT		15
+
+class cSynthTMS9919 : public cTMS9919 {
+
+    enum SOUND_COMMAND_E {
+        SOUND_FREQUENCY,
+        SOUND_ATTENUATION,
+        SOUND_NOISE
+    };
+
+    // Times are in 16.16 fixed-point samples
+    struct sVoiceInfo {
+        INT32  period;
+        INT32  counter;
+        int    polarity;
+        int    level;
+        int    frequency;
+        int    attenuation;
+    };
+
+    struct sRegisterWrite {
+        UINT32 clock;
+        int    command;
+        int    voice;
+        int    value;
+    };
+
+    static INT16        sm_BlepKernel [ BLEP_PHASES ][ BLEP_TAPS ];
+    static bool         sm_KernelReady;
+
+    int                 m_VolumeTable [16];
+
+    // Register writes from the CPU thread waiting to be played
+    sRegisterWrite      m_Queue [ SOUND_QUEUE_SIZE ];
+    volatile int        m_GetIndex;
+    volatile int        m_PutIndex;
+
+    // Everything below is owned by the thread calling Render
+    sVoiceInfo          m_Info [4];
+    int                 m_ShiftRegister;
+    int                 m_NoiseGenerator;
+    int                 m_ActiveNoiseColor;
+    int                 m_MaxSamples;
+    INT32              *m_DeltaBuffer;
+    INT32               m_Integrator;
+
+    static void BuildKernel ();
+
+    void QueueWrite ( int, int, int );
+    void ApplyWrite ( const sRegisterWrite &, int );
+
+    void AddDelta ( INT32, int );
+    void UpdateLevel ( sVoiceInfo *, INT32 );
+    void RenderVoices ( int, int );
+
+protected:
+
+    bool                m_Initialized;
+    int                 m_SampleRate;
+
+    bool InitSynthesizer ( int, int );
+
+    bool Render ( INT16 *, int, UINT32 );
+
+    virtual void SetNoise ( NOISE_COLOR_E, int );
+    virtual void SetFrequency ( int, int );
+    virtual void SetAttenuation ( int, int );
+
+public:
+
+    cSynthTMS9919 ();
+    ~cSynthTMS9919 ();
+
+    virtual int SetSpeechSynthesizer ( cTMS5220 * );
+
+    int  GetSampleRate () const			{ return m_SampleRate; }
+
+private:
+
+    cSynthTMS9919 ( const cSynthTMS9919 & );   // no implementation
+    void operator = ( const cSynthTMS9919 & ); // no implementation
+
+};
+
+#endif
@@ -0,0 +1,69 @@
+//----------------------------------------------------------------------------
+//
+// File:        tms9919-wave.hpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: Offline TMS9919 audio sink that writes WAV files and checksums
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#ifndef TMS9919_WAVE_HPP_
+#define TMS9919_WAVE_HPP_
+
+#include "tms9919-synth.hpp"
+
+#define WAVE_MAX_SAMPLES	2048
+
+class cWaveTMS9919 : public cSynthTMS9919 {
+
+    FILE               *m_WaveFile;
+    FILE               *m_ChecksumFile;
+    UINT32              m_DataLength;
+
+    INT16               m_MixBuffer [ WAVE_MAX_SAMPLES ];
+
+    bool                m_ClockValid;
+    UINT32              m_RenderClock;
+    UINT32              m_Remainder;
+    int                 m_FrameCount;
+
+    void WriteHeader ();
+
+public:
+
+    cWaveTMS9919 ( int, const char *, const char * = NULL );
+    ~cWaveTMS9919 ();
+
+    bool IsOpen () const			{ return ( m_WaveFile != NULL ) || ( m_ChecksumFile != NULL ); }
+    UINT32 GetDataLength () const		{ return m_DataLength; }
+
+    // cTMS9919 public methods
+    virtual void EndFrame ( UINT32 );
+
+private:
+
+    cWaveTMS9919 ( const cWaveTMS9919 & );    // no implementation
+    void operator = ( const cWaveTMS9919 & ); // no implementation
+
+};
+
+#endif
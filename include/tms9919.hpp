@@ -62,6 +62,9 @@ public:
 
     void WriteData ( UINT8 data );
 
+    // Called at each vertical retrace with the CPU clock of the new frame
+    virtual void EndFrame ( UINT32 )		{}
+
 private:
 
     cTMS9919 ( const cTMS9919 & );        // no implementation
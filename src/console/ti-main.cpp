@@ -35,6 +35,8 @@
 #include "cartridge.hpp"
 #include "ti994a-console.hpp"
 #include "tms9918a-console.hpp"
+#include "tms9919-wave.hpp"
+#include "tms5220.hpp"
 #include "ti-disk.hpp"
 #include "screenio.hpp"
 #include "option.hpp"
@@ -43,6 +45,9 @@
 DBG_REGISTER ( __FILE__ );
 
 static char *diskImage [3];
+static int   diskSpeed [3] = { DISK_SPEED_ACCURATE, DISK_SPEED_ACCURATE, DISK_SPEED_ACCURATE };
+static char *waveFile;
+static char *checksumFile;
 
 bool ParseDisk ( const char *arg, void * )
 {
@@ -60,6 +65,47 @@ bool ParseDisk ( const char *arg, void * )
     return true;
 }
 
+bool ParseDiskSpeed ( const char *arg, void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "ParseDiskSpeed", true );
+
+    return cDiskDevice::ParseSpeed ( strchr ( arg, '=' ) + 1, ( int * ) ptr );
+}
+
+bool ParseFileName ( const char *arg, void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "ParseFileName", true );
+
+    arg = strchr ( arg, '=' ) + 1;
+
+    * ( char ** ) ptr = strdup ( arg );
+
+    return true;
+}
+
+bool ParseSampleRate ( const char *arg, void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "ParseSampleRate", true );
+
+    int freq = 0;
+
+    arg = strchr ( arg, '=' ) + 1;
+
+    if ( sscanf ( arg, "%d", &freq ) != 1 ) {
+        fprintf ( stderr, "Invalid sampling rate '%s'\n", arg );
+        return false;
+    }
+
+    if (( freq > 96000 ) || ( freq < 8000 )) {
+        fprintf ( stderr, "Sampling rate must be between 8000 and 96000\n" );
+        return false;
+    }
+
+    * ( int * ) ptr = freq;
+
+    return true;
+}
+
 bool IsType ( const char *filename, const char *type )
 {
     FUNCTION_ENTRY ( NULL, "IsType", true );
@@ -81,24 +127,36 @@ int main ( int argc, char *argv[] )
 {
     FUNCTION_ENTRY ( NULL, "main", true );
 
-    int refreshRate = 60;
+    int refreshRate  = 60;
+    int samplingRate = 44100;
+    int frames       = 0;
+    bool highLevel   = false;
 
     sOption optList [] = {
-        {  0,  "dsk*n=<filename>", OPT_NONE,                      0,     NULL,            ParseDisk,      "Use <filename> disk image for DSKn" },
-        {  0,  "NTSC",             OPT_VALUE_SET | OPT_SIZE_INT,  60,    &refreshRate,    NULL,           "Emulate a NTSC display (60Hz)" },
-        {  0,  "PAL",              OPT_VALUE_SET | OPT_SIZE_INT,  50,    &refreshRate,    NULL,           "Emulate a PAL display (50Hz)" },
-        { 'v', "verbose*=n",       OPT_VALUE_PARSE_INT,           1,     &verbose,        NULL,           "Display extra information" },
+        {  0,  "checksum=*<file>", OPT_NONE,                      0,     &checksumFile,   ParseFileName,   "Write a checksum of the audio output for each frame to <file>" },
+        {  0,  "disk-speed=*[n:]<mode>", OPT_NONE,                0,     diskSpeed,       ParseDiskSpeed,  "Disk timing (accurate, fast, or a multiplier) for all drives or DSKn" },
+        {  0,  "dsk*n=<filename>", OPT_NONE,                      0,     NULL,            ParseDisk,       "Use <filename> disk image for DSKn" },
+        {  0,  "frames=*n",        OPT_VALUE_PARSE_INT,           0,     &frames,         NULL,            "Run n frames without user interaction and exit" },
+        {  0,  "hle-disk",         OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &highLevel,      NULL,            "Handle disk DSR calls without running the controller ROM" },
+        {  0,  "NTSC",             OPT_VALUE_SET | OPT_SIZE_INT,  60,    &refreshRate,    NULL,            "Emulate a NTSC display (60Hz)" },
+        {  0,  "PAL",              OPT_VALUE_SET | OPT_SIZE_INT,  50,    &refreshRate,    NULL,            "Emulate a PAL display (50Hz)" },
+        { 's', "sample=*<freq>",   OPT_NONE,                      0,     &samplingRate,   ParseSampleRate, "Select sampling frequency for audio output" },
+        { 'v', "verbose*=n",       OPT_VALUE_PARSE_INT,           1,     &verbose,        NULL,            "Display extra information" },
+        {  0,  "wav=*<file>",      OPT_NONE,                      0,     &waveFile,       ParseFileName,   "Write the sound and speech output to WAV file <file>" },
     };
 
     int index = 1;
     index = ParseArgs ( index, argc, argv, SIZE ( optList ), optList );
 
-    SaveConsoleSettings ();
+    bool interactive = ( frames <= 0 ) ? true : false;
 
-    HideCursor ();
-    ClearScreen ();
+    if ( interactive == true ) {
+        SaveConsoleSettings ();
+        HideCursor ();
+        ClearScreen ();
+    }
 
-    cTMS9918A *vdp = new cConsoleTMS9918A ( refreshRate );
+    cTMS9918A *vdp = ( interactive == true ) ? new cConsoleTMS9918A ( refreshRate ) : new cTMS9918A ( refreshRate );
 
     const char *romFile = LocateFile ( "TI-994A.ctg", "roms" );
     if ( romFile == NULL ) {
@@ -110,9 +168,23 @@ int main ( int argc, char *argv[] )
     if ( verbose > 0 ) fprintf ( stdout, "Using system ROM \"%s\"\n", romFile );
     cCartridge *consoleROM = new cCartridge ( romFile );
 
-    cConsoleTI994A computer ( consoleROM, vdp );
+    // Sound and speech are only produced when they are going somewhere
+    cTMS9919 *sound  = NULL;
+    cTMS5220 *speech = NULL;
+
+    if (( waveFile != NULL ) || ( checksumFile != NULL )) {
+        cWaveTMS9919 *sink = new cWaveTMS9919 ( samplingRate, waveFile, checksumFile );
+        if ( sink->IsOpen () == false ) {
+            fprintf ( stderr, "Unable to create audio output file\n" );
+        }
+        sound  = sink;
+        speech = new cTMS5220 ( sound );
+    }
+
+    cConsoleTI994A computer ( consoleROM, vdp, sound, speech );
 
     cDiskDevice *disk = new cDiskDevice ( LocateFile ( "ti-disk.ctg", "roms" ));
+    disk->SetHighLevel ( highLevel );
     for ( unsigned i = 0; i < SIZE ( diskImage ); i++ ) {
         char dskName [10];
         sprintf ( dskName, "dsk%d.dsk", i + 1 );
@@ -124,6 +196,7 @@ int main ( int argc, char *argv[] )
             }
         }
         disk->LoadDisk ( i, validName );
+        disk->SetSpeed ( i, diskSpeed [i] );
     }
     computer.AddDevice ( disk );
 
@@ -145,7 +218,11 @@ int main ( int argc, char *argv[] )
         index++;
     }
 
-    computer.Run ();
+    if ( interactive == true ) {
+        computer.Run ();
+    } else {
+        computer.RunFrames ( frames );
+    }
 
     if ( ctg != NULL ) {
         computer.RemoveCartridge ( ctg );
@@ -158,10 +235,14 @@ int main ( int argc, char *argv[] )
         }
     }
 
-    ClearScreen ();
-    ShowCursor ();
+    if ( waveFile != NULL ) free ( waveFile );
+    if ( checksumFile != NULL ) free ( checksumFile );
 
-    RestoreConsoleSettings ();
+    if ( interactive == true ) {
+        ClearScreen ();
+        ShowCursor ();
+        RestoreConsoleSettings ();
+    }
 
     return 0;
 }
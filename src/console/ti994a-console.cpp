@@ -55,8 +55,8 @@ extern "C" UINT8  CpuMemory [ 0x10000 ];
 extern UINT16 DisassembleASM ( UINT16, const UINT8 *, char * );
 extern UINT16 DisassembleGPL ( UINT16, const UINT8 *, char * );
 
-cConsoleTI994A::cConsoleTI994A ( cCartridge *ctg, cTMS9918A *vdp ) :
-    cTI994A ( ctg, vdp ),
+cConsoleTI994A::cConsoleTI994A ( cCartridge *ctg, cTMS9918A *vdp, cTMS9919 *sound, cTMS5220 *speech ) :
+    cTI994A ( ctg, vdp, sound, speech ),
     m_CapsLock ( false ),
     m_ColumnSelect ( 0 ),
     m_KeyHead ( 0 ),
@@ -206,6 +206,24 @@ void cConsoleTI994A::Run ()
     m_CPU->DeRegisterDebugHandler ();
 }
 
+// Run without any user interaction for the given number of video frames
+void cConsoleTI994A::RunFrames ( int frames )
+{
+    UINT32 lastRetrace = m_LastRetrace;
+
+    while ( frames > 0 ) {
+
+        Step ();
+
+        TimerHookProc ();
+
+        if ( m_LastRetrace != lastRetrace ) {
+            lastRetrace = m_LastRetrace;
+            frames--;
+        }
+    }
+}
+
 bool cConsoleTI994A::Step ()
 {
     m_CPU->Step ();
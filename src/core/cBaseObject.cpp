@@ -18,6 +18,14 @@
 
 #include <typeinfo>
 
+#if defined ( DEBUG )
+    #if defined ( OS_WINDOWS )
+        #include <windows.h>
+    #else
+        #include <pthread.h>
+    #endif
+#endif
+
 #include "common.hpp"
 #include "logger.hpp"
 #include "iBaseObject.hpp"
@@ -29,10 +37,37 @@ DBG_REGISTER ( __FILE__ );
 
     cBaseObject::tBaseObjectMap cBaseObject::sm_ActiveObjects;
 
+    // Objects are created and destroyed on several threads at once (catalog, disk --batch)
+#if defined ( OS_WINDOWS )
+    struct sActiveObjectsLock {
+        CRITICAL_SECTION    Lock;
+        sActiveObjectsLock () { InitializeCriticalSection ( &Lock ); }
+    };
+
+    // Initialized on first use so objects created during static initialization are still tracked
+    static CRITICAL_SECTION *ActiveObjectsLock ()
+    {
+        FUNCTION_ENTRY ( NULL, "ActiveObjectsLock", true );
+
+        static sActiveObjectsLock lock;
+
+        return &lock.Lock;
+    }
+
+    #define LOCK_ACTIVE_OBJECTS()       EnterCriticalSection ( ActiveObjectsLock ())
+    #define UNLOCK_ACTIVE_OBJECTS()     LeaveCriticalSection ( ActiveObjectsLock ())
+#else
+    static pthread_mutex_t activeObjectsLock = PTHREAD_MUTEX_INITIALIZER;
+    #define LOCK_ACTIVE_OBJECTS()       pthread_mutex_lock ( &activeObjectsLock )
+    #define UNLOCK_ACTIVE_OBJECTS()     pthread_mutex_unlock ( &activeObjectsLock )
+#endif
+
     void cBaseObject::Check ()
     {
         FUNCTION_ENTRY ( NULL, "Check", true );
 
+        LOCK_ACTIVE_OBJECTS ();
+
         size_t count = sm_ActiveObjects.size ();
 
         if ( count != 0 ) {
@@ -43,6 +78,8 @@ DBG_REGISTER ( __FILE__ );
                 iter++;
             }
         }
+
+        UNLOCK_ACTIVE_OBJECTS ();
     }
 
     static int x = atexit ( cBaseObject::Check );
@@ -67,7 +104,9 @@ cBaseObject::cBaseObject ( const char *name ) :
 
     AddOwner ( NULL );
 
+    LOCK_ACTIVE_OBJECTS ();
     sm_ActiveObjects[this] = this;
+    UNLOCK_ACTIVE_OBJECTS ();
 #else
     UNREFERENCED_PARAMETER ( name );
 #endif
@@ -97,7 +136,9 @@ cBaseObject::~cBaseObject ()
     m_ObjectName  = "<Deleted>";
     m_ObjectCount = 0;
 
+    LOCK_ACTIVE_OBJECTS ();
     sm_ActiveObjects.erase ( this );
+    UNLOCK_ACTIVE_OBJECTS ();
 
 #endif
 
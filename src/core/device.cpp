@@ -39,7 +39,8 @@ cDevice::cDevice ( const char *filename ) :
     m_IsValid ( true ),
     m_CRU ( -1 ),
     m_pROM ( NULL ),
-    m_pCPU ( NULL )
+    m_pCPU ( NULL ),
+    m_pVDP ( NULL )
 {
     FUNCTION_ENTRY ( this, "cDevice ctor", true );
 
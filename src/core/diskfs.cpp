@@ -55,6 +55,53 @@ static inline UINT16 GetUINT16 ( const void *_ptr )
     return ( UINT16 ) (( ptr [0] << 8 ) | ptr [1] );
 }
 
+//----------------------------------------------------------------------------
+//
+// The allocation bitmap in the VIB is scanned 64 bits at a time.  Bit 0 of
+// the first byte is sector 0, so words are assembled little-endian whatever
+// the byte order of the host is.  A set bit means the sector is in use.
+//
+//----------------------------------------------------------------------------
+
+static inline UINT64 GetMapWord ( const UINT8 *map, int word )
+{
+    FUNCTION_ENTRY ( NULL, "GetMapWord", false );
+
+    const UINT8 *ptr = map + word * 8;
+
+    return (( UINT64 ) ptr [0] <<  0 ) | (( UINT64 ) ptr [1] <<  8 ) | (( UINT64 ) ptr [2] << 16 ) | (( UINT64 ) ptr [3] << 24 ) |
+           (( UINT64 ) ptr [4] << 32 ) | (( UINT64 ) ptr [5] << 40 ) | (( UINT64 ) ptr [6] << 48 ) | (( UINT64 ) ptr [7] << 56 );
+}
+
+// Only valid for non-zero values
+static inline int CountTrailingZeros ( UINT64 value )
+{
+    FUNCTION_ENTRY ( NULL, "CountTrailingZeros", false );
+
+#if defined ( __GNUC__ )
+    return __builtin_ctzll ( value );
+#else
+    int count = 0;
+    while (( value & 0xFF ) == 0 ) { value >>= 8; count += 8; }
+    while (( value & 0x01 ) == 0 ) { value >>= 1; count += 1; }
+    return count;
+#endif
+}
+
+static inline int CountBits ( UINT64 value )
+{
+    FUNCTION_ENTRY ( NULL, "CountBits", false );
+
+#if defined ( __GNUC__ )
+    return __builtin_popcountll ( value );
+#else
+    value = value - (( value >> 1 ) & 0x5555555555555555ULL );
+    value = ( value & 0x3333333333333333ULL ) + (( value >> 2 ) & 0x3333333333333333ULL );
+    value = ( value + ( value >> 4 )) & 0x0F0F0F0F0F0F0F0FULL;
+    return ( int ) (( value * 0x0101010101010101ULL ) >> 56 );
+#endif
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::Open
 // Purpose:
@@ -157,6 +204,24 @@ cDiskMedia *cDiskFileSystem::GetMedia ( iBaseObject *obj ) const
     return NULL;
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::AllocationLimit
+// Purpose:     Return the number of sectors covered by the allocation bitmap
+// Parameters:
+// Returns:
+// Notes:       Some images leave the bits past the end of the disk clear - don't
+//              hand those sectors out
+//------------------------------------------------------------------------------
+int cDiskFileSystem::AllocationLimit () const
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::AllocationLimit", true );
+
+    int mapSectors       = SIZE ( m_VIB->AllocationMap ) * 8;
+    int formattedSectors = GetUINT16 ( &m_VIB->FormattedSectors );
+
+    return (( formattedSectors > 0 ) && ( formattedSectors < mapSectors )) ? formattedSectors : mapSectors;
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::FindFreeSector
 // Purpose:     Find a free sector on the disk beginning at sector 'start'
@@ -168,22 +233,63 @@ int cDiskFileSystem::FindFreeSector ( int start ) const
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::FindFreeSector", true );
 
-    int index = ( start / 8 ) * 8;
+    int limit = AllocationLimit ();
 
-    for ( unsigned i = ( start / 8 ); i < SIZE ( m_VIB->AllocationMap ); i++ ) {
-        UINT8 bits = m_VIB->AllocationMap [i];
-        for ( int j = 0; j < 8; j++ ) {
-            if ((( bits & 1 ) == 0 ) && ( index >= start )) {
-                return index;
-            }
-            index++;
-            bits >>= 1;
+    if ( start < 0 ) start = 0;
+
+    for ( int word = start / 64; word * 64 < limit; word++ ) {
+        UINT64 free = ~GetMapWord ( m_VIB->AllocationMap, word );
+        if ( word == start / 64 ) {
+            free &= ~ ( UINT64 ) 0 << ( start % 64 );
+        }
+        if ( free != 0 ) {
+            int index = word * 64 + CountTrailingZeros ( free );
+            return ( index < limit ) ? index : -1;
         }
     }
 
     return -1;
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::FindFreeSectors
+// Purpose:     Find the first run of free sectors on the disk beginning at sector 'start'
+// Parameters:
+// Returns:     The first sector of the run (or -1) and its length (up to 'max') in 'count'
+// Notes:
+//------------------------------------------------------------------------------
+int cDiskFileSystem::FindFreeSectors ( int start, int max, int *count ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::FindFreeSectors", true );
+
+    *count = 0;
+
+    int index = FindFreeSector ( start );
+    if ( index == -1 ) {
+        return -1;
+    }
+
+    int limit = min ( index + max, AllocationLimit ());
+
+    // The run ends at the next sector that is in use
+    int end = index;
+    for ( int word = index / 64; end < limit; word++ ) {
+        UINT64 used = GetMapWord ( m_VIB->AllocationMap, word );
+        if ( word == index / 64 ) {
+            used &= ~ ( UINT64 ) 0 << ( index % 64 );
+        }
+        if ( used != 0 ) {
+            end = word * 64 + CountTrailingZeros ( used );
+            break;
+        }
+        end = ( word + 1 ) * 64;
+    }
+
+    *count = min ( end, limit ) - index;
+
+    return index;
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::SetSectorAllocation
 // Purpose:     Update the allocation bitmap in the VIB for the indicated sector
@@ -206,12 +312,41 @@ void cDiskFileSystem::SetSectorAllocation ( int index, bool bUsed )
 }
 
 //------------------------------------------------------------------------------
-// Procedure:   cDiskFileSystem::FindLastSector
-// Purpose:     Return the index of the last sector of the file
+// Procedure:   cDiskFileSystem::SetSectorAllocation
+// Purpose:     Update the allocation bitmap in the VIB for a run of sectors
 // Parameters:
 // Returns:
 // Notes:
 //------------------------------------------------------------------------------
+void cDiskFileSystem::SetSectorAllocation ( int index, int count, bool bUsed )
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::SetSectorAllocation", true );
+
+    int end = index + count;
+
+    // Partial bytes at either end, whole bytes in between
+    while (( index < end ) && ( index % 8 != 0 )) {
+        SetSectorAllocation ( index++, bUsed );
+    }
+
+    int bytes = ( end - index ) / 8;
+    if ( bytes > 0 ) {
+        memset ( m_VIB->AllocationMap + index / 8, ( bUsed == true ) ? 0xFF : 0x00, bytes );
+        index += bytes * 8;
+    }
+
+    while ( index < end ) {
+        SetSectorAllocation ( index++, bUsed );
+    }
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::FindLastSector
+// Purpose:     Return the sector index of the last sector of the file
+// Parameters:
+// Returns:     The sector on the disk, or -1 if the file is empty
+// Notes:
+//------------------------------------------------------------------------------
 int cDiskFileSystem::FindLastSector ( const sFileDescriptorRecord *FDR ) const
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::FindLastSector", true );
@@ -221,7 +356,8 @@ int cDiskFileSystem::FindLastSector ( const sFileDescriptorRecord *FDR ) const
     const CHAIN *chain = FDR->DataChain;
 
     // Keep track of how many sectors we've already seen
-    int count = 0;
+    int count      = 0;
+    int lastOffset = 0;
 
     while ( count < totalSectors ) {
 
@@ -231,23 +367,30 @@ int cDiskFileSystem::FindLastSector ( const sFileDescriptorRecord *FDR ) const
 
         DBG_ASSERT ( offset > count );
 
-        count = offset;
+        lastOffset = count;
+        count      = offset;
         chain++;
     }
 
-    return count - 1;
+    if ( count == 0 ) {
+        return -1;
+    }
+
+    int start = chain[-1].start + (( int ) ( chain[-1].start_offset & 0x0F ) << 8 );
+
+    return start + ( count - lastOffset ) - 1;
 }
 
 //------------------------------------------------------------------------------
-// Procedure:   cDiskFileSystem::AddFileSector
-// Purpose:     Add the sector to the file's sector chain
+// Procedure:   cDiskFileSystem::AddFileSectors
+// Purpose:     Add a run of sectors to the file's sector chain
 // Parameters:
 // Returns:
 // Notes:
 //------------------------------------------------------------------------------
-bool cDiskFileSystem::AddFileSector ( sFileDescriptorRecord *FDR, int index )
+bool cDiskFileSystem::AddFileSectors ( sFileDescriptorRecord *FDR, int index, int length )
 {
-    FUNCTION_ENTRY ( this, "cDiskFileSystem::AddFileSector", true );
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::AddFileSectors", true );
 
     int totalSectors = GetUINT16 ( &FDR->TotalSectors );
 
@@ -267,14 +410,17 @@ bool cDiskFileSystem::AddFileSector ( sFileDescriptorRecord *FDR, int index )
         chain++;
     }
 
+    // The chain records the file-relative index of the last sector in each extent
+    int last = totalSectors + length - 1;
+
     // See if we can append to the last chain
     if ( count > 0 ) {
         int start  = chain[-1].start + (( int ) ( chain[-1].start_offset & 0x0F ) << 8 );
         int offset = (( int ) chain[-1].offset << 4 ) + ( chain[-1].start_offset >> 4 ) + 1;
         if ( index == start + offset - lastOffset ) {
-            chain[-1].start_offset = (( totalSectors & 0x0F ) << 4 ) | (( start >> 8 ) & 0x0F );
-            chain[-1].offset       = ( totalSectors >> 4 ) & 0xFF;
-            totalSectors++;
+            chain[-1].start_offset = (( last & 0x0F ) << 4 ) | (( start >> 8 ) & 0x0F );
+            chain[-1].offset       = ( last >> 4 ) & 0xFF;
+            totalSectors += length;
             FDR->TotalSectors = GetUINT16 ( &totalSectors );
             return true;
         }
@@ -283,9 +429,9 @@ bool cDiskFileSystem::AddFileSector ( sFileDescriptorRecord *FDR, int index )
     // Start a new chain if there is room
     if ( chain < FDR->DataChain + MAX_CHAINS ) {
         chain->start        = index & 0xFF;
-        chain->start_offset = (( totalSectors & 0x0F ) << 4 ) | (( index >> 8 ) & 0x0F );
-        chain->offset       = ( totalSectors >> 4 ) & 0xFF;
-        totalSectors++;
+        chain->start_offset = (( last & 0x0F ) << 4 ) | (( index >> 8 ) & 0x0F );
+        chain->offset       = ( last >> 4 ) & 0xFF;
+        totalSectors += length;
         FDR->TotalSectors = GetUINT16 ( &totalSectors );
         return true;
     }
@@ -306,19 +452,9 @@ sSector *cDiskFileSystem::FindSector ( int index )
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::FindSector", true );
 
-    int trackSize = (( m_VIB != NULL ) && ( m_VIB->SectorsPerTrack != 0 )) ? m_VIB->SectorsPerTrack : 9;
-
-    int t = index / trackSize;
-    int s = index % trackSize;
-    int h = 0;
-
-    if ( t >= m_Media->NumTracks ()) {
-        t = 2 * m_Media->NumTracks () - t - 1;
-        h = 1;
-    }
+    int t, h, s;
 
-    if ( t >= m_Media->NumTracks ()) {
-        DBG_WARNING ( "Invalid sector index (" << index << ")" );
+    if ( GetSectorLocation ( index, &t, &h, &s ) == false ) {
         return NULL;
     }
 
@@ -336,6 +472,26 @@ const sSector *cDiskFileSystem::FindSector ( int index ) const
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::FindSector", true );
 
+    int t, h, s;
+
+    if ( GetSectorLocation ( index, &t, &h, &s ) == false ) {
+        return NULL;
+    }
+
+    return m_Media->GetSector ( t, h, s );
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::GetSectorLocation
+// Purpose:     Convert a sector index into a track/side/sector on the media
+// Parameters:
+// Returns:
+// Notes:       Side 1 is numbered from the outermost track inward, as the TI-DSR does
+//------------------------------------------------------------------------------
+bool cDiskFileSystem::GetSectorLocation ( int index, int *track, int *side, int *sector ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::GetSectorLocation", true );
+
     int trackSize = (( m_VIB != NULL ) && ( m_VIB->SectorsPerTrack != 0 )) ? m_VIB->SectorsPerTrack : 9;
 
     int t = index / trackSize;
@@ -347,12 +503,58 @@ const sSector *cDiskFileSystem::FindSector ( int index ) const
         h = 1;
     }
 
-    if ( t >= m_Media->NumTracks ()) {
+    if (( index < 0 ) || ( t >= m_Media->NumTracks ())) {
         DBG_WARNING ( "Invalid sector index (" << index << ")" );
-        return NULL;
+        return false;
     }
 
-    return m_Media->GetSector ( t, h, s );
+    *track  = t;
+    *side   = h;
+    *sector = s;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::ReadSector
+// Purpose:     Copy the contents of a sector into a buffer
+// Parameters:
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+bool cDiskFileSystem::ReadSector ( int index, void *buffer ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::ReadSector", true );
+
+    const sSector *sector = FindSector ( index );
+
+    if ( sector == NULL ) return false;
+
+    memcpy ( buffer, sector->Data, DEFAULT_SECTOR_SIZE );
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::WriteSector
+// Purpose:     Replace the contents of a sector
+// Parameters:
+// Returns:
+// Notes:       Goes through the media so only the sector itself has to be saved
+//------------------------------------------------------------------------------
+bool cDiskFileSystem::WriteSector ( int index, const void *buffer )
+{
+    FUNCTION_ENTRY ( this, "cDiskFileSystem::WriteSector", true );
+
+    int t, h, s;
+
+    if (( GetSectorLocation ( index, &t, &h, &s ) == false ) || ( m_Media->GetSector ( t, h, s ) == NULL )) {
+        return false;
+    }
+
+    m_Media->WriteSector ( t, h, s, t, buffer );
+
+    return true;
 }
 
 //------------------------------------------------------------------------------
@@ -597,14 +799,15 @@ int cDiskFileSystem::FreeSectors () const
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::FreeSectors", true );
 
-    int free = 0;
+    int limit = AllocationLimit ();
+    int free  = 0;
 
-    for ( unsigned i = 0; i < SIZE ( m_VIB->AllocationMap ); i++ ) {
-        UINT8 bits = m_VIB->AllocationMap [i];
-        for ( int j = 0; j < 8; j++ ) {
-            if (( bits & 1 ) == 0 ) free++;
-            bits >>= 1;
+    for ( int word = 0; word * 64 < limit; word++ ) {
+        UINT64 bits = ~GetMapWord ( m_VIB->AllocationMap, word );
+        if ( limit - word * 64 < 64 ) {
+            bits &= (( UINT64 ) 1 << ( limit - word * 64 )) - 1;
         }
+        free += CountBits ( bits );
     }
 
     return free;
@@ -732,6 +935,47 @@ sSector *cDiskFileSystem::GetFileSector ( sFileDescriptorRecord *FDR, int index
     return NULL;
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cDiskFileSystem::GetDataChain
+// Purpose:     Find the sector used for each part of a file.
+// Parameters:  FDR - may come from a damaged disk
+//              formattedSectors - number of sectors on the disk
+//              sectors - filled in with TotalSectors sector indices
+// Returns:     false if the data chain is corrupt
+// Notes:       Uses the same rules as CheckDisk - the last chain may run past
+//              the end of the file, but every sector in it must be on the disk.
+//------------------------------------------------------------------------------
+bool cDiskFileSystem::GetDataChain ( const sFileDescriptorRecord *FDR, int formattedSectors, int *sectors )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskFileSystem::GetDataChain", true );
+
+    const CHAIN *chain = FDR->DataChain;
+    int totalSectors   = GetUINT16 ( &FDR->TotalSectors );
+
+    // Keep track of how many sectors we've already seen
+    int count = 0;
+
+    while ( count < totalSectors ) {
+
+        if ( chain >= FDR->DataChain + MAX_CHAINS ) return false;
+
+        int start  = chain->start + (( int ) ( chain->start_offset & 0x0F ) << 8 );
+        int offset = (( int ) chain->offset << 4 ) + ( chain->start_offset >> 4 ) + 1;
+
+        if (( offset <= count ) || ( start + offset - count > formattedSectors )) return false;
+
+        if ( offset > totalSectors ) offset = totalSectors;
+
+        for ( ; count < offset; count++ ) {
+            *sectors++ = start++;
+        }
+
+        chain++;
+    }
+
+    return true;
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cDiskFileSystem::ExtendFile
 // Purpose:     Increase the sector allocation for this file by 'count'.
@@ -749,39 +993,48 @@ int cDiskFileSystem::ExtendFile ( sFileDescriptorRecord *FDR, int count )
         start = 34;
     }
 
-    for ( int i = 0; i < count; i++ ) {
+    int added = 0;
 
-        int index = FindFreeSector ( start );
+    // Allocate whole runs of free sectors at a time
+    while ( added < count ) {
+
+        int length = 0;
+        int index  = FindFreeSectors ( start, count - added, &length );
         if ( index == -1 ) {
             // Can't stay contiguous, try any available sector - start at sector 34 (from TI-DSR)
-            index = FindFreeSector ( 34 );
+            index = FindFreeSectors ( 34, count - added, &length );
             if ( index == -1 ) {
                 // No 'normal' sectors left - try FDI sector range
-                index = FindFreeSector ( 0 );
+                index = FindFreeSectors ( 0, count - added, &length );
                 if ( index == -1 ) {
                     DBG_WARNING ( "Disk is full" );
-                    return i;
+                    break;
                 }
             }
         }
 
-        // Add this sector to the file chain and mark it in use
-        if ( AddFileSector ( FDR, index ) == false ) {
+        // Add these sectors to the file chain and mark them in use
+        if ( AddFileSectors ( FDR, index, length ) == false ) {
             DBG_WARNING ( "File is too fragmented" );
-            return i;
+            break;
         }
 
-        sSector *sector = FindSector ( index );
-        memset ( sector->Data, 0, DEFAULT_SECTOR_SIZE );
+        for ( int i = 0; i < length; i++ ) {
+            sSector *sector = FindSector ( index + i );
+            memset ( sector->Data, 0, DEFAULT_SECTOR_SIZE );
+        }
 
-        SetSectorAllocation ( index, true );
+        SetSectorAllocation ( index, length, true );
 
-        start = index + 1;
+        start  = index + length;
+        added += length;
+    }
 
+    if ( added > 0 ) {
         DiskModified ();
     }
 
-    return count;
+    return added;
 }
 
 //------------------------------------------------------------------------------
@@ -819,9 +1072,7 @@ void cDiskFileSystem::TruncateFile ( sFileDescriptorRecord *FDR, int limit )
         if ( limit < offset ) {
 
             // Mark the excess sectors as free
-            for ( int i = limit - count; i < offset - count; i++ ) {
-                SetSectorAllocation ( start + i, false );
-            }
+            SetSectorAllocation ( start + limit - count, offset - limit, false );
 
             // Update the chain
             chain->start        = start & 0xFF;
@@ -840,9 +1091,7 @@ void cDiskFileSystem::TruncateFile ( sFileDescriptorRecord *FDR, int limit )
         int offset = (( int ) chain->offset << 4 ) + ( chain->start_offset >> 4 ) + 1;
 
         // Mark the sectors as free
-        for ( int i = 0; i < offset - count; i++ ) {
-            SetSectorAllocation ( start + i, false );
-        }
+        SetSectorAllocation ( start, offset - count, false );
 
         chain->start        = 0;
         chain->start_offset = 0;
@@ -879,17 +1128,24 @@ void cDiskFileSystem::DiskModified ()
 // Returns:
 // Notes:
 //------------------------------------------------------------------------------
-bool cDiskFileSystem::CheckDisk () const
+bool cDiskFileSystem::CheckDisk ( bool verbose ) const
 {
     FUNCTION_ENTRY ( this, "cDiskFileSystem::CheckDisk", true );
 
     if ( m_VIB == NULL ) return false;
 
-    printf ( "Checking disk '%s'\n", m_Media->GetName ());
+    if ( verbose == true ) printf ( "Checking disk '%s'\n", m_Media->GetName ());
+
+    // The allocation bitmap can't describe more than this many sectors
+    int maxSectors = SIZE ( m_VIB->AllocationMap ) * 8;
 
     int formattedSectors = GetUINT16 ( &m_VIB->FormattedSectors );
+    if (( formattedSectors <= 0 ) || ( formattedSectors > maxSectors )) {
+        if ( verbose == true ) fprintf ( stderr, "Invalid number of formatted sectors (%d)\n", formattedSectors );
+        return false;
+    }
 
-    int allocSize = formattedSectors * sizeof ( const sFileDescriptorRecord * );
+    int allocSize = maxSectors * sizeof ( const sFileDescriptorRecord * );
 
     const sFileDescriptorRecord **allocationTable = ( const sFileDescriptorRecord ** ) alloca ( allocSize );
 
@@ -899,20 +1155,39 @@ bool cDiskFileSystem::CheckDisk () const
 
     for ( int dir = -1; dir < DirectoryCount (); dir++ ) {
 
+        // Walk the FDI by hand - a damaged disk can have entries that point anywhere
+        const sSector *dirSector = FindSector ( GetDirSector ( dir ));
+        if ( dirSector == NULL ) {
+            if ( verbose == true ) fprintf ( stderr, "Unable to read the directory index on sector %d\n", GetDirSector ( dir ));
+            isOK = false;
+            continue;
+        }
+
+        const UINT16 *dirIndex = ( const UINT16 * ) dirSector->Data;
+
+        int first     = ( dirIndex [0] == 0 ) ? 1 : 0;
         int fileCount = FileCount ( dir );
 
         // Create a list of which files are on which sectors
         for ( int i = 0; i < fileCount; i++ ) {
 
-            const sFileDescriptorRecord *FDR = GetFileDescriptor ( i, dir );
+            int index = GetUINT16 ( &dirIndex [ first + i ] );
+
+            const sSector *sector = (( index > 1 ) && ( index < formattedSectors )) ? FindSector ( index ) : NULL;
+            if ( sector == NULL ) {
+                if ( verbose == true ) fprintf ( stderr, "Directory entry %d refers to an invalid sector (%d)\n", i, index );
+                isOK = false;
+                continue;
+            }
+
+            const sFileDescriptorRecord *FDR = ( const sFileDescriptorRecord * ) sector->Data;
 
             if ( IsValidFDR ( FDR ) == false ) {
                 continue;
             }
 
-            int index = GetFileDescriptorIndex ( FDR, dir );
             if ( allocationTable [index] != NULL ) {
-                fprintf ( stderr, "File '%10.10s' is cross-linked with file '%10.10s' on sector %d\n", FDR->FileName, allocationTable [index]->FileName, index );
+                if ( verbose == true ) fprintf ( stderr, "File '%10.10s' is cross-linked with file '%10.10s' on sector %d\n", FDR->FileName, allocationTable [index]->FileName, index );
                 isOK = false;
             }
             allocationTable [index] = FDR;
@@ -925,16 +1200,28 @@ bool cDiskFileSystem::CheckDisk () const
 
             while ( count < totalSectors ) {
 
-                DBG_ASSERT ( chain < FDR->DataChain + MAX_CHAINS );
+                int start  = 0;
+                int offset = 0;
 
-                int start  = chain->start + (( int ) ( chain->start_offset & 0x0F ) << 8 );
-                int offset = (( int ) chain->offset << 4 ) + ( chain->start_offset >> 4 ) + 1;
+                if ( chain < FDR->DataChain + MAX_CHAINS ) {
+                    start  = chain->start + (( int ) ( chain->start_offset & 0x0F ) << 8 );
+                    offset = (( int ) chain->offset << 4 ) + ( chain->start_offset >> 4 ) + 1;
+                }
 
-                DBG_ASSERT ( offset > count );
+                if ( offset <= count ) {
+                    if ( verbose == true ) fprintf ( stderr, "File '%10.10s' has a corrupt data chain\n", FDR->FileName );
+                    isOK = false;
+                    break;
+                }
 
                 for ( int sector = start; sector < start + offset - count; sector++ ) {
+                    if ( sector >= formattedSectors ) {
+                        if ( verbose == true ) fprintf ( stderr, "File '%10.10s' uses sector %d past the end of the disk\n", FDR->FileName, sector );
+                        isOK = false;
+                        break;
+                    }
                     if ( allocationTable [sector] != NULL ) {
-                        fprintf ( stderr, "File '%10.10s' is cross-linked with file '%10.10s' on sector %d\n", FDR->FileName, allocationTable [sector]->FileName, sector );
+                        if ( verbose == true ) fprintf ( stderr, "File '%10.10s' is cross-linked with file '%10.10s' on sector %d\n", FDR->FileName, allocationTable [sector]->FileName, sector );
                         isOK = false;
                     }
                     allocationTable [sector] = FDR;
@@ -946,19 +1233,17 @@ bool cDiskFileSystem::CheckDisk () const
         }
     }
 
-    int index = 0;
-
-    for ( unsigned i = 0; i < SIZE ( m_VIB->AllocationMap ); i++ ) {
-        UINT8 bits = m_VIB->AllocationMap [i];
-        for ( int j = 0; j < 8; j++ ) {
-            if (( bits & 1 ) == 0 ) {
-                if ( allocationTable [index] != NULL ) {
-                    fprintf ( stderr, "Sector %d is marked as free but is used by file '%10.10s'\n", index, allocationTable [index]->FileName );
-                    isOK = false;
-                }
+    // Only the sectors marked as free need to be looked at
+    for ( int word = 0; word * 64 < formattedSectors; word++ ) {
+        UINT64 free = ~GetMapWord ( m_VIB->AllocationMap, word );
+        while ( free != 0 ) {
+            int index = word * 64 + CountTrailingZeros ( free );
+            if ( index >= formattedSectors ) break;
+            if ( allocationTable [index] != NULL ) {
+                if ( verbose == true ) fprintf ( stderr, "Sector %d is marked as free but is used by file '%10.10s'\n", index, allocationTable [index]->FileName );
+                isOK = false;
             }
-            bits >>= 1;
-            index++;
+            free &= free - 1;
         }
     }
 
@@ -1102,13 +1387,22 @@ cFile *cDiskFileSystem::CreateFile ( const char *filename, UINT8 type, int recor
         fdr.FileName [i] = ( *filename != '\0' ) ? *filename++ : ' ';
     }
 
-    fdr.FileStatus       = type;
-    fdr.RecordsPerSector = ( type & VARIABLE_TYPE ) ? ( 255 / ( recordLength + 1 )) : 256 / recordLength;
-    fdr.RecordLength     = recordLength;
+    fdr.FileStatus = type;
 
-    DBG_FATAL ( "Function not implemented yet" );
+    if (( type & PROGRAM_TYPE ) == 0 ) {
+        fdr.RecordsPerSector = ( UINT8 ) (( type & VARIABLE_TYPE ) ? ( 255 / ( recordLength + 1 )) : 256 / recordLength );
+        fdr.RecordLength     = ( UINT8 ) recordLength;
+    }
 
-    return NULL;
+    int fdrIndex = AddFileDescriptor ( &fdr, dir );
+    if ( fdrIndex == -1 ) {
+        DBG_WARNING ( "No room left in the file descriptor table" );
+        return NULL;
+    }
+
+    DiskModified ();
+
+    return cFileSystem::CreateFile (( sFileDescriptorRecord * ) FindSector ( fdrIndex )->Data );
 }
 
 
@@ -1160,7 +1454,7 @@ bool cDiskFileSystem::AddFile ( cFile *file, int dir )
     sFileDescriptorRecord *newFDR = ( sFileDescriptorRecord * ) FindSector ( fdrIndex )->Data;
 
     // This shouldn't fail since we've already checked for free space
-    if ( ExtendFile ( newFDR, totalSectors ) == false ) {
+    if ( ExtendFile ( newFDR, totalSectors ) != totalSectors ) {
         DBG_FATAL ( "Internal error: Unable to extend file" );
         DeleteFile ( FDR->FileName, dir );
         return false;
@@ -1204,7 +1498,7 @@ bool cDiskFileSystem::DeleteFile ( const char *fileName, int dir )
     int fdrIndex = GetUINT16 ( &index );
     for ( int i = start; i < 127; i++ ) {
         if ( FDI [i] == fdrIndex ) {
-            memcpy ( FDI + i, FDI + i + 1, ( 127 - i ) * sizeof ( UINT16 ));
+            memmove ( FDI + i, FDI + i + 1, ( 127 - i ) * sizeof ( UINT16 ));
             FDI [127] = 0;
             break;
         }
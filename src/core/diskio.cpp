@@ -26,20 +26,37 @@
 //
 //----------------------------------------------------------------------------
 
+#include <ctype.h>
 #include <errno.h>
+#include <limits.h>
+#include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#if defined ( OS_LINUX ) || defined ( OS_MACOSX )
+    #include <dirent.h>
+    #include <fcntl.h>
+    #include <pthread.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+#elif defined ( OS_WINDOWS )
+    #include <windows.h>
+    #include <io.h>
+    #include <sys/stat.h>
+#endif
 #include "common.hpp"
 #include "logger.hpp"
 #include "support.hpp"
 #include "diskio.hpp"
 #include "diskfs.hpp"
+#include "pseudofs.hpp"
 #include "fileio.hpp"
+#include "decodelzw.hpp"
+#include "encodelzw.hpp"
 
 DBG_REGISTER ( __FILE__ );
 
-static long CF7_DISK_SIZE = 0x0640 * 512;
-
 static inline UINT16 GetUINT16 ( const void *_ptr )
 {
     FUNCTION_ENTRY ( NULL, "GetUINT16", true );
@@ -48,38 +65,501 @@ static inline UINT16 GetUINT16 ( const void *_ptr )
     return ( UINT16 ) (( ptr [0] << 8 ) | ptr [1] );
 }
 
-size_t freadcf7 ( void *restrict ptr, size_t size, size_t nitems, FILE *restrict file )
+// CF7 cards only use the low byte of each 16-bit word
+static void copycf7 ( void *restrict dst, const void *restrict src, size_t size )
+{
+    for ( size_t i = 0; i < size; i++ ) {
+        ((char*)dst) [i] = ((const char*)src) [2*i];
+    }
+}
+
+static void expandcf7 ( void *restrict dst, const void *restrict src, size_t size )
+{
+    memset ( dst, 0, 2 * size );
+
+    for ( size_t i = 0; i < size; i++ ) {
+        ((char*)dst) [2*i] = ((const char*)src) [i];
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+// Map an entire disk image into memory.  Where mmap isn't available the file
+// is read into a buffer instead.
+//
+//----------------------------------------------------------------------------
+
+static const UINT8 *MapImage ( const char *fileName, size_t *size, bool *mapped )
 {
-    char *buffer = new char [ size * nitems * 2 ];
+    FUNCTION_ENTRY ( NULL, "MapImage", true );
+
+    *size   = 0;
+    *mapped = false;
+
+#if defined ( OS_LINUX ) || defined ( OS_MACOSX )
+
+    int fd = open ( fileName, O_RDONLY );
+    if ( fd == -1 ) return NULL;
+
+    struct stat info;
+    if (( fstat ( fd, &info ) != 0 ) || ( info.st_size == 0 )) {
+        close ( fd );
+        return NULL;
+    }
+
+    void *view = mmap ( NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+
+    close ( fd );
+
+    if ( view != MAP_FAILED ) {
+        *size   = info.st_size;
+        *mapped = true;
+        return ( const UINT8 * ) view;
+    }
+
+    DBG_WARNING ( "Unable to map file '" << fileName << "' - errno: " << errno );
+
+#endif
+
+    FILE *file = fopen ( fileName, "rb" );
+    if ( file == NULL ) return NULL;
+
+    fseek ( file, 0L, SEEK_END );
+    long fsize = ftell ( file );
+    fseek ( file, 0L, SEEK_SET );
 
-    // Read the raw sector from the disk
-    size_t read = fread ( buffer, 2 * size, nitems, file );
-    if ( read == nitems ) {
-        for ( size_t i = 0; i < size; i++ ) {
-            ((char*)ptr) [i] = buffer [2*i];
+    UINT8 *data = NULL;
+
+    if ( fsize > 0 ) {
+        data = new UINT8 [ fsize ];
+        if ( fread ( data, fsize, 1, file ) != 1 ) {
+            delete [] data;
+            data = NULL;
+        } else {
+            *size = fsize;
         }
     }
 
-    delete [] buffer;
+    fclose ( file );
 
-    return read;
+    return data;
 }
 
-static size_t fwritecf7 ( void *restrict ptr, size_t size, size_t nitems, FILE *restrict file )
+static void UnmapImage ( const UINT8 *data, size_t size, bool mapped )
 {
-    char *buffer = new char [ size * nitems * 2 ];
+    FUNCTION_ENTRY ( NULL, "UnmapImage", true );
 
-    memset ( buffer, 0, size * nitems * 2 );
+    if ( data == NULL ) return;
 
-    for ( size_t i = 0; i < size; i++ ) {
-        buffer [2*i] = ((char*)ptr) [i];
+#if defined ( OS_LINUX ) || defined ( OS_MACOSX )
+    if ( mapped == true ) {
+        munmap (( void * ) data, size );
+        return;
     }
+#endif
 
-    size_t written = fwrite ( buffer, 2 * size, nitems, file );
+    delete [] data;
+}
 
-    delete [] buffer;
+//----------------------------------------------------------------------------
+//
+// Changes are written back to an image in place.  To keep a crash part way
+// through from leaving a damaged image, the new data is first written to a
+// journal file beside the image and flushed to disk.  The journal is applied
+// to the image and then removed.  A journal that is still around when the
+// image is next loaded is applied then (or ignored if it's incomplete).
+//
+//   <"TI99JRN2"> <count:4> <checksum:4> { <offset:8> <length:4> <data...> }
+//
+// The first version ("TI99JRNL") only had room for a 4-byte offset, which
+// isn't enough for a large CF7+ image.  Those journals are still applied.
+//
+//----------------------------------------------------------------------------
+
+#define JOURNAL_MAGIC           "TI99JRN2"
+#define JOURNAL_MAGIC_V1        "TI99JRNL"
+#define JOURNAL_HEADER_SIZE     16
+#define JOURNAL_ENTRY_SIZE      12
+#define JOURNAL_ENTRY_SIZE_V1   8
+
+static inline UINT32 GetUINT32 ( const UINT8 *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "GetUINT32", true );
+
+    return ( UINT32 ) (( ptr [0] << 24 ) | ( ptr [1] << 16 ) | ( ptr [2] << 8 ) | ptr [3] );
+}
+
+static inline UINT8 *PutUINT32 ( UINT8 *ptr, UINT32 value )
+{
+    FUNCTION_ENTRY ( NULL, "PutUINT32", true );
+
+    ptr [0] = ( UINT8 ) ( value >> 24 );
+    ptr [1] = ( UINT8 ) ( value >> 16 );
+    ptr [2] = ( UINT8 ) ( value >> 8 );
+    ptr [3] = ( UINT8 ) value;
+
+    return ptr + 4;
+}
+
+static inline UINT64 GetUINT64 ( const UINT8 *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "GetUINT64", true );
+
+    return (( UINT64 ) GetUINT32 ( ptr ) << 32 ) | GetUINT32 ( ptr + 4 );
+}
+
+static inline UINT8 *PutUINT64 ( UINT8 *ptr, UINT64 value )
+{
+    FUNCTION_ENTRY ( NULL, "PutUINT64", true );
+
+    ptr = PutUINT32 ( ptr, ( UINT32 ) ( value >> 32 ));
+
+    return PutUINT32 ( ptr, ( UINT32 ) value );
+}
+
+static UINT32 Checksum ( const UINT8 *ptr, size_t size )
+{
+    FUNCTION_ENTRY ( NULL, "Checksum", true );
+
+    return HashFNV1a32 ( ptr, size );
+}
+
+// Make sure everything written to the file has actually reached the disk
+static bool SyncFile ( FILE *file )
+{
+    FUNCTION_ENTRY ( NULL, "SyncFile", true );
+
+    if ( fflush ( file ) != 0 ) return false;
+
+#if defined ( OS_LINUX ) || defined ( OS_MACOSX )
+    return ( fsync ( fileno ( file )) == 0 ) ? true : false;
+#elif defined ( OS_WINDOWS )
+    return ( _commit ( _fileno ( file )) == 0 ) ? true : false;
+#else
+    return true;
+#endif
+}
+
+static char *JournalName ( const char *fileName )
+{
+    FUNCTION_ENTRY ( NULL, "JournalName", true );
+
+    char *name = new char [ strlen ( fileName ) + strlen ( JOURNAL_SUFFIX ) + 1 ];
+    sprintf ( name, "%s%s", fileName, JOURNAL_SUFFIX );
+
+    return name;
+}
+
+// Returns the size of the entries in the journal, or 0 if it isn't a journal
+static size_t JournalEntrySize ( const UINT8 *journal )
+{
+    FUNCTION_ENTRY ( NULL, "JournalEntrySize", true );
+
+    if ( memcmp ( journal, JOURNAL_MAGIC, 8 ) == 0 ) return JOURNAL_ENTRY_SIZE;
+    if ( memcmp ( journal, JOURNAL_MAGIC_V1, 8 ) == 0 ) return JOURNAL_ENTRY_SIZE_V1;
+
+    return 0;
+}
+
+static bool IsValidJournal ( const UINT8 *journal, size_t size )
+{
+    FUNCTION_ENTRY ( NULL, "IsValidJournal", true );
+
+    size_t entrySize = ( size >= JOURNAL_HEADER_SIZE ) ? JournalEntrySize ( journal ) : 0;
+
+    if ( entrySize == 0 ) {
+        return false;
+    }
+
+    if ( GetUINT32 ( journal + 12 ) != Checksum ( journal + JOURNAL_HEADER_SIZE, size - JOURNAL_HEADER_SIZE )) {
+        return false;
+    }
+
+    // Make sure the entries account for the whole journal
+    const UINT8 *ptr = journal + JOURNAL_HEADER_SIZE;
+    const UINT8 *end = journal + size;
+
+    UINT32 count = GetUINT32 ( journal + 8 );
+
+    for ( UINT32 i = 0; i < count; i++ ) {
+        if ( ptr + entrySize > end ) return false;
+        UINT32 length = GetUINT32 ( ptr + entrySize - 4 );
+        if ( length > ( UINT32 ) ( end - ptr - entrySize )) return false;
+        ptr += entrySize + length;
+    }
+
+    return ( ptr == end ) ? true : false;
+}
+
+static bool WriteJournal ( const char *journalName, const UINT8 *journal, size_t size )
+{
+    FUNCTION_ENTRY ( NULL, "WriteJournal", true );
+
+    FILE *file = fopen ( journalName, "wb" );
+    if ( file == NULL ) {
+        DBG_ERROR ( "Unable to create journal " << journalName << " - errno: " << errno );
+        return false;
+    }
+
+    bool retVal = (( fwrite ( journal, size, 1, file ) == 1 ) && SyncFile ( file )) ? true : false;
+
+    fclose ( file );
+
+    if ( retVal == false ) {
+        DBG_ERROR ( "Error writing journal " << journalName );
+        remove ( journalName );
+    }
+
+    return retVal;
+}
+
+static bool ApplyJournal ( const char *fileName, const UINT8 *journal )
+{
+    FUNCTION_ENTRY ( NULL, "ApplyJournal", true );
+
+    FILE *file = fopen ( fileName, "rb+" );
+    if ( file == NULL ) {
+        DBG_ERROR ( "Unable to open file " << fileName << " for writing (mode 'rb+') - errno: " << errno );
+        return false;
+    }
+
+    bool retVal = true;
+
+    UINT32 count     = GetUINT32 ( journal + 8 );
+    size_t entrySize = JournalEntrySize ( journal );
+
+    const UINT8 *ptr = journal + JOURNAL_HEADER_SIZE;
+
+    for ( UINT32 i = 0; i < count; i++ ) {
+        UINT64 offset = ( entrySize == JOURNAL_ENTRY_SIZE ) ? GetUINT64 ( ptr ) : GetUINT32 ( ptr );
+        UINT32 length = GetUINT32 ( ptr + entrySize - 4 );
+        ptr += entrySize;
+        // fseek can't reach past LONG_MAX, but then neither could ftell when the offsets were recorded
+        if (( offset > ( UINT64 ) LONG_MAX ) || ( fseek ( file, ( long ) offset, SEEK_SET ) != 0 ) || ( fwrite ( ptr, length, 1, file ) != 1 )) {
+            retVal = false;
+            break;
+        }
+        ptr += length;
+    }
+
+    if ( SyncFile ( file ) == false ) retVal = false;
+
+    fclose ( file );
+
+    if ( retVal == false ) {
+        DBG_ERROR ( "Error writing to file " << fileName );
+    }
+
+    return retVal;
+}
+
+// Finish off a write-back that was interrupted before the image was last closed
+static void ReplayJournal ( const char *fileName )
+{
+    FUNCTION_ENTRY ( NULL, "ReplayJournal", true );
+
+    char *journalName = JournalName ( fileName );
+
+    FILE *file = fopen ( journalName, "rb" );
+
+    if ( file != NULL ) {
+
+        fseek ( file, 0L, SEEK_END );
+        long size = ftell ( file );
+        fseek ( file, 0L, SEEK_SET );
+
+        UINT8 *journal = ( size > 0 ) ? new UINT8 [ size ] : NULL;
+
+        bool valid = (( journal != NULL ) && ( fread ( journal, size, 1, file ) == 1 ) && IsValidJournal ( journal, size )) ? true : false;
+
+        fclose ( file );
+
+        if ( valid == true ) {
+            DBG_WARNING ( "Applying journal " << journalName );
+            if ( ApplyJournal ( fileName, journal ) == true ) {
+                remove ( journalName );
+            }
+        } else {
+            // The image was never touched - the crash happened while the journal was being written
+            DBG_WARNING ( "Discarding incomplete journal " << journalName );
+            remove ( journalName );
+        }
+
+        delete [] journal;
+    }
+
+    delete [] journalName;
+}
+
+// Write the journal out, apply it and then throw it away
+static bool CommitJournal ( const char *fileName, const UINT8 *journal, size_t size )
+{
+    FUNCTION_ENTRY ( NULL, "CommitJournal", true );
+
+    char *journalName = JournalName ( fileName );
+
+    bool retVal = false;
+
+    if ( WriteJournal ( journalName, journal, size ) == true ) {
+        // If the image can't be updated now, the journal is left to be applied when it's next loaded
+        if ( ApplyJournal ( fileName, journal ) == true ) {
+            remove ( journalName );
+            retVal = true;
+        }
+    }
+
+    delete [] journalName;
+
+    return retVal;
+}
+
+//----------------------------------------------------------------------------
+//
+// A write-back is done in two parts.  The journal is built on the caller's
+// thread from the tracks in memory, so it is a snapshot of everything that
+// changed and the disk can go on being used.  Writing the journal, syncing it
+// and applying it to the image is the slow part and is left to a thread.
+//
+//----------------------------------------------------------------------------
+
+struct sWriteBack {
+    char          *FileName;
+    UINT8         *Journal;
+    size_t         Size;
+    int            Count;
+    bool           Result;
+    bool           Threaded;
+#if defined ( OS_WINDOWS )
+    HANDLE         Thread;
+#else
+    pthread_t      Thread;
+#endif
+};
+
+#if defined ( OS_WINDOWS )
+static DWORD WINAPI _WriteBackThreadProc ( LPVOID ptr )
+#else
+static void *_WriteBackThreadProc ( void *ptr )
+#endif
+{
+    FUNCTION_ENTRY ( NULL, "_WriteBackThreadProc", true );
+
+    sWriteBack *job = ( sWriteBack * ) ptr;
+
+    job->Result = CommitJournal ( job->FileName, job->Journal, job->Size );
+
+    return 0;
+}
+
+static bool StartWriteBackThread ( sWriteBack *job )
+{
+    FUNCTION_ENTRY ( NULL, "StartWriteBackThread", true );
+
+#if defined ( OS_WINDOWS )
+    job->Thread = CreateThread ( NULL, 0, _WriteBackThreadProc, job, 0, NULL );
+    return ( job->Thread != NULL ) ? true : false;
+#else
+    return ( pthread_create ( &job->Thread, NULL, _WriteBackThreadProc, job ) == 0 ) ? true : false;
+#endif
+}
+
+static void JoinWriteBackThread ( sWriteBack *job )
+{
+    FUNCTION_ENTRY ( NULL, "JoinWriteBackThread", true );
+
+#if defined ( OS_WINDOWS )
+    WaitForSingleObject ( job->Thread, INFINITE );
+    CloseHandle ( job->Thread );
+#else
+    pthread_join ( job->Thread, NULL );
+#endif
+}
+
+//----------------------------------------------------------------------------
+//
+// Compressed disk images hold the same raw tracks as a PC99 image, but each
+// track is compressed on its own so it can still be found and expanded
+// without touching the rest of the image.
+//
+//   Offset Size  Contents
+//     0000    8  "TI99TRKZ"
+//     0008    1  version
+//     0009    1  # heads
+//     000A    1  # tracks
+//     000B    1  reserved
+//     000C  4*n  offset of each track (head 0 first) - 0 if not present
+//
+// Each track is:
+//
+//   <track size:2> <stored size:2> <data...>
+//
+// The stored size has bit 15 set if the track didn't compress and is stored
+// as is.  Tracks are only expanded when they are used, and saving the image
+// again only recompresses the tracks that have changed.
+//
+//----------------------------------------------------------------------------
+
+#define COMPRESSED_MAGIC        "TI99TRKZ"
+#define COMPRESSED_VERSION      1
+#define COMPRESSED_HEADER_SIZE  12
+#define COMPRESSED_TRACK_HEADER 4
+#define COMPRESSED_RAW          0x8000
 
-    return written;
+// Compressed tracks use 15-bit LZW codes (like cartridge files)
+#define COMPRESSED_LZW_BITS     15
+
+static bool DecodeCallback ( void *, size_t size, void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "DecodeCallback", false );
+
+    * ( size_t * ) ptr += size;
+
+    return true;
+}
+
+static bool EncodeCallback ( void *, size_t size, void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "EncodeCallback", false );
+
+    * ( size_t * ) ptr = size;
+
+    return true;
+}
+
+//----------------------------------------------------------------------------
+//
+// Expand one track from a compressed image (see ReadDiskCompressed).
+//
+//----------------------------------------------------------------------------
+
+static bool ExpandTrack ( const UINT8 *data, UINT8 *buffer, size_t *size )
+{
+    FUNCTION_ENTRY ( NULL, "ExpandTrack", true );
+
+    size_t trackSize  = GetUINT16 ( data );
+    size_t storedSize = GetUINT16 ( data + 2 );
+
+    data += COMPRESSED_TRACK_HEADER;
+
+    *size = trackSize;
+
+    if ( storedSize & COMPRESSED_RAW ) {
+        if (( storedSize & ~COMPRESSED_RAW ) != trackSize ) return false;
+        memcpy ( buffer, data, trackSize );
+        return true;
+    }
+
+    if ( trackSize == 0 ) return false;
+
+    size_t count = 0;
+
+    cDecodeLZW decoder ( COMPRESSED_LZW_BITS );
+
+    decoder.SetWriteCallback ( DecodeCallback, buffer, MAX_TRACK_SIZE, &count );
+
+    if ( decoder.ParseBuffer (( void * ) data, storedSize ) != 1 ) return false;
+
+    return ( count == trackSize ) ? true : false;
 }
 
 cDiskMedia::cDiskMedia ( const char *fileName, int volume ) :
@@ -94,11 +574,23 @@ cDiskMedia::cDiskMedia ( const char *fileName, int volume ) :
     m_NumHeads ( 0 ),
     m_NumTracks ( 0 ),
     m_LastSectorIndex ( 0 ),
-    m_RawData ( NULL )
+    m_ImageData ( NULL ),
+    m_ImageSize ( 0 ),
+    m_ImageMapped ( false ),
+    m_PendingTracks ( 0 ),
+    m_SourceSectors ( 0 ),
+    m_SourceDensity ( DENSITY_UNKNOWN ),
+    m_WriteBack ( NULL ),
+    m_HostFile ( NULL ),
+    m_HostFiles ( 0 )
 {
     FUNCTION_ENTRY ( this, "cDiskMedia ctor", true );
 
     memset ( m_Track, 0, sizeof ( m_Track ));
+    memset ( m_Source, 0, sizeof ( m_Source ));
+
+    ClearChanges ();
+    ForgetLayout ();
 
     SetName ( fileName );
     LoadFile ();
@@ -116,11 +608,23 @@ cDiskMedia::cDiskMedia ( int maxTracks, int maxHeads ) :
     m_NumHeads ( 0 ),
     m_NumTracks ( 0 ),
     m_LastSectorIndex ( 0 ),
-    m_RawData ( NULL )
+    m_ImageData ( NULL ),
+    m_ImageSize ( 0 ),
+    m_ImageMapped ( false ),
+    m_PendingTracks ( 0 ),
+    m_SourceSectors ( 0 ),
+    m_SourceDensity ( DENSITY_UNKNOWN ),
+    m_WriteBack ( NULL ),
+    m_HostFile ( NULL ),
+    m_HostFiles ( 0 )
 {
     FUNCTION_ENTRY ( this, "cDiskMedia ctor", true );
 
     memset ( m_Track, 0, sizeof ( m_Track ));
+    memset ( m_Source, 0, sizeof ( m_Source ));
+
+    ClearChanges ();
+    ForgetLayout ();
 
     AllocateTracks ( maxTracks, maxHeads );
 
@@ -131,18 +635,27 @@ cDiskMedia::~cDiskMedia ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia dtor", true );
 
+    FinishWriteBack ();
+
     if ( m_HasChanged == true ) {
         SaveFile ();
     }
 
+    ForgetHostFiles ();
+
     delete [] m_FileName;
     m_FileName = NULL;
 
-    delete [] m_RawData;
-    m_RawData = NULL;
+    for ( int h = 0; h < 2; h++ ) {
+        for ( int t = 0; t < MAX_TRACKS; t++ ) {
+            delete [] m_Track [h][t].Data;
+        }
+    }
+
+    ReleaseImage ();
 }
 
-UINT8 *cDiskMedia::FindAddressMark ( UINT8 mask, UINT8 mark, eDiskDensity density, UINT8 *ptr, const UINT8 *max )
+const UINT8 *cDiskMedia::FindAddressMark ( UINT8 mask, UINT8 mark, eDiskDensity density, const UINT8 *ptr, const UINT8 *max )
 {
     FUNCTION_ENTRY ( NULL, "cDiskMedia::FindAddressMark", false );
 
@@ -169,7 +682,7 @@ restart:
     return ptr;
 }
 
-UINT8 *cDiskMedia::FindEndOfTrack ( eDiskDensity density, UINT8, int indexGapSize, UINT8 *start, const UINT8 *max )
+const UINT8 *cDiskMedia::FindEndOfTrack ( eDiskDensity density, UINT8, int indexGapSize, const UINT8 *start, const UINT8 *max )
 {
     FUNCTION_ENTRY ( NULL, "cDiskMedia::FindEndOfTrack", true );
 
@@ -178,11 +691,11 @@ UINT8 *cDiskMedia::FindEndOfTrack ( eDiskDensity density, UINT8, int indexGapSiz
 
     eotGAP = 75 * eotGAP / 100;
 
-    UINT8 *ptr = start;
+    const UINT8 *ptr = start;
 
     while ( ptr < max ) {
 
-        UINT8 *markID = FindAddressMark ( 0xFF, 0xFE, density, ptr, max );
+        const UINT8 *markID = FindAddressMark ( 0xFF, 0xFE, density, ptr, max );
         if ( markID == NULL ) return ( ptr == start ) ? NULL : ptr;
 
         int gapSize = markID - ptr;
@@ -200,7 +713,7 @@ UINT8 *cDiskMedia::FindEndOfTrack ( eDiskDensity density, UINT8, int indexGapSiz
 
         // NOTE: WD1771 controllers can use 0xF8 0xF9 0xFA or 0xFB
         // NOTE: PC controllers cannot detect 0xF9 or 0xFA marks
-        UINT8 *markData = FindAddressMark ( 0xFC, 0xF8, density, ptr, max );
+        const UINT8 *markData = FindAddressMark ( 0xFC, 0xF8, density, ptr, max );
         if ( markData == NULL ) return NULL;
 
         ptr = markData + dataSize + 2;
@@ -209,7 +722,7 @@ UINT8 *cDiskMedia::FindEndOfTrack ( eDiskDensity density, UINT8, int indexGapSiz
     return NULL;
 }
 
-eDiskFormat cDiskMedia::DetermineFormat ( FILE *file )
+eDiskFormat cDiskMedia::DetermineFormat ( const UINT8 *data, size_t size )
 {
     FUNCTION_ENTRY ( NULL, "cDiskMedia::DetermineFormat", true );
 
@@ -217,12 +730,8 @@ eDiskFormat cDiskMedia::DetermineFormat ( FILE *file )
 
     // If a volume was specified, make sure it's valid
     if ( m_VolumeIndex > 0 ) {
-        // Get the size of the file
-        fseek ( file, 0, SEEK_END );
-        long fsize = ftell ( file );
-
         // Make sure the Volume index is valid
-        long indexMax = fsize / CF7_DISK_SIZE - 1;
+        long indexMax = size / CF7_DISK_SIZE - 1;
         if (( m_VolumeIndex < 0 ) || ( m_VolumeIndex > indexMax )) {
             DBG_ERROR ( "Invalid volume index " << m_VolumeIndex + 1 << " valid range is 1-" << indexMax + 1 );
             return FORMAT_INVALID;
@@ -230,14 +739,16 @@ eDiskFormat cDiskMedia::DetermineFormat ( FILE *file )
         fstart = m_VolumeIndex * CF7_DISK_SIZE;
     }
 
-    char testBuffer [64];
-    if (( fseek ( file, fstart, SEEK_SET ) != 0 ) ||
-        ( fread ( testBuffer, sizeof ( testBuffer ), 1, file ) != 1 ) ||
-        ( fseek ( file, fstart, SEEK_SET ) != 0 )) {
+    if ( fstart + 64 > ( long ) size ) {
         DBG_ERROR ( "Unable to read from file" );
         return FORMAT_INVALID;
     }
 
+    const char *testBuffer = ( const char * ) data + fstart;
+
+    if ( memcmp ( testBuffer, COMPRESSED_MAGIC, 8 ) == 0 ) {
+        return FORMAT_COMPRESSED;
+    }
     if ( strncmp ( testBuffer + 0x0D, "DSK", 3 ) == 0 ) {
         return FORMAT_RAW_SECTOR;
     }
@@ -252,7 +763,7 @@ eDiskFormat cDiskMedia::DetermineFormat ( FILE *file )
     eDiskDensity density = ( indexGapChar != 0x4E ) ? DENSITY_SINGLE : DENSITY_DOUBLE;
 
     // Look for an ID Address Mark
-    UINT8 *markID = FindAddressMark ( 0xFF, 0xFE, density, ( UINT8 * ) testBuffer, ( UINT8 * ) testBuffer + 64 );
+    const UINT8 *markID = FindAddressMark ( 0xFF, 0xFE, density, ( const UINT8 * ) testBuffer, ( const UINT8 * ) testBuffer + 64 );
     if ( markID == NULL ) return FORMAT_UNKNOWN;
 
     // Look for a valid SYNC byte sequence
@@ -288,47 +799,79 @@ void cDiskMedia::AllocateTracks ( int maxTracks, int maxHeads )
     m_MaxHeads  = ( maxHeads != 0 ) ? maxHeads : 2;
     m_MaxTracks = ( maxTracks != 0 ) ? maxTracks : MAX_TRACKS;
 
-    UINT8 *ptr = new UINT8 [ m_MaxHeads * m_MaxTracks * MAX_TRACK_SIZE ];
-
-    delete [] m_RawData;
-    m_RawData = ptr;
-    memset ( m_RawData, 0, m_MaxHeads * m_MaxTracks * MAX_TRACK_SIZE );
+    // Track buffers are allocated as tracks are used (see AllocateTrackData)
+    for ( int h = 0; h < 2; h++ ) {
+        for ( int t = 0; t < MAX_TRACKS; t++ ) {
+            delete [] m_Track [h][t].Data;
+        }
+    }
 
     memset ( m_Track, 0, sizeof ( m_Track ));
+    memset ( m_Source, 0, sizeof ( m_Source ));
 
-    for ( int h = 0; h < m_MaxHeads; h++ ) {
-        for ( int t = 0; t < m_MaxTracks; t++ ) {
-            sTrack *track = &m_Track [h][t];
-            track->Size = 0;
-            track->Data = ptr;
-            memset ( track->Sector, 0, sizeof ( track->Sector ));
-            ptr += MAX_TRACK_SIZE;
-        }
-    }
+    m_PendingTracks = 0;
+
+    ClearChanges ();
+    ForgetLayout ();
 
     m_HasChanged = true;
 }
 
-void cDiskMedia::FormatTrack ( int tIndex, int hIndex, eDiskDensity density, int count, const sSector *info )
+void cDiskMedia::ClearChanges ()
 {
-    FUNCTION_ENTRY ( this, "cDiskMedia::FormatTrack", false );
+    FUNCTION_ENTRY ( this, "cDiskMedia::ClearChanges", true );
 
-    DBG_ASSERT (( tIndex >= 0 ) && ( tIndex < m_MaxTracks ));
-    DBG_ASSERT (( hIndex >= 0 ) && ( hIndex < m_MaxHeads ));
-    DBG_ASSERT ( density != DENSITY_UNKNOWN );
-    DBG_ASSERT (( count > 0 ) && ( count <= MAX_SECTORS ));
+    memset ( m_DirtySectors, 0, sizeof ( m_DirtySectors ));
+    memset ( m_DirtyTrack, 0, sizeof ( m_DirtyTrack ));
 
-    if ( tIndex + 1 > m_NumTracks ) m_NumTracks = tIndex + 1;
-    if ( hIndex + 1 > m_NumHeads ) m_NumHeads = hIndex + 1;
+    m_UntrackedChanges = false;
+}
 
-    sTrack *track  = &m_Track [hIndex][tIndex];
-    track->Density = density;
+// The image file no longer matches what we know about it - the next save rewrites it
+void cDiskMedia::ForgetLayout ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::ForgetLayout", true );
+
+    for ( int h = 0; h < 2; h++ ) {
+        for ( int t = 0; t < MAX_TRACKS; t++ ) {
+            m_TrackOffset [h][t] = -1;
+            m_TrackLength [h][t] = 0;
+        }
+    }
+}
+
+UINT8 *cDiskMedia::AllocateTrackData ( sTrack *track )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::AllocateTrackData", true );
+
+    if ( track->Data == NULL ) {
+        track->Data = new UINT8 [ MAX_TRACK_SIZE ];
+        memset ( track->Data, 0, MAX_TRACK_SIZE );
+    }
+
+    return track->Data;
+}
+
+void cDiskMedia::FormatTrack ( int tIndex, int hIndex, eDiskDensity density, int count, const sSector *info )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::FormatTrack", false );
+
+    DBG_ASSERT (( tIndex >= 0 ) && ( tIndex < m_MaxTracks ));
+    DBG_ASSERT (( hIndex >= 0 ) && ( hIndex < m_MaxHeads ));
+    DBG_ASSERT ( density != DENSITY_UNKNOWN );
+    DBG_ASSERT (( count > 0 ) && ( count <= MAX_SECTORS ));
+
+    if ( tIndex + 1 > m_NumTracks ) m_NumTracks = tIndex + 1;
+    if ( hIndex + 1 > m_NumHeads ) m_NumHeads = hIndex + 1;
+
+    sTrack *track  = &m_Track [hIndex][tIndex];
+    track->Density = density;
 
     sSector *sector = track->Sector;
     memcpy ( sector, info, sizeof ( sSector ) * count );
 
     UINT8 filler = ( UINT8 ) (( density == DENSITY_SINGLE ) ? 0xFF : 0x4E );
-    UINT8 *ptr = track->Data;
+    UINT8 *ptr = AllocateTrackData ( track );
 
     memset ( ptr, filler, MAX_TRACK_SIZE );
 
@@ -389,6 +932,30 @@ void cDiskMedia::FormatTrack ( int tIndex, int hIndex, eDiskDensity density, int
     ptr += eotGap - dataGap;
 
     track->Size = ptr - track->Data;
+
+    IndexTrack ( track );
+}
+
+//----------------------------------------------------------------------------
+//
+// Build the logical sector -> slot lookup table used by GetSector.  Only
+// sectors that appear more than once on a track (copy protection schemes)
+// still need to be searched for.
+//
+//----------------------------------------------------------------------------
+
+void cDiskMedia::IndexTrack ( sTrack *track )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskMedia::IndexTrack", true );
+
+    memset ( track->SectorIndex, SECTOR_NOT_FOUND, sizeof ( track->SectorIndex ));
+
+    for ( int i = 0; i < MAX_SECTORS; i++ ) {
+        const sSector *sector = &track->Sector [i];
+        if ( sector->Data == NULL ) continue;
+        UINT8 *entry = &track->SectorIndex [ sector->LogicalSector & 0xFF ];
+        *entry = ( UINT8 ) (( *entry == SECTOR_NOT_FOUND ) ? i + 1 : SECTOR_DUPLICATED );
+    }
 }
 
 static sSector sectorInfo [] = {
@@ -430,29 +997,6 @@ static sSector sectorInfo [] = {
     { 0, 0, 35, 1, NULL }
 };
 
-//----------------------------------------------------------------------------
-//
-// Format a 'standard' disk using the given parameters
-//
-//----------------------------------------------------------------------------
-
-void cDiskMedia::FormatDisk ( int noTracks, int noSides, int noSectors, eDiskDensity density )
-{
-    FUNCTION_ENTRY ( this, "cDiskMedia::ForamtDisk", true );
-
-    AllocateTracks ( noTracks, noSides );
-
-    for ( int h = 0; h < noSides; h++ ) {
-        for ( int t = 0; t < noTracks; t++ ) {
-            for ( int s = 0; s < noSectors; s++ ) {
-                sectorInfo [s].LogicalCylinder = t;
-                sectorInfo [s].LogicalSide     = h;
-            }
-            FormatTrack ( t, h, density, noSectors, sectorInfo );
-        }
-    }
-}
-
 void cDiskMedia::WriteSector ( int tIndex, int hIndex, int logSec, int logCyl, const void *data )
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::WriteSector", true );
@@ -463,6 +1007,7 @@ void cDiskMedia::WriteSector ( int tIndex, int hIndex, int logSec, int logCyl, c
 
     if ( memcmp ( sector->Data, data, 128 << sector->Size ) != 0 ) {
         memcpy ( sector->Data, data, 128 << sector->Size );
+        m_DirtySectors [hIndex][tIndex] |= ( UINT64 ) 1 << ( sector - m_Track [hIndex][tIndex].Sector );
         m_HasChanged = true;
     }
 }
@@ -477,7 +1022,8 @@ void cDiskMedia::WriteTrack ( int tIndex, int hIndex, size_t size, const UINT8 *
     if ( tIndex + 1 > m_NumTracks ) m_NumTracks = tIndex + 1;
     if ( hIndex + 1 > m_NumHeads ) m_NumHeads = hIndex + 1;
 
-    sTrack *track = &m_Track [hIndex][tIndex];
+    // Make sure we're comparing against the current contents of the track
+    sTrack *track = GetTrack ( tIndex, hIndex );
 
     if (( track->Size == size ) && ( memcmp ( track->Data, data, size ) == 0 )) {
         return;
@@ -492,33 +1038,184 @@ void cDiskMedia::WriteTrack ( int tIndex, int hIndex, size_t size, const UINT8 *
 
     sSector *sector = track->Sector;
 
-    UINT8 *ptr = track->Data;
-    UINT8 *max = track->Data + size;
+    const UINT8 *ptr = track->Data;
+    const UINT8 *max = track->Data + size;
 
     for ( EVER ) {
 
-        UINT8 *markID = FindAddressMark ( 0xFF, 0xFE, density, ptr, max );
+        const UINT8 *markID = FindAddressMark ( 0xFF, 0xFE, density, ptr, max );
         if ( markID == NULL ) break;
 
         ptr += 6;
 
-        UINT8 *markData = FindAddressMark ( 0xFC, 0xF8, density, ptr, max );
+        const UINT8 *markData = FindAddressMark ( 0xFC, 0xF8, density, ptr, max );
         if ( markData == NULL ) break;
 
         sector->LogicalCylinder = markID [0];
         sector->LogicalSide     = markID [1];
         sector->LogicalSector   = markID [2];
         sector->Size            = markID [3];
-        sector->Data            = markData;
+        sector->Data            = track->Data + ( markData - track->Data );
 
         ptr = markData + ( 128 << sector->Size ) + 2;
 
         sector++;
     }
 
+    IndexTrack ( track );
+
+    m_DirtyTrack [hIndex][tIndex] = true;
     m_HasChanged = true;
 }
 
+//----------------------------------------------------------------------------
+//
+// Remember where a track can be found in the disk image.  It won't be copied
+// out and parsed until something asks for it.
+//
+//----------------------------------------------------------------------------
+
+void cDiskMedia::SetSource ( int tIndex, int hIndex, const UINT8 *data, size_t size )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::SetSource", true );
+
+    DBG_ASSERT (( tIndex >= 0 ) && ( tIndex < m_MaxTracks ));
+    DBG_ASSERT (( hIndex >= 0 ) && ( hIndex < m_MaxHeads ));
+
+    if ( tIndex + 1 > m_NumTracks ) m_NumTracks = tIndex + 1;
+    if ( hIndex + 1 > m_NumHeads ) m_NumHeads = hIndex + 1;
+
+    sTrackSource *source = &m_Source [hIndex][tIndex];
+
+    if ( source->Pending == false ) m_PendingTracks++;
+
+    source->Pending = true;
+    source->Data    = data;
+    source->Size    = size;
+
+    // Remember where the track is so changes can be written back in place
+    m_TrackOffset [hIndex][tIndex] = data - m_ImageData;
+
+    switch ( m_Format ) {
+        case FORMAT_RAW_TRACK :
+            m_TrackLength [hIndex][tIndex] = size;
+            break;
+        case FORMAT_RAW_SECTOR :
+            m_TrackLength [hIndex][tIndex] = size * DEFAULT_SECTOR_SIZE;
+            break;
+        case FORMAT_CF7 :
+            m_TrackLength [hIndex][tIndex] = size * 2 * DEFAULT_SECTOR_SIZE;
+            break;
+        case FORMAT_COMPRESSED :
+            m_TrackLength [hIndex][tIndex] = size;
+            break;
+        default :
+            m_TrackOffset [hIndex][tIndex] = -1;
+            break;
+    }
+}
+
+void cDiskMedia::LoadTrack ( int tIndex, int hIndex )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::LoadTrack", true );
+
+    sTrackSource *source = &m_Source [hIndex][tIndex];
+
+    source->Pending = false;
+
+    // Parsing a track isn't a change to the disk
+    bool hasChanged = m_HasChanged;
+
+    switch ( m_Format ) {
+        case FORMAT_RAW_TRACK :
+            WriteTrack ( tIndex, hIndex, source->Size, source->Data );
+            break;
+        case FORMAT_COMPRESSED :
+            {
+                UINT8 buffer [ MAX_TRACK_SIZE ];
+                size_t size = 0;
+                if ( ExpandTrack ( source->Data, buffer, &size ) == false ) {
+                    DBG_ERROR ( "Unable to expand track " << tIndex << " side " << hIndex );
+                    break;
+                }
+                WriteTrack ( tIndex, hIndex, size, buffer );
+            }
+            break;
+        case FORMAT_RAW_SECTOR :
+        case FORMAT_CF7 :
+        case FORMAT_DIRECTORY :
+            {
+                sSector info [ MAX_SECTORS ];
+                memcpy ( info, sectorInfo, sizeof ( info ));
+                for ( int s = 0; s < m_SourceSectors; s++ ) {
+                    info [s].LogicalCylinder = tIndex;
+                    info [s].LogicalSide     = hIndex;
+                }
+                FormatTrack ( tIndex, hIndex, m_SourceDensity, m_SourceSectors, info );
+                sSector *sector = m_Track [hIndex][tIndex].Sector;
+                for ( size_t s = 0; s < source->Size; s++ ) {
+                    if ( m_Format == FORMAT_CF7 ) {
+                        copycf7 ( sector [s].Data, source->Data + s * 2 * DEFAULT_SECTOR_SIZE, DEFAULT_SECTOR_SIZE );
+                    } else {
+                        memcpy ( sector [s].Data, source->Data + s * DEFAULT_SECTOR_SIZE, DEFAULT_SECTOR_SIZE );
+                    }
+                }
+                // Update the disk configuration in the VIB
+                if (( m_Format == FORMAT_CF7 ) && ( tIndex == 0 ) && ( hIndex == 0 )) {
+                    VIB *vib = ( VIB * ) sector [0].Data;
+                    vib->TracksPerSide   = m_NumTracks;
+                    vib->Sides           = m_NumHeads;
+                    vib->SectorsPerTrack = m_SourceSectors;
+                    vib->Density         = m_SourceDensity;
+                }
+            }
+            break;
+        default :
+            DBG_ERROR ( "Unexpected disk format " << m_Format );
+            break;
+    }
+
+    m_HasChanged = hasChanged;
+
+    m_DirtySectors [hIndex][tIndex] = 0;
+    m_DirtyTrack [hIndex][tIndex]   = false;
+
+    // Once every track has been parsed the image isn't needed any more
+    if ( --m_PendingTracks == 0 ) {
+        ReleaseImage ();
+    }
+}
+
+void cDiskMedia::LoadAllTracks ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::LoadAllTracks", true );
+
+    for ( int h = 0; h < 2; h++ ) {
+        for ( int t = 0; t < MAX_TRACKS; t++ ) {
+            if ( m_Source [h][t].Pending == true ) {
+                LoadTrack ( t, h );
+            }
+        }
+    }
+
+    ReleaseImage ();
+}
+
+void cDiskMedia::ReleaseImage ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::ReleaseImage", true );
+
+    // Any tracks that haven't been parsed yet are gone along with the image
+    memset ( m_Source, 0, sizeof ( m_Source ));
+    m_PendingTracks = 0;
+
+    UnmapImage ( m_ImageData, m_ImageSize, m_ImageMapped );
+
+    m_ImageData   = NULL;
+    m_ImageSize   = 0;
+    m_ImageMapped = false;
+}
+
 //----------------------------------------------------------------------------
 //
 // Read disk files that contain raw track data.  This is the format used by
@@ -527,73 +1224,49 @@ void cDiskMedia::WriteTrack ( int tIndex, int hIndex, size_t size, const UINT8 *
 //
 //----------------------------------------------------------------------------
 
-bool cDiskMedia::ReadDiskRawTrack ( FILE *file )
+bool cDiskMedia::ReadDiskRawTrack ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::ReadDiskRawTrack", true );
 
-    UINT8 trackBuffer [ 2 * MAX_TRACK_SIZE ];
+    const UINT8 *start = m_ImageData;
+    const UINT8 *end   = m_ImageData + m_ImageSize;
 
     // Find out the index GAP character (should be 0xFF or 0x4E but PC99 uses 0x00 for FM disks)
-    if ( fread ( trackBuffer, 64, 1, file ) != 1 ) {
-        DBG_ERROR ( "Error reading from file" );
-        return false;
-    }
-
-    UINT8 indexGapChar   = trackBuffer [0];
+    UINT8 indexGapChar   = start [0];
     eDiskDensity density = ( indexGapChar != 0x4E ) ? DENSITY_SINGLE : DENSITY_DOUBLE;
     size_t maxTrackSize  = 120 * (( density == DENSITY_SINGLE ) ? TRACK_SIZE_FM : TRACK_SIZE_MFM ) / 100;
 
-    UINT8 *markID = FindAddressMark ( 0xFF, 0xFE, density, trackBuffer, trackBuffer + 64 );
+    const UINT8 *markID = FindAddressMark ( 0xFF, 0xFE, density, start, start + 64 );
     if ( markID == NULL ) return false;
     if ( density == DENSITY_DOUBLE ) markID -= 3;
     markID -= 1 + (( density == DENSITY_SINGLE ) ? SYNC_BYTES_FM : SYNC_BYTES_MFM );
-    int indexGapSize = markID - trackBuffer;
+    int indexGapSize = markID - start;
 
-    sTrack trackData [ 2 * MAX_TRACKS ];
-    memset ( trackData, 0, sizeof ( trackData ));
+    const UINT8 *trackStart [ 2 * MAX_TRACKS ];
+    size_t       trackSize [ 2 * MAX_TRACKS ];
 
-    size_t count = 0;
     size_t index = 0;
 
-    fseek ( file, 0L, SEEK_SET );
-
-    for ( EVER ) {
-
-        DBG_ASSERT ( count < sizeof ( trackBuffer ));
-
-        size_t read = ( int ) fread ( trackBuffer + count, 1, sizeof ( trackBuffer ) - count, file );
-
-        if (( read == ( size_t ) EOF ) || ( read == 0 )) break;
-
-        count += read;
+    // Just find where each track starts - they're parsed when they're used
+    const UINT8 *ptr = start;
+    while (( ptr < end ) && ( index < 2 * MAX_TRACKS )) {
 
-        UINT8 *trackStart = trackBuffer;
+        size_t count = end - ptr;
+        size_t size  = count;
 
-        // trackBuffer should now contain enough data for at least 1 track
-        while ( count >= maxTrackSize ) {
-
-            UINT8 *trackEnd = FindEndOfTrack ( density, indexGapChar, indexGapSize, trackStart, trackStart + count );
+        if ( count >= maxTrackSize ) {
+            // Don't look further ahead than a couple of tracks
+            const UINT8 *max = ptr + (( count < 2 * MAX_TRACK_SIZE ) ? count : 2 * MAX_TRACK_SIZE );
+            const UINT8 *trackEnd = FindEndOfTrack ( density, indexGapChar, indexGapSize, ptr, max );
             if ( trackEnd == NULL ) return false;
-
-            size_t size = trackEnd - trackStart;
-
-            trackData [index].Size = size;
-            trackData [index].Data = new UINT8 [ size ];
-            memcpy ( trackData [index].Data, trackStart, size );
-            index++;
-
-            count      -= size;
-            trackStart += size;
+            size = trackEnd - ptr;
         }
 
-        memmove ( trackBuffer, trackStart, count );
-    }
-
-    if ( count > 0 ) {
-        trackData [index].Size = count;
-        trackData [index].Data = new UINT8 [ count ];
-        memcpy ( trackData [index].Data, trackBuffer, count );
+        trackStart [index] = ptr;
+        trackSize [index]  = size;
         index++;
+
+        ptr += size;
     }
 
     int maxTrack = MAX_TRACKS_HI;
@@ -603,19 +1276,18 @@ bool cDiskMedia::ReadDiskRawTrack ( FILE *file )
 
     // Try to distinguish between single-sided 80 tracks and double-sided 40 track disks
     if ( index == MAX_TRACKS_HI ) {
-        WriteTrack ( 0, 0, trackData [MAX_TRACKS_LO].Size, trackData [MAX_TRACKS_LO].Data );
-        sSector *sector = &m_Track [0][0].Sector [0];
-        if ( sector->LogicalSide == 1 ) maxTrack = MAX_TRACKS_LO;
-        m_Track [0][0].Size = 0;
+        const UINT8 *track = trackStart [MAX_TRACKS_LO];
+        eDiskDensity trackDensity = ( *track == 0x4E ) ? DENSITY_DOUBLE : DENSITY_SINGLE;
+        const UINT8 *id = FindAddressMark ( 0xFF, 0xFE, trackDensity, track, track + trackSize [MAX_TRACKS_LO] );
+        if (( id != NULL ) && ( id [1] == 1 )) maxTrack = MAX_TRACKS_LO;
     }
 
-    index = 0;
+    size_t i = 0;
     for ( int h = 0; h < 2; h++ ) {
         for ( int t = 0; t < MAX_TRACKS; t++ ) {
-            if (( t < maxTrack ) && ( trackData [index].Data != NULL )) {
-                WriteTrack ( t, h, trackData [index].Size, trackData [index].Data );
-                delete [] trackData [index].Data;
-                index++;
+            if (( t < maxTrack ) && ( i < index )) {
+                SetSource ( t, h, trackStart [i], trackSize [i] );
+                i++;
             }
         }
     }
@@ -634,27 +1306,21 @@ bool cDiskMedia::ReadDiskRawTrack ( FILE *file )
 //
 //----------------------------------------------------------------------------
 
-bool cDiskMedia::ReadDiskRawSector ( FILE *file )
+bool cDiskMedia::ReadDiskRawSector ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::ReadDiskRawSector", true );
 
-    fseek ( file, 0L, SEEK_END );
-    UINT32 size = ftell ( file );
-    fseek ( file, 0L, SEEK_SET );
-
-    int totalSectors = size / DEFAULT_SECTOR_SIZE;
-
-    char buffer [ DEFAULT_SECTOR_SIZE ];
+    int totalSectors = m_ImageSize / DEFAULT_SECTOR_SIZE;
 
-    // Read the 1st sector from the disk to get the VIB
-    if ( fread ( buffer, sizeof ( buffer ), 1, file ) != 1 ) {
+    // We need at least the 1st sector from the disk to get the VIB
+    if ( totalSectors == 0 ) {
         DBG_ERROR ( "Error reading from file" );
         return false;
     }
 
-    VIB *vib      = ( VIB * ) buffer;
-    int noSectors = ( vib->SectorsPerTrack != 0 ) ? vib->SectorsPerTrack : 9;
-    int noTracks  = totalSectors / noSectors;
+    const VIB *vib = ( const VIB * ) m_ImageData;
+    int noSectors  = ( vib->SectorsPerTrack != 0 ) ? vib->SectorsPerTrack : 9;
+    int noTracks   = totalSectors / noSectors;
 
     // Some TI disks don't have accurate # sides & density
     int noSides          = ( noTracks > MAX_TRACKS_LO ) ? 2 : 1;
@@ -664,23 +1330,22 @@ bool cDiskMedia::ReadDiskRawSector ( FILE *file )
     noTracks /= noSides;
 
     // Clear any old data & prepare for a new image
-    FormatDisk ( noTracks, noSides, noSectors, density );
+    AllocateTracks ( noTracks, noSides );
 
-    fseek ( file, 0L, SEEK_SET );
+    m_SourceSectors = noSectors;
+    m_SourceDensity = density;
+
+    const UINT8 *ptr = m_ImageData;
 
     for ( int h = 0; h < noSides; h++ ) {
         for ( int t = 0; t < noTracks; t++ ) {
             int track = ( h == 0 ) ? t : noTracks - ( t + 1 );
-            for ( int s = 0; s < noSectors; s++ ) {
-                if ( fread ( buffer, sizeof ( buffer ), 1, file ) != 1 ) {
-                    if ( feof ( file )) {
-                        return true;
-                    }
-                    DBG_ERROR ( "Error reading from file" );
-                    return false;
-                }
-                WriteSector ( track, h, s, track, buffer );
-            }
+            // A short file leaves the remaining sectors formatted but empty
+            int present = totalSectors - ( ptr - m_ImageData ) / DEFAULT_SECTOR_SIZE;
+            if ( present < 0 ) present = 0;
+            if ( present > noSectors ) present = noSectors;
+            SetSource ( track, h, ptr, present );
+            ptr += noSectors * DEFAULT_SECTOR_SIZE;
         }
     }
 
@@ -703,9 +1368,11 @@ struct sTrackInfo {
 // this format, it is possible to handle 'copy-protected' disks that utilize
 // non-standard disk formatting properties.
 //
+// Sectors can appear in any order so these images are parsed up front.
+//
 //----------------------------------------------------------------------------
 
-bool cDiskMedia::ReadDiskAnadisk ( FILE *file )
+bool cDiskMedia::ReadDiskAnadisk ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::ReadDiskAnadisk", true );
 
@@ -713,24 +1380,27 @@ bool cDiskMedia::ReadDiskAnadisk ( FILE *file )
     memset ( info, 0, sizeof ( info ));
 
     // Make a 1st pass to see what the disk looks like
-    fseek ( file, 0L, SEEK_SET );
+    const UINT8 *ptr = m_ImageData;
+    const UINT8 *end = m_ImageData + m_ImageSize;
 
     int noHeads  = -1;
     int noTracks = -1;
 
-    for ( EVER ) {
+    while ( ptr + sizeof ( sAnadiskHeader ) <= end ) {
 
         sAnadiskHeader header;
-        if ( fread ( &header, sizeof ( sAnadiskHeader ), 1, file ) != 1 ) break;
+        memcpy ( &header, ptr, sizeof ( sAnadiskHeader ));
 
         if (( header.ActualSide >= 2 ) || ( header.ActualCylinder >= MAX_TRACKS )) {
-            DBG_WARNING ( "Bad header at offset " << hex << ftell ( file ) - sizeof ( sAnadiskHeader ));
+            DBG_WARNING ( "Bad header at offset " << hex << ptr - m_ImageData );
             if (( noHeads == -1 ) || ( noTracks == -1 )) {
                 return false;
             }
             break;
         }
 
+        ptr += sizeof ( sAnadiskHeader );
+
         if ( header.ActualSide > noHeads ) noHeads = header.ActualSide;
         if ( header.ActualCylinder > noTracks ) noTracks = header.ActualCylinder;
 
@@ -744,15 +1414,17 @@ bool cDiskMedia::ReadDiskAnadisk ( FILE *file )
         sector->Size            = header.Length;
 
         // Make sure we handle this properly on big-endian machines
-        UINT8 *ptr = ( UINT8 * ) &header.DataCount;
-        int size = ( ptr [1] << 8 ) | ptr [0];
+        UINT8 *count = ( UINT8 * ) &header.DataCount;
+        int size = ( count [1] << 8 ) | count [0];
 
         if ( size > 0 ) {
-            sector->Data = new UINT8 [ size ];
-            if ( fread ( sector->Data, size, 1, file ) != 1 ) {
+            if ( ptr + size > end ) {
                 DBG_ERROR ( "Unable to read sector data" );
                 return false;
             }
+            // Sector data is copied straight from the image below
+            sector->Data = ( UINT8 * ) ptr;
+            ptr += size;
         }
 
         track->noSectors++;
@@ -769,8 +1441,8 @@ bool cDiskMedia::ReadDiskAnadisk ( FILE *file )
             eDiskDensity density = ( info [h][t].totalSize > TRACK_SIZE_FM ) ? DENSITY_DOUBLE : DENSITY_SINGLE;
             FormatTrack ( t, h, density, info [h][t].noSectors, info [h][t].sector );
             for ( int s = 0; s < info [h][t].noSectors; s++ ) {
+                if ( info [h][t].sector [s].Data == NULL ) continue;
                 WriteSector ( t, h, info [h][t].sector [s].LogicalSector, info [h][t].sector [s].LogicalCylinder, info [h][t].sector [s].Data );
-                delete [] info [h][t].sector [s].Data;
             }
         }
     }
@@ -780,18 +1452,14 @@ bool cDiskMedia::ReadDiskAnadisk ( FILE *file )
     return true;
 }
 
-bool cDiskMedia::ReadDiskCF7 ( FILE *file )
+bool cDiskMedia::ReadDiskCF7 ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::ReadDiskCF", true );
 
-    long fstart = m_VolumeIndex * CF7_DISK_SIZE;
-
-    fseek ( file, fstart, SEEK_SET );
+    size_t fstart = ( m_VolumeIndex > 0 ) ? m_VolumeIndex * CF7_DISK_SIZE : 0;
 
-    char buffer [ DEFAULT_SECTOR_SIZE ];
-
-    // Read the 1st sector from the disk to get the VIB
-    if ( freadcf7 ( buffer, sizeof ( buffer ), 1, file ) != 1 ) {
+    // We need at least the 1st sector from the disk to get the VIB
+    if ( fstart + 2 * DEFAULT_SECTOR_SIZE > m_ImageSize ) {
         DBG_ERROR ( "Error reading from file" );
         return false;
     }
@@ -803,133 +1471,641 @@ bool cDiskMedia::ReadDiskCF7 ( FILE *file )
     eDiskDensity density   = DENSITY_DOUBLE;
 
     // Clear any old data & prepare for a new image
-    FormatDisk ( noTracks, noSides, noSectors, density );
+    AllocateTracks ( noTracks, noSides );
+
+    m_SourceSectors = noSectors;
+    m_SourceDensity = density;
+
+    int totalSectors = ( m_ImageSize - fstart ) / ( 2 * DEFAULT_SECTOR_SIZE );
 
-    fseek ( file, fstart, SEEK_SET );
+    const UINT8 *base = m_ImageData + fstart;
+    const UINT8 *ptr  = base;
 
     for ( int h = 0; h < noSides; h++ ) {
         for ( int t = 0; t < noTracks; t++ ) {
             int track = ( h == 0 ) ? t : noTracks - ( t + 1 );
-            for ( int s = 0; s < noSectors; s++ ) {
-                if ( freadcf7 ( buffer, sizeof ( buffer ), 1, file ) != 1 ) {
-                    if ( feof ( file )) {
-                        return true;
-                    }
-                    DBG_ERROR ( "Error reading from file" );
-                    return false;
-                }
-                WriteSector ( track, h, s, track, buffer );
-            }
+            int present = totalSectors - ( ptr - base ) / ( 2 * DEFAULT_SECTOR_SIZE );
+            if ( present < 0 ) present = 0;
+            if ( present > noSectors ) present = noSectors;
+            SetSource ( track, h, ptr, present );
+            ptr += noSectors * 2 * DEFAULT_SECTOR_SIZE;
         }
     }
 
-    // Update the disk configuration in the VIB
-    sSector *sector = GetSector ( 0, 0, 0 );
-
-    VIB *vib      = ( VIB * ) sector->Data;
-    vib->TracksPerSide   = noTracks;
-    vib->Sides           = noSides;
-    vib->SectorsPerTrack = noSectors;
-    vib->Density         = density;
-
     DBG_EVENT ( "Disk loaded" );
 
     return true;
 }
 
-bool cDiskMedia::LoadFile ()
-{
-    FUNCTION_ENTRY ( this, "cDiskMedia::LoadFile", true );
+//----------------------------------------------------------------------------
+//
+// Read a compressed disk image.  The tracks are only expanded when they are
+// used (see ExpandTrack).
+//
+//----------------------------------------------------------------------------
 
-    m_Format = FORMAT_INVALID;
+bool cDiskMedia::ReadDiskCompressed ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::ReadDiskCompressed", true );
 
-    if ( m_FileName == NULL ) {
-        DBG_ERROR ( "No filename specified" );
+    if (( m_ImageSize < COMPRESSED_HEADER_SIZE ) || ( m_ImageData [8] != COMPRESSED_VERSION )) {
+        DBG_ERROR ( "Unsupported compressed disk image" );
         return false;
     }
 
-    bool retVal = false;
-    const char *errMsg = NULL;
-
-    FILE *file = fopen ( m_FileName, "rb" );
+    int noSides  = m_ImageData [9];
+    int noTracks = m_ImageData [10];
 
-    if ( file == NULL ) {
-        errMsg = "Unable to open";
-    } else {
-        errMsg = "Error reading";
-        switch ( m_Format = DetermineFormat ( file )) {
-            case FORMAT_RAW_TRACK :
-                retVal = ReadDiskRawTrack ( file );
-                break;
-            case FORMAT_RAW_SECTOR :
-                retVal = ReadDiskRawSector ( file );
-                break;
-            case FORMAT_ANADISK :
-                retVal = ReadDiskAnadisk ( file );
-                break;
-            case FORMAT_CF7 :
-                retVal = ReadDiskCF7 ( file );
-                break;
-            default :
-                errMsg = "Unable to determine format of";
-                break;
-        }
-
-        fclose ( file );
+    if (( noSides < 1 ) || ( noSides > 2 ) || ( noTracks < 1 ) || ( noTracks > MAX_TRACKS )) {
+        DBG_ERROR ( "Invalid disk geometry: " << noSides << " sides, " << noTracks << " tracks" );
+        return false;
     }
 
-    m_IsWriteProtected = false;
+    const UINT8 *table = m_ImageData + COMPRESSED_HEADER_SIZE;
 
-    if ( retVal != true ) {
-        DBG_WARNING ( errMsg << " disk image '" << m_FileName << '\'' );
-        if ( m_Format != FORMAT_INVALID ) {
-            AllocateTracks ( m_MaxTracks, m_MaxHeads );
-            m_Format = FORMAT_UNKNOWN;
-        }
-    } else {
-        m_IsWriteProtected = IsWriteable ( m_FileName ) ? false : true;
+    if (( size_t ) ( table - m_ImageData ) + 4 * noSides * noTracks > m_ImageSize ) {
+        DBG_ERROR ( "Track table is incomplete" );
+        return false;
     }
 
-    m_HasChanged = false;
-
-    return retVal;
-}
-
-bool cDiskMedia::IsValidRawSector ()
-{
-    FUNCTION_ENTRY ( this, "cDiskMedia::IsValidRawSector", true );
+    // Clear any old data & prepare for a new image
+    AllocateTracks ( MAX_TRACKS, 2 );
 
-    // Look for features that will get lost/destroyed if saved in raw sector format
-    for ( int h = 0; h < m_NumHeads; h++ ) {
-        for ( int t = 0; t < m_NumTracks; t++ ) {
-            int track = ( h == 0 ) ? t : m_NumTracks - ( t + 1 );
-            const sTrack *ptr = GetTrack ( track, h );
-            for ( int s = 0; s < MAX_SECTORS; s++ ) {
-                const sSector *sector = GetSector ( track, h, s );
-                if ( sector == NULL ) {
-                    if (( s == 0 ) && ( ptr->Sector [0].Data != NULL )) {
-                        return false;
-                    }
-                    continue;
-                }
-                if (( sector->Size != 1 ) || ( sector->Data [-1] != 0xFB )) {
-                    return false;
-                }
+    for ( int h = 0; h < noSides; h++ ) {
+        for ( int t = 0; t < noTracks; t++ ) {
+            size_t offset = GetUINT32 ( table );
+            table += 4;
+            if ( offset == 0 ) continue;
+            if ( offset + COMPRESSED_TRACK_HEADER > m_ImageSize ) {
+                DBG_ERROR ( "Invalid offset for track " << t << " side " << h );
+                return false;
+            }
+            const UINT8 *ptr = m_ImageData + offset;
+            size_t trackSize  = GetUINT16 ( ptr );
+            size_t storedSize = GetUINT16 ( ptr + 2 ) & ~COMPRESSED_RAW;
+            if (( trackSize > MAX_TRACK_SIZE ) || ( offset + COMPRESSED_TRACK_HEADER + storedSize > m_ImageSize )) {
+                DBG_ERROR ( "Invalid data for track " << t << " side " << h );
+                return false;
             }
+            SetSource ( t, h, ptr, COMPRESSED_TRACK_HEADER + storedSize );
         }
     }
 
+    DBG_EVENT ( "Disk loaded" );
+
     return true;
 }
 
-bool cDiskMedia::SaveDiskRawTrack ( FILE *file )
-{
+//----------------------------------------------------------------------------
+//
+// A host directory of TIFILES/FIAD files can be used as a disk.  When it is
+// loaded, a sector image is built in memory as if each file had been copied
+// to a freshly formatted disk (VIB, file descriptor index, one FDR per file
+// and each file's data in a single run).  From there on it's treated like a
+// v9t9 image, so tracks are still only parsed as they are used.
+//
+// Saving goes the other way: every file on the disk is turned back into a
+// host file, but only the files that differ from what was last read or
+// written are touched.  Files that are no longer on the disk are removed and
+// new ones are written out in TIFILES format.
+//
+//----------------------------------------------------------------------------
+
+// The smallest disk that will hold all of the files is used
+#define DIRECTORY_SECTORS_SD    720         // 40 tracks, 2 sides, 9 sectors/track
+#define DIRECTORY_SECTORS_DD    1440        // 40 tracks, 2 sides, 18 sectors/track
+
+// Where the TI Disk Manager starts putting file data on a new disk
+#define FIRST_DATA_SECTOR       34
+
+struct sHostFile {
+    char          *Name;                            // Without the path
+    char           FileName [ MAX_FILENAME ];
+    UINT8          Header [ HOST_HEADER_SIZE ];
+    UINT32         Checksum;                        // Of the file's data sectors
+};
+
+static inline void PutUINT16 ( void *_ptr, int value )
+{
+    FUNCTION_ENTRY ( NULL, "PutUINT16", true );
+
+    UINT8 *ptr = ( UINT8 * ) _ptr;
+    ptr [0] = ( UINT8 ) ( value >> 8 );
+    ptr [1] = ( UINT8 ) value;
+}
+
+static bool IsDirectory ( const char *name )
+{
+    FUNCTION_ENTRY ( NULL, "IsDirectory", true );
+
+    struct stat info;
+    if ( stat ( name, &info ) != 0 ) return false;
+
+    return (( info.st_mode & S_IFMT ) == S_IFDIR ) ? true : false;
+}
+
+static bool IsRegularFile ( const char *name )
+{
+    FUNCTION_ENTRY ( NULL, "IsRegularFile", true );
+
+    struct stat info;
+    if ( stat ( name, &info ) != 0 ) return false;
+
+    return (( info.st_mode & S_IFMT ) == S_IFREG ) ? true : false;
+}
+
+static char *HostPath ( const char *dirName, const char *name )
+{
+    FUNCTION_ENTRY ( NULL, "HostPath", true );
+
+    char *path = new char [ strlen ( dirName ) + strlen ( name ) + 2 ];
+    sprintf ( path, "%s%c%s", dirName, FILE_SEPERATOR, name );
+
+    return path;
+}
+
+static int CompareNames ( const void *ptr1, const void *ptr2 )
+{
+    FUNCTION_ENTRY ( NULL, "CompareNames", true );
+
+    return strcmp ( * ( const char * const * ) ptr1, * ( const char * const * ) ptr2 );
+}
+
+static void AddName ( char ***list, int *count, int *max, const char *name )
+{
+    FUNCTION_ENTRY ( NULL, "AddName", true );
+
+    if ( *count == *max ) {
+        *max = ( *max != 0 ) ? *max * 2 : 64;
+        char **newList = new char * [ *max ];
+        if ( *count != 0 ) memcpy ( newList, *list, *count * sizeof ( char * ));
+        delete [] *list;
+        *list = newList;
+    }
+
+    char *copy = new char [ strlen ( name ) + 1 ];
+    strcpy ( copy, name );
+
+    ( *list ) [ ( *count )++ ] = copy;
+}
+
+// Return the (sorted) names of everything in a directory that isn't hidden
+static int ListDirectory ( const char *dirName, char ***list )
+{
+    FUNCTION_ENTRY ( NULL, "ListDirectory", true );
+
+    int count = 0;
+    int max   = 0;
+
+    *list = NULL;
+
+#if defined ( OS_LINUX ) || defined ( OS_MACOSX )
+
+    DIR *dir = opendir ( dirName );
+    if ( dir == NULL ) {
+        DBG_ERROR ( "Unable to read directory '" << dirName << "' - errno: " << errno );
+        return 0;
+    }
+
+    for ( dirent *dp = readdir ( dir ); dp != NULL; dp = readdir ( dir )) {
+        if ( dp->d_name [0] == '.' ) continue;
+        AddName ( list, &count, &max, dp->d_name );
+    }
+
+    closedir ( dir );
+
+#elif defined ( OS_WINDOWS )
+
+    char *pattern = HostPath ( dirName, "*" );
+
+    _finddata_t info;
+    intptr_t handle = _findfirst ( pattern, &info );
+    if ( handle != -1 ) {
+        do {
+            if ( info.name [0] == '.' ) continue;
+            AddName ( list, &count, &max, info.name );
+        } while ( _findnext ( handle, &info ) == 0 );
+        _findclose ( handle );
+    }
+
+    delete [] pattern;
+
+#else
+
+    DBG_ERROR ( "Directory disks are not supported on this platform" );
+
+#endif
+
+    if ( count > 1 ) {
+        qsort ( *list, count, sizeof ( char * ), CompareNames );
+    }
+
+    return count;
+}
+
+// Build a host file name from a TI file name (the same way 'disk --dump' does)
+static void MakeHostName ( char *buffer, const char *fileName )
+{
+    FUNCTION_ENTRY ( NULL, "MakeHostName", true );
+
+    int length = MAX_FILENAME;
+    while (( length > 0 ) && ( fileName [ length - 1 ] == ' ' )) length--;
+
+    for ( int i = 0; i < length; i++ ) {
+        char ch = fileName [i];
+        buffer [i] = ( isalnum (( UINT8 ) ch ) || ( ch == '_' ) || ( ch == '-' )) ? ch : '_';
+    }
+
+    buffer [length] = '\0';
+}
+
+// Replace a host file only once the new one has been written out safely
+static bool WriteHostFile ( const char *dirName, const char *name, const UINT8 *data, size_t size )
+{
+    FUNCTION_ENTRY ( NULL, "WriteHostFile", true );
+
+    char *path     = HostPath ( dirName, name );
+    char *tempName = new char [ strlen ( path ) + 6 ];
+
+    // Hidden, so it can't be picked up as part of the disk
+    sprintf ( tempName, "%s%c.%s.tmp", dirName, FILE_SEPERATOR, name );
+
+    bool retVal = false;
+
+    FILE *file = fopen ( tempName, "wb" );
+    if ( file == NULL ) {
+        DBG_ERROR ( "Unable to open file " << tempName << " for writing (mode 'wb') - errno: " << errno );
+    } else {
+        retVal = (( fwrite ( data, size, 1, file ) == 1 ) && ( SyncFile ( file ) == true )) ? true : false;
+        fclose ( file );
+        if ( retVal == false ) {
+            DBG_ERROR ( "Error writing to file " << tempName );
+        }
+    }
+
+    if ( retVal == true ) {
+#if defined ( OS_WINDOWS )
+        // rename won't replace an existing file on Windows
+        remove ( path );
+#endif
+        if ( rename ( tempName, path ) != 0 ) {
+            DBG_ERROR ( "Unable to rename " << tempName << " to " << path << " - errno: " << errno );
+            retVal = false;
+        }
+    }
+
+    if ( retVal == false ) {
+        remove ( tempName );
+    }
+
+    delete [] tempName;
+    delete [] path;
+
+    return retVal;
+}
+
+// Copy a file's data sectors out of a sector image by following its data chain
+static bool ReadFileData ( const UINT8 *image, int totalSectors, const sFileDescriptorRecord *fdr, UINT8 *data )
+{
+    FUNCTION_ENTRY ( NULL, "ReadFileData", true );
+
+    int fileSectors = GetUINT16 ( &fdr->TotalSectors );
+    int *sectors    = new int [ fileSectors + 1 ];
+
+    bool retVal = cDiskFileSystem::GetDataChain ( fdr, totalSectors, sectors );
+
+    for ( int i = 0; ( retVal == true ) && ( i < fileSectors ); i++ ) {
+        memcpy ( data + i * DEFAULT_SECTOR_SIZE, image + sectors [i] * DEFAULT_SECTOR_SIZE, DEFAULT_SECTOR_SIZE );
+    }
+
+    delete [] sectors;
+
+    return retVal;
+}
+
+void cDiskMedia::ForgetHostFiles ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::ForgetHostFiles", true );
+
+    for ( int i = 0; i < m_HostFiles; i++ ) {
+        delete [] m_HostFile [i].Name;
+    }
+
+    delete [] m_HostFile;
+
+    m_HostFile  = NULL;
+    m_HostFiles = 0;
+}
+
+bool cDiskMedia::ReadDiskDirectory ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::ReadDiskDirectory", true );
+
+    ForgetHostFiles ();
+
+    m_HostFile = new sHostFile [ MAX_FILES ];
+
+    cFile *file [ MAX_FILES ];
+    int dataSectors = 0;
+
+    char **names = NULL;
+    int count = ListDirectory ( m_FileName, &names );
+
+    // Find all the TI files and sort them by name
+    for ( int i = 0; i < count; i++ ) {
+
+        char *path = HostPath ( m_FileName, names [i] );
+
+        cFile *hostFile = NULL;
+
+        if ( IsRegularFile ( path ) == true ) {
+            cPseudoFileSystem *fs = cPseudoFileSystem::Open ( path, NULL );
+            if ( fs != NULL ) {
+                if ( fs->IsValid () == true ) {
+                    hostFile = fs->OpenFile ( NULL, -1 );
+                }
+                fs->Release ( NULL );
+            }
+        }
+
+        sHostFile info;
+        memset ( &info, 0, sizeof ( info ));
+
+        if ( hostFile != NULL ) {
+            FILE *hdrFile = fopen ( path, "rb" );
+            if (( hdrFile == NULL ) || ( fread ( info.Header, sizeof ( info.Header ), 1, hdrFile ) != 1 )) {
+                hostFile->Release ( NULL );
+                hostFile = NULL;
+            }
+            if ( hdrFile != NULL ) fclose ( hdrFile );
+        }
+
+        if ( hostFile == NULL ) {
+            DBG_TRACE ( "Ignoring '" << path << "'" );
+            delete [] path;
+            continue;
+        }
+
+        const sFileDescriptorRecord *fdr = hostFile->GetFDR ();
+
+        int slot = m_HostFiles;
+        while (( slot > 0 ) && ( memcmp ( m_HostFile [ slot - 1 ].FileName, fdr->FileName, MAX_FILENAME ) > 0 )) slot--;
+
+        if (( slot > 0 ) && ( memcmp ( m_HostFile [ slot - 1 ].FileName, fdr->FileName, MAX_FILENAME ) == 0 )) {
+            DBG_WARNING ( "Ignoring '" << path << "' - there is already a file with the same name" );
+            hostFile->Release ( NULL );
+        } else if ( m_HostFiles == MAX_FILES ) {
+            DBG_WARNING ( "Ignoring '" << path << "' - too many files" );
+            hostFile->Release ( NULL );
+        } else {
+            memmove ( &m_HostFile [ slot + 1 ], &m_HostFile [ slot ], ( m_HostFiles - slot ) * sizeof ( sHostFile ));
+            memmove ( &file [ slot + 1 ], &file [ slot ], ( m_HostFiles - slot ) * sizeof ( cFile * ));
+            info.Name = names [i];
+            names [i] = NULL;
+            memcpy ( info.FileName, fdr->FileName, MAX_FILENAME );
+            cPseudoFileSystem::UpdateHeader ( fdr, info.Header );
+            m_HostFile [ slot ] = info;
+            file [ slot ] = hostFile;
+            m_HostFiles++;
+            dataSectors += GetUINT16 ( &fdr->TotalSectors );
+        }
+
+        delete [] path;
+    }
+
+    for ( int i = 0; i < count; i++ ) {
+        delete [] names [i];
+    }
+    delete [] names;
+
+    int firstData = ( 2 + m_HostFiles > FIRST_DATA_SECTOR ) ? 2 + m_HostFiles : FIRST_DATA_SECTOR;
+
+    // Leave out whatever won't fit
+    while (( m_HostFiles > 0 ) && ( firstData + dataSectors > DIRECTORY_SECTORS_DD )) {
+        sHostFile *info = &m_HostFile [ --m_HostFiles ];
+        DBG_WARNING ( "Ignoring '" << info->Name << "' - there isn't enough room on the disk" );
+        dataSectors -= GetUINT16 ( &file [ m_HostFiles ]->GetFDR ()->TotalSectors );
+        file [ m_HostFiles ]->Release ( NULL );
+        delete [] info->Name;
+        firstData = ( 2 + m_HostFiles > FIRST_DATA_SECTOR ) ? 2 + m_HostFiles : FIRST_DATA_SECTOR;
+    }
+
+    int totalSectors    = ( firstData + dataSectors <= DIRECTORY_SECTORS_SD ) ? DIRECTORY_SECTORS_SD : DIRECTORY_SECTORS_DD;
+    int sectorsPerTrack = ( totalSectors == DIRECTORY_SECTORS_SD ) ? 9 : 18;
+
+    size_t size  = totalSectors * DEFAULT_SECTOR_SIZE;
+    UINT8 *image = new UINT8 [ size ];
+    memset ( image, 0, size );
+
+    VIB *vib = ( VIB * ) image;
+
+    // Name the volume after the directory
+    const char *end   = m_FileName + strlen ( m_FileName );
+    while (( end > m_FileName + 1 ) && ( end [-1] == FILE_SEPERATOR )) end--;
+    const char *start = end;
+    while (( start > m_FileName ) && ( start [-1] != FILE_SEPERATOR )) start--;
+
+    memset ( vib->VolumeName, ' ', MAX_FILENAME );
+    for ( int i = 0; ( i < MAX_FILENAME ) && ( start + i < end ); i++ ) {
+        char ch = ( char ) toupper (( UINT8 ) start [i] );
+        vib->VolumeName [i] = (( ch == '.' ) || ( ch == ' ' ) || ( isprint (( UINT8 ) ch ) == 0 )) ? '_' : ch;
+    }
+
+    PutUINT16 ( &vib->FormattedSectors, totalSectors );
+    vib->SectorsPerTrack = ( UINT8 ) sectorsPerTrack;
+    memcpy ( vib->DSK, "DSK", 3 );
+    vib->reserved        = ' ';
+    vib->TracksPerSide   = MAX_TRACKS_LO;
+    vib->Sides           = 2;
+    vib->Density         = ( UINT8 ) (( sectorsPerTrack == 9 ) ? DENSITY_SINGLE : DENSITY_DOUBLE );
+
+    // Sectors past the end of the disk are marked as in use too
+    for ( int i = 0; i < ( int ) sizeof ( vib->AllocationMap ) * 8; i++ ) {
+        if (( i < firstData + dataSectors ) || ( i >= totalSectors )) {
+            if (( i >= 2 + m_HostFiles ) && ( i < firstData )) continue;
+            vib->AllocationMap [ i / 8 ] |= ( UINT8 ) ( 1 << ( i % 8 ));
+        }
+    }
+
+    int next = firstData;
+
+    for ( int i = 0; i < m_HostFiles; i++ ) {
+
+        const sFileDescriptorRecord *hostFDR = file [i]->GetFDR ();
+        int fileSectors = GetUINT16 ( &hostFDR->TotalSectors );
+
+        PutUINT16 ( image + DEFAULT_SECTOR_SIZE + i * 2, 2 + i );
+
+        sFileDescriptorRecord *fdr = ( sFileDescriptorRecord * ) ( image + ( 2 + i ) * DEFAULT_SECTOR_SIZE );
+        memcpy ( fdr, hostFDR, FDR_INFO_SIZE );
+
+        if ( fileSectors > 0 ) {
+            int last = fileSectors - 1;
+            fdr->DataChain [0].start        = ( UINT8 ) ( next & 0xFF );
+            fdr->DataChain [0].start_offset = ( UINT8 ) ((( last & 0x0F ) << 4 ) | (( next >> 8 ) & 0x0F ));
+            fdr->DataChain [0].offset       = ( UINT8 ) (( last >> 4 ) & 0xFF );
+        }
+
+        UINT8 *data = image + next * DEFAULT_SECTOR_SIZE;
+        for ( int s = 0; s < fileSectors; s++ ) {
+            file [i]->ReadSector ( s, data + s * DEFAULT_SECTOR_SIZE );
+        }
+
+        m_HostFile [i].Checksum = Checksum ( data, fileSectors * DEFAULT_SECTOR_SIZE );
+
+        next += fileSectors;
+
+        file [i]->Release ( NULL );
+    }
+
+    DBG_EVENT ( "Built a " << totalSectors << " sector disk from " << m_HostFiles << " files in '" << m_FileName << '\'' );
+
+    m_ImageData   = image;
+    m_ImageSize   = size;
+    m_ImageMapped = false;
+
+    return ReadDiskRawSector ();
+}
+
+bool cDiskMedia::LoadFile ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::LoadFile", true );
+
+    m_Format = FORMAT_INVALID;
+
+    if ( m_FileName == NULL ) {
+        DBG_ERROR ( "No filename specified" );
+        return false;
+    }
+
+    bool retVal = false;
+    const char *errMsg = NULL;
+
+    size_t size   = 0;
+    bool   mapped = false;
+
+    ForgetHostFiles ();
+
+    bool directory = IsDirectory ( m_FileName );
+
+    const UINT8 *data = NULL;
+
+    if ( directory == false ) {
+        ReplayJournal ( m_FileName );
+        data = MapImage ( m_FileName, &size, &mapped );
+    }
+
+    if ( directory == true ) {
+        errMsg = "Error reading";
+        // Forget about the previous image before building the new one
+        AllocateTracks ( m_MaxTracks, m_MaxHeads );
+        ReleaseImage ();
+        m_Format    = FORMAT_DIRECTORY;
+        m_NumTracks = 0;
+        m_NumHeads  = 0;
+        retVal = ReadDiskDirectory ();
+    } else if ( data == NULL ) {
+        errMsg = "Unable to open";
+    } else {
+        errMsg = "Error reading";
+        m_Format = DetermineFormat ( data, size );
+        if ( m_Format == FORMAT_INVALID ) {
+            UnmapImage ( data, size, mapped );
+        } else {
+            // Forget about the previous image before switching to the new one
+            AllocateTracks ( m_MaxTracks, m_MaxHeads );
+            ReleaseImage ();
+            m_ImageData   = data;
+            m_ImageSize   = size;
+            m_ImageMapped = mapped;
+            m_NumTracks   = 0;
+            m_NumHeads    = 0;
+        }
+        switch ( m_Format ) {
+            case FORMAT_INVALID :
+                break;
+            case FORMAT_RAW_TRACK :
+                retVal = ReadDiskRawTrack ();
+                break;
+            case FORMAT_RAW_SECTOR :
+                retVal = ReadDiskRawSector ();
+                break;
+            case FORMAT_ANADISK :
+                retVal = ReadDiskAnadisk ();
+                break;
+            case FORMAT_CF7 :
+                retVal = ReadDiskCF7 ();
+                break;
+            case FORMAT_COMPRESSED :
+                retVal = ReadDiskCompressed ();
+                break;
+            default :
+                errMsg = "Unable to determine format of";
+                break;
+        }
+    }
+
+    m_IsWriteProtected = false;
+
+    if ( retVal != true ) {
+        DBG_WARNING ( errMsg << " disk image '" << m_FileName << '\'' );
+        if ( m_Format != FORMAT_INVALID ) {
+            AllocateTracks ( m_MaxTracks, m_MaxHeads );
+            m_Format = FORMAT_UNKNOWN;
+        }
+    } else {
+        m_IsWriteProtected = IsWriteable ( m_FileName ) ? false : true;
+    }
+
+    // Nothing left to parse (or the load failed)
+    if ( m_PendingTracks == 0 ) {
+        ReleaseImage ();
+    }
+
+    ClearChanges ();
+
+    m_HasChanged = false;
+
+    return retVal;
+}
+
+bool cDiskMedia::IsValidRawSector ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::IsValidRawSector", true );
+
+    // Look for features that will get lost/destroyed if saved in raw sector format
+    for ( int h = 0; h < m_NumHeads; h++ ) {
+        for ( int t = 0; t < m_NumTracks; t++ ) {
+            int track = ( h == 0 ) ? t : m_NumTracks - ( t + 1 );
+            const sTrack *ptr = GetTrack ( track, h );
+            for ( int s = 0; s < MAX_SECTORS; s++ ) {
+                const sSector *sector = GetSector ( track, h, s );
+                if ( sector == NULL ) {
+                    if (( s == 0 ) && ( ptr->Sector [0].Data != NULL )) {
+                        return false;
+                    }
+                    continue;
+                }
+                if (( sector->Size != 1 ) || ( sector->Data [-1] != 0xFB )) {
+                    return false;
+                }
+            }
+        }
+    }
+
+    return true;
+}
+
+bool cDiskMedia::SaveDiskRawTrack ( FILE *file )
+{
     FUNCTION_ENTRY ( this, "cDiskMedia::SaveDiskRawTrack", true );
 
     for ( int h = 0; h < m_NumHeads; h++ ) {
         for ( int t = 0; t < m_NumTracks; t++ ) {
             sTrack *track = &m_Track [h][t];
             if ( track->Size != 0 ) {
+                m_TrackOffset [h][t] = ftell ( file );
+                m_TrackLength [h][t] = track->Size;
                 if ( fwrite ( track->Data, track->Size, 1, file ) != 1 ) {
                     DBG_ERROR ( "Error writing to file" );
                     return false;
@@ -948,6 +2124,8 @@ bool cDiskMedia::SaveDiskRawSector ( FILE *file )
     for ( int h = 0; h < m_NumHeads; h++ ) {
         for ( int t = 0; t < m_NumTracks; t++ ) {
             int track = ( h == 0 ) ? t : m_NumTracks - ( t + 1 );
+            long offset = ftell ( file );
+            int count = 0;
             for ( int s = 0; s < MAX_SECTORS; s++ ) {
                 const sSector *sector = GetSector ( track, h, s );
                 if ( sector == NULL ) continue;
@@ -956,7 +2134,11 @@ bool cDiskMedia::SaveDiskRawSector ( FILE *file )
                     DBG_ERROR ( "Error writing to file" );
                     return false;
                 }
+                // Sectors can only be written back in place if they're numbered 0..n-1
+                if ( s != count++ ) offset = -1;
             }
+            m_TrackOffset [h][track] = offset;
+            m_TrackLength [h][track] = count * DEFAULT_SECTOR_SIZE;
         }
     }
 
@@ -997,37 +2179,527 @@ bool cDiskMedia::SaveDiskAnadisk ( FILE *file )
     return true;
 }
 
-bool cDiskMedia::SaveDiskCF7 ( FILE *file )
+bool cDiskMedia::SaveDiskCF7 ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::SaveDiskCF7", true );
 
-    fseek ( file, m_VolumeIndex * CF7_DISK_SIZE, SEEK_SET );
-
     // TODO - Restore the disk configuration values in the VIB
 
+    // A CF7+ volume is part of a larger file, so every sector is written back in place
     for ( int h = 0; h < m_NumHeads; h++ ) {
         for ( int t = 0; t < m_NumTracks; t++ ) {
-            int track = ( h == 0 ) ? t : m_NumTracks - ( t + 1 );
+            const sTrack *track = GetTrack ( t, h );
             for ( int s = 0; s < MAX_SECTORS; s++ ) {
+                if ( track->Sector [s].Data == NULL ) continue;
+                m_DirtySectors [h][t] |= ( UINT64 ) 1 << s;
+            }
+        }
+    }
+
+    // Which covers anything the file system changed directly
+    m_UntrackedChanges = false;
+
+    if ( CanWriteBack () == false ) {
+        DBG_ERROR ( "Disk contains features that this format does not support" );
+        return false;
+    }
+
+    return WriteBack ( false );
+}
+
+//----------------------------------------------------------------------------
+//
+// Write a compressed disk image.  When the disk was read from a compressed
+// image, the tracks that haven't changed since are copied from the old image
+// as they are instead of being compressed again.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskMedia::SaveDiskCompressed ( FILE *file )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::SaveDiskCompressed", true );
+
+    long   oldOffset [ 2 ][ MAX_TRACKS ];
+    size_t oldLength [ 2 ][ MAX_TRACKS ];
+
+    memcpy ( oldOffset, m_TrackOffset, sizeof ( oldOffset ));
+    memcpy ( oldLength, m_TrackLength, sizeof ( oldLength ));
+
+    ForgetLayout ();
+
+    FILE *oldFile = NULL;
+    if (( m_Format == FORMAT_COMPRESSED ) && ( m_UntrackedChanges == false )) {
+        oldFile = fopen ( m_FileName, "rb" );
+    }
+
+    int tableSize = 4 * m_NumHeads * m_NumTracks;
+
+    UINT8 *header = new UINT8 [ COMPRESSED_HEADER_SIZE + tableSize ];
+    memset ( header, 0, COMPRESSED_HEADER_SIZE + tableSize );
+
+    memcpy ( header, COMPRESSED_MAGIC, 8 );
+    header [8]  = COMPRESSED_VERSION;
+    header [9]  = ( UINT8 ) m_NumHeads;
+    header [10] = ( UINT8 ) m_NumTracks;
+
+    UINT8 *table = header + COMPRESSED_HEADER_SIZE;
+
+    // The track table is filled in once we know where everything went
+    bool retVal = ( fwrite ( header, COMPRESSED_HEADER_SIZE + tableSize, 1, file ) == 1 ) ? true : false;
+
+    UINT8 *buffer = new UINT8 [ COMPRESSED_TRACK_HEADER + 2 * MAX_TRACK_SIZE ];
+
+    cEncodeLZW encoder ( COMPRESSED_LZW_BITS );
+
+    int reused = 0;
+
+    for ( int h = 0; ( h < m_NumHeads ) && ( retVal == true ); h++ ) {
+        for ( int t = 0; ( t < m_NumTracks ) && ( retVal == true ); t++ ) {
+
+            sTrack *track = &m_Track [h][t];
+
+            if ( track->Size == 0 ) {
+                table = PutUINT32 ( table, 0 );
+                continue;
+            }
+
+            size_t size = 0;
+
+            bool clean = (( m_DirtySectors [h][t] == 0 ) && ( m_DirtyTrack [h][t] == false )) ? true : false;
+
+            if (( oldFile != NULL ) && ( clean == true ) && ( oldOffset [h][t] != -1 ) &&
+                ( oldLength [h][t] <= COMPRESSED_TRACK_HEADER + MAX_TRACK_SIZE ) &&
+                ( fseek ( oldFile, oldOffset [h][t], SEEK_SET ) == 0 ) &&
+                ( fread ( buffer, oldLength [h][t], 1, oldFile ) == 1 )) {
+                size = oldLength [h][t];
+                reused++;
+            } else {
+                size_t outSize = 0;
+                encoder.SetWriteCallback ( EncodeCallback, buffer + COMPRESSED_TRACK_HEADER, 2 * MAX_TRACK_SIZE, &outSize );
+                if ( encoder.EncodeBuffer ( track->Data, track->Size ) != 1 ) {
+                    DBG_ERROR ( "Error compressing data" );
+                    retVal = false;
+                    break;
+                }
+                // Make sure we didn't make things worse
+                if ( outSize >= track->Size ) {
+                    memcpy ( buffer + COMPRESSED_TRACK_HEADER, track->Data, track->Size );
+                    outSize = COMPRESSED_RAW | track->Size;
+                }
+                PutUINT16 ( buffer, track->Size );
+                PutUINT16 ( buffer + 2, outSize );
+                size = COMPRESSED_TRACK_HEADER + ( outSize & ~COMPRESSED_RAW );
+            }
+
+            m_TrackOffset [h][t] = ftell ( file );
+            m_TrackLength [h][t] = size;
+
+            table = PutUINT32 ( table, m_TrackOffset [h][t] );
+
+            if ( fwrite ( buffer, size, 1, file ) != 1 ) {
+                DBG_ERROR ( "Error writing to file" );
+                retVal = false;
+            }
+        }
+    }
+
+    if ( retVal == true ) {
+        if (( fseek ( file, 0L, SEEK_SET ) != 0 ) || ( fwrite ( header, COMPRESSED_HEADER_SIZE + tableSize, 1, file ) != 1 )) {
+            DBG_ERROR ( "Error writing to file" );
+            retVal = false;
+        }
+    }
+
+    if ( oldFile != NULL ) {
+        fclose ( oldFile );
+    }
+
+    delete [] buffer;
+    delete [] header;
+
+    DBG_TRACE ( "Reused " << reused << " compressed tracks" );
+
+    return retVal;
+}
+
+bool cDiskMedia::SaveDiskDirectory ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::SaveDiskDirectory", true );
+
+    if ( m_SourceSectors == 0 ) {
+        DBG_ERROR ( "Disk was not read from a directory" );
+        return false;
+    }
+
+    // Lay the disk out as a sector image to make the files easy to find
+    int totalSectors = m_NumHeads * m_NumTracks * m_SourceSectors;
+
+    UINT8 *image = new UINT8 [ totalSectors * DEFAULT_SECTOR_SIZE ];
+    memset ( image, 0, totalSectors * DEFAULT_SECTOR_SIZE );
+
+    UINT8 *ptr = image;
+    for ( int h = 0; h < m_NumHeads; h++ ) {
+        for ( int t = 0; t < m_NumTracks; t++ ) {
+            int track = ( h == 0 ) ? t : m_NumTracks - ( t + 1 );
+            for ( int s = 0; s < m_SourceSectors; s++ ) {
                 const sSector *sector = GetSector ( track, h, s );
-                if ( sector == NULL ) continue;
-                if ( sector->Data == NULL ) break;
-                if ( fwritecf7 ( sector->Data, DEFAULT_SECTOR_SIZE , 1, file ) != 1 ) {
-                    DBG_ERROR ( "Error writing to file" );
-                    return false;
+                if (( sector != NULL ) && ( sector->Data != NULL ) && ( sector->Size == 1 )) {
+                    memcpy ( ptr, sector->Data, DEFAULT_SECTOR_SIZE );
                 }
+                ptr += DEFAULT_SECTOR_SIZE;
             }
         }
     }
 
-    return true;
+    // Find the files that are on the disk now
+    const sFileDescriptorRecord *fdr [ MAX_FILES ];
+    int hostIndex [ MAX_FILES ];
+    int files = 0;
+
+    const UINT8 *fdi = image + DEFAULT_SECTOR_SIZE;
+
+    for ( int i = 0; i < MAX_FILES; i++ ) {
+        int index = GetUINT16 ( fdi + i * 2 );
+        if ( index == 0 ) break;
+        if ( index >= totalSectors ) continue;
+        const sFileDescriptorRecord *entry = ( const sFileDescriptorRecord * ) ( image + index * DEFAULT_SECTOR_SIZE );
+        if ( cFileSystem::IsValidFDR ( entry ) == false ) {
+            DBG_WARNING ( "Invalid FDR in sector " << index );
+            continue;
+        }
+        hostIndex [files] = -1;
+        for ( int j = 0; j < m_HostFiles; j++ ) {
+            if ( memcmp ( m_HostFile [j].FileName, entry->FileName, MAX_FILENAME ) == 0 ) {
+                hostIndex [files] = j;
+                break;
+            }
+        }
+        // A damaged disk may have the same name twice - only one of them gets the host file
+        for ( int k = 0; k < files; k++ ) {
+            if ( hostIndex [k] == hostIndex [files] ) hostIndex [files] = -1;
+        }
+        fdr [files++] = entry;
+    }
+
+    bool retVal = true;
+
+    // Remove the host files for anything that's been deleted (or renamed)
+    int kept = 0;
+    for ( int j = 0; j < m_HostFiles; j++ ) {
+        int found = -1;
+        for ( int i = 0; i < files; i++ ) {
+            if ( hostIndex [i] == j ) found = i;
+        }
+        if ( found == -1 ) {
+            char *path = HostPath ( m_FileName, m_HostFile [j].Name );
+            DBG_EVENT ( "Removing '" << path << "'" );
+            if ( remove ( path ) != 0 ) {
+                DBG_ERROR ( "Unable to remove " << path << " - errno: " << errno );
+            }
+            delete [] path;
+            delete [] m_HostFile [j].Name;
+            continue;
+        }
+        hostIndex [found] = kept;
+        m_HostFile [kept++] = m_HostFile [j];
+    }
+    m_HostFiles = kept;
+
+    // Write out anything that's new or has changed
+    for ( int i = 0; i < files; i++ ) {
+
+        int fileSectors = GetUINT16 ( &fdr [i]->TotalSectors );
+
+        UINT8 *data = new UINT8 [ HOST_HEADER_SIZE + fileSectors * DEFAULT_SECTOR_SIZE ];
+
+        if ( ReadFileData ( image, totalSectors, fdr [i], data + HOST_HEADER_SIZE ) == false ) {
+            DBG_ERROR ( "File data chain is invalid - unable to save file" );
+            delete [] data;
+            retVal = false;
+            continue;
+        }
+
+        UINT32 checksum = Checksum ( data + HOST_HEADER_SIZE, fileSectors * DEFAULT_SECTOR_SIZE );
+
+        sHostFile *info = ( hostIndex [i] != -1 ) ? &m_HostFile [ hostIndex [i]] : NULL;
+
+        char newName [ MAX_FILENAME + 5 ];
+
+        if ( info != NULL ) {
+            memcpy ( data, info->Header, HOST_HEADER_SIZE );
+            cPseudoFileSystem::UpdateHeader ( fdr [i], data );
+            if (( memcmp ( data, info->Header, HOST_HEADER_SIZE ) == 0 ) && ( checksum == info->Checksum )) {
+                delete [] data;
+                continue;
+            }
+        } else {
+            cPseudoFileSystem::MakeHeader ( fdr [i], data );
+            // Don't clobber any host files that weren't part of the disk
+            char baseName [ MAX_FILENAME + 1 ];
+            MakeHostName ( baseName, fdr [i]->FileName );
+            for ( int j = 0; j < 1000; j++ ) {
+                sprintf ( newName, j ? "%s.%03d" : "%s", baseName, j );
+                char *path = HostPath ( m_FileName, newName );
+                FILE *testFile = fopen ( path, "rb" );
+                delete [] path;
+                if ( testFile == NULL ) break;
+                fclose ( testFile );
+            }
+        }
+
+        const char *name = ( info != NULL ) ? info->Name : newName;
+
+        DBG_EVENT ( "Writing '" << name << "' to '" << m_FileName << "'" );
+
+        if ( WriteHostFile ( m_FileName, name, data, HOST_HEADER_SIZE + fileSectors * DEFAULT_SECTOR_SIZE ) == true ) {
+            if (( info == NULL ) && ( m_HostFiles < MAX_FILES )) {
+                info = &m_HostFile [ m_HostFiles++ ];
+                info->Name = new char [ strlen ( newName ) + 1 ];
+                strcpy ( info->Name, newName );
+                memcpy ( info->FileName, fdr [i]->FileName, MAX_FILENAME );
+            }
+            if ( info != NULL ) {
+                memcpy ( info->Header, data, HOST_HEADER_SIZE );
+                info->Checksum = checksum;
+            }
+        } else {
+            retVal = false;
+        }
+
+        delete [] data;
+    }
+
+    delete [] image;
+
+    if ( retVal == true ) {
+        ClearChanges ();
+        m_HasChanged = false;
+    }
+
+    return retVal;
+}
+
+//----------------------------------------------------------------------------
+//
+// See if everything that's changed can be written back to the image file in
+// place.  Raw track images are updated a track at a time, and only if the
+// track is still the same size.  Raw sector and CF7 images are updated a
+// sector at a time.  A track that was reformatted has to keep its layout.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskMedia::CanWriteBack () const
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::CanWriteBack", true );
+
+    if (( m_FileName == NULL ) || ( m_UntrackedChanges == true )) return false;
+
+    if (( m_Format != FORMAT_RAW_TRACK ) && ( m_Format != FORMAT_RAW_SECTOR ) && ( m_Format != FORMAT_CF7 )) {
+        return false;
+    }
+
+    size_t sectorSize = ( m_Format == FORMAT_CF7 ) ? 2 * DEFAULT_SECTOR_SIZE : DEFAULT_SECTOR_SIZE;
+
+    bool hasChanges = false;
+
+    for ( int h = 0; h < 2; h++ ) {
+        for ( int t = 0; t < MAX_TRACKS; t++ ) {
+
+            if (( m_DirtySectors [h][t] == 0 ) && ( m_DirtyTrack [h][t] == false )) continue;
+
+            hasChanges = true;
+
+            if ( m_TrackOffset [h][t] == -1 ) return false;
+
+            const sTrack *track = &m_Track [h][t];
+
+            if ( m_Format == FORMAT_RAW_TRACK ) {
+                if ( track->Size != m_TrackLength [h][t] ) return false;
+                continue;
+            }
+
+            size_t count = 0;
+            for ( int s = 0; s < MAX_SECTORS; s++ ) {
+                const sSector *sector = &track->Sector [s];
+                if ( sector->Data == NULL ) continue;
+                if (( sector->Size != 1 ) || ( sector->Data [-1] != 0xFB )) return false;
+                if (( size_t ) ( sector->LogicalSector + 1 ) * sectorSize > m_TrackLength [h][t] ) return false;
+                count++;
+            }
+
+            if (( m_DirtyTrack [h][t] == true ) && ( count * sectorSize != m_TrackLength [h][t] )) return false;
+        }
+    }
+
+    // Something changed, but we don't know what - the whole image needs to be saved
+    return hasChanges;
+}
+
+//----------------------------------------------------------------------------
+//
+// Build the journal entries for everything that's changed.  With a NULL
+// journal this just works out how big the journal needs to be.
+//
+//----------------------------------------------------------------------------
+
+size_t cDiskMedia::CollectChanges ( UINT8 *journal, int *count ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::CollectChanges", true );
+
+    size_t sectorSize = ( m_Format == FORMAT_CF7 ) ? 2 * DEFAULT_SECTOR_SIZE : DEFAULT_SECTOR_SIZE;
+
+    size_t size = JOURNAL_HEADER_SIZE;
+    UINT8 *ptr  = ( journal != NULL ) ? journal + JOURNAL_HEADER_SIZE : NULL;
+
+    *count = 0;
+
+    for ( int h = 0; h < 2; h++ ) {
+        for ( int t = 0; t < MAX_TRACKS; t++ ) {
+
+            UINT64 dirty = ( m_DirtyTrack [h][t] == true ) ? ~( UINT64 ) 0 : m_DirtySectors [h][t];
+            if ( dirty == 0 ) continue;
+
+            const sTrack *track = &m_Track [h][t];
+
+            if ( m_Format == FORMAT_RAW_TRACK ) {
+                if ( ptr != NULL ) {
+                    ptr = PutUINT64 ( ptr, m_TrackOffset [h][t] );
+                    ptr = PutUINT32 ( ptr, track->Size );
+                    memcpy ( ptr, track->Data, track->Size );
+                    ptr += track->Size;
+                }
+                size += JOURNAL_ENTRY_SIZE + track->Size;
+                ( *count )++;
+                continue;
+            }
+
+            for ( int s = 0; s < MAX_SECTORS; s++ ) {
+                if ((( dirty >> s ) & 1 ) == 0 ) continue;
+                const sSector *sector = &track->Sector [s];
+                if ( sector->Data == NULL ) continue;
+                if ( ptr != NULL ) {
+                    ptr = PutUINT64 ( ptr, m_TrackOffset [h][t] + sector->LogicalSector * sectorSize );
+                    ptr = PutUINT32 ( ptr, sectorSize );
+                    if ( m_Format == FORMAT_CF7 ) {
+                        expandcf7 ( ptr, sector->Data, DEFAULT_SECTOR_SIZE );
+                    } else {
+                        memcpy ( ptr, sector->Data, DEFAULT_SECTOR_SIZE );
+                    }
+                    ptr += sectorSize;
+                }
+                size += JOURNAL_ENTRY_SIZE + sectorSize;
+                ( *count )++;
+            }
+        }
+    }
+
+    return size;
+}
+
+bool cDiskMedia::WriteBack ( bool background )
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::WriteBack", true );
+
+    sWriteBack *job = new sWriteBack;
+
+    job->Count    = 0;
+    job->Size     = CollectChanges ( NULL, &job->Count );
+    job->Journal  = new UINT8 [ job->Size ];
+    job->FileName = new char [ strlen ( m_FileName ) + 1 ];
+    job->Result   = false;
+    job->Threaded = false;
+
+    CollectChanges ( job->Journal, &job->Count );
+
+    memcpy ( job->Journal, JOURNAL_MAGIC, 8 );
+    PutUINT32 ( job->Journal + 8, job->Count );
+    PutUINT32 ( job->Journal + 12, Checksum ( job->Journal + JOURNAL_HEADER_SIZE, job->Size - JOURNAL_HEADER_SIZE ));
+
+    strcpy ( job->FileName, m_FileName );
+
+    // Everything that's changed is in the journal now (see FinishWriteBack if it can't be written)
+    ClearChanges ();
+    m_HasChanged = false;
+
+    m_WriteBack = job;
+
+    if ( background == true ) {
+        job->Threaded = StartWriteBackThread ( job );
+        if ( job->Threaded == true ) return true;
+        DBG_WARNING ( "Unable to start a thread to write back changes to '" << m_FileName << '\'' );
+    }
+
+    job->Result = CommitJournal ( job->FileName, job->Journal, job->Size );
+
+    return FinishWriteBack ();
+}
+
+//----------------------------------------------------------------------------
+//
+// Start writing the changes back to the image in the background.  Returns
+// false (and does nothing) if the changes can't be written back in place, in
+// which case SaveFile has to rewrite the image.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskMedia::StartWriteBack ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::StartWriteBack", true );
+
+    // Only one journal at a time can be written for an image
+    FinishWriteBack ();
+
+    if (( m_HasChanged == false ) || ( CanWriteBack () == false )) return false;
+
+    return WriteBack ( true );
+}
+
+//----------------------------------------------------------------------------
+//
+// Wait for a write-back started by StartWriteBack to finish.  If it failed,
+// the disk is marked as changed so the next save rewrites the whole image.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskMedia::FinishWriteBack ()
+{
+    FUNCTION_ENTRY ( this, "cDiskMedia::FinishWriteBack", true );
+
+    sWriteBack *job = m_WriteBack;
+
+    if ( job == NULL ) return true;
+
+    m_WriteBack = NULL;
+
+    if ( job->Threaded == true ) {
+        JoinWriteBackThread ( job );
+    }
+
+    bool retVal = job->Result;
+
+    if ( retVal == true ) {
+        DBG_EVENT ( "Wrote " << job->Count << " changes back to '" << job->FileName << '\'' );
+    } else {
+        DBG_ERROR ( "Unable to write changes back to '" << job->FileName << '\'' );
+        m_HasChanged = m_UntrackedChanges = true;
+    }
+
+    delete [] job->FileName;
+    delete [] job->Journal;
+    delete job;
+
+    return retVal;
 }
 
 void cDiskMedia::ClearDisk ()
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::ClearDisk", true );
 
+    FinishWriteBack ();
+
     AllocateTracks ( m_MaxTracks, m_MaxHeads );
+    ReleaseImage ();
+    ForgetHostFiles ();
 
     m_HasChanged = false;
 }
@@ -1036,6 +2708,8 @@ bool cDiskMedia::LoadFile ( const char *name )
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::LoadFile", true );
 
+    FinishWriteBack ();
+
     SetName ( name );
 
     return LoadFile ();
@@ -1045,6 +2719,9 @@ bool cDiskMedia::SaveFile ( eDiskFormat format, bool force )
 {
     FUNCTION_ENTRY ( this, "cDiskMedia::SaveFile", true );
 
+    // Anything still being written back has to be on disk before the image is touched again
+    FinishWriteBack ();
+
     if ( m_FileName == NULL ) {
         DBG_ERROR ( "No filename specified" );
         return false;
@@ -1066,6 +2743,20 @@ bool cDiskMedia::SaveFile ( eDiskFormat format, bool force )
         }
     }
 
+    // A directory can only be saved back to itself
+    if (( format == FORMAT_DIRECTORY ) || ( m_Format == FORMAT_DIRECTORY )) {
+        if ( format != m_Format ) {
+            DBG_ERROR ( "Converting disks to or from a directory is not supported" );
+            return false;
+        }
+        return SaveDiskDirectory ();
+    }
+
+    // If the image is already in the right format just write back what's changed
+    if (( format == m_Format ) && ( m_HasChanged == true ) && ( CanWriteBack () == true )) {
+        return WriteBack ( false );
+    }
+
     if (( format == FORMAT_RAW_SECTOR ) && ( IsValidRawSector () == false )) {
         DBG_ERROR ( "Disk contains features that this format does not support" );
         return false;
@@ -1076,13 +2767,34 @@ bool cDiskMedia::SaveFile ( eDiskFormat format, bool force )
         return false;
     }
 
-    const char *mode = ( format != FORMAT_CF7 ) ? "wb" : "rb+";
-    FILE *file = fopen ( m_FileName, mode );
+    if (( m_Format != FORMAT_CF7 ) && ( format == FORMAT_CF7 )) {
+        DBG_ERROR ( "Converting disks to CF7+ format is not supported" );
+        return false;
+    }
+
+    if ( format == FORMAT_CF7 ) {
+        return SaveDiskCF7 ();
+    }
+
+    // Everything has to come out of the image before it gets overwritten
+    LoadAllTracks ();
+
+    // Write the new image beside the old one and only replace it once it's safely on disk
+    char *tempName = new char [ strlen ( m_FileName ) + 5 ];
+    sprintf ( tempName, "%s.tmp", m_FileName );
+
+    FILE *file = fopen ( tempName, "wb" );
     if ( file == NULL ) {
-        DBG_ERROR ( "Unable to open file " << m_FileName << " for writing (mode '" << mode << "') - errno: " << errno );
+        DBG_ERROR ( "Unable to open file " << tempName << " for writing (mode 'wb') - errno: " << errno );
+        delete [] tempName;
         return false;
     }
 
+    // A compressed image keeps the tracks that haven't changed (see SaveDiskCompressed)
+    if ( format != FORMAT_COMPRESSED ) {
+        ForgetLayout ();
+    }
+
     bool retVal = false;
     const char *errMsg = NULL;
 
@@ -1090,20 +2802,25 @@ bool cDiskMedia::SaveFile ( eDiskFormat format, bool force )
         case FORMAT_RAW_TRACK :
             retVal = SaveDiskRawTrack ( file );
             break;
+        case FORMAT_COMPRESSED :
+            retVal = SaveDiskCompressed ( file );
+            break;
         case FORMAT_RAW_SECTOR :
             retVal = SaveDiskRawSector ( file );
             break;
         case FORMAT_ANADISK :
             retVal = SaveDiskAnadisk ( file );
             break;
-        case FORMAT_CF7 :
-            retVal = SaveDiskCF7 ( file );
-            break;
         default :
             errMsg = "Invalid format for";
             break;
     }
 
+    if (( retVal == true ) && ( SyncFile ( file ) == false )) {
+        DBG_ERROR ( "Error writing to file" );
+        retVal = false;
+    }
+
     fclose ( file );
 
     if ( errMsg != NULL ) {
@@ -1111,10 +2828,31 @@ bool cDiskMedia::SaveFile ( eDiskFormat format, bool force )
     }
 
     if ( retVal == true ) {
+#if defined ( OS_WINDOWS )
+        // rename won't replace an existing file on Windows
+        remove ( m_FileName );
+#endif
+        if ( rename ( tempName, m_FileName ) != 0 ) {
+            DBG_ERROR ( "Unable to rename " << tempName << " to " << m_FileName << " - errno: " << errno );
+            retVal = false;
+        }
+    }
+
+    if ( retVal == true ) {
+        // Any journal left for the old image no longer applies
+        char *journalName = JournalName ( m_FileName );
+        remove ( journalName );
+        delete [] journalName;
+        ClearChanges ();
         m_HasChanged = false;
         m_Format     = format;
+    } else {
+        remove ( tempName );
+        ForgetLayout ();
     }
 
+    delete [] tempName;
+
     return retVal;
 }
 
@@ -1131,6 +2869,8 @@ void cDiskMedia::SetName ( const char *fileName )
         strcpy ( m_FileName, fileName );
     }
 
+    ForgetLayout ();
+
     m_HasChanged = true;
 }
 
@@ -1141,7 +2881,15 @@ sTrack *cDiskMedia::GetTrack ( int tIndex, int hIndex )
     if (( tIndex < 0 ) || ( tIndex >= m_MaxTracks )) return NULL;
     if (( hIndex < 0 ) || ( hIndex >= m_MaxHeads )) return NULL;
 
-    return &m_Track [hIndex][tIndex];
+    if ( m_Source [hIndex][tIndex].Pending == true ) {
+        LoadTrack ( tIndex, hIndex );
+    }
+
+    sTrack *track = &m_Track [hIndex][tIndex];
+
+    AllocateTrackData ( track );
+
+    return track;
 }
 
 sSector *cDiskMedia::GetSector ( int tIndex, int hIndex, int sIndex, int track )
@@ -1153,13 +2901,26 @@ sSector *cDiskMedia::GetSector ( int tIndex, int hIndex, int sIndex, int track )
 
     if ( track == -1 ) track = tIndex;
 
-    for ( int i = 0; i < MAX_SECTORS; i++ ) {
-        int index = ( m_LastSectorIndex + i + 1 ) % MAX_SECTORS;
-        sSector *sector = &m_Track [hIndex][tIndex].Sector [index];
-        if ( sector->Data == NULL ) continue;
-        if (( sector->LogicalSector == sIndex ) &&
-            ( sector->LogicalCylinder == track )) {
-            m_LastSectorIndex = index;
+    sTrack *trackData = GetTrack ( tIndex, hIndex );
+
+    int slot = (( sIndex & ~0xFF ) == 0 ) ? trackData->SectorIndex [ sIndex ] : SECTOR_NOT_FOUND;
+
+    if ( slot == SECTOR_DUPLICATED ) {
+        // Duplicate sectors are returned in the order they pass under the head
+        for ( int i = 0; i < MAX_SECTORS; i++ ) {
+            int index = ( m_LastSectorIndex + i + 1 ) % MAX_SECTORS;
+            sSector *sector = &trackData->Sector [index];
+            if ( sector->Data == NULL ) continue;
+            if (( sector->LogicalSector == sIndex ) &&
+                ( sector->LogicalCylinder == track )) {
+                m_LastSectorIndex = index;
+                return sector;
+            }
+        }
+    } else if ( slot != SECTOR_NOT_FOUND ) {
+        sSector *sector = &trackData->Sector [ slot - 1 ];
+        if ( sector->LogicalCylinder == track ) {
+            m_LastSectorIndex = slot - 1;
             return sector;
         }
     }
@@ -192,7 +192,7 @@ void cFileSystem::PrintVerboseInformation ( FILE *, const sFileDescriptorRecord
 // Returns:
 // Notes:
 //------------------------------------------------------------------------------
-bool cFileSystem::CheckDisk () const
+bool cFileSystem::CheckDisk ( bool ) const
 {
     FUNCTION_ENTRY ( this, "cFileSystem::CheckDisk", true );
 
@@ -27,6 +27,7 @@
 //----------------------------------------------------------------------------
 
 #include <ctype.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <string.h>
 #include "common.hpp"
@@ -143,6 +144,56 @@ cPseudoFileSystem::~cPseudoFileSystem ()
     delete m_CurrentSector;
 }
 
+//------------------------------------------------------------------------------
+// Procedure:   cPseudoFileSystem::MakeHeader
+// Purpose:     Create a TIFILES header for a file.
+// Parameters:  FDR - the file being written to the host
+//              header - HOST_HEADER_SIZE bytes
+// Returns:
+// Notes:
+//------------------------------------------------------------------------------
+void cPseudoFileSystem::MakeHeader ( const sFileDescriptorRecord *FDR, UINT8 *header )
+{
+    FUNCTION_ENTRY ( NULL, "cPseudoFileSystem::MakeHeader", true );
+
+    memset ( header, 0, HOST_HEADER_SIZE );
+
+    sTIFILES_Header *hdr = ( sTIFILES_Header * ) header;
+    hdr->length          = 7;
+    memcpy ( hdr->Name, "TIFILES", 7 );
+
+    memcpy ( header + 16, FDR->FileName, MAX_FILENAME );
+
+    UpdateHeader ( FDR, header );
+}
+
+//------------------------------------------------------------------------------
+// Procedure:   cPseudoFileSystem::UpdateHeader
+// Purpose:     Bring a host file header up to date with the FDR.
+// Parameters:  FDR - the file being written to the host
+//              header - a TIFILES or FIAD header (HOST_HEADER_SIZE bytes)
+// Returns:
+// Notes:       Anything else in the header (e.g. the file name) is left alone.
+//------------------------------------------------------------------------------
+void cPseudoFileSystem::UpdateHeader ( const sFileDescriptorRecord *FDR, UINT8 *header )
+{
+    FUNCTION_ENTRY ( NULL, "cPseudoFileSystem::UpdateHeader", true );
+
+    sTIFILES_Header *hdr = ( sTIFILES_Header * ) header;
+
+    if (( hdr->length == 7 ) && ( memcmp ( hdr->Name, "TIFILES", 7 ) == 0 )) {
+        hdr->SectorCount      = FDR->TotalSectors;
+        hdr->Status           = FDR->FileStatus;
+        hdr->RecordsPerSector = FDR->RecordsPerSector;
+        hdr->EOF_Offset       = FDR->EOF_Offset;
+        hdr->RecordSize       = FDR->RecordLength;
+        hdr->RecordCount      = FDR->NoFixedRecords;
+    } else {
+        // FIAD files start with a copy of the FDR
+        memcpy ( header, FDR, FDR_INFO_SIZE );
+    }
+}
+
 //------------------------------------------------------------------------------
 // Procedure:   cPseudoFileSystem::FindHeader
 // Purpose:
@@ -155,7 +206,7 @@ bool cPseudoFileSystem::FindHeader ()
     FUNCTION_ENTRY ( this, "cPseudoFileSystem::FindHeader", true );
 
     // See if there is either a TIFILES header or a file descriptor record (FIAD)
-    char buffer [128];
+    char buffer [ HOST_HEADER_SIZE ];
     fseek ( m_File, 0L, SEEK_SET );
     if ( fread ( buffer, 1, sizeof ( buffer ), m_File ) != sizeof ( buffer )) {
         DBG_ERROR ( "Unable to read header from file " << m_FileName );
@@ -252,13 +303,13 @@ bool cPseudoFileSystem::ConstructFDR_FIAD ( char *buffer )
     long expectedMax = totalSectors * DEFAULT_SECTOR_SIZE;
 
     fseek ( m_File, 0L, SEEK_END );
-    long actualSize = ftell ( m_File ) - 128;
+    long actualSize = ftell ( m_File ) - HOST_HEADER_SIZE;
 
     if (( actualSize < expectedMin ) || ( actualSize > expectedMax )) return false;
 
     // We made it this far - it's most likely an FIAD file
     memset ( &m_FDR, 0, sizeof ( m_FDR ));
-    memcpy ( &m_FDR, buffer, 128 );
+    memcpy ( &m_FDR, buffer, HOST_HEADER_SIZE );
 
     return true;
 }
@@ -277,8 +328,9 @@ void cPseudoFileSystem::LoadFileBuffer ()
     int totalSectors = GetUINT16 ( &m_FDR.TotalSectors );
     size_t maxSize = totalSectors * DEFAULT_SECTOR_SIZE;
     m_FileBuffer = new UINT8 [ maxSize ];
+    memset ( m_FileBuffer, 0, maxSize );
 
-    fseek ( m_File, 128L, SEEK_SET );
+    fseek ( m_File, ( long ) HOST_HEADER_SIZE, SEEK_SET );
 
     if ( fread ( m_FileBuffer, 1, maxSize, m_File ) != maxSize ) {
         DBG_ERROR ( "Failed to read " << maxSize << " bytes from file" );
@@ -0,0 +1,193 @@
+//----------------------------------------------------------------------------
+//
+// File:        resampler.cpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: Polyphase FIR sample rate converter
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <math.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "resampler.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+#if defined ( __SSE2__ )
+    #include <emmintrin.h>
+#endif
+
+#define HALF_TAPS   ( RESAMPLER_TAPS / 2 )
+
+//----------------------------------------------------------------------------
+//
+// Each output sample is a 16-tap dot product of the input around it, using
+// the kernel phase closest to its fractional position.  The position is
+// tracked in 32.32 fixed-point so the long term rate is exact, and all state
+// lives in the object so any number of streams can be converted at once.
+//
+// The first HALF_TAPS - 1 input samples of each call are history from the
+// previous call, so output lags the input by half the kernel length.
+//
+//----------------------------------------------------------------------------
+
+cResampler::cResampler ( int inputRate, int outputRate, int maxInput ) :
+    m_InputRate ( inputRate ),
+    m_OutputRate ( outputRate ),
+    m_StepWhole ( 0 ),
+    m_StepFraction ( 0 ),
+    m_Kernel (),
+    m_MaxInput ( maxInput ),
+    m_History ( NULL ),
+    m_Length ( 0 ),
+    m_Position ( 0 ),
+    m_Fraction ( 0 )
+{
+    FUNCTION_ENTRY ( this, "cResampler ctor", true );
+
+    UINT64 step = (( UINT64 ) inputRate << 32 ) / outputRate;
+
+    m_StepWhole    = ( UINT32 ) ( step >> 32 );
+    m_StepFraction = ( UINT32 ) step;
+
+    m_History = new INT16 [ RESAMPLER_TAPS + maxInput ];
+
+    BuildKernel ();
+
+    Reset ();
+}
+
+cResampler::~cResampler ()
+{
+    FUNCTION_ENTRY ( this, "cResampler dtor", true );
+
+    delete [] m_History;
+}
+
+void cResampler::BuildKernel ()
+{
+    FUNCTION_ENTRY ( this, "cResampler::BuildKernel", true );
+
+    // Blackman windowed sinc with the cutoff a little below the lower Nyquist
+    const double cutoff = 0.9 * (( m_OutputRate < m_InputRate ) ? ( double ) m_OutputRate / m_InputRate : 1.0 );
+    const double half   = HALF_TAPS;
+
+    for ( int p = 0; p < RESAMPLER_PHASES; p++ ) {
+        double tap [ RESAMPLER_TAPS ], sum = 0.0;
+        for ( int k = 0; k < RESAMPLER_TAPS; k++ ) {
+            // Centered in its phase so the position rounds to nearest
+            double x = k - ( half - 1 ) - ( p + 0.5 ) / RESAMPLER_PHASES;
+            double w = ( fabs ( x ) < half ) ? 0.42 + 0.5 * cos ( M_PI * x / half ) + 0.08 * cos ( 2.0 * M_PI * x / half ) : 0.0;
+            double s = ( x != 0.0 ) ? sin ( M_PI * x * cutoff ) / ( M_PI * x ) : cutoff;
+            tap [k] = s * w;
+            sum += tap [k];
+        }
+        // Unity gain at DC for every phase
+        int total = 0, peak = 0;
+        for ( int k = 0; k < RESAMPLER_TAPS; k++ ) {
+            m_Kernel [p][k] = ( INT16 ) floor ( tap [k] / sum * ( 1 << RESAMPLER_SHIFT ) + 0.5 );
+            total += m_Kernel [p][k];
+            if ( m_Kernel [p][k] > m_Kernel [p][peak] ) peak = k;
+        }
+        m_Kernel [p][peak] += ( INT16 ) (( 1 << RESAMPLER_SHIFT ) - total );
+    }
+}
+
+int cResampler::GetMaxOutput ( int count ) const
+{
+    FUNCTION_ENTRY ( this, "cResampler::GetMaxOutput", true );
+
+    return ( int ) (( INT64 ) count * m_OutputRate / m_InputRate ) + 2;
+}
+
+void cResampler::Reset ()
+{
+    FUNCTION_ENTRY ( this, "cResampler::Reset", true );
+
+    memset ( m_History, 0, sizeof ( INT16 ) * RESAMPLER_TAPS );
+
+    m_Length   = RESAMPLER_TAPS - 1;
+    m_Position = HALF_TAPS - 1;
+    m_Fraction = 0;
+}
+
+//----------------------------------------------------------------------------
+//
+// Convert count input samples and return the number of output samples
+// written, which is at most GetMaxOutput ( count ).
+//
+//----------------------------------------------------------------------------
+
+int cResampler::Process ( const INT16 *input, int count, INT16 *output )
+{
+    FUNCTION_ENTRY ( this, "cResampler::Process", false );
+
+    DBG_ASSERT ( count <= m_MaxInput );
+
+    memcpy ( m_History + m_Length, input, sizeof ( INT16 ) * count );
+    m_Length += count;
+
+    int produced = 0;
+
+    while ( m_Position + HALF_TAPS < m_Length ) {
+
+        const INT16 *kernel = m_Kernel [ m_Fraction >> ( 32 - RESAMPLER_PHASE_BITS ) ];
+        const INT16 *data   = m_History + m_Position - ( HALF_TAPS - 1 );
+
+#if defined ( __SSE2__ )
+        // 16x16->32 bit multiply-adds, 8 taps at a time
+        __m128i sum = _mm_setzero_si128 ();
+        for ( int k = 0; k < RESAMPLER_TAPS; k += 8 ) {
+            __m128i x = _mm_loadu_si128 (( const __m128i * ) &data [k] );
+            __m128i h = _mm_loadu_si128 (( const __m128i * ) &kernel [k] );
+            sum = _mm_add_epi32 ( sum, _mm_madd_epi16 ( x, h ));
+        }
+        sum = _mm_add_epi32 ( sum, _mm_shuffle_epi32 ( sum, _MM_SHUFFLE ( 1, 0, 3, 2 )));
+        sum = _mm_add_epi32 ( sum, _mm_shuffle_epi32 ( sum, _MM_SHUFFLE ( 2, 3, 0, 1 )));
+        INT32 total = _mm_cvtsi128_si32 ( sum );
+#else
+        INT32 total = 0;
+        for ( int k = 0; k < RESAMPLER_TAPS; k++ ) {
+            total += data [k] * kernel [k];
+        }
+#endif
+
+        int sample = ( total + ( 1 << ( RESAMPLER_SHIFT - 1 ))) >> RESAMPLER_SHIFT;
+        output [ produced++ ] = ( INT16 ) min ( 32767, max ( -32768, sample ));
+
+        UINT32 last = m_Fraction;
+        m_Fraction += m_StepFraction;
+        m_Position += m_StepWhole + (( m_Fraction < last ) ? 1 : 0 );
+    }
+
+    // Keep only what the next output sample still needs
+    int start = m_Position - ( HALF_TAPS - 1 );
+    if ( start > m_Length ) start = m_Length;
+
+    memmove ( m_History, m_History + start, sizeof ( INT16 ) * ( m_Length - start ));
+    m_Length   -= start;
+    m_Position -= start;
+
+    return produced;
+}
@@ -0,0 +1,202 @@
+//----------------------------------------------------------------------------
+//
+// File:        spchindex.cpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: Phrase lookup table for a TMS5220 speech ROM
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <ctype.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "spchindex.hpp"
+#include "support.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+//----------------------------------------------------------------------------
+//
+// The speech ROM holds a binary tree of phrases starting at offset 1.  Each
+// node is:
+//
+//   <length> <text...> <prev:2> <next:2> <flags> <address:2> <data length>
+//
+// Finding a phrase used to mean walking that tree through the chip's
+// Load-Address/Read-Byte commands.  Instead, the tree is walked once here
+// and every phrase is put in a hash table keyed on its (case-insensitive)
+// text.
+//
+//----------------------------------------------------------------------------
+
+static inline UINT16 GetUINT16 ( const UINT8 *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "GetUINT16", false );
+
+    return ( UINT16 ) (( ptr [0] << 8 ) | ptr [1] );
+}
+
+cSpeechIndex::cSpeechIndex ( const UINT8 *rom ) :
+    m_Phrase ( NULL ),
+    m_Count ( 0 ),
+    m_TextPool ( NULL ),
+    m_Table ( NULL ),
+    m_TableMask ( 0 )
+{
+    FUNCTION_ENTRY ( this, "cSpeechIndex ctor", true );
+
+    UINT8 *visited = new UINT8 [ SPEECH_ROM_SIZE ];
+    int   *node    = new int [ MAX_SPEECH_PHRASES ];
+
+    memset ( visited, 0, SPEECH_ROM_SIZE );
+
+    int count = CollectNodes ( rom, 1, visited, node, 0 );
+
+    size_t poolSize = 1;
+    for ( int i = 0; i < count; i++ ) {
+        poolSize += rom [ node [i]] + 1;
+    }
+
+    m_Phrase   = new sSpeechPhrase [ count + 1 ];
+    m_TextPool = new char [ poolSize ];
+
+    // Keep the table at most half full so probe sequences stay short
+    UINT32 tableSize = 16;
+    while ( tableSize < ( UINT32 ) count * 2 ) tableSize <<= 1;
+
+    m_Table     = new int [ tableSize ];
+    m_TableMask = tableSize - 1;
+
+    memset ( m_Table, -1, sizeof ( int ) * tableSize );
+
+    char *text = m_TextPool;
+
+    for ( int i = 0; i < count; i++ ) {
+
+        int length = rom [ node [i]];
+
+        const UINT8 *ptr = &rom [ node [i] + length + 1 ];
+
+        memcpy ( text, rom + node [i] + 1, length );
+        text [ length ] = '\0';
+
+        // Leave the first copy of a phrase in place if the tree has duplicates
+        if ( Find ( text, length ) != NULL ) {
+            DBG_WARNING ( "Duplicate phrase '" << text << "' in speech ROM" );
+            continue;
+        }
+
+        sSpeechPhrase *phrase = &m_Phrase [ m_Count ];
+
+        phrase->Text       = text;
+        phrase->Length     = length;
+        phrase->Address    = GetUINT16 ( ptr + 5 );
+        phrase->DataLength = ptr [7];
+
+        UINT32 slot = Hash ( text, length ) & m_TableMask;
+        while ( m_Table [ slot ] != -1 ) {
+            slot = ( slot + 1 ) & m_TableMask;
+        }
+        m_Table [ slot ] = m_Count++;
+
+        text += length + 1;
+    }
+
+    delete [] node;
+    delete [] visited;
+
+    DBG_TRACE ( "Indexed " << m_Count << " phrases" );
+}
+
+cSpeechIndex::~cSpeechIndex ()
+{
+    FUNCTION_ENTRY ( this, "cSpeechIndex dtor", true );
+
+    delete [] m_Table;
+    delete [] m_TextPool;
+    delete [] m_Phrase;
+}
+
+UINT32 cSpeechIndex::Hash ( const char *text, size_t length )
+{
+    FUNCTION_ENTRY ( NULL, "cSpeechIndex::Hash", false );
+
+    UINT32 hash = FNV1A32_INITIAL;
+
+    // Phrases are looked up without regard to case
+    for ( size_t i = 0; i < length; i++ ) {
+        UINT8 ch = ( UINT8 ) toupper (( UINT8 ) text [i] );
+        hash = HashFNV1a32 ( &ch, 1, hash );
+    }
+
+    return hash;
+}
+
+int cSpeechIndex::CollectNodes ( const UINT8 *rom, int offset, UINT8 *visited, int *node, int count )
+{
+    FUNCTION_ENTRY ( this, "cSpeechIndex::CollectNodes", true );
+
+    // Stop at the leaves, and don't let a corrupt ROM send us off the end or around in circles
+    if (( offset == 0 ) || ( offset + rom [ offset ] + 9 > SPEECH_ROM_SIZE ) || ( visited [ offset ] != 0 )) {
+        return count;
+    }
+
+    visited [ offset ] = 1;
+
+    const UINT8 *ptr = &rom [ offset + rom [ offset ] + 1 ];
+
+    // In order, so the phrases come out sorted
+    count = CollectNodes ( rom, GetUINT16 ( ptr ), visited, node, count );
+
+    if (( count < MAX_SPEECH_PHRASES ) && ( rom [ offset ] != 0 )) {
+        node [ count++ ] = offset;
+    }
+
+    count = CollectNodes ( rom, GetUINT16 ( ptr + 2 ), visited, node, count );
+
+    return count;
+}
+
+const sSpeechPhrase *cSpeechIndex::Find ( const char *text, size_t length ) const
+{
+    FUNCTION_ENTRY ( this, "cSpeechIndex::Find", true );
+
+    UINT32 slot = Hash ( text, length ) & m_TableMask;
+
+    while ( m_Table [ slot ] != -1 ) {
+        const sSpeechPhrase *phrase = &m_Phrase [ m_Table [ slot ]];
+        if (( phrase->Length == length ) && ( strnicmp ( phrase->Text, text, length ) == 0 )) {
+            return phrase;
+        }
+        slot = ( slot + 1 ) & m_TableMask;
+    }
+
+    return NULL;
+}
+
+const sSpeechPhrase *cSpeechIndex::Find ( const char *text ) const
+{
+    FUNCTION_ENTRY ( this, "cSpeechIndex::Find", true );
+
+    return Find ( text, strlen ( text ));
+}
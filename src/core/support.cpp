@@ -35,8 +35,12 @@
 #if defined ( __GNUC__ )
     #include <unistd.h>
 #endif
+#if defined ( OS_LINUX ) || defined ( OS_MACOSX )
+    #include <dirent.h>
+#endif
 #if defined ( OS_WINDOWS )
     #include <windows.h>
+    #include <io.h>
 #endif
 #include "common.hpp"
 #include "logger.hpp"
@@ -182,6 +186,185 @@ const char *LocateFile ( const char *filename, const char *path )
     return NULL;
 }
 
+int GetProcessorCount ()
+{
+    FUNCTION_ENTRY ( NULL, "GetProcessorCount", true );
+
+#if defined ( OS_WINDOWS )
+    SYSTEM_INFO info;
+    GetSystemInfo ( &info );
+    return ( int ) info.dwNumberOfProcessors;
+#elif defined ( _SC_NPROCESSORS_ONLN )
+    long count = sysconf ( _SC_NPROCESSORS_ONLN );
+    return ( count > 0 ) ? ( int ) count : 1;
+#else
+    return 1;
+#endif
+}
+
+UINT32 HashFNV1a32 ( const void *data, size_t size, UINT32 hash )
+{
+    FUNCTION_ENTRY ( NULL, "HashFNV1a32", false );
+
+    const UINT8 *ptr = ( const UINT8 * ) data;
+
+    for ( size_t i = 0; i < size; i++ ) {
+        hash = ( hash ^ ptr [i] ) * 0x01000193;
+    }
+
+    return hash;
+}
+
+UINT64 HashFNV1a64 ( const void *data, size_t size, UINT64 hash )
+{
+    FUNCTION_ENTRY ( NULL, "HashFNV1a64", false );
+
+    const UINT8 *ptr = ( const UINT8 * ) data;
+
+    for ( size_t i = 0; i < size; i++ ) {
+        hash = ( hash ^ ptr [i] ) * 0x00000100000001B3ULL;
+    }
+
+    return hash;
+}
+
+static bool GetFileInfo ( const char *path, struct stat *info, bool follow )
+{
+    FUNCTION_ENTRY ( NULL, "GetFileInfo", true );
+
+#if defined ( OS_LINUX ) || defined ( OS_MACOSX )
+    if ( follow == false ) return lstat ( path, info ) == 0;
+#else
+    UNREFERENCED_PARAMETER ( follow );
+#endif
+
+    return stat ( path, info ) == 0;
+}
+
+void AddPath ( sPathList *list, const char *path )
+{
+    FUNCTION_ENTRY ( NULL, "AddPath", true );
+
+    if ( list->count == list->size ) {
+        list->size = ( list->size == 0 ) ? 256 : list->size * 2;
+        char **newPath = new char * [ list->size ];
+        if ( list->count > 0 ) {
+            memcpy ( newPath, list->path, list->count * sizeof ( char * ));
+        }
+        delete [] list->path;
+        list->path = newPath;
+    }
+
+    list->path [ list->count ] = new char [ strlen ( path ) + 1 ];
+    strcpy ( list->path [ list->count++ ], path );
+}
+
+void FreePaths ( sPathList *list )
+{
+    FUNCTION_ENTRY ( NULL, "FreePaths", true );
+
+    for ( int i = 0; i < list->count; i++ ) {
+        delete [] list->path [i];
+    }
+
+    delete [] list->path;
+
+    list->path  = NULL;
+    list->count = 0;
+    list->size  = 0;
+}
+
+static int sortByName ( const void *ptr1, const void *ptr2 )
+{
+    FUNCTION_ENTRY ( NULL, "sortByName", false );
+
+    return strcmp ( * ( const char ** ) ptr1, * ( const char ** ) ptr2 );
+}
+
+//----------------------------------------------------------------------------
+//
+// Add every regular file under 'root' to the list, in name order.  Symbolic
+// links to directories are only followed for 'root' itself.
+//
+//----------------------------------------------------------------------------
+
+void FindFiles ( const char *root, sPathList *list, bool follow )
+{
+    FUNCTION_ENTRY ( NULL, "FindFiles", true );
+
+    struct stat info;
+
+    if ( GetFileInfo ( root, &info, follow ) == false ) {
+        fprintf ( stderr, "Unable to access \"%s\"\n", root );
+        return;
+    }
+
+    // Everything that isn't a directory is left for the caller to decide on
+    if (( info.st_mode & S_IFMT ) == S_IFREG ) {
+        AddPath ( list, root );
+        return;
+    }
+
+    // Don't follow symbolic links to directories - they're too easy to loop through
+    if (( info.st_mode & S_IFMT ) != S_IFDIR ) {
+        if (( follow == false ) && ( GetFileInfo ( root, &info, true ) == true ) && (( info.st_mode & S_IFMT ) == S_IFREG )) {
+            AddPath ( list, root );
+        }
+        return;
+    }
+
+    // Read the whole directory first so the files come out in the same order every time
+    sPathList names = { NULL, 0, 0 };
+
+#if defined ( OS_LINUX ) || defined ( OS_MACOSX )
+
+    DIR *dir = opendir ( root );
+    if ( dir == NULL ) {
+        fprintf ( stderr, "Unable to read directory \"%s\"\n", root );
+        return;
+    }
+
+    for ( dirent *dp = readdir ( dir ); dp != NULL; dp = readdir ( dir )) {
+        if ( dp->d_name [0] == '.' ) continue;
+        AddPath ( &names, dp->d_name );
+    }
+
+    closedir ( dir );
+
+#elif defined ( OS_WINDOWS )
+
+    char *pattern = new char [ strlen ( root ) + 3 ];
+    sprintf ( pattern, "%s%c*", root, FILE_SEPERATOR );
+
+    _finddata_t data;
+    intptr_t handle = _findfirst ( pattern, &data );
+    if ( handle != -1 ) {
+        do {
+            if ( data.name [0] == '.' ) continue;
+            AddPath ( &names, data.name );
+        } while ( _findnext ( handle, &data ) == 0 );
+        _findclose ( handle );
+    }
+
+    delete [] pattern;
+
+#endif
+
+    if ( names.count > 1 ) {
+        qsort ( names.path, names.count, sizeof ( char * ), sortByName );
+    }
+
+    for ( int i = 0; i < names.count; i++ ) {
+        char *path = new char [ strlen ( root ) + strlen ( names.path [i] ) + 2 ];
+        sprintf ( path, "%s%c%s", root, FILE_SEPERATOR, names.path [i] );
+        FindFiles ( path, list, false );
+        delete [] path;
+        delete [] names.path [i];
+    }
+
+    delete [] names.path;
+}
+
 #if defined ( OS_AMIGAOS )
 
 char *strdup ( const char *string )
@@ -33,17 +33,81 @@
 #include "logger.hpp"
 #include "cartridge.hpp"
 #include "tms9900.hpp"
+#include "ti994a.hpp"
 #include "device.hpp"
 #include "diskio.hpp"
+#include "diskfs.hpp"
+#include "fileio.hpp"
+#include "tms9918a.hpp"
 #include "ti-disk.hpp"
 
 DBG_REGISTER ( __FILE__ );
 
+// How long the DSR has to be idle before changes are written back to the disk images
+#define WRITE_BACK_DELAY        CPU_SPEED_HZ
+
+// Scratch pad locations used to pass parameters to the DSR
+#define SCRATCH_SECTOR_RESULT   0x834A
+#define SCRATCH_SECTOR_DRIVE    0x834C
+#define SCRATCH_SECTOR_MODE     0x834D
+#define SCRATCH_SECTOR_BUFFER   0x834E
+#define SCRATCH_SECTOR_NUMBER   0x8350
+#define SCRATCH_SECTOR_ERROR    0x8350
+#define SCRATCH_DEVICE_LENGTH   0x8354
+#define SCRATCH_NAME_POINTER    0x8356
+
+// Peripheral Access Block layout
+#define PAB_OPCODE              0
+#define PAB_STATUS              1
+#define PAB_BUFFER              2
+#define PAB_RECORD_NUMBER       6
+#define PAB_NAME_LENGTH         9
+#define PAB_NAME                10
+
+#define PAB_ERROR_MASK          0xE0
+
+#define OPCODE_LOAD             5
+#define OPCODE_SAVE             6
+#define OPCODE_DELETE           7
+
+// High byte of the TMS9900 JMP instruction - the low byte is the displacement
+#define JMP_OPCODE              0x10
+
+extern "C" UINT8 CpuMemory [ 0x10000 ];
+
+static inline UINT8 *CpuPtr ( ADDRESS address )
+{
+    FUNCTION_ENTRY ( NULL, "CpuPtr", false );
+
+    // The scratch pad RAM is mirrored throughout >8000->83FF
+    if (( address & 0xFC00 ) == 0x8000 ) address |= 0x8300;
+
+    return &CpuMemory [ address ];
+}
+
+static inline UINT16 GetUINT16 ( const UINT8 *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "GetUINT16", false );
+
+    return ( UINT16 ) (( ptr [0] << 8 ) | ptr [1] );
+}
+
+static inline void PutUINT16 ( UINT8 *ptr, UINT16 value )
+{
+    FUNCTION_ENTRY ( NULL, "PutUINT16", false );
+
+    ptr [0] = ( UINT8 ) ( value >> 8 );
+    ptr [1] = ( UINT8 ) value;
+}
+
 cDiskDevice::cDiskDevice ( const char *filename ) :
     cDevice ( filename ),
     m_StepDirection ( 0 ),
     m_ClocksPerRev ( 600000 ),
     m_ClockStart ( 0 ),
+    m_IndexPulse ( false ),
+    m_WriteBackPending ( false ),
+    m_LastAccess ( 0 ),
     m_HardwareBits ( 0 ),
     m_DriveSelect ( 0 ),
     m_HeadSelect ( 0 ),
@@ -60,20 +124,27 @@ cDiskDevice::cDiskDevice ( const char *filename ) :
     m_BytesLeft ( 0 ),
     m_DataPtr ( NULL ),
     m_CmdInProgress ( CMD_NONE ),
-    m_TrapIndex (( UINT8 ) -1 )
+    m_TrapIndex (( UINT8 ) -1 ),
+    m_HighLevel ( false ),
+    m_EntryPoints ( 0 ),
+    m_EntryTrapIndex (( UINT8 ) -1 )
 {
     FUNCTION_ENTRY ( this, "cDiskDevice::cDiskDevice", true );
 
     for ( unsigned i = 0; i < SIZE ( m_DiskMedia ); i++ ) {
         m_DiskMedia [i] = new cDiskMedia ();
+        m_Speed [i]     = DISK_SPEED_ACCURATE;
     }
 
     memset ( m_DataBuffer, 0, sizeof ( m_DataBuffer ));
+    memset ( m_EntryPoint, 0, sizeof ( m_EntryPoint ));
 
     if ( m_IsValid && ( m_CRU == -1 )) {
         DBG_ERROR ( "Cartridge does not appear to be a valid disk device" );
         m_IsValid = false;
     }
+
+    FindEntryPoints ();
 }
 
 cDiskDevice::~cDiskDevice ()
@@ -81,6 +152,7 @@ cDiskDevice::~cDiskDevice ()
     FUNCTION_ENTRY ( this, "cDiskDevice::~cDiskDevice", true );
 
     for ( unsigned i = 0; i < SIZE ( m_DiskMedia ); i++ ) {
+        m_DiskMedia [i]->FinishWriteBack ();
         m_DiskMedia [i]->Release ( NULL );
     }
 }
@@ -105,6 +177,15 @@ void cDiskDevice::Activate ()
     m_pCPU->SetTrap ( 0x5FFC, ( UINT8 ) MEMFLG_TRAP_WRITE, m_TrapIndex );
     m_pCPU->SetTrap ( 0x5FFE, ( UINT8 ) MEMFLG_TRAP_WRITE, m_TrapIndex );
 
+    if (( m_HighLevel == true ) && ( m_pVDP != NULL ) && ( m_EntryPoints > 0 )) {
+        m_EntryTrapIndex = m_pCPU->RegisterTrapHandler ( TrapFunction, this, TRAP_DSR_ENTRY );
+        if ( m_EntryTrapIndex != ( UINT8 ) -1 ) {
+            for ( int i = 0; i < m_EntryPoints; i++ ) {
+                m_pCPU->SetTrap ( m_EntryPoint [i].Address, ( UINT8 ) MEMFLG_TRAP_READ, m_EntryTrapIndex );
+            }
+        }
+    }
+
 /*
     m_pCPU->SetMemory ( MEM_ROM, 0x5020, 0x6000 - 0x5020 );
 
@@ -118,9 +199,48 @@ void cDiskDevice::DeActivate ()
 {
     FUNCTION_ENTRY ( this, "cDiskDevice::DeActivate", true );
 
+    if ( m_EntryTrapIndex != ( UINT8 ) -1 ) {
+        m_pCPU->DeRegisterTrapHandler ( m_EntryTrapIndex );
+        m_EntryTrapIndex = ( UINT8 ) -1;
+    }
+
     if ( m_TrapIndex != ( UINT8 ) -1 ) {
         m_pCPU->DeRegisterTrapHandler ( m_TrapIndex );
         m_TrapIndex = ( UINT8 ) -1;
+        m_WriteBackPending = true;
+        m_LastAccess       = m_pCPU->GetClocks ();
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+// Write changes back to the disk images after the DSR has been switched off
+// for a while.  Waiting lets a burst of sector writes (i.e. saving a file) go
+// out in a single journaled update, and makes sure the DSR isn't part way
+// through changing the disk.  The update is written on a thread of its own
+// so the emulation doesn't stall while the image is synced.
+//
+//----------------------------------------------------------------------------
+
+void cDiskDevice::Update ( UINT32 clock )
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::Update", false );
+
+    if (( m_WriteBackPending == false ) || ( m_TrapIndex != ( UINT8 ) -1 )) return;
+
+    if ( clock - m_LastAccess < ( UINT32 ) WRITE_BACK_DELAY ) return;
+
+    m_WriteBackPending = false;
+
+    for ( unsigned i = 0; i < SIZE ( m_DiskMedia ); i++ ) {
+        cDiskMedia *media = m_DiskMedia [i];
+        if (( media->HasChanged () == true ) && ( media->GetName () != NULL ) && ( media->IsWriteProtected () == false )) {
+            DBG_EVENT ( "Writing back changes to " << media->GetName ());
+            // An image that can't be updated in place has to be rewritten here
+            if ( media->StartWriteBack () == false ) {
+                media->SaveFile ();
+            }
+        }
     }
 }
 
@@ -320,6 +440,12 @@ void cDiskDevice::LoadDisk ( int index, const char *filename )
 
     DBG_EVENT ( "Loading file: " << filename );
 
+    // Don't lose anything that hasn't been written back yet
+    m_DiskMedia [index]->FinishWriteBack ();
+    if ( m_DiskMedia [index]->HasChanged () == true ) {
+        m_DiskMedia [index]->SaveFile ();
+    }
+
     if ( m_DiskMedia [index]->LoadFile ( filename ) == true ) {
         DBG_EVENT ( "Disk image loaded successfully" );
     }
@@ -331,16 +457,480 @@ void cDiskDevice::UnLoadDisk ( int index )
 
     DBG_EVENT ( "Removing disk: " << m_DiskMedia [index]->GetName ());
 
+    // Don't lose anything that hasn't been written back yet
+    m_DiskMedia [index]->FinishWriteBack ();
+    if ( m_DiskMedia [index]->HasChanged () == true ) {
+        m_DiskMedia [index]->SaveFile ();
+    }
+
     m_DiskMedia [index]->ClearDisk ();
 }
 
-UINT8 cDiskDevice::TrapFunction ( void *ptr, int, bool read, ADDRESS address, UINT8 value )
+//----------------------------------------------------------------------------
+//
+// Set how closely a drive follows the timing of the real hardware.  Head
+// movement and data transfers already happen immediately, so the rotation of
+// the disk is all that is left: the index pulse and the revolution a Read or
+// Write Track command takes to finish.
+//
+//   DISK_SPEED_ACCURATE - the disk turns at 300 RPM, which is what software
+//                         that measures index timing (copy protection) needs
+//   DISK_SPEED_INSTANT  - a track command finishes as soon as the status is
+//                         read and every other status read shows the index
+//   n                   - the disk turns n times faster
+//
+// This may be changed at any time, and takes effect on the next status read.
+//
+//----------------------------------------------------------------------------
+
+void cDiskDevice::SetSpeed ( int index, int speed )
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::SetSpeed", true );
+
+    if (( index < 0 ) || ( index >= ( int ) SIZE ( m_Speed )) || ( speed < 0 )) {
+        DBG_ERROR ( "Invalid speed " << speed << " for drive " << index );
+        return;
+    }
+
+    DBG_EVENT ( "Drive " << index << " speed set to " << speed );
+
+    m_Speed [index] = speed;
+}
+
+//----------------------------------------------------------------------------
+//
+// Parse a disk speed setting of the form [n:]<mode>, where mode is
+// 'accurate', 'fast' or a multiplier, into speed [] for drive n (or every
+// drive).  Used by the front ends for their --disk-speed option.
+//
+//----------------------------------------------------------------------------
+
+bool cDiskDevice::ParseSpeed ( const char *arg, int speed [ 3 ] )
+{
+    FUNCTION_ENTRY ( NULL, "cDiskDevice::ParseSpeed", true );
+
+    int first = 0, last = 2;
+    if (( arg [0] != '\0' ) && ( arg [1] == ':' )) {
+        first = last = arg [0] - '1';
+        if (( first < 0 ) || ( first > 2 )) {
+            fprintf ( stderr, "Disk must be either 1, 2, or 3\n" );
+            return false;
+        }
+        arg += 2;
+    }
+
+    int value = 0;
+    if ( stricmp ( arg, "accurate" ) == 0 ) {
+        value = DISK_SPEED_ACCURATE;
+    } else if ( stricmp ( arg, "fast" ) == 0 ) {
+        value = DISK_SPEED_INSTANT;
+    } else if (( sscanf ( arg, "%d", &value ) != 1 ) || ( value < 1 )) {
+        fprintf ( stderr, "Disk speed must be 'accurate', 'fast', or a multiplier\n" );
+        return false;
+    }
+
+    for ( int i = first; i <= last; i++ ) {
+        speed [i] = value;
+    }
+
+    return true;
+}
+
+int cDiskDevice::GetSpeed ( int index ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::GetSpeed", true );
+
+    if (( index < 0 ) || ( index >= ( int ) SIZE ( m_Speed ))) return DISK_SPEED_ACCURATE;
+
+    return m_Speed [index];
+}
+
+UINT32 cDiskDevice::GetRevolutionTime () const
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::GetRevolutionTime", true );
+
+    int speed = DISK_SPEED_ACCURATE;
+
+    for ( unsigned i = 0; i < SIZE ( m_DiskMedia ); i++ ) {
+        if ( m_CurDisk == m_DiskMedia [i] ) {
+            speed = m_Speed [i];
+            break;
+        }
+    }
+
+    if ( speed == DISK_SPEED_INSTANT ) return 0;
+
+    UINT32 revolution = m_ClocksPerRev / speed;
+
+    return ( revolution > 360 ) ? revolution : 360;
+}
+
+bool cDiskDevice::IsIndexPulse ()
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::IsIndexPulse", true );
+
+    UINT32 revolution = GetRevolutionTime ();
+
+    if ( revolution == 0 ) {
+        m_IndexPulse = ! m_IndexPulse;
+        return m_IndexPulse;
+    }
+
+    return (( m_pCPU->GetClocks () % revolution ) < 10 * revolution / 360 ) ? true : false;
+}
+
+//----------------------------------------------------------------------------
+//
+// High-level DSR emulation
+//
+// When enabled, calls to the sector I/O subprogram (>10) and LOAD, SAVE and
+// DELETE requests for DSK1-DSK3 are serviced directly from the disk images
+// instead of running the DSR's code against the emulated FD1771.  Anything
+// else - record I/O on open files, requests that would fail, disks the file
+// system can't make sense of - is left to the ROM, so programs see exactly
+// the same behaviour (and error codes) as before.
+//
+//----------------------------------------------------------------------------
+
+UINT8 cDiskDevice::GetRomByte ( ADDRESS address ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::GetRomByte", false );
+
+    if (( m_pROM == NULL ) || (( address & 0xE000 ) != 0x4000 )) return 0;
+
+    const UINT8 *data = m_pROM->CpuMemory [ address >> 12 ].Bank [0].Data;
+
+    return ( data != NULL ) ? data [ address & 0x0FFF ] : ( UINT8 ) 0;
+}
+
+UINT16 cDiskDevice::GetRomWord ( ADDRESS address ) const
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::GetRomWord", false );
+
+    return ( UINT16 ) (( GetRomByte ( address ) << 8 ) | GetRomByte (( ADDRESS ) ( address + 1 )));
+}
+
+void cDiskDevice::AddEntryPoint ( ADDRESS address, ENTRY_TYPE_E type )
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::AddEntryPoint", true );
+
+    if ((( address & 0xE001 ) != 0x4000 ) || ( m_EntryPoints == MAX_ENTRY_POINTS )) return;
+
+    for ( int i = 0; i < m_EntryPoints; i++ ) {
+        if ( m_EntryPoint [i].Address != address ) continue;
+        if ( m_EntryPoint [i].Type != type ) {
+            // We wouldn't know which request we're looking at - leave this one to the ROM
+            DBG_WARNING ( "DSR entry point " << hex << address << " is shared - ignored" );
+            m_EntryPoint [i] = m_EntryPoint [ --m_EntryPoints ];
+        }
+        return;
+    }
+
+    m_EntryPoint [ m_EntryPoints ].Address = address;
+    m_EntryPoint [ m_EntryPoints ].Type    = type;
+    m_EntryPoints++;
+}
+
+void cDiskDevice::FindEntryPoints ()
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::FindEntryPoints", true );
+
+    m_EntryPoints = 0;
+
+    if (( m_IsValid == false ) || ( GetRomByte ( 0x4000 ) != 0xAA )) return;
+
+    // Walk the device (>4008) and subprogram (>400A) lists: <link> <address> <length> <name>
+    for ( int list = 0; list < 2; list++ ) {
+
+        ADDRESS link = GetRomWord (( ADDRESS ) (( list == 0 ) ? 0x4008 : 0x400A ));
+
+        for ( int i = 0; ( link != 0 ) && ( i < 64 ); i++ ) {
+
+            ADDRESS address = GetRomWord (( ADDRESS ) ( link + 2 ));
+            int length      = GetRomByte (( ADDRESS ) ( link + 4 ));
+
+            char name [4];
+            for ( int j = 0; j < 4; j++ ) {
+                name [j] = ( char ) GetRomByte (( ADDRESS ) ( link + 5 + j ));
+            }
+
+            if (( list == 0 ) && ( length == 4 ) && ( memcmp ( name, "DSK", 3 ) == 0 ) && ( name [3] >= '1' ) && ( name [3] <= '3' )) {
+                AddEntryPoint ( address, ENTRY_FILE );
+            }
+
+            if (( list == 1 ) && ( length == 1 ) && ( name [0] == 0x10 )) {
+                AddEntryPoint ( address, ENTRY_SECTOR_IO );
+            }
+
+            link = GetRomWord ( link );
+        }
+    }
+
+    DBG_TRACE ( "Found " << m_EntryPoints << " DSR entry points" );
+}
+
+UINT8 cDiskDevice::CallEntryPoint ( ADDRESS address, UINT8 opcode )
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::CallEntryPoint", true );
+
+    // We're only interested in the instruction fetch, not the odd data read
+    if ( m_pCPU->GetPC () != address ) return opcode;
+
+    bool handled = false;
+
+    for ( int i = 0; i < m_EntryPoints; i++ ) {
+        if ( m_EntryPoint [i].Address == address ) {
+            handled = ( m_EntryPoint [i].Type == ENTRY_SECTOR_IO ) ? SectorIO () : FileIO ();
+            break;
+        }
+    }
+
+    if ( handled == false ) return opcode;
+
+    // A DSR reports success by returning to R11 + 2.  Turn the instruction
+    // being fetched into a JMP and move the PC so that's where it lands.
+    ADDRESS returnAddress = ( ADDRESS ) ( GetUINT16 ( CpuPtr (( ADDRESS ) ( m_pCPU->GetWP () + 2 * 11 ))) + 2 );
+    int displacement      = ( char ) CpuMemory [ address + 1 ];
+
+    m_pCPU->SetPC (( ADDRESS ) ( returnAddress - 2 * displacement - 2 ));
+
+    return JMP_OPCODE;
+}
+
+bool cDiskDevice::SectorIO ()
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::SectorIO", true );
+
+    int drive     = *CpuPtr ( SCRATCH_SECTOR_DRIVE );
+    bool read     = ( *CpuPtr ( SCRATCH_SECTOR_MODE ) != 0 ) ? true : false;
+    ADDRESS vdp   = GetUINT16 ( CpuPtr ( SCRATCH_SECTOR_BUFFER ));
+    UINT16 sector = GetUINT16 ( CpuPtr ( SCRATCH_SECTOR_NUMBER ));
+
+    if (( drive < 1 ) || ( drive > ( int ) SIZE ( m_DiskMedia ))) return false;
+
+    cDiskMedia *media = m_DiskMedia [ drive - 1 ];
+
+    if (( read == false ) && ( media->IsWriteProtected () == true )) return false;
+
+    cDiskFileSystem *disk = new cDiskFileSystem ( media );
+
+    UINT8 buffer [ DEFAULT_SECTOR_SIZE ];
+
+    bool ok = false;
+
+    if ( read == true ) {
+        ok = disk->ReadSector ( sector, buffer );
+        if ( ok == true ) m_pVDP->WriteMemory ( vdp, buffer, DEFAULT_SECTOR_SIZE );
+    } else {
+        m_pVDP->ReadMemory ( vdp, buffer, DEFAULT_SECTOR_SIZE );
+        ok = disk->WriteSector ( sector, buffer );
+    }
+
+    disk->Release ( NULL );
+
+    if ( ok == false ) return false;
+
+    DBG_EVENT ( "DSK" << drive << ": sector " << sector << (( read == true ) ? " read" : " written" ));
+
+    PutUINT16 ( CpuPtr ( SCRATCH_SECTOR_RESULT ), sector );
+    *CpuPtr ( SCRATCH_SECTOR_ERROR ) = 0;
+
+    return true;
+}
+
+bool cDiskDevice::FileIO ()
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::FileIO", true );
+
+    int deviceLength = GetUINT16 ( CpuPtr ( SCRATCH_DEVICE_LENGTH ));
+    ADDRESS pab      = ( ADDRESS ) ( GetUINT16 ( CpuPtr ( SCRATCH_NAME_POINTER )) - deviceLength - PAB_NAME );
+
+    UINT8 header [ PAB_NAME + 256 ];
+    m_pVDP->ReadMemory ( pab, header, PAB_NAME );
+    m_pVDP->ReadMemory (( ADDRESS ) ( pab + PAB_NAME ), header + PAB_NAME, header [ PAB_NAME_LENGTH ] );
+
+    // Only simple 'DSKn.FILENAME' requests are handled here
+    const char *name = ( const char * ) header + PAB_NAME;
+    int nameLength   = header [ PAB_NAME_LENGTH ] - 5;
+
+    if (( deviceLength != 4 ) || ( nameLength < 1 ) || ( nameLength > MAX_FILENAME )) return false;
+    if (( memcmp ( name, "DSK", 3 ) != 0 ) || ( name [3] < '1' ) || ( name [3] > '3' ) || ( name [4] != '.' )) return false;
+
+    char fileName [ MAX_FILENAME + 1 ];
+    memset ( fileName, ' ', MAX_FILENAME );
+    fileName [ MAX_FILENAME ] = '\0';
+
+    for ( int i = 0; i < nameLength; i++ ) {
+        char ch = name [ 5 + i ];
+        if (( ch == '.' ) || ( ch == ' ' )) return false;
+        fileName [i] = ch;
+    }
+
+    cDiskMedia *media     = m_DiskMedia [ name [3] - '1' ];
+    cDiskFileSystem *disk = new cDiskFileSystem ( media );
+
+    bool handled = false;
+
+    if ( disk->IsValid () == true ) {
+        switch ( header [ PAB_OPCODE ] ) {
+            case OPCODE_LOAD :
+                handled = LoadProgram ( disk, fileName, header );
+                break;
+            case OPCODE_SAVE :
+                handled = SaveProgram ( media, disk, fileName, header );
+                break;
+            case OPCODE_DELETE :
+                handled = DeleteFile ( media, disk, fileName );
+                break;
+        }
+    }
+
+    disk->Release ( NULL );
+
+    if ( handled == false ) return false;
+
+    DBG_EVENT ( "DSK" << name [3] << ": opcode " << ( int ) header [ PAB_OPCODE ] << " on '" << fileName << "'" );
+
+    header [ PAB_STATUS ] &= ~PAB_ERROR_MASK;
+    m_pVDP->WriteMemory (( ADDRESS ) ( pab + PAB_STATUS ), &header [ PAB_STATUS ], 1 );
+
+    return true;
+}
+
+// The file system ignores case, the DSR doesn't
+static cFile *OpenFile ( cDiskFileSystem *disk, const char *fileName, bool *mismatch )
+{
+    FUNCTION_ENTRY ( NULL, "OpenFile", true );
+
+    cFile *file = disk->OpenFile ( fileName, -1 );
+
+    *mismatch = false;
+
+    if (( file != NULL ) && ( memcmp ( file->GetFDR ()->FileName, fileName, MAX_FILENAME ) != 0 )) {
+        file->Release ( NULL );
+        file      = NULL;
+        *mismatch = true;
+    }
+
+    return file;
+}
+
+bool cDiskDevice::LoadProgram ( cDiskFileSystem *disk, const char *fileName, const UINT8 *header )
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::LoadProgram", true );
+
+    bool mismatch;
+    cFile *file = OpenFile ( disk, fileName, &mismatch );
+    if ( file == NULL ) return false;
+
+    const sFileDescriptorRecord *fdr = file->GetFDR ();
+
+    int size    = file->FileSize ();
+    int maxSize = GetUINT16 ( header + PAB_RECORD_NUMBER );
+    ADDRESS vdp = GetUINT16 ( header + PAB_BUFFER );
+
+    bool ok = false;
+
+    if ((( fdr->FileStatus & PROGRAM_TYPE ) != 0 ) && ( fdr->TotalSectors != 0 ) && ( size <= maxSize )) {
+        UINT8 buffer [ DEFAULT_SECTOR_SIZE ];
+        for ( int i = 0; size > 0; i++ ) {
+            int count = ( size < DEFAULT_SECTOR_SIZE ) ? size : DEFAULT_SECTOR_SIZE;
+            file->ReadSector ( i, buffer );
+            m_pVDP->WriteMemory ( vdp, buffer, count );
+            vdp   = ( ADDRESS ) ( vdp + count );
+            size -= count;
+        }
+        ok = true;
+    }
+
+    file->Release ( NULL );
+
+    return ok;
+}
+
+bool cDiskDevice::SaveProgram ( cDiskMedia *media, cDiskFileSystem *disk, const char *fileName, const UINT8 *header )
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::SaveProgram", true );
+
+    int size    = GetUINT16 ( header + PAB_RECORD_NUMBER );
+    ADDRESS vdp = GetUINT16 ( header + PAB_BUFFER );
+
+    if (( size == 0 ) || ( media->IsWriteProtected () == true )) return false;
+
+    // Sectors that will be available once an existing copy is replaced
+    int available = disk->FreeSectors ();
+
+    // Let the DSR complain about protected files
+    bool mismatch;
+    cFile *file = OpenFile ( disk, fileName, &mismatch );
+    if ( file != NULL ) {
+        bool isProtected = ( file->GetFDR ()->FileStatus & WRITE_PROTECTED_TYPE ) ? true : false;
+        available += GetUINT16 (( const UINT8 * ) &file->GetFDR ()->TotalSectors ) + 1;
+        file->Release ( NULL );
+        if ( isProtected == true ) return false;
+    }
+
+    // CreateFile would replace a file whose name only differs in case
+    if ( mismatch == true ) return false;
+
+    // CreateFile deletes the old file, so make sure the new one fits (data + FDR) first
+    if (( size + DEFAULT_SECTOR_SIZE - 1 ) / DEFAULT_SECTOR_SIZE + 1 > available ) return false;
+
+    file = disk->CreateFile ( fileName, PROGRAM_TYPE, 0, -1 );
+    if ( file == NULL ) return false;
+
+    bool ok = true;
+
+    UINT8 buffer [ DEFAULT_SECTOR_SIZE ];
+
+    for ( int i = 0, left = size; ( ok == true ) && ( left > 0 ); i++ ) {
+        int count = ( left < DEFAULT_SECTOR_SIZE ) ? left : DEFAULT_SECTOR_SIZE;
+        memset ( buffer, 0, sizeof ( buffer ));
+        m_pVDP->ReadMemory ( vdp, buffer, count );
+        ok    = ( file->WriteSector ( i, buffer ) == 0 ) ? true : false;
+        vdp   = ( ADDRESS ) ( vdp + count );
+        left -= count;
+    }
+
+    file->GetFDR ()->EOF_Offset = ( UINT8 ) ( size % DEFAULT_SECTOR_SIZE );
+
+    file->Release ( NULL );
+
+    // Out of space - the DSR will report the error
+    if ( ok == false ) {
+        disk->DeleteFile ( fileName, -1 );
+    }
+
+    return ok;
+}
+
+bool cDiskDevice::DeleteFile ( cDiskMedia *media, cDiskFileSystem *disk, const char *fileName )
+{
+    FUNCTION_ENTRY ( this, "cDiskDevice::DeleteFile", true );
+
+    if ( media->IsWriteProtected () == true ) return false;
+
+    bool mismatch;
+    cFile *file = OpenFile ( disk, fileName, &mismatch );
+    if ( file == NULL ) return false;
+
+    bool isProtected = ( file->GetFDR ()->FileStatus & WRITE_PROTECTED_TYPE ) ? true : false;
+    file->Release ( NULL );
+
+    if ( isProtected == true ) return false;
+
+    return disk->DeleteFile ( fileName, -1 );
+}
+
+UINT8 cDiskDevice::TrapFunction ( void *ptr, int data, bool read, ADDRESS address, UINT8 value )
 {
     FUNCTION_ENTRY ( ptr, "cDiskDevice::Trap", false );
 
     cDiskDevice *pThis = ( cDiskDevice * ) ptr;
 
-    if ( read == true ) {
+    if ( data == TRAP_DSR_ENTRY ) {
+        value = pThis->CallEntryPoint ( address, value );
+    } else if ( read == true ) {
         value = pThis->ReadMemory ( address, value );
     } else {
         value = pThis->WriteMemory ( address, value );
@@ -801,14 +1391,17 @@ UINT8 cDiskDevice::ReadMemory ( ADDRESS address, UINT8 )
 
     switch ( address ) {
         case REG_STATUS :
-            if (( m_ClockStart != 0 ) && ( m_pCPU->GetClocks () - m_ClockStart > m_ClocksPerRev )) {
-                CompleteCommand ();
+            if ( m_ClockStart != 0 ) {
+                UINT32 revolution = GetRevolutionTime ();
+                if (( revolution == 0 ) || ( m_pCPU->GetClocks () - m_ClockStart > revolution )) {
+                    CompleteCommand ();
+                }
             }
             retVal = m_StatusRegister;
             if (( m_CurDisk != NULL ) && ( m_CurDisk->IsWriteProtected ())) {
                 retVal |= STATUS_WRITE_PROTECTED;
             }
-            if (( m_pCPU->GetClocks () % m_ClocksPerRev ) < 10 * m_ClocksPerRev / 360 ) {
+            if ( IsIndexPulse () == true ) {
                 retVal |= STATUS_INDEX_PULSE;
             }
 //            DBG_TRACE ( "Left: " << m_BytesLeft << " Expected: " << m_BytesExpected );
@@ -222,10 +222,20 @@ int cTI994A::TimerHookProc ()
 
     UINT32 clockCycles = m_CPU->GetClocks ();
 
+    if ( m_SpeechSynthesizer != NULL ) {
+        m_SpeechSynthesizer->Update ( clockCycles );
+    }
+
     // Simulate a 50/60Hz VDP interrupt
     if ( clockCycles - m_LastRetrace > m_RetraceInterval ) {
         m_LastRetrace += m_RetraceInterval;
         m_VDP->Retrace ();
+        m_SoundGenerator->EndFrame ( m_LastRetrace );
+        for ( unsigned i = 0; i < SIZE ( m_Device ); i++ ) {
+            if ( m_Device [i] != NULL ) {
+                m_Device [i]->Update ( m_LastRetrace );
+            }
+        }
     }
 
     return 0;
@@ -441,6 +451,14 @@ extern "C" int ReadCRU ( cTI994A *ti, ADDRESS address, int count )
     return value;
 }
 
+void cTI994A::Sleep ( int cycles, UINT32 )
+{
+    FUNCTION_ENTRY ( this, "cTI994A::Sleep", false );
+
+    // Nothing else to wait for - just account for the time the CPU was idle
+    m_CPU->AddClocks ( cycles );
+}
+
 int cTI994A::ReadCRU ( ADDRESS address )
 {
     FUNCTION_ENTRY ( this, "cTI994A::ReadCRU", false );
@@ -912,6 +930,7 @@ void cTI994A::AddDevice ( cDevice *dev )
     }
     m_Device [index] = dev;
     dev->SetCPU ( m_CPU );
+    dev->SetVDP ( m_VDP );
 }
 
 void cTI994A::InsertCartridge ( cCartridge *cartridge, bool reset )
@@ -35,6 +35,8 @@
 #include "common.hpp"
 #include "logger.hpp"
 #include "support.hpp"
+#include "resampler.hpp"
+#include "spchindex.hpp"
 #include "tms5220.hpp"
 #include "tms9919.hpp"
 #include "tms9900.hpp"
@@ -44,9 +46,15 @@ DBG_REGISTER ( __FILE__ );
 
 extern int verbose;
 
-// RMS Energy values
+extern "C" UINT32 ClockCycleCounter;
+
+// CPU clocks per 3.125 ms interpolation interval
+const int SPEECH_INTERVAL_CLOCKS = CPU_SPEED_HZ / TMS5220_INTERPOLATION_RATE;
+
+// Energy, pitch and reflection coefficient tables from the TMS5220's ROM
+
 const int COEFF_ENERGY [0x10] = {
-    0, 52, 87, 123, 174, 246, 348, 491, 694, 981, 1385, 1957, 2764, 3904, 5514, 7789
+      0,   1,   2,   3,   4,   6,   8,  11,  16,  23,  33,  47,  63,  85, 114,   0
 };
 
 const int COEFF_PITCH [0x40] = {
@@ -56,104 +64,79 @@ const int COEFF_PITCH [0x40] = {
     91,  94,  98, 101, 105, 109, 114, 118, 122, 127, 132, 137, 142, 148, 153, 159
 };
 
-const double COEFF_K1 [0x20] = {
-  -0.97850, -0.97270, -0.97070, -0.96680, -0.96290, -0.95900, -0.95310, -0.94140,
-  -0.93360, -0.92580, -0.91600, -0.90620, -0.89650, -0.88280, -0.86910, -0.85350,
-  -0.80420, -0.74058, -0.66019, -0.56116, -0.44296, -0.30706, -0.15735, -0.00005,
-   0.15725,  0.30696,  0.44288,  0.56109,  0.66013,  0.74054,  0.80416,  0.85350
+// Reflection coefficients in the chip's 10-bit (1/512) units
+const INT16 COEFF_K1 [0x20] = {
+  -501, -498, -497, -495, -493, -491, -488, -482,
+  -478, -474, -469, -464, -459, -452, -445, -437,
+  -412, -380, -339, -288, -227, -158,  -81,   -1,
+    80,  157,  226,  287,  337,  379,  411,  436
 };
 
-
-const double COEFF_K2 [0x20] = {
-  -0.64000, -0.58999, -0.53500, -0.47507, -0.41039, -0.34129, -0.26830, -0.19209,
-  -0.11350, -0.03345,  0.04702,  0.12690,  0.20515,  0.28087,  0.35325,  0.42163,
-   0.48553,  0.54464,  0.59878,  0.64796,  0.69227,  0.73190,  0.76714,  0.79828,
-   0.82567,  0.84965,  0.87057,  0.88875,  0.90451,  0.91813,  0.92988,  0.98830
+const INT16 COEFF_K2 [0x20] = {
+  -328, -303, -274, -244, -211, -175, -138,  -99,
+   -59,  -18,   24,   64,  105,  143,  180,  215,
+   248,  278,  306,  331,  354,  374,  392,  408,
+   422,  435,  445,  455,  463,  470,  476,  506
 };
 
-const double COEFF_K3 [0x10] = {
-  -0.86000, -0.75467, -0.64933, -0.54400, -0.43867, -0.33333, -0.22800, -0.12267,
-  -0.01733,  0.08800,  0.19333,  0.29867,  0.40400,  0.50933,  0.61467,  0.72000
+const INT16 COEFF_K3 [0x10] = {
+  -441, -387, -333, -279, -225, -171, -117,  -63,
+    -9,   45,   98,  152,  206,  260,  314,  368
 };
 
-const double COEFF_K4 [0x10] = {
-  -0.64000, -0.53145, -0.42289, -0.31434, -0.20579, -0.09723,  0.01132,  0.11987,
-   0.22843,  0.33698,  0.44553,  0.55409,  0.66264,  0.77119,  0.87975,  0.98830
+const INT16 COEFF_K4 [0x10] = {
+  -328, -273, -217, -161, -106,  -50,    5,   61,
+   116,  172,  228,  283,  339,  394,  450,  506
 };
 
-const double COEFF_K5 [0x10] = {
-  -0.64000, -0.54933, -0.45867, -0.36800, -0.27733, -0.18667, -0.09600, -0.00533,
-   0.08533,  0.17600,  0.26667,  0.35733,  0.44800,  0.53867,  0.62933,  0.72000
+const INT16 COEFF_K5 [0x10] = {
+  -328, -282, -235, -189, -142,  -96,  -50,   -3,
+    43,   90,  136,  182,  229,  275,  322,  368
 };
 
-const double COEFF_K6 [0x10] = {
-  -0.50000, -0.41333, -0.32667, -0.24000, -0.15333, -0.06667,  0.02000,  0.10667,
-   0.19333,  0.28000,  0.36667,  0.45333,  0.54000,  0.62667,  0.71333,  0.80000
+const INT16 COEFF_K6 [0x10] = {
+  -256, -212, -168, -123,  -79,  -35,   10,   54,
+    98,  143,  187,  232,  276,  320,  365,  409
 };
 
-const double COEFF_K7 [0x10] = {
-  -0.60000, -0.50667, -0.41333, -0.32000, -0.22667, -0.13333, -0.04000,  0.05333,
-   0.14667,  0.24000,  0.33333,  0.42667,  0.52000,  0.61333,  0.70667,  0.80000
+const INT16 COEFF_K7 [0x10] = {
+  -308, -260, -212, -164, -117,  -69,  -21,   27,
+    75,  122,  170,  218,  266,  314,  361,  409
 };
 
-const double COEFF_K8 [0x08] = {
-  -0.50000, -0.31429, -0.12857,  0.05714,  0.24286,  0.42857,  0.61429,  0.80000
+const INT16 COEFF_K8 [0x08] = {
+  -256, -161,  -66,   29,  124,  219,  314,  409
 };
 
-const double COEFF_K9 [0x08] = {
-  -0.50000, -0.34286, -0.18571, -0.02857,  0.12857,  0.28571,  0.44286,  0.60000
+const INT16 COEFF_K9 [0x08] = {
+  -256, -176,  -96,  -15,   65,  146,  226,  307
 };
 
-const double COEFF_K10 [0x08] = {
-  -0.40000, -0.25714, -0.11429,  0.02857,  0.17143,  0.31429,  0.45714,  0.60000
+const INT16 COEFF_K10 [0x08] = {
+  -205, -132,  -59,   14,   87,  160,  234,  307
 };
 
-#define CHIRP 22222
-
-#if ( CHIRP == 1 )
-
-static const int chirpTable [25] = {
-       8,  -16,   26,  -48,   86,
-    -162,  294, -502,  718, -728,
-     184,  672, -610, -672,  184,
-     728,  718,  502,  294,  162,
-      86,   48,   26,   16,    8
+// Sign-extend the low 10 bits of a coefficient and the low 15 bits of a lattice value
+#define WRAP_10(x)          (((( x ) + 0x0200 ) & 0x03FF ) - 0x0200 )
+#define WRAP_15(x)          (((( x ) + 0x4000 ) & 0x7FFF ) - 0x4000 )
+
+// The chip's 10 x 15-bit multiplier - the low 9 bits of the product are dropped
+#define MULTIPLY(k,x)       (( WRAP_10 ( k ) * WRAP_15 ( x )) >> 9 )
+
+// Chirp excitation used for voiced frames
+static const signed char chirpTable [52] = {
+    0x00, 0x03, 0x0F, 0x28, 0x4C, 0x6C, 0x71, 0x50,
+    0x25, 0x26, 0x4C, 0x44, 0x1A, 0x32, 0x3B, 0x13,
+    0x37, 0x1A, 0x25, 0x1F, 0x1D, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+    0x00, 0x00, 0x00, 0x00
 };
 
-#elif ( CHIRP == 2 )
-
-static const int chirpTable [30] = { 0x0100 };
-
-#elif ( CHIRP == 3 )
-
-static const int chirpTable [41] = {
-    0x00, 0x2A, 0xD4, 0x32, 0xB2, 0x12, 0x25, 0x14, 0x02, 0xE1,
-    0xC5, 0x02, 0x5F, 0x5A, 0x05, 0x0F, 0x26, 0xFC, 0xA5, 0xA5,
-    0xD6, 0xDD, 0xDC, 0xFC, 0x25, 0x2B, 0x22, 0x21, 0x0F, 0xFF,
-    0xF8, 0xEE, 0xED, 0xEF, 0xF7, 0xF6, 0xFA, 0x00, 0x03, 0x02,
-    0x01
-};
-
-#else
-
-static const char chirpTable [51] = {
-    ( char ) 0x00, ( char ) 0x2A, ( char ) 0xD4, ( char ) 0x32,
-    ( char ) 0xB2, ( char ) 0x12, ( char ) 0x25, ( char ) 0x14,
-    ( char ) 0x02, ( char ) 0xE1, ( char ) 0xC5, ( char ) 0x02,
-    ( char ) 0x5F, ( char ) 0x5A, ( char ) 0x05, ( char ) 0x0F,
-    ( char ) 0x26, ( char ) 0xFC, ( char ) 0xA5, ( char ) 0xA5,
-    ( char ) 0xD6, ( char ) 0xDD, ( char ) 0xDC, ( char ) 0xFC,
-    ( char ) 0x25, ( char ) 0x2B, ( char ) 0x22, ( char ) 0x21,
-    ( char ) 0x0F, ( char ) 0xFF, ( char ) 0xF8, ( char ) 0xEE,
-    ( char ) 0xED, ( char ) 0xEF, ( char ) 0xF7, ( char ) 0xF6,
-    ( char ) 0xFA, ( char ) 0x00, ( char ) 0x03, ( char ) 0x02,
-    ( char ) 0x01
-};
-
-#endif
-
-cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
+cTMS5220::cTMS5220 ( cTMS9919 *pSound, const UINT8 *rom ) :
     m_SpeechRom ( NULL ),
+    m_PhraseIndex ( NULL ),
     m_LoadPointer ( 0 ),
     m_Address ( 0x0000 ),
     m_ChipSelect ( 0x0000 ),
@@ -165,6 +148,7 @@ cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
     m_BitsLeft ( 0 ),
     m_ReadByte ( false ),
     m_SpeakExternal ( false ),
+    m_JumpBuffer (),
     m_BufferEmpty ( true ),
     m_TalkStatus ( false ),
     m_Data ( 0x00 ),
@@ -172,14 +156,24 @@ cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
     m_StartParams (),
     m_TargetParams (),
     m_InterpolationStage ( 0 ),
+    m_Inhibit ( false ),
     m_Computer ( NULL ),
     m_SoundChip ( pSound ),
     m_PitchIndex ( 0 ),
-    m_NonVoicedLevel ( 0.0 ),
+    m_RNG ( 0x1FFF ),
+    m_ReferenceFilter ( false ),
+    m_ReferenceOverflows ( 0 ),
     m_FilterHistory (),
+    m_ReferenceHistory (),
     m_RawDataBuffer (),
+    m_SynthClock ( 0 ),
+    m_Ring (),
+    m_RingGetIndex ( 0 ),
+    m_RingPutIndex ( 0 ),
     m_PlaybackFrequency ( -1 ),
     m_PlaybackInterval ( 0 ),
+    m_Playing ( false ),
+    m_Resampler ( NULL ),
     m_PlaybackBuffer ( NULL ),
     m_PlaybackSamplesLeft ( 0 ),
     m_PlaybackDataPtr ( NULL )
@@ -191,8 +185,10 @@ cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
     // Default to 0xFF in case there is no ROM so that we won't get locked up.
     memset ( m_SpeechRom, 0, 0x8000 );
 
-    const char *filename = LocateFile ( "spchrom.bin", "roms" );
-    if ( filename != NULL ) {
+    const char *filename = ( rom == NULL ) ? LocateFile ( "spchrom.bin", "roms" ) : NULL;
+    if ( rom != NULL ) {
+        memcpy ( m_SpeechRom, rom, 0x8000 );
+    } else if ( filename != NULL ) {
         FILE *file = fopen ( filename, "rb" );
         if ( file != NULL ) {
             if ( fread ( m_SpeechRom, 1, 0x8000, file ) != 0x8000 ) {
@@ -208,22 +204,20 @@ cTMS5220::cTMS5220 ( cTMS9919 *pSound ) :
         DBG_WARNING ( "A valid speech ROM was not found" );
         // Create an empty ROM image
         m_SpeechRom [0] = 0xAA;
-    } else {
+    } else if ( filename != NULL ) {
         if ( verbose >= 1 ) fprintf ( stdout, "Using speech ROM \"%s\"\n", filename );
     }
 
+    m_PhraseIndex = new cSpeechIndex ( m_SpeechRom );
+
     if ( m_SoundChip != NULL ) {
         m_PlaybackFrequency = m_SoundChip->SetSpeechSynthesizer ( this );
-        m_PlaybackInterval  = ( int ) ( m_PlaybackFrequency * 0.003125 );
-        m_PlaybackBuffer    = new double [ m_PlaybackInterval ];
-    }
-
-    // Calculate the RMS level to use for non-voiced sounds
-    double sum = 0.0;
-    for ( unsigned  i = 0; i < SIZE ( chirpTable ); i++ ) {
-        sum += ( double ) chirpTable [i] * ( double ) chirpTable [i];
+        if ( m_PlaybackFrequency > 0 ) {
+            m_Resampler        = new cResampler ( SAMPLE_RATE, m_PlaybackFrequency, INTERPOLATION_INTERVAL );
+            m_PlaybackInterval = m_Resampler->GetMaxOutput ( INTERPOLATION_INTERVAL );
+            m_PlaybackBuffer   = new INT16 [ m_PlaybackInterval ];
+        }
     }
-    m_NonVoicedLevel = sqrt ( sum / SIZE ( chirpTable ));
 
     Reset ();
 }
@@ -236,9 +230,15 @@ cTMS5220::~cTMS5220 ()
         m_SoundChip->SetSpeechSynthesizer ( NULL );
     }
 
+    delete m_Resampler;
+    m_Resampler = NULL;
+
     delete [] m_PlaybackBuffer;
     m_PlaybackBuffer = NULL;
 
+    delete m_PhraseIndex;
+    m_PhraseIndex = NULL;
+
     delete [] m_SpeechRom;
     m_SpeechRom = NULL;
 }
@@ -308,8 +308,6 @@ void cTMS5220::RestoreReadState ( const sReadState &state )
     }
 }
 
-static jmp_buf jump_buffer;
-
 UINT8 cTMS5220::ReadBits ( int count )
 {
     FUNCTION_ENTRY ( this, "cTMS5220::ReadBits", true );
@@ -350,25 +348,13 @@ UINT8 cTMS5220::ReadBitsFIFO ( int count )
 
     DBG_TRACE ( "Reading " << count << "/" << m_BitsLeft << " bits" );
 
-    // Last chance for the CPU thread...
-    for ( int retry = 0; ( m_BitsLeft < count ) && ( retry < 10 ); retry++ ) {
-        DBG_TRACE ( "waiting for bits..." );
-        if ( m_Computer != NULL ) {
-            m_Computer->WakeCPU ( 1 );
-        }
-    }
-
-    // TBD - Acquire MUTEX
-
     UINT8 data = 0;
 
     if ( m_BitsLeft < count ) {
 
-        DBG_ERROR ( "Not enough bits (" << m_BitsLeft << ") left in the FIFO - " << count << " needed" );
+        DBG_TRACE ( "Not enough bits (" << m_BitsLeft << ") left in the FIFO - " << count << " needed" );
 
-        // TBD - Release MUTEX
-
-        longjmp ( jump_buffer, -1 );
+        longjmp ( m_JumpBuffer, -1 );
 
     } else {
 
@@ -395,8 +381,6 @@ UINT8 cTMS5220::ReadBitsFIFO ( int count )
         }
     }
 
-    // TBD - Release MUTEX
-
     return data;
 }
 
@@ -404,7 +388,17 @@ void cTMS5220::StoreDataFIFO ( UINT8 data )
 {
     FUNCTION_ENTRY ( this, "cTMS5220::StoreDataFIFO", true );
 
-    // TBD - Acquire MUTEX
+    // The FIFO only drains as emulated time passes, so stall the CPU until
+    // the synthesizer has used up a frame and made room for this byte
+    while ((( m_PutIndex + 1 ) % FIFO_BYTES == m_GetIndex ) && ( m_TalkStatus == true )) {
+        DBG_TRACE ( "FIFO full - stalling CPU... (" << m_PutIndex << "/" << m_GetIndex << ")" );
+        UINT32 clock = m_SynthClock + SPEECH_INTERVAL_CLOCKS;
+        if ( m_Computer != NULL ) {
+            m_Computer->Sleep (( int ) ( clock - ClockCycleCounter ), 0 );
+        }
+        Update ( clock );
+    }
+
     m_FIFO [ m_PutIndex ] = data;
 
 //data = (( data >> 1 ) & 0x55 ) | (( data << 1 ) & 0xAA );
@@ -414,36 +408,13 @@ void cTMS5220::StoreDataFIFO ( UINT8 data )
 
     m_BitsLeft += 8;
 
-    int nextIndex = ( m_PutIndex + 1 ) % FIFO_BYTES;
-
-    if (( m_PlaybackFrequency != -1 ) && ( nextIndex == m_GetIndex )) {
-        DBG_TRACE ( "FIFO full - stalling CPU... (" << m_PutIndex << "/" << m_GetIndex << ")" );
-        while ( nextIndex == m_GetIndex ) {
-            if ( m_Computer != NULL ) {
-                // TBD - calculate a good approximation for the # of CPU cycles to stall
-                m_Computer->Sleep ( 100, 1 );
-            }
-            // Check TalkStatus in case we stalled
-            if ( m_TalkStatus == false ) break;
-        }
-        DBG_TRACE ( "CPU stall complete... (" << m_PutIndex << "/" << m_GetIndex << ")" );
-    }
-
-    m_PutIndex = nextIndex;
+    m_PutIndex = ( m_PutIndex + 1 ) % FIFO_BYTES;
 
     if (( m_TalkStatus == false ) && ( m_PutIndex >= 9 )) {
         m_TalkStatus = true;
     }
 
     m_BufferEmpty = false;
-
-    // TBD - Release MUTEX
-
-    // If we aren't getting audio callbacks, try to empty the buffer
-    if (( m_PlaybackFrequency == -1 ) && ( m_TalkStatus == true )) {
-        sSpeechParams temp;
-        ReadFrame ( &temp, true );
-    }
 }
 
 #if 0
@@ -478,25 +449,30 @@ bool cTMS5220::CreateNextBuffer ()
             return false;
         }
 
-        // Update the start & target parameters
-        memcpy ( &m_StartParams, &m_TargetParams, sizeof ( sSpeechParams ));
+        bool oldUnvoiced = ( m_TargetParams.Pitch == 0 );
+        bool oldSilence  = ( m_TargetParams.Energy == 0 );
 
-        // TBD: SILENCE - copy all parameters except energy
+        // Silence and STOP frames only carry an energy value, repeat frames reuse the old K's
+        m_TargetParams.Energy = temp.Energy;
+        m_TargetParams.Stop   = temp.Stop;
 
-        if (( temp.Repeat == false ) && ( temp.Stop == false )) {
-            memcpy ( &m_TargetParams, &temp, sizeof ( sSpeechParams ));
-        } else {
-            m_TargetParams.Energy = temp.Energy;
-            if ( temp.Stop == false ) {
-                m_TargetParams.Pitch  = temp.Pitch;
+        if ( temp.Energy != 0 ) {
+            m_TargetParams.Pitch = temp.Pitch;
+            if ( temp.Repeat == false ) {
+                memcpy ( m_TargetParams.Reflection, temp.Reflection, sizeof ( temp.Reflection ));
             }
         }
 
-        m_TargetParams.Stop = temp.Stop;
+        bool newUnvoiced = ( m_TargetParams.Pitch == 0 );
+        bool newSilence  = ( m_TargetParams.Energy == 0 );
+
+        // The chip doesn't interpolate across voicing changes or out of silence
+        m_Inhibit = (( oldUnvoiced != newUnvoiced ) || (( oldSilence == true ) && ( newSilence == false )) ||
+                     (( oldUnvoiced == true ) && ( newSilence == true )));
     }
 
     sSpeechParams param;
-    InterpolateParameters ( m_InterpolationStage, m_StartParams, m_TargetParams, &param );
+    InterpolateParameters ( m_InterpolationStage, m_Inhibit, m_StartParams, m_TargetParams, &param );
     m_InterpolationStage = ( m_InterpolationStage + 1 ) % 8;
 
     if ( m_PitchIndex >= param.Pitch ) {
@@ -505,55 +481,33 @@ bool cTMS5220::CreateNextBuffer ()
 
     for ( int i = 0; i < INTERPOLATION_INTERVAL; i++ ) {
 
-        double sample = 0.0;
+        int excitation = 0;
 
         if ( param.Pitch == 0 ) {
-//            double random = ( rand () % 32768 ) / 16384.0 - 1.0;
-//            sample = m_NonVoicedLevel * random;
-//sample *= 0.25;
-            sample = ( rand () & 1 ) ? 64 : -64;
+            // Unvoiced - the 13-bit noise LFSR is clocked 20 times per sample
+            for ( int j = 0; j < 20; j++ ) {
+                int bit = (( m_RNG >> 12 ) ^ ( m_RNG >> 3 ) ^ ( m_RNG >> 2 ) ^ m_RNG ) & 1;
+                m_RNG = ( UINT16 ) ((( m_RNG << 1 ) | bit ) & 0x1FFF );
+            }
+            excitation = ( m_RNG & 1 ) ? -64 : 64;
         } else {
             if ( m_PitchIndex < ( int ) SIZE ( chirpTable )) {
-                sample = chirpTable [ m_PitchIndex ];
-//sample *= param.Gain;
+                excitation = chirpTable [ m_PitchIndex ];
             }
             m_PitchIndex = ( m_PitchIndex + 1 ) % param.Pitch;
         }
-sample *= param.Gain * 0.1;
-
-        // Synthesize...
-//        m_FilterHistory [ 0 ][ RC_ORDER ] = sample * param.Gain;
-        m_FilterHistory [ 0 ][ RC_ORDER ] = sample;
 
-        // Forward path
-        for ( int j = RC_ORDER - 1; j >= 0; j-- ) {
-            m_FilterHistory [ 0 ][ j ] = m_FilterHistory [ 0 ][ j + 1 ] - param.Reflection [ j ] * m_FilterHistory [ 1 ][ j ];
-        }
-
-        // Backward path
-        for ( int j = RC_ORDER - 1; j >= 1; j-- ) {
-            m_FilterHistory [ 1 ][ j ] = m_FilterHistory [ 1 ][ j - 1 ] + param.Reflection [ j - 1 ] * m_FilterHistory [ 0 ][ j - 1 ];
-        }
-
-//        m_RawDataBuffer [ i ] = m_FilterHistory [ 1 ][ 0 ] = m_FilterHistory [ 0 ][ 0 ];
-        double cliptemp = m_FilterHistory [ 1 ][ 0 ] = m_FilterHistory [ 0 ][ 0 ];
+        INT32 cliptemp = ( m_ReferenceFilter == true ) ? ReferenceFilter ( param, excitation ) : LatticeFilter ( param, excitation );
 
         DBG_TRACE ( "Data: " << cliptemp );
 
-        if (cliptemp > 2047) cliptemp = -2048 + (cliptemp-2047);
-        else if (cliptemp < -2048) cliptemp = 2047 - (cliptemp+2048);
-
-        if (cliptemp > 511)
-            m_RawDataBuffer [ i ] = 127;//<<8;
-        else if (cliptemp < -512)
-            m_RawDataBuffer [ i ] = -128;//<<8;
-        else
-            m_RawDataBuffer [ i ] = cliptemp / 4 ;//* 64;//<< 6;
+        // The top 8 bits of the 12-bit clipped result go to the DAC
+        if ( cliptemp > 2047 ) cliptemp = 2047;
+        else if ( cliptemp < -2048 ) cliptemp = -2048;
 
+        m_RawDataBuffer [ i ] = ( INT16 ) ( cliptemp >> 4 );
     }
 
-//    deemp ( m_RawDataBuffer, INTERPOLATION_INTERVAL );
-
     if (( m_InterpolationStage == 0 ) && ( m_TargetParams.Stop == true )) {
         m_BufferEmpty   = false;
         m_TalkStatus    = false;
@@ -563,53 +517,137 @@ sample *= param.Gain * 0.1;
     return true;
 }
 
-bool cTMS5220::ConvertBuffer ()
+//----------------------------------------------------------------------------
+//
+// 10-stage lattice filter as the chip does it: 10-bit coefficients, 14-bit
+// (plus sign) values and a multiplier that truncates the product.  The
+// excitation is scaled by the 7-bit energy value going in.
+//
+//----------------------------------------------------------------------------
+
+INT32 cTMS5220::LatticeFilter ( const sSpeechParams &param, int excitation )
 {
-    FUNCTION_ENTRY ( this, "cTMS5220::ConvertBuffer", true );
+    FUNCTION_ENTRY ( this, "cTMS5220::LatticeFilter", false );
 
-    // TBD - Convert buffer from 8KHz to m_PlaybackFrequency here
+    m_FilterHistory [ 0 ][ RC_ORDER ] = MULTIPLY ( param.Energy, excitation << 6 );
 
-    // NOTE: This is a simple way to do it - linearly interpolate the samples (introduces some high-frequecy artifacts)
-    double ratio = ( double ) m_PlaybackInterval / ( double ) INTERPOLATION_INTERVAL;
-    double count = ratio;
-    int j = 0;
-    static double last = 0.0;
-    for ( int i = 0; i < INTERPOLATION_INTERVAL; i++ ) {
-        double next = m_RawDataBuffer [i];
-        double max  = ( int ) count;
-        while ( count >= 1.0 ) {
-            double x = ( int ) count / max;
-            m_PlaybackBuffer [j++] = x * last + ( 1.0 - x ) * next;
-            count -= 1.0;
-        }
-        last = next;
-        count += ratio;
+    // Forward path
+    for ( int j = RC_ORDER - 1; j >= 0; j-- ) {
+        m_FilterHistory [ 0 ][ j ] = m_FilterHistory [ 0 ][ j + 1 ] - MULTIPLY ( param.Reflection [ j ], m_FilterHistory [ 1 ][ j ] );
     }
 
-    // Finish what's left over (will be less than n=ratio samples)
-    while ( j < m_PlaybackInterval ) {
-        m_PlaybackBuffer [j++] = m_RawDataBuffer [INTERPOLATION_INTERVAL-1];
+    // Backward path
+    for ( int j = RC_ORDER - 1; j >= 1; j-- ) {
+        m_FilterHistory [ 1 ][ j ] = m_FilterHistory [ 1 ][ j - 1 ] + MULTIPLY ( param.Reflection [ j - 1 ], m_FilterHistory [ 0 ][ j - 1 ] );
     }
 
-    last = m_RawDataBuffer [INTERPOLATION_INTERVAL-1];
+    m_FilterHistory [ 1 ][ 0 ] = m_FilterHistory [ 0 ][ 0 ];
 
-    return true;
+    // The final sum can overflow - the chip only keeps 15 bits of it
+    return WRAP_15 ( m_FilterHistory [ 0 ][ 0 ] );
+}
+
+//----------------------------------------------------------------------------
+//
+// The same lattice in floating point.  Each product is truncated the way the
+// chip's multiplier does it, but nothing is wrapped, so the two filters agree
+// to the last bit unless LatticeFilter gets a shift, a wrap or a table wrong.
+// Selected at run time with SetReferenceFilter to check LatticeFilter.
+//
+//----------------------------------------------------------------------------
+
+INT32 cTMS5220::ReferenceFilter ( const sSpeechParams &param, int excitation )
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::ReferenceFilter", false );
+
+    m_ReferenceHistory [ 0 ][ RC_ORDER ] = floor (( param.Energy * excitation * 64.0 ) / 512.0 );
+
+    for ( int j = RC_ORDER - 1; j >= 0; j-- ) {
+        m_ReferenceHistory [ 0 ][ j ] = m_ReferenceHistory [ 0 ][ j + 1 ] - floor (( param.Reflection [ j ] * m_ReferenceHistory [ 1 ][ j ] ) / 512.0 );
+        // Past this point the chip's values wrap and the two filters can't be expected to agree
+        if ( fabs ( m_ReferenceHistory [ 0 ][ j ] ) > 16383.0 ) m_ReferenceOverflows++;
+    }
+
+    for ( int j = RC_ORDER - 1; j >= 1; j-- ) {
+        m_ReferenceHistory [ 1 ][ j ] = m_ReferenceHistory [ 1 ][ j - 1 ] + floor (( param.Reflection [ j - 1 ] * m_ReferenceHistory [ 0 ][ j - 1 ] ) / 512.0 );
+        if ( fabs ( m_ReferenceHistory [ 1 ][ j ] ) > 16383.0 ) m_ReferenceOverflows++;
+    }
+
+    m_ReferenceHistory [ 1 ][ 0 ] = m_ReferenceHistory [ 0 ][ 0 ];
+
+    // Same 15-bit output as the chip so overflows look the same
+    return WRAP_15 (( INT32 ) m_ReferenceHistory [ 0 ][ 0 ] );
+}
+
+void cTMS5220::SetReferenceFilter ( bool enable )
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::SetReferenceFilter", true );
+
+    m_ReferenceFilter = enable;
+}
+
+//----------------------------------------------------------------------------
+//
+// Speech is synthesized on the CPU thread as emulated time passes (see
+// Update) so the FIFO and status bits match what the CPU would see on real
+// hardware.  Each 3.125 ms block is scaled up to 16 bits and handed to the
+// audio thread through a single-producer/single-consumer ring, which only
+// has to resample and mix it.
+
+void cTMS5220::QueueBuffer ()
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::QueueBuffer", true );
+
+    // Nobody is listening
+    if ( m_Resampler == NULL ) {
+        return;
+    }
+
+    int nextIndex = ( m_RingPutIndex + 1 ) % SPEECH_RING_BLOCKS;
+
+    if ( nextIndex == m_RingGetIndex ) {
+        DBG_TRACE ( "Speech ring full - dropping block" );
+        return;
+    }
+
+    INT16 *block = m_Ring [ m_RingPutIndex ];
+    for ( int i = 0; i < INTERPOLATION_INTERVAL; i++ ) {
+        block [i] = ( INT16 ) ( m_RawDataBuffer [i] * 256 );
+    }
+
+    MEMORY_BARRIER ();
+
+    m_RingPutIndex = nextIndex;
 }
 
 bool cTMS5220::GetNextBuffer ()
 {
     FUNCTION_ENTRY ( this, "cTMS5220::GetNextBuffer", true );
 
-    if ( CreateNextBuffer () == false ) {
-        return false;
-    }
+    int available = ( m_RingPutIndex - m_RingGetIndex + SPEECH_RING_BLOCKS ) % SPEECH_RING_BLOCKS;
 
-    if ( ConvertBuffer () == false ) {
+    if ( m_Playing == false ) {
+        // Let a few blocks build up first so the CPU thread's timing jitter doesn't starve us
+        if ( available < SPEECH_PREFILL_BLOCKS ) {
+            return false;
+        }
+        m_Resampler->Reset ();
+        m_Playing = true;
+    } else if ( available == 0 ) {
+        DBG_TRACE ( "Speech ring empty" );
+        m_Playing = false;
         return false;
     }
 
+    MEMORY_BARRIER ();
+
+    // Convert from 8KHz to m_PlaybackFrequency
+    m_PlaybackSamplesLeft = m_Resampler->Process ( m_Ring [ m_RingGetIndex ], INTERPOLATION_INTERVAL, m_PlaybackBuffer );
     m_PlaybackDataPtr     = m_PlaybackBuffer;
-    m_PlaybackSamplesLeft = m_PlaybackInterval;
+
+    MEMORY_BARRIER ();
+
+    m_RingGetIndex = ( m_RingGetIndex + 1 ) % SPEECH_RING_BLOCKS;
 
     return true;
 }
@@ -628,7 +666,7 @@ char *cTMS5220::FormatParameters ( const sSpeechParams &param, bool showAll )
         int max = (( showAll == true ) || ( param.Pitch != 0 ))? 10 : 4;
         ptr += sprintf ( ptr, "  K:" );
         for ( int i = 0; i < max; i++ ) {
-            ptr += sprintf ( ptr, " %8.5f", param.Reflection [i] );
+            ptr += sprintf ( ptr, " %8.5f", param.Reflection [i] / 512.0 );
         }
     }
 
@@ -664,29 +702,37 @@ void cTMS5220::InterpolateParameters ( int stage, const sSpeechParams &start, co
 }
 */
 
-void cTMS5220::InterpolateParameters ( int stage,  sSpeechParams &start, const sSpeechParams &end, sSpeechParams *param )
+void cTMS5220::InterpolateParameters ( int stage, bool inhibit, sSpeechParams &start, const sSpeechParams &end, sSpeechParams *param )
 {
     FUNCTION_ENTRY ( NULL, "cTMS5220::InterpolateParameters", true );
 
     memcpy ( param, &start, sizeof ( sSpeechParams ));
 
-    static int X [8] = { 8, 8, 8, 4, 4, 2, 2, 1 };
+    // The chip moves 1/8, 1/8, 1/8, 1/4, 1/4, 1/2, 1/2, then all of the way to the target
+    static const int SHIFT [8] = { 3, 3, 3, 2, 2, 1, 1, 0 };
 
-    param->Energy += ( end.Energy - param->Energy ) / X[stage];
-    param->Pitch  += ( end.Pitch - param->Pitch ) / X[stage];
+    int shift = SHIFT [stage];
 
-    if ( end.Pitch == 0 ) {
-        param->Pitch = start.Pitch;
-    } else if ( start.Pitch == 0 ) {
-        param->Pitch = 0;
+    // An inhibited frame holds the old values until the last step
+    if (( inhibit == false ) || ( shift == 0 )) {
+        param->Energy += ( end.Energy - param->Energy ) >> shift;
+        param->Pitch  += ( end.Pitch - param->Pitch ) >> shift;
+        for ( int i = 0; i < RC_ORDER; i++ ) {
+            param->Reflection [i] = ( INT16 ) ( param->Reflection [i] + (( end.Reflection [i] - param->Reflection [i] ) >> shift ));
+        }
     }
 
-    for ( int i = 0; i < RC_ORDER; i++ ) {
-        param->Reflection [i] += ( end.Reflection [i] - param->Reflection [i] ) / X[stage];
+    // Silence zeroes everything, unvoiced frames zero K5-K10
+    if ( end.Energy == 0 ) {
+        param->Energy = 0;
+        param->Pitch  = 0;
+        memset ( param->Reflection, 0, sizeof ( param->Reflection ));
+    } else if ( end.Pitch == 0 ) {
+        for ( int i = REFLECTION_K5; i < RC_ORDER; i++ ) {
+            param->Reflection [i] = 0;
+        }
     }
 
-    param->Gain = param->Energy / 256.0;
-
     DBG_TRACE ( FormatParameters ( *param, false ));
 
     memcpy ( &start, param, sizeof ( sSpeechParams ));
@@ -701,7 +747,7 @@ bool cTMS5220::ReadFrame ( sSpeechParams *info, bool restore )
     sReadState state;
     SaveReadState ( &state );
 
-    if ( setjmp ( jump_buffer ) != 0 ) {
+    if ( setjmp ( m_JumpBuffer ) != 0 ) {
         if ( restore == true ) {
             RestoreReadState ( state );
         } else {
@@ -775,17 +821,17 @@ void cTMS5220::SetComputer ( cTI994A *computer )
     m_Computer = computer;
 }
 
-bool cTMS5220::AudioCallback ( UINT8 *buffer, int count )
+bool cTMS5220::AudioCallback ( INT16 *buffer, int count )
 {
     FUNCTION_ENTRY ( this, "cTMS5220::AudioCallback", false );
 
-    if ( m_TalkStatus == false ) {
+    if ( m_Resampler == NULL ) {
         return false;
     }
 
     bool modified = false;
 
-    while (( count > 0 ) && ( m_TalkStatus == true )) {
+    while ( count > 0 ) {
 
         if (( m_PlaybackSamplesLeft == 0 ) && ( GetNextBuffer () == false )) {
             break;
@@ -795,18 +841,14 @@ bool cTMS5220::AudioCallback ( UINT8 *buffer, int count )
 
         int size = min ( count, m_PlaybackSamplesLeft );
         for ( int i = 0; i < size; i++ ) {
-            int sample = ( int ) ( *buffer - 128 + *m_PlaybackDataPtr++ );
-            *buffer++ = 128 + min ( 127, max ( -128, sample ));
+            int sample = *buffer + *m_PlaybackDataPtr++;
+            *buffer++ = ( INT16 ) min ( 32767, max ( -32768, sample ));
         }
 
         count -= size;
         m_PlaybackSamplesLeft -= size;
     }
 
-    if ( m_TalkStatus == false ) {
-        Reset ();
-    }
-
     return modified;
 }
 
@@ -841,16 +883,51 @@ void cTMS5220::Reset ()
     memset ( &m_TargetParams, 0, sizeof ( m_TargetParams ));
 
     memset ( m_FilterHistory, 0, sizeof ( m_FilterHistory ));
+    memset ( m_ReferenceHistory, 0, sizeof ( m_ReferenceHistory ));
     memset ( m_RawDataBuffer, 0, sizeof ( m_RawDataBuffer ));
 
-    m_InterpolationStage  = 0;
-    m_PlaybackSamplesLeft = 0;
+    m_Inhibit = false;
+
+    m_RNG = 0x1FFF;
+
+    m_InterpolationStage = 0;
+}
+
+void cTMS5220::Update ( UINT32 clock )
+{
+    FUNCTION_ENTRY ( this, "cTMS5220::Update", false );
+
+    INT32 elapsed = ( INT32 ) ( clock - m_SynthClock );
+
+    // Start over if we're quiet or the clock jumped (an image was loaded).  A
+    // FIFO stall may leave us slightly ahead of the CPU, which is fine.
+    if (( m_TalkStatus == false ) || ( elapsed < -CPU_SPEED_HZ ) || ( elapsed > CPU_SPEED_HZ )) {
+        m_SynthClock = clock;
+        return;
+    }
+
+    while ( elapsed >= SPEECH_INTERVAL_CLOCKS ) {
+
+        m_SynthClock += SPEECH_INTERVAL_CLOCKS;
+        elapsed      -= SPEECH_INTERVAL_CLOCKS;
+
+        if ( CreateNextBuffer () == true ) {
+            QueueBuffer ();
+        }
+
+        if ( m_TalkStatus == false ) {
+            Reset ();
+            break;
+        }
+    }
 }
 
 UINT8 cTMS5220::WriteData ( UINT8 data )
 {
     FUNCTION_ENTRY ( this, "cTMS5220::WriteData", false );
 
+    Update ( ClockCycleCounter );
+
     if ( m_SpeakExternal == true ) {
 
         DBG_TRACE ( "External data: " << hex << data );
@@ -904,6 +981,8 @@ UINT8 cTMS5220::ReadData ( UINT8 data )
 {
     FUNCTION_ENTRY ( this, "cTMS5220::ReadData", false );
 
+    Update ( ClockCycleCounter );
+
     if ( m_ReadByte == true ) {
         m_ReadByte = false;
         data = ReadBitsROM ( 8 );
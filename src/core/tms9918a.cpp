@@ -67,6 +67,12 @@ cTMS9918A::cTMS9918A ( int refreshRate ) :
     m_CoincidenceFlag ( false ),
     m_FifthSpriteFlag ( false ),
     m_FifthSpriteIndex ( 0 ),
+    m_CoincidencePending ( false ),
+    m_CoincidenceStale ( false ),
+    m_SpriteCheck (),
+    m_LastSprite ( 0 ),
+    m_CoincidenceChecks ( 0 ),
+    m_CoincidenceSkipped ( 0 ),
     m_RefreshRate ( refreshRate )
 {
     FUNCTION_ENTRY ( this, "cTMS9918A ctor", true );
@@ -96,6 +102,9 @@ void cTMS9918A::Reset ()
 {
     FUNCTION_ENTRY ( this, "cTMS9918A::Reset", true );
 
+    UpdateCoincidence ();
+    m_CoincidenceStale = true;
+
     memset ( m_Memory, 0, 0x4000 );
 
     m_Status = 0;
@@ -147,12 +156,15 @@ void cTMS9918A::WriteData ( UINT8 data )
 
     m_Shift = 0;
 
-    UINT8 *MemPtr = &m_Memory [ m_Address++ & 0x3FFF ];
+    int address = m_Address++ & 0x3FFF;
+
+    UINT8 *MemPtr = &m_Memory [ address ];
 
     if ( *MemPtr != data ) {
-        int type = m_MemoryType [ m_Address & 0x3FFF ];
-        if ( type & ( MEM_SPRITE_ATTR_TABLE | MEM_SPRITE_DESC_TABLE )) {
-            m_SpritesDirty = true;
+        if ( m_MemoryType [ address ] & ( MEM_SPRITE_ATTR_TABLE | MEM_SPRITE_DESC_TABLE )) {
+            UpdateCoincidence ();
+            m_SpritesDirty     = true;
+            m_CoincidenceStale = true;
         }
         *MemPtr = data;
     }
@@ -173,6 +185,50 @@ UINT8 cTMS9918A::ReadData ()
     return retVal;
 }
 
+//----------------------------------------------------------------------------
+//
+// Block transfers to/from VDP memory for devices that bypass the data port.
+// The address register is left untouched.  Anything the display is using
+// still goes through WriteData so derived classes see the change.
+//
+//----------------------------------------------------------------------------
+
+void cTMS9918A::ReadMemory ( ADDRESS address, void *buffer, size_t length ) const
+{
+    FUNCTION_ENTRY ( this, "cTMS9918A::ReadMemory", true );
+
+    UINT8 *ptr = ( UINT8 * ) buffer;
+
+    for ( size_t i = 0; i < length; i++ ) {
+        ptr [i] = m_Memory [( address + i ) & 0x3FFF ];
+    }
+}
+
+void cTMS9918A::WriteMemory ( ADDRESS address, const void *buffer, size_t length )
+{
+    FUNCTION_ENTRY ( this, "cTMS9918A::WriteMemory", true );
+
+    const UINT8 *ptr = ( const UINT8 * ) buffer;
+
+    ADDRESS savedAddress   = m_Address;
+    UINT16  savedShift     = m_Shift;
+    UINT8   savedReadAhead = m_ReadAhead;
+
+    for ( size_t i = 0; i < length; i++ ) {
+        int offset = ( address + i ) & 0x3FFF;
+        if ( m_MemoryType [ offset ] == 0 ) {
+            m_Memory [ offset ] = ptr [i];
+        } else {
+            m_Address = ( ADDRESS ) offset;
+            WriteData ( ptr [i] );
+        }
+    }
+
+    m_Address   = savedAddress;
+    m_Shift     = savedShift;
+    m_ReadAhead = savedReadAhead;
+}
+
 void cTMS9918A::WriteRegister ( size_t reg, UINT8 value )
 {
     FUNCTION_ENTRY ( this, "cTMS9918A::WriteRegister", true );
@@ -186,6 +242,11 @@ void cTMS9918A::WriteRegister ( size_t reg, UINT8 value )
 
     UINT8 changes = m_Register [reg] ^ value;
 
+    // Settle any pending coincidence check before its inputs change
+    if ((( reg == 1 ) && ( changes & ( VDP_SPRITE_MASK | VDP_16K_MASK ))) || ((( reg == 5 ) || ( reg == 6 )) && ( changes != 0 ))) {
+        UpdateCoincidence ();
+    }
+
     m_Register [reg] = value;
 
     int offset, newMode = m_Mode;
@@ -213,7 +274,7 @@ void cTMS9918A::WriteRegister ( size_t reg, UINT8 value )
             newMode &= ~ ( VDP_M2 | VDP_M1 );
             if ( value & VDP_MODE_2_BIT ) newMode |= VDP_M2;
             if ( value & VDP_MODE_1_BIT ) newMode |= VDP_M1;
-            if ( changes & VDP_SPRITE_MASK ) m_SpritesDirty = true;
+            if ( changes & VDP_SPRITE_MASK ) m_SpritesDirty = m_CoincidenceStale = true;
             SetMode ( newMode );
             if (( value & VDP_INTERRUPT_MASK ) && ( m_Status & VDP_INTERRUPT_FLAG ) && ( m_PIC != NULL )) {
                 m_PIC->SignalInterrupt ( m_InterruptLevel );
@@ -237,10 +298,12 @@ void cTMS9918A::WriteRegister ( size_t reg, UINT8 value )
         case 5 :
             DBG_ASSERT ( value * 0x0080 < 0x4000 );
             m_SpriteAttrTable = ( sSpriteAttribute * ) &m_Memory [ value * 0x0080 ];
+            if ( changes != 0 ) m_CoincidenceStale = true;
             break;
         case 6 :
             DBG_ASSERT ( value * 0x0800 < 0x4000 );
             m_SpriteDescTable = ( sSpriteDescriptor * ) &m_Memory [ value * 0x0800 ];
+            if ( changes != 0 ) m_CoincidenceStale = true;
             break;
     }
 
@@ -263,6 +326,8 @@ UINT8 cTMS9918A::ReadStatus ()
     if ( m_SpritesRefreshed == true ) {
         m_SpritesRefreshed = false;
 
+        UpdateCoincidence ();
+
         // All the sprite related bits in m_Status are still 0 so we can just OR things in
         if ( m_CoincidenceFlag ) m_Status |= VDP_COINCIDENCE_FLAG;
         if ( m_FifthSpriteFlag ) m_Status |= VDP_FIFTH_SPRITE_FLAG;
@@ -418,8 +483,7 @@ bool cTMS9918A::CheckCoincidence ( const bool check [32] )
 {
     FUNCTION_ENTRY ( this, "cTMS9918A::CheckCoincidence", false );
 
-    // NOTE: m_FifthSpriteIndex is still the highest valid sprite
-    for ( int i = m_FifthSpriteIndex; i >= 0; i-- ) {
+    for ( int i = m_LastSprite; i >= 0; i-- ) {
         // Only check sprites that were marked
         if ( check [i] == false ) continue;
         for ( int j = i - 1; j >= 0; j-- ) {
@@ -437,8 +501,7 @@ void cTMS9918A::CheckSprites ()
 {
     FUNCTION_ENTRY ( this, "cTMS9918A::CheckSprites", false );
 
-    bool check [32];
-    memset ( check, false, sizeof ( check ));
+    memset ( m_SpriteCheck, false, sizeof ( m_SpriteCheck ));
 
     sSpriteAttributeEntry *sprite = &m_SpriteAttrTable->data [0];
 
@@ -472,10 +535,15 @@ void cTMS9918A::CheckSprites ()
         }
 
         // This sprite should be checked for coincidence
-        check [i] = true;
+        m_SpriteCheck [i] = true;
     }
 
-    m_CoincidenceFlag = CheckCoincidence ( check );
+    // Remember the highest valid sprite for the deferred coincidence check
+    m_LastSprite = m_FifthSpriteIndex;
+
+    // If nobody read the status since the last check, that work was never needed
+    if ( m_CoincidencePending == true ) m_CoincidenceSkipped++;
+    m_CoincidencePending = true;
 
     m_FifthSpriteFlag = false;
 
@@ -489,6 +557,29 @@ void cTMS9918A::CheckSprites ()
     }
 }
 
+//----------------------------------------------------------------------------
+//
+// The coincidence test is the expensive part of CheckSprites and most
+// programs never look at the flag, so it is done when the status register is
+// read instead of at every retrace.  Anything that changes the sprite tables,
+// sprite registers or reloads memory first settles a pending check against
+// the state seen at the last retrace, then marks the result as stale so the
+// sprites are rescanned once at the next retrace.
+//
+//----------------------------------------------------------------------------
+
+void cTMS9918A::UpdateCoincidence ()
+{
+    FUNCTION_ENTRY ( this, "cTMS9918A::UpdateCoincidence", false );
+
+    if ( m_CoincidencePending == false ) return;
+
+    m_CoincidencePending = false;
+    m_CoincidenceChecks++;
+
+    m_CoincidenceFlag = CheckCoincidence ( m_SpriteCheck );
+}
+
 void cTMS9918A::Retrace ()
 {
     FUNCTION_ENTRY ( this, "cTMS9918A::Retrace", false );
@@ -496,8 +587,9 @@ void cTMS9918A::Retrace ()
     m_SpritesRefreshed = true;
 
     // Only check if something has changed
-    if ( m_SpritesDirty == true ) {
-        m_SpritesDirty = false;
+    if (( m_SpritesDirty == true ) || ( m_CoincidenceStale == true )) {
+        m_SpritesDirty     = false;
+        m_CoincidenceStale = false;
         CheckSprites ();
     }
 
@@ -515,6 +607,9 @@ bool cTMS9918A::LoadImage ( FILE *file )
 {
     FUNCTION_ENTRY ( this, "cTMS9918A::LoadImage", true );
 
+    UpdateCoincidence ();
+    m_CoincidenceStale = true;
+
     UINT8 NewRegister [8];
     if (( fread ( &m_Address, sizeof ( m_Address ), 1, file ) != 1 )   ||
         ( fread ( &m_Transfer, sizeof ( m_Transfer ), 1, file ) != 1 ) ||
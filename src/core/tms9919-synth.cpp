@@ -0,0 +1,411 @@
+//----------------------------------------------------------------------------
+//
+// File:        tms9919-synth.cpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: Band-limited software synthesis for the TMS9919 Sound Generator
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#if defined ( OS_WINDOWS )
+    #include <windows.h>
+#endif
+
+#include <math.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "tms9919-synth.hpp"
+#include "tms5220.hpp"
+#include "ti994a.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+extern "C" UINT32 ClockCycleCounter;
+
+#if defined ( __SSE2__ )
+    #include <emmintrin.h>
+#endif
+
+// NOTE: These numbers were taken from the MESS source code
+#define NOISE_RESET              0x00F35
+#define NOISE_WHITE_GENERATOR    0x12000
+#define NOISE_PERIODIC_GENERATOR 0x08000
+
+INT16 cSynthTMS9919::sm_BlepKernel [ BLEP_PHASES ][ BLEP_TAPS ];
+bool  cSynthTMS9919::sm_KernelReady = false;
+
+cSynthTMS9919::cSynthTMS9919 () :
+    m_VolumeTable (),
+    m_Queue (),
+    m_GetIndex ( 0 ),
+    m_PutIndex ( 0 ),
+    m_Info (),
+    m_ShiftRegister ( NOISE_RESET ),
+    m_NoiseGenerator ( 0 ),
+    m_ActiveNoiseColor ( -1 ),
+    m_MaxSamples ( 0 ),
+    m_DeltaBuffer ( NULL ),
+    m_Integrator ( 0 ),
+    m_Initialized ( false ),
+    m_SampleRate ( 0 )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919 ctor", true );
+
+    BuildKernel ();
+
+    for ( int i = 0; i < 4; i++ ) {
+        m_Info [i].polarity    = 1;
+        m_Info [i].attenuation = m_Attenuation [i];
+    }
+
+    // Set loudest volume to max possible level / 4 (so 4 audio channels won't clip)
+    float volume = 32767.0 / 4.0;
+    for ( unsigned int i = 0; i < SIZE ( m_VolumeTable ) - 1; i++ ) {
+        m_VolumeTable [i] = ( int ) volume;
+        volume = ( float ) ( volume / 1.258925412 );    // Reduce volume by 2dB
+    }
+    m_VolumeTable [15] = 0;
+}
+
+cSynthTMS9919::~cSynthTMS9919 ()
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919 dtor", true );
+
+    delete [] m_DeltaBuffer;
+}
+
+bool cSynthTMS9919::InitSynthesizer ( int sampleRate, int maxSamples )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::InitSynthesizer", true );
+
+    m_SampleRate  = sampleRate;
+    m_MaxSamples  = maxSamples;
+    m_DeltaBuffer = new INT32 [ maxSamples + BLEP_TAPS ];
+    memset ( m_DeltaBuffer, 0, sizeof ( INT32 ) * ( maxSamples + BLEP_TAPS ));
+
+    m_Initialized = true;
+
+    // Queue up the current noise settings
+    NOISE_COLOR_E color = m_NoiseColor;
+    int type     = m_NoiseType;
+    m_NoiseColor = ( NOISE_COLOR_E ) -1;
+    m_NoiseType  = -1;
+    SetNoise ( color, type );
+
+    return true;
+}
+
+int cSynthTMS9919::SetSpeechSynthesizer ( cTMS5220 *speech )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::SetSpeechSynthesizer", true );
+
+    m_pSpeechSynthesizer = speech;
+
+    return m_SampleRate;
+}
+
+//----------------------------------------------------------------------------
+//
+// Register writes are queued by the CPU thread along with the CPU clock at
+// the time of the write.  Render is told which CPU clock its buffer starts at
+// and plays every write at the sample that matches its timestamp.
+//
+//----------------------------------------------------------------------------
+
+void cSynthTMS9919::QueueWrite ( int command, int voice, int value )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::QueueWrite", false );
+
+    int next = ( m_PutIndex + 1 ) % SOUND_QUEUE_SIZE;
+
+    if ( next == m_GetIndex ) {
+        DBG_WARNING ( "Sound register queue overflow" );
+        return;
+    }
+
+    sRegisterWrite *write = &m_Queue [ m_PutIndex ];
+
+    write->clock   = ClockCycleCounter;
+    write->command = command;
+    write->voice   = voice;
+    write->value   = value;
+
+    MEMORY_BARRIER ();
+
+    m_PutIndex = next;
+}
+
+//----------------------------------------------------------------------------
+//
+// The tone and noise generators produce ideal square waves.  Rather than
+// point sampling them (which aliases badly at higher frequencies), every
+// change in output level is added to a delta buffer as a band-limited step
+// at its exact sub-sample position, and the delta buffer is integrated into
+// the output.  All of the work is proportional to the number of transitions
+// rather than the number of samples.
+//
+//----------------------------------------------------------------------------
+
+void cSynthTMS9919::BuildKernel ()
+{
+    FUNCTION_ENTRY ( NULL, "cSynthTMS9919::BuildKernel", true );
+
+    if ( sm_KernelReady == true ) return;
+
+    // Blackman windowed sinc with the cutoff a little below Nyquist
+    const double cutoff = 0.9;
+    const double half   = BLEP_TAPS / 2;
+
+    for ( int p = 0; p < BLEP_PHASES; p++ ) {
+        double tap [ BLEP_TAPS ], sum = 0.0;
+        for ( int k = 0; k < BLEP_TAPS; k++ ) {
+            double x = k - ( half - 1 ) - ( double ) p / BLEP_PHASES;
+            double w = ( fabs ( x ) < half ) ? 0.42 + 0.5 * cos ( M_PI * x / half ) + 0.08 * cos ( 2.0 * M_PI * x / half ) : 0.0;
+            double s = ( x != 0.0 ) ? sin ( M_PI * x * cutoff ) / ( M_PI * x ) : cutoff;
+            tap [k] = s * w;
+            sum += tap [k];
+        }
+        // Each phase must add up to exactly 1.0 so the integrator never drifts
+        int total = 0, peak = 0;
+        for ( int k = 0; k < BLEP_TAPS; k++ ) {
+            sm_BlepKernel [p][k] = ( INT16 ) floor ( tap [k] / sum * ( 1 << BLEP_SHIFT ) + 0.5 );
+            total += sm_BlepKernel [p][k];
+            if ( sm_BlepKernel [p][k] > sm_BlepKernel [p][peak] ) peak = k;
+        }
+        sm_BlepKernel [p][peak] += ( INT16 ) (( 1 << BLEP_SHIFT ) - total );
+    }
+
+    sm_KernelReady = true;
+}
+
+void cSynthTMS9919::AddDelta ( INT32 time, int delta )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::AddDelta", false );
+
+    const INT16 *kernel = sm_BlepKernel [ (( time & 0xFFFF ) * BLEP_PHASES ) >> 16 ];
+    INT32 *buffer = &m_DeltaBuffer [ time >> 16 ];
+
+#if defined ( __SSE2__ )
+    // 16x16->32 bit products, 8 taps at a time
+    __m128i scale = _mm_set1_epi16 (( short ) delta );
+    for ( int k = 0; k < BLEP_TAPS; k += 8 ) {
+        __m128i taps = _mm_loadu_si128 (( const __m128i * ) &kernel [k] );
+        __m128i lo   = _mm_mullo_epi16 ( taps, scale );
+        __m128i hi   = _mm_mulhi_epi16 ( taps, scale );
+        __m128i *dst = ( __m128i * ) &buffer [k];
+        _mm_storeu_si128 ( dst, _mm_add_epi32 ( _mm_loadu_si128 ( dst ), _mm_unpacklo_epi16 ( lo, hi )));
+        _mm_storeu_si128 ( dst + 1, _mm_add_epi32 ( _mm_loadu_si128 ( dst + 1 ), _mm_unpackhi_epi16 ( lo, hi )));
+    }
+#else
+    for ( int k = 0; k < BLEP_TAPS; k++ ) {
+        buffer [k] += kernel [k] * delta;
+    }
+#endif
+}
+
+void cSynthTMS9919::UpdateLevel ( sVoiceInfo *info, INT32 time )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::UpdateLevel", false );
+
+    int level = ( info->period != 0 ) ? info->polarity * m_VolumeTable [ info->attenuation ] : 0;
+
+    if ( level != info->level ) {
+        AddDelta ( time, level - info->level );
+        info->level = level;
+    }
+}
+
+void cSynthTMS9919::ApplyWrite ( const sRegisterWrite &write, int offset )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::ApplyWrite", false );
+
+    sVoiceInfo *info = &m_Info [ write.voice ];
+
+    switch ( write.command ) {
+        case SOUND_FREQUENCY :
+            info->frequency = write.value;
+            info->period    = 0;
+            if ( info->frequency != 0 ) {
+                // Tones flip twice per cycle, the noise shift register is clocked once
+                INT64 period = (( INT64 ) m_SampleRate << 16 ) / (( write.voice == 3 ) ? info->frequency : 2 * info->frequency );
+                // Anything faster than one step per sample is above Nyquist
+                if ( period >= 0x10000 ) info->period = ( INT32 ) period;
+            }
+            if ( info->counter > info->period ) info->counter = info->period;
+            UpdateLevel ( info, offset << 16 );
+            break;
+        case SOUND_ATTENUATION :
+            info->attenuation = write.value;
+            UpdateLevel ( info, offset << 16 );
+            break;
+        case SOUND_NOISE :
+            // The shift register is reset when the color is changed
+            if ( write.value != m_ActiveNoiseColor ) m_ShiftRegister = NOISE_RESET;
+            m_ActiveNoiseColor = write.value;
+            m_NoiseGenerator   = ( write.value == NOISE_WHITE ) ? NOISE_WHITE_GENERATOR : NOISE_PERIODIC_GENERATOR;
+            break;
+    }
+}
+
+void cSynthTMS9919::RenderVoices ( int start, int end )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::RenderVoices", false );
+
+    INT32 limit = end << 16;
+
+    for ( int i = 0; i < 4; i++ ) {
+        sVoiceInfo *info = &m_Info [i];
+        if ( info->period == 0 ) continue;
+        INT32 time = ( start << 16 ) + info->counter;
+        if ( info->level == 0 ) {
+            // Nothing to hear - just keep the phase moving
+            if ( time < limit ) time += (( limit - time ) / info->period + 1 ) * info->period;
+        }
+        while ( time < limit ) {
+            if ( i < 3 ) {
+                // Tone
+                info->polarity = -info->polarity;
+            } else {
+                // Noise
+                if ( m_ShiftRegister & 1 ) {
+                    m_ShiftRegister ^= m_NoiseGenerator;
+                    // Protect against 0
+                    if ( m_ShiftRegister == 0 ) {
+                        m_ShiftRegister = NOISE_RESET;
+                    }
+                    info->polarity = -info->polarity;
+                }
+                m_ShiftRegister >>= 1;
+            }
+            UpdateLevel ( info, time );
+            time += info->period;
+        }
+        info->counter = time - limit;
+    }
+}
+
+//----------------------------------------------------------------------------
+//
+// Render 'length' samples of the tone, noise and speech output onto a signed
+// 16-bit mixing bus.  The buffer starts at CPU clock 'startClock' and covers
+// length * CPU_SPEED_HZ / m_SampleRate clocks.  Returns false if everything
+// was silent.
+//
+//----------------------------------------------------------------------------
+
+bool cSynthTMS9919::Render ( INT16 *buffer, int length, UINT32 startClock )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::Render", false );
+
+    DBG_ASSERT ( length <= m_MaxSamples );
+
+    float clocksPerSample = ( float ) CPU_SPEED_HZ / ( float ) m_SampleRate;
+    INT32 bufferClocks    = ( INT32 ) ( length * clocksPerSample );
+
+    int pos = 0;
+
+    while ( m_GetIndex != m_PutIndex ) {
+        MEMORY_BARRIER ();
+        const sRegisterWrite &write = m_Queue [ m_GetIndex ];
+        INT32 delta = ( INT32 ) ( write.clock - startClock );
+        // Leave writes for the next buffer in the queue
+        if ( delta >= bufferClocks ) break;
+        int offset = ( delta > 0 ) ? ( int ) ( delta / clocksPerSample ) : 0;
+        if ( offset >= length ) offset = length - 1;
+        if ( offset > pos ) {
+            RenderVoices ( pos, offset );
+            pos = offset;
+        }
+        ApplyWrite ( write, offset );
+        m_GetIndex = ( m_GetIndex + 1 ) % SOUND_QUEUE_SIZE;
+    }
+
+    RenderVoices ( pos, length );
+
+    // Integrate the steps onto the mixing bus
+    bool mix = false;
+
+    for ( int i = 0; i < length; i++ ) {
+        m_Integrator += m_DeltaBuffer [i];
+        int sample = m_Integrator >> BLEP_SHIFT;
+        buffer [i] = ( INT16 ) min ( 32767, max ( -32768, sample ));
+        mix |= ( sample != 0 );
+    }
+
+    // Carry the tails of the last steps over to the next buffer
+    memmove ( m_DeltaBuffer, m_DeltaBuffer + length, sizeof ( INT32 ) * BLEP_TAPS );
+    memset ( m_DeltaBuffer + BLEP_TAPS, 0, sizeof ( INT32 ) * length );
+
+    if ( m_pSpeechSynthesizer != NULL ) {
+        mix |= m_pSpeechSynthesizer->AudioCallback ( buffer, length );
+    }
+
+    return mix;
+}
+
+void cSynthTMS9919::SetNoise ( NOISE_COLOR_E color, int type )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::SetNoise", true );
+
+    if (( color == m_NoiseColor ) && ( type == m_NoiseType )) return;
+
+    cTMS9919::SetNoise ( color, type );
+
+    if ( m_Initialized == true ) {
+        QueueWrite ( SOUND_NOISE, 3, color );
+        QueueWrite ( SOUND_FREQUENCY, 3, m_Frequency [3] );
+    }
+}
+
+void cSynthTMS9919::SetFrequency ( int tone, int freq )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::SetFrequency", true );
+
+    if ( freq == m_Frequency [ tone ] ) return;
+
+    cTMS9919::SetFrequency ( tone, freq );
+
+    if ( m_Initialized == true ) {
+
+        QueueWrite ( SOUND_FREQUENCY, tone, freq );
+
+        // If we changed voice 2, see if the noise channel needs to be updated
+        if (( tone == 2 ) && ( m_NoiseType == 3 )) {
+            m_Frequency [3] = m_Frequency [2];
+            QueueWrite ( SOUND_FREQUENCY, 3, m_Frequency [3] );
+        }
+    }
+}
+
+void cSynthTMS9919::SetAttenuation ( int tone, int atten )
+{
+    FUNCTION_ENTRY ( this, "cSynthTMS9919::SetAttenuation", true );
+
+    if ( atten == m_Attenuation [ tone ] ) return;
+
+    cTMS9919::SetAttenuation ( tone, atten );
+
+    if ( m_Initialized == true ) {
+        QueueWrite ( SOUND_ATTENUATION, tone, atten );
+    }
+}
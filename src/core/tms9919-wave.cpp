@@ -0,0 +1,203 @@
+//----------------------------------------------------------------------------
+//
+// File:        tms9919-wave.cpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: Offline TMS9919 audio sink that writes WAV files and checksums
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "tms9919-wave.hpp"
+#include "ti994a.hpp"
+#include "support.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+#if ( BYTE_ORDER == BIG_ENDIAN )
+    #define SWAP_ENDIAN_16(x)   (((( x ) & 0xFF ) << 8 ) | ((( x ) >> 8 ) & 0xFF ))
+    #define SWAP_ENDIAN_32(x)   (( SWAP_ENDIAN_16 ( x ) << 16 ) | SWAP_ENDIAN_16 (( x ) >> 16 ))
+#else
+    #define SWAP_ENDIAN_16(x)   ( x )
+    #define SWAP_ENDIAN_32(x)   ( x )
+#endif
+
+#define WAVE_FORMAT_PCM     1
+
+struct sRIFF_Block
+{
+    char   Tag [ 4 ];
+    UINT32 Length;
+};
+
+struct sFormatChunk : sRIFF_Block
+{
+    UINT16    wFormatTag;
+    UINT16    nChannels;
+    UINT32    nSamplesPerSec;
+    UINT32    nAvgBytesPerSec;
+    UINT16    nBlockAlign;
+    UINT16    wBitsPerSample;
+};
+
+struct sWaveHeader
+{
+    sRIFF_Block  riff;
+    char         wave [ 4 ];
+    sFormatChunk format;
+    sRIFF_Block  data;
+};
+
+cWaveTMS9919::cWaveTMS9919 ( int sampleRate, const char *waveFile, const char *checksumFile ) :
+    m_WaveFile ( NULL ),
+    m_ChecksumFile ( NULL ),
+    m_DataLength ( 0 ),
+    m_ClockValid ( false ),
+    m_RenderClock ( 0 ),
+    m_Remainder ( 0 ),
+    m_FrameCount ( 0 )
+{
+    FUNCTION_ENTRY ( this, "cWaveTMS9919 ctor", true );
+
+    memset ( m_MixBuffer, 0, sizeof ( m_MixBuffer ));
+
+    InitSynthesizer ( sampleRate, WAVE_MAX_SAMPLES );
+
+    if ( waveFile != NULL ) {
+        m_WaveFile = fopen ( waveFile, "wb" );
+        if ( m_WaveFile == NULL ) {
+            DBG_ERROR ( "Unable to open WAV file " << waveFile );
+        } else {
+            WriteHeader ();
+        }
+    }
+
+    if ( checksumFile != NULL ) {
+        m_ChecksumFile = fopen ( checksumFile, "wt" );
+        if ( m_ChecksumFile == NULL ) {
+            DBG_ERROR ( "Unable to open checksum file " << checksumFile );
+        }
+    }
+}
+
+cWaveTMS9919::~cWaveTMS9919 ()
+{
+    FUNCTION_ENTRY ( this, "cWaveTMS9919 dtor", true );
+
+    if ( m_WaveFile != NULL ) {
+        // Go back and fill in the final sizes
+        fseek ( m_WaveFile, 0, SEEK_SET );
+        WriteHeader ();
+        fclose ( m_WaveFile );
+    }
+
+    if ( m_ChecksumFile != NULL ) {
+        fclose ( m_ChecksumFile );
+    }
+}
+
+void cWaveTMS9919::WriteHeader ()
+{
+    FUNCTION_ENTRY ( this, "cWaveTMS9919::WriteHeader", true );
+
+    sWaveHeader header;
+
+    memcpy ( header.riff.Tag, "RIFF", 4 );
+    header.riff.Length            = SWAP_ENDIAN_32 ( sizeof ( sWaveHeader ) - sizeof ( sRIFF_Block ) + m_DataLength );
+    memcpy ( header.wave, "WAVE", 4 );
+    memcpy ( header.format.Tag, "fmt ", 4 );
+    header.format.Length          = SWAP_ENDIAN_32 ( sizeof ( sFormatChunk ) - sizeof ( sRIFF_Block ));
+    header.format.wFormatTag      = SWAP_ENDIAN_16 ( WAVE_FORMAT_PCM );
+    header.format.nChannels       = SWAP_ENDIAN_16 ( 1 );
+    header.format.nSamplesPerSec  = SWAP_ENDIAN_32 ( m_SampleRate );
+    header.format.nAvgBytesPerSec = SWAP_ENDIAN_32 ( m_SampleRate * sizeof ( INT16 ));
+    header.format.nBlockAlign     = SWAP_ENDIAN_16 ( sizeof ( INT16 ));
+    header.format.wBitsPerSample  = SWAP_ENDIAN_16 ( 16 );
+    memcpy ( header.data.Tag, "data", 4 );
+    header.data.Length            = SWAP_ENDIAN_32 ( m_DataLength );
+
+    fwrite ( &header, sizeof ( header ), 1, m_WaveFile );
+}
+
+//----------------------------------------------------------------------------
+//
+// Called at each retrace with the CPU clock at the start of the new frame.
+// Renders everything between the last frame and this one, so the output
+// follows emulated time no matter how fast the emulator is running.
+//
+//----------------------------------------------------------------------------
+
+void cWaveTMS9919::EndFrame ( UINT32 clock )
+{
+    FUNCTION_ENTRY ( this, "cWaveTMS9919::EndFrame", false );
+
+    if ( m_Initialized == false ) return;
+
+    INT32 elapsed = ( INT32 ) ( clock - m_RenderClock );
+
+    // Start over if the clock jumped (first frame or an image was loaded)
+    if (( m_ClockValid == false ) || ( elapsed <= 0 ) || ( elapsed > CPU_SPEED_HZ )) {
+        m_ClockValid  = true;
+        m_RenderClock = clock;
+        m_Remainder   = 0;
+        return;
+    }
+
+    UINT64 total   = ( UINT64 ) elapsed * m_SampleRate + m_Remainder;
+    int    samples = ( int ) ( total / CPU_SPEED_HZ );
+    m_Remainder    = ( UINT32 ) ( total % CPU_SPEED_HZ );
+
+    UINT32 checksum = FNV1A32_INITIAL;
+
+    for ( int done = 0; done < samples; ) {
+        int count = min ( samples - done, WAVE_MAX_SAMPLES );
+        UINT32 start = m_RenderClock + ( UINT32 ) (( UINT64 ) done * CPU_SPEED_HZ / m_SampleRate );
+
+        if ( Render ( m_MixBuffer, count, start ) == false ) {
+            memset ( m_MixBuffer, 0, sizeof ( INT16 ) * count );
+        }
+
+        // Stored little-endian in the WAV file and hashed in that order
+        for ( int i = 0; i < count; i++ ) {
+            m_MixBuffer [i] = ( INT16 ) SWAP_ENDIAN_16 (( UINT16 ) m_MixBuffer [i] );
+        }
+
+        checksum = HashFNV1a32 ( m_MixBuffer, sizeof ( INT16 ) * count, checksum );
+
+        if ( m_WaveFile != NULL ) {
+            fwrite ( m_MixBuffer, sizeof ( INT16 ), count, m_WaveFile );
+            m_DataLength += sizeof ( INT16 ) * count;
+        }
+
+        done += count;
+    }
+
+    if ( m_ChecksumFile != NULL ) {
+        fprintf ( m_ChecksumFile, "%6d %08X\n", m_FrameCount, checksum );
+    }
+
+    m_FrameCount++;
+    m_RenderClock = clock;
+}
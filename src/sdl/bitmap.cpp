@@ -27,23 +27,52 @@
 //----------------------------------------------------------------------------
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "common.hpp"
 #include "logger.hpp"
 #include "tms9900.hpp"
 #include "tms9918a.hpp"
 #include "ti994a.hpp"
 #include "SDL.h"
+#include "SDL_thread.h"
 #include "bitmap.hpp"
 #include "tms9918a-sdl.hpp"
+#include "support.hpp"
+
+#if defined ( __GNUC__ ) && ( defined ( __i386__ ) || defined ( __x86_64__ ))
+    #include <immintrin.h>
+    #define HAVE_SIMD
+    #define TARGET_SSE2		__attribute__ (( target ( "sse2" )))
+    #define TARGET_AVX2		__attribute__ (( target ( "avx2" )))
+#endif
 
 DBG_REGISTER ( __FILE__ );
 
+const int MAX_SCALE_THREADS = 4;
+
+struct sScaleWorker {
+    cBitMap     *pBitMap;
+    SDL_Thread  *pThread;
+    SDL_sem     *StartSem;
+    SDL_sem     *DoneSem;
+    cBitMap     *pOriginal;
+    UINT8       *pDstData;
+    int          Scale;
+    sRECT        Band;
+    bool         Quit;
+};
+
+eScaleMethod cBitMap::sm_ScaleMethod  = cBitMap::BestScaleMethod ();
+int          cBitMap::sm_ScaleThreads = 0;
+
 cBitMap::cBitMap ( SDL_Surface *surface, bool useScale2x ) :
     m_Scale2x ( useScale2x ),
     m_Width ( 0 ),
     m_Height ( 0 ),
     m_Pitch ( 0 ),
-    m_pSurface ( surface )
+    m_pSurface ( surface ),
+    m_WorkerCount ( 0 ),
+    m_Worker ( NULL )
 {
     FUNCTION_ENTRY ( this, "cBitMap ctor", true );
 
@@ -51,6 +80,7 @@ cBitMap::cBitMap ( SDL_Surface *surface, bool useScale2x ) :
       m_Width  = m_pSurface->w;
       m_Height = m_pSurface->h;
       m_Pitch  = m_pSurface->pitch;
+      if ( m_Scale2x == true ) StartWorkers ();
     }
 }
 
@@ -58,6 +88,8 @@ cBitMap::~cBitMap ()
 {
     FUNCTION_ENTRY ( this, "cBitMap dtor", true );
 
+    StopWorkers ();
+
     SDL_FreeSurface ( m_pSurface );
 }
 
@@ -86,24 +118,25 @@ void cBitMap::UnlockSurface ()
     }
 }
 
-template<class T> inline void cBitMap::Scale ( cBitMap *original, int scale, UINT8 *pDstData )
+template<class T> inline void cBitMap::Scale ( cBitMap *original, int scale, UINT8 *pDstData, const sRECT &rect )
 {
     FUNCTION_ENTRY ( this, "Scale<>", false );
 
-    UINT8 *pSrcData = original->GetData ();
+    UINT8 *pSrcData = original->GetData () + rect.Top * original->Pitch ();
+
+    int width = ( rect.Right - rect.Left ) * scale;
 
-    int width  = original->Width ();
-    int height = original->Height ();
+    pDstData += rect.Top * scale * Pitch () + rect.Left * scale * sizeof ( T );
 
-    for ( int y = 0; y < height; y++ ) {
+    for ( int y = rect.Top; y < rect.Bottom; y++ ) {
         T *pData = ( T * ) pDstData;
-        for ( int x = 0; x < width; x++ ) {
+        for ( int x = rect.Left; x < rect.Right; x++ ) {
             for ( int i = 0; i < scale; i++ ) {
                 *pData++ = (( T * ) pSrcData) [x];
             }
         }
         for ( int i = 1; i < scale; i++ ) {
-            memcpy ( pDstData + Pitch (), pDstData, Width () * sizeof ( T ));
+            memcpy ( pDstData + Pitch (), pDstData, width * sizeof ( T ));
             pDstData += Pitch ();
         }
         pSrcData += original->Pitch ();
@@ -168,422 +201,741 @@ template<class T> void CalculatePixels ( int B, int D, int E, int F, int H, T &E
     }
 }
 
-void cBitMap::CalculateNewPixels ( int B, int D, int E, int F, int H, UINT8 *pData1, UINT8 *pData2 )
-{
-    FUNCTION_ENTRY ( this, "cBitMap::CalculateNewPixels", false );
-
-    CalculatePixels<UINT8> ( B, D, E, F, H, pData1 [0], pData1 [1], pData2 [0], pData2 [1] );
-}
+//----------------------------------------------------------------------------
+// Scalar kernels - these are the reference for the SIMD versions below
+//----------------------------------------------------------------------------
 
-void cBitMap::CalculateNewPixels ( int B, int D, int E, int F, int H, UINT16 *pData1, UINT16 *pData2 )
+template<class T> static void Scale2xSpan ( const T *pLst, const T *pCur, const T *pNxt, int x, int end, int width, T *pData1, T *pData2 )
 {
-    FUNCTION_ENTRY ( this, "cBitMap::CalculateNewPixels", false );
-
-    CalculatePixels<UINT16> ( B, D, E, F, H, pData1 [0], pData1 [1], pData2 [0], pData2 [1] );
-}
+    for ( ; x < end; x++ ) {
 
-void cBitMap::CalculateNewPixels ( int B, int D, int E, int F, int H, UINT32 *pData1, UINT32 *pData2 )
-{
-    FUNCTION_ENTRY ( this, "cBitMap::CalculateNewPixels", false );
+        int B = pLst [ x ];
+        int D = pCur [ ( x > 0 ) ? x - 1 : x ];
+        int E = pCur [ x ];
+        int F = pCur [ ( x < width - 1 ) ? x + 1 : x ];
+        int H = pNxt [ x ];
 
-    CalculatePixels<UINT32> ( B, D, E, F, H, pData1 [0], pData1 [1], pData2 [0], pData2 [1] );
+        CalculatePixels<T> ( B, D, E, F, H, pData1 [ 2 * x ], pData1 [ 2 * x + 1 ], pData2 [ 2 * x ], pData2 [ 2 * x + 1 ] );
+    }
 }
 
-void cBitMap::CalculateNewPixels ( int B, int D, int E, int F, int H, UINT8 *pData1, UINT8 *pData2, UINT8 *pData3 )
+template<class T> static void Scale3xSpan ( const T *pLst, const T *pCur, const T *pNxt, int x, int end, int width, T *pData1, T *pData2, T *pData3 )
 {
-    FUNCTION_ENTRY ( this, "cBitMap::CalculateNewPixels", false );
+    for ( ; x < end; x++ ) {
 
-    CalculatePixels<UINT8> ( B, D, E, F, H, pData1 [0], pData1 [2], pData3 [0], pData3 [2] );
+        int B = pLst [ x ];
+        int D = pCur [ ( x > 0 ) ? x - 1 : x ];
+        int E = pCur [ x ];
+        int F = pCur [ ( x < width - 1 ) ? x + 1 : x ];
+        int H = pNxt [ x ];
 
-    pData1 [1] = ( UINT8 ) E;
-    pData2 [0] = ( UINT8 ) E;
-    pData2 [1] = ( UINT8 ) E;
-    pData2 [2] = ( UINT8 ) E;
-    pData3 [1] = ( UINT8 ) E;
-}
+        T *p1 = pData1 + 3 * x;
+        T *p2 = pData2 + 3 * x;
+        T *p3 = pData3 + 3 * x;
 
-void cBitMap::CalculateNewPixels ( int B, int D, int E, int F, int H, UINT16 *pData1, UINT16 *pData2, UINT16 *pData3 )
-{
-    FUNCTION_ENTRY ( this, "cBitMap::CalculateNewPixels", false );
-
-    CalculatePixels<UINT16> ( B, D, E, F, H, pData1 [0], pData1 [2], pData3 [0], pData3 [2] );
+        CalculatePixels<T> ( B, D, E, F, H, p1 [0], p1 [2], p3 [0], p3 [2] );
 
-    pData1 [1] = ( UINT16 ) E;
-    pData2 [0] = ( UINT16 ) E;
-    pData2 [1] = ( UINT16 ) E;
-    pData2 [2] = ( UINT16 ) E;
-    pData3 [1] = ( UINT16 ) E;
+        p1 [1] = ( T ) E;
+        p2 [0] = ( T ) E;
+        p2 [1] = ( T ) E;
+        p2 [2] = ( T ) E;
+        p3 [1] = ( T ) E;
+    }
 }
 
-void cBitMap::CalculateNewPixels ( int B, int D, int E, int F, int H, UINT32 *pData1, UINT32 *pData2, UINT32 *pData3 )
+template<class T> static inline void Scatter3x ( const T *c0, const T *c1, const T *c2, const T *c3, const T *e, int count, T *pData1, T *pData2, T *pData3 )
 {
-    FUNCTION_ENTRY ( this, "cBitMap::CalculateNewPixels", false );
-
-    CalculatePixels<UINT32> ( B, D, E, F, H, pData1 [0], pData1 [2], pData3 [0], pData3 [2] );
-
-    pData1 [1] = ( UINT32 ) E;
-    pData2 [0] = ( UINT32 ) E;
-    pData2 [1] = ( UINT32 ) E;
-    pData2 [2] = ( UINT32 ) E;
-    pData3 [1] = ( UINT32 ) E;
+    for ( int i = 0; i < count; i++ ) {
+
+        T E = e [i];
+
+        pData1 [0] = c0 [i];
+        pData1 [1] = E;
+        pData1 [2] = c1 [i];
+        pData2 [0] = E;
+        pData2 [1] = E;
+        pData2 [2] = E;
+        pData3 [0] = c2 [i];
+        pData3 [1] = E;
+        pData3 [2] = c3 [i];
+
+        pData1 += 3;
+        pData2 += 3;
+        pData3 += 3;
+    }
 }
 
-template<class T> void cBitMap::Scale2xImp ( cBitMap *original, UINT8 *pDstData )
-{
-    FUNCTION_ENTRY ( this, "cBitMap::Scale2xImp<>", false );
-
-    UINT8 *pSrcData = original->GetData ();
+#if defined ( HAVE_SIMD )
 
-    int width  = original->Width ();
-    int height = original->Height ();
+//----------------------------------------------------------------------------
+// SSE2 kernels
+//
+//   The interior of each row is handled N pixels at a time using the masked
+//   form of the Scale2x equations.  The first and last pixels of the row have
+//   to replicate the edge of the image and are left to the scalar code.
+//----------------------------------------------------------------------------
 
-    int B, D, E, F, H;
+template<class T> __m128i CompareSSE2 ( __m128i, __m128i );
+template<class T> __m128i UnpackLoSSE2 ( __m128i, __m128i );
+template<class T> __m128i UnpackHiSSE2 ( __m128i, __m128i );
 
-    T background = * ( T * ) pDstData;
+template<> inline TARGET_SSE2 __m128i CompareSSE2<UINT8>  ( __m128i a, __m128i b )	{ return _mm_cmpeq_epi8 ( a, b ); }
+template<> inline TARGET_SSE2 __m128i CompareSSE2<UINT16> ( __m128i a, __m128i b )	{ return _mm_cmpeq_epi16 ( a, b ); }
+template<> inline TARGET_SSE2 __m128i CompareSSE2<UINT32> ( __m128i a, __m128i b )	{ return _mm_cmpeq_epi32 ( a, b ); }
 
-    T *pLstData = ( T * ) ( pSrcData );
-    T *pCurData = ( T * ) ( pSrcData );
-    T *pNxtData = ( T * ) ( pSrcData + original->Pitch ());
+template<> inline TARGET_SSE2 __m128i UnpackLoSSE2<UINT8>  ( __m128i a, __m128i b )	{ return _mm_unpacklo_epi8 ( a, b ); }
+template<> inline TARGET_SSE2 __m128i UnpackLoSSE2<UINT16> ( __m128i a, __m128i b )	{ return _mm_unpacklo_epi16 ( a, b ); }
+template<> inline TARGET_SSE2 __m128i UnpackLoSSE2<UINT32> ( __m128i a, __m128i b )	{ return _mm_unpacklo_epi32 ( a, b ); }
 
-    {
-        T *pData1 = ( T * ) ( pDstData );
-        T *pData2 = ( T * ) ( pDstData + Pitch ());
+template<> inline TARGET_SSE2 __m128i UnpackHiSSE2<UINT8>  ( __m128i a, __m128i b )	{ return _mm_unpackhi_epi8 ( a, b ); }
+template<> inline TARGET_SSE2 __m128i UnpackHiSSE2<UINT16> ( __m128i a, __m128i b )	{ return _mm_unpackhi_epi16 ( a, b ); }
+template<> inline TARGET_SSE2 __m128i UnpackHiSSE2<UINT32> ( __m128i a, __m128i b )	{ return _mm_unpackhi_epi32 ( a, b ); }
 
-        B = background;
-        E = background;
-        F = pCurData [0];
+template<class T> static inline TARGET_SSE2 void CornersSSE2 ( const T *pLst, const T *pCur, const T *pNxt, __m128i &E, __m128i &E0, __m128i &E1, __m128i &E2, __m128i &E3 )
+{
+    __m128i B = _mm_loadu_si128 (( const __m128i * ) pLst );
+    __m128i D = _mm_loadu_si128 (( const __m128i * ) ( pCur - 1 ));
+    __m128i F = _mm_loadu_si128 (( const __m128i * ) ( pCur + 1 ));
+    __m128i H = _mm_loadu_si128 (( const __m128i * ) pNxt );
+
+    E = _mm_loadu_si128 (( const __m128i * ) pCur );
+
+    __m128i BD = CompareSSE2<T> ( B, D );
+    __m128i BF = CompareSSE2<T> ( B, F );
+    __m128i DH = CompareSSE2<T> ( D, H );
+    __m128i HF = CompareSSE2<T> ( H, F );
+
+    // E0 = B == D && B != F && D != H ? D : E (and likewise for E1-E3)
+    __m128i m0 = _mm_andnot_si128 ( DH, _mm_andnot_si128 ( BF, BD ));
+    __m128i m1 = _mm_andnot_si128 ( HF, _mm_andnot_si128 ( BD, BF ));
+    __m128i m2 = _mm_andnot_si128 ( HF, _mm_andnot_si128 ( BD, DH ));
+    __m128i m3 = _mm_andnot_si128 ( BF, _mm_andnot_si128 ( DH, HF ));
+
+    E0 = _mm_or_si128 ( _mm_and_si128 ( m0, D ), _mm_andnot_si128 ( m0, E ));
+    E1 = _mm_or_si128 ( _mm_and_si128 ( m1, F ), _mm_andnot_si128 ( m1, E ));
+    E2 = _mm_or_si128 ( _mm_and_si128 ( m2, D ), _mm_andnot_si128 ( m2, E ));
+    E3 = _mm_or_si128 ( _mm_and_si128 ( m3, F ), _mm_andnot_si128 ( m3, E ));
+}
 
-        for ( int x = 0; x < width - 1; x++ ) {
+template<class T> static TARGET_SSE2 void Scale2xRowSSE2 ( const T *pLst, const T *pCur, const T *pNxt, int x, int end, int width, T *pData1, T *pData2 )
+{
+    const int N = sizeof ( __m128i ) / sizeof ( T );
 
-            D = E;
-            E = F;
-            F = pCurData [ x + 1 ];
-            H = pNxtData [ x ];
+    if ( x == 0 ) {
+        Scale2xSpan<T> ( pLst, pCur, pNxt, 0, 1, width, pData1, pData2 );
+        x = 1;
+    }
 
-            CalculateNewPixels ( B, D, E, F, H, pData1, pData2 );
+    for ( ; ( x + N < width ) && ( x + N <= end ); x += N ) {
 
-            pData1 += 2;
-            pData2 += 2;
-        }
+        __m128i E, E0, E1, E2, E3;
 
-        CalculateNewPixels ( B, E, F, background, pNxtData [ width - 1 ], pData1, pData2 );
+        CornersSSE2<T> ( pLst + x, pCur + x, pNxt + x, E, E0, E1, E2, E3 );
 
-        pLstData  = pCurData;
-        pCurData  = pNxtData;
-        pNxtData += original->Pitch () / sizeof ( T );
-        pDstData += 2 * Pitch ();
+        _mm_storeu_si128 (( __m128i * ) ( pData1 + 2 * x ),     UnpackLoSSE2<T> ( E0, E1 ));
+        _mm_storeu_si128 (( __m128i * ) ( pData1 + 2 * x + N ), UnpackHiSSE2<T> ( E0, E1 ));
+        _mm_storeu_si128 (( __m128i * ) ( pData2 + 2 * x ),     UnpackLoSSE2<T> ( E2, E3 ));
+        _mm_storeu_si128 (( __m128i * ) ( pData2 + 2 * x + N ), UnpackHiSSE2<T> ( E2, E3 ));
     }
 
-    for ( int y = 1; y < height - 1; y++ ) {
+    Scale2xSpan<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2 );
+}
 
-        T *pData1 = ( T * ) ( pDstData );
-        T *pData2 = ( T * ) ( pDstData + Pitch ());
+template<class T> static TARGET_SSE2 void Scale3xRowSSE2 ( const T *pLst, const T *pCur, const T *pNxt, int x, int end, int width, T *pData1, T *pData2, T *pData3 )
+{
+    const int N = sizeof ( __m128i ) / sizeof ( T );
 
-        E = background;
-        F = pCurData [0];
+    T c0 [N], c1 [N], c2 [N], c3 [N];
 
-        for ( int x = 0; x < width - 1; x++ ) {
+    if ( x == 0 ) {
+        Scale3xSpan<T> ( pLst, pCur, pNxt, 0, 1, width, pData1, pData2, pData3 );
+        x = 1;
+    }
 
-            B = pLstData [ x ];
-            D = E;
-            E = F;
-            F = pCurData [ x + 1 ];
-            H = pNxtData [ x ];
+    for ( ; ( x + N < width ) && ( x + N <= end ); x += N ) {
 
-            CalculateNewPixels ( B, D, E, F, H, pData1, pData2 );
+        __m128i E, E0, E1, E2, E3;
 
-            pData1 += 2;
-            pData2 += 2;
-        }
+        CornersSSE2<T> ( pLst + x, pCur + x, pNxt + x, E, E0, E1, E2, E3 );
 
-        CalculateNewPixels ( B, E, F, background, pNxtData [ width - 1 ], pData1, pData2 );
+        _mm_storeu_si128 (( __m128i * ) c0, E0 );
+        _mm_storeu_si128 (( __m128i * ) c1, E1 );
+        _mm_storeu_si128 (( __m128i * ) c2, E2 );
+        _mm_storeu_si128 (( __m128i * ) c3, E3 );
 
-        pLstData  = pCurData;
-        pCurData  = pNxtData;
-        pNxtData += original->Pitch () / sizeof ( T );
-        pDstData += 2 * Pitch ();
+        Scatter3x<T> ( c0, c1, c2, c3, pCur + x, N, pData1 + 3 * x, pData2 + 3 * x, pData3 + 3 * x );
     }
 
-    {
-        T *pData1 = ( T * ) ( pDstData );
-        T *pData2 = ( T * ) ( pDstData + Pitch ());
+    Scale3xSpan<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2, pData3 );
+}
 
-        E = background;
-        F = pCurData [0];
-        H = background;
+//----------------------------------------------------------------------------
+// AVX2 kernels
+//
+//   Same as the SSE2 versions, except the 256-bit unpack instructions work on
+//   each 128-bit lane separately so the results need to be put back in order.
+//----------------------------------------------------------------------------
 
-        for ( int x = 0; x < width - 1; x++ ) {
+template<class T> __m256i CompareAVX2 ( __m256i, __m256i );
+template<class T> __m256i UnpackLoAVX2 ( __m256i, __m256i );
+template<class T> __m256i UnpackHiAVX2 ( __m256i, __m256i );
 
-            B = pLstData [ x ];
-            D = E;
-            E = F;
-            F = pCurData [ x + 1 ];
+template<> inline TARGET_AVX2 __m256i CompareAVX2<UINT8>  ( __m256i a, __m256i b )	{ return _mm256_cmpeq_epi8 ( a, b ); }
+template<> inline TARGET_AVX2 __m256i CompareAVX2<UINT16> ( __m256i a, __m256i b )	{ return _mm256_cmpeq_epi16 ( a, b ); }
+template<> inline TARGET_AVX2 __m256i CompareAVX2<UINT32> ( __m256i a, __m256i b )	{ return _mm256_cmpeq_epi32 ( a, b ); }
 
-            CalculateNewPixels ( B, D, E, F, H, pData1, pData2 );
+template<> inline TARGET_AVX2 __m256i UnpackLoAVX2<UINT8>  ( __m256i a, __m256i b )	{ return _mm256_unpacklo_epi8 ( a, b ); }
+template<> inline TARGET_AVX2 __m256i UnpackLoAVX2<UINT16> ( __m256i a, __m256i b )	{ return _mm256_unpacklo_epi16 ( a, b ); }
+template<> inline TARGET_AVX2 __m256i UnpackLoAVX2<UINT32> ( __m256i a, __m256i b )	{ return _mm256_unpacklo_epi32 ( a, b ); }
 
-            pData1 += 2;
-            pData2 += 2;
-        }
+template<> inline TARGET_AVX2 __m256i UnpackHiAVX2<UINT8>  ( __m256i a, __m256i b )	{ return _mm256_unpackhi_epi8 ( a, b ); }
+template<> inline TARGET_AVX2 __m256i UnpackHiAVX2<UINT16> ( __m256i a, __m256i b )	{ return _mm256_unpackhi_epi16 ( a, b ); }
+template<> inline TARGET_AVX2 __m256i UnpackHiAVX2<UINT32> ( __m256i a, __m256i b )	{ return _mm256_unpackhi_epi32 ( a, b ); }
 
-        CalculateNewPixels ( B, E, F, background, pNxtData [ width - 1 ], pData1, pData2 );
-    }
+template<class T> static inline TARGET_AVX2 void CornersAVX2 ( const T *pLst, const T *pCur, const T *pNxt, __m256i &E, __m256i &E0, __m256i &E1, __m256i &E2, __m256i &E3 )
+{
+    __m256i B = _mm256_loadu_si256 (( const __m256i * ) pLst );
+    __m256i D = _mm256_loadu_si256 (( const __m256i * ) ( pCur - 1 ));
+    __m256i F = _mm256_loadu_si256 (( const __m256i * ) ( pCur + 1 ));
+    __m256i H = _mm256_loadu_si256 (( const __m256i * ) pNxt );
+
+    E = _mm256_loadu_si256 (( const __m256i * ) pCur );
+
+    __m256i BD = CompareAVX2<T> ( B, D );
+    __m256i BF = CompareAVX2<T> ( B, F );
+    __m256i DH = CompareAVX2<T> ( D, H );
+    __m256i HF = CompareAVX2<T> ( H, F );
+
+    __m256i m0 = _mm256_andnot_si256 ( DH, _mm256_andnot_si256 ( BF, BD ));
+    __m256i m1 = _mm256_andnot_si256 ( HF, _mm256_andnot_si256 ( BD, BF ));
+    __m256i m2 = _mm256_andnot_si256 ( HF, _mm256_andnot_si256 ( BD, DH ));
+    __m256i m3 = _mm256_andnot_si256 ( BF, _mm256_andnot_si256 ( DH, HF ));
+
+    E0 = _mm256_blendv_epi8 ( E, D, m0 );
+    E1 = _mm256_blendv_epi8 ( E, F, m1 );
+    E2 = _mm256_blendv_epi8 ( E, D, m2 );
+    E3 = _mm256_blendv_epi8 ( E, F, m3 );
 }
 
-template<class T> void cBitMap::Scale3xImp ( cBitMap *original, UINT8 *pDstData )
+template<class T> static TARGET_AVX2 void Scale2xRowAVX2 ( const T *pLst, const T *pCur, const T *pNxt, int x, int end, int width, T *pData1, T *pData2 )
 {
-    FUNCTION_ENTRY ( this, "cBitMap::Scale3xImp<>", false );
-
-    UINT8 *pSrcData = original->GetData ();
-
-    int width  = original->Width ();
-    int height = original->Height ();
+    const int N = sizeof ( __m256i ) / sizeof ( T );
 
-    int B, D, E, F, H;
-
-    T background = * ( T * ) pDstData;
+    if ( x == 0 ) {
+        Scale2xSpan<T> ( pLst, pCur, pNxt, 0, 1, width, pData1, pData2 );
+        x = 1;
+    }
 
-    T *pLstData = ( T * ) ( pSrcData );
-    T *pCurData = ( T * ) ( pSrcData );
-    T *pNxtData = ( T * ) ( pSrcData + original->Pitch ());
+    for ( ; ( x + N < width ) && ( x + N <= end ); x += N ) {
 
-    {
-        T *pData1 = ( T * ) ( pDstData );
-        T *pData2 = ( T * ) ( pDstData + Pitch ());
-        T *pData3 = ( T * ) ( pDstData + Pitch () * 2 );
+        __m256i E, E0, E1, E2, E3;
 
-        B = background;
-        E = background;
-        F = pCurData [0];
+        CornersAVX2<T> ( pLst + x, pCur + x, pNxt + x, E, E0, E1, E2, E3 );
 
-        for ( int x = 0; x < width - 1; x++ ) {
+        __m256i lo1 = UnpackLoAVX2<T> ( E0, E1 );
+        __m256i hi1 = UnpackHiAVX2<T> ( E0, E1 );
+        __m256i lo2 = UnpackLoAVX2<T> ( E2, E3 );
+        __m256i hi2 = UnpackHiAVX2<T> ( E2, E3 );
 
-            D = E;
-            E = F;
-            F = pCurData [ x + 1 ];
-            H = pNxtData [ x ];
+        _mm256_storeu_si256 (( __m256i * ) ( pData1 + 2 * x ),     _mm256_permute2x128_si256 ( lo1, hi1, 0x20 ));
+        _mm256_storeu_si256 (( __m256i * ) ( pData1 + 2 * x + N ), _mm256_permute2x128_si256 ( lo1, hi1, 0x31 ));
+        _mm256_storeu_si256 (( __m256i * ) ( pData2 + 2 * x ),     _mm256_permute2x128_si256 ( lo2, hi2, 0x20 ));
+        _mm256_storeu_si256 (( __m256i * ) ( pData2 + 2 * x + N ), _mm256_permute2x128_si256 ( lo2, hi2, 0x31 ));
+    }
 
-            CalculateNewPixels ( B, D, E, F, H, pData1, pData2, pData3 );
+    Scale2xSpan<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2 );
+}
 
-            pData1 += 3;
-            pData2 += 3;
-            pData3 += 3;
-        }
+template<class T> static TARGET_AVX2 void Scale3xRowAVX2 ( const T *pLst, const T *pCur, const T *pNxt, int x, int end, int width, T *pData1, T *pData2, T *pData3 )
+{
+    const int N = sizeof ( __m256i ) / sizeof ( T );
 
-        CalculateNewPixels ( B, E, F, background, pNxtData [ width - 1 ], pData1, pData2, pData3 );
+    T c0 [N], c1 [N], c2 [N], c3 [N];
 
-        pLstData  = pCurData;
-        pCurData  = pNxtData;
-        pNxtData += original->Pitch () / sizeof ( T );
-        pDstData += 3 * Pitch ();
+    if ( x == 0 ) {
+        Scale3xSpan<T> ( pLst, pCur, pNxt, 0, 1, width, pData1, pData2, pData3 );
+        x = 1;
     }
 
-    for ( int y = 1; y < height - 1; y++ ) {
+    for ( ; ( x + N < width ) && ( x + N <= end ); x += N ) {
 
-        T *pData1 = ( T * ) ( pDstData );
-        T *pData2 = ( T * ) ( pDstData + Pitch ());
-        T *pData3 = ( T * ) ( pDstData + Pitch () * 2 );
+        __m256i E, E0, E1, E2, E3;
 
-        E = background;
-        F = pCurData [0];
+        CornersAVX2<T> ( pLst + x, pCur + x, pNxt + x, E, E0, E1, E2, E3 );
 
-        for ( int x = 0; x < width - 1; x++ ) {
+        _mm256_storeu_si256 (( __m256i * ) c0, E0 );
+        _mm256_storeu_si256 (( __m256i * ) c1, E1 );
+        _mm256_storeu_si256 (( __m256i * ) c2, E2 );
+        _mm256_storeu_si256 (( __m256i * ) c3, E3 );
 
-            B = pLstData [ x ];
-            D = E;
-            E = F;
-            F = pCurData [ x + 1 ];
-            H = pNxtData [ x ];
+        Scatter3x<T> ( c0, c1, c2, c3, pCur + x, N, pData1 + 3 * x, pData2 + 3 * x, pData3 + 3 * x );
+    }
 
-            CalculateNewPixels ( B, D, E, F, H, pData1, pData2, pData3 );
+    Scale3xSpan<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2, pData3 );
+}
 
-            pData1 += 3;
-            pData2 += 3;
-            pData3 += 3;
-        }
+#endif
 
-        CalculateNewPixels ( B, E, F, background, pNxtData [ width - 1 ], pData1, pData2, pData3 );
+template<class T> static void Scale2xRow ( eScaleMethod method, const T *pLst, const T *pCur, const T *pNxt, int x, int end, int width, T *pData1, T *pData2 )
+{
+    switch ( method ) {
+#if defined ( HAVE_SIMD )
+        case SCALE_AVX2 :
+            Scale2xRowAVX2<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2 );
+            break;
+        case SCALE_SSE2 :
+            Scale2xRowSSE2<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2 );
+            break;
+#endif
+        default :
+            Scale2xSpan<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2 );
+            break;
+    }
+}
 
-        pLstData  = pCurData;
-        pCurData  = pNxtData;
-        pNxtData += original->Pitch () / sizeof ( T );
-        pDstData += 3 * Pitch ();
+template<class T> static void Scale3xRow ( eScaleMethod method, const T *pLst, const T *pCur, const T *pNxt, int x, int end, int width, T *pData1, T *pData2, T *pData3 )
+{
+    switch ( method ) {
+#if defined ( HAVE_SIMD )
+        case SCALE_AVX2 :
+            Scale3xRowAVX2<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2, pData3 );
+            break;
+        case SCALE_SSE2 :
+            Scale3xRowSSE2<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2, pData3 );
+            break;
+#endif
+        default :
+            Scale3xSpan<T> ( pLst, pCur, pNxt, x, end, width, pData1, pData2, pData3 );
+            break;
     }
+}
 
-    {
-        T *pData1 = ( T * ) ( pDstData );
-        T *pData2 = ( T * ) ( pDstData + Pitch ());
-        T *pData3 = ( T * ) ( pDstData + Pitch () * 2 );
+template<class T> void cBitMap::Scale2xImp ( cBitMap *original, UINT8 *pDstData, int left, int right, int first, int last )
+{
+    FUNCTION_ENTRY ( this, "cBitMap::Scale2xImp<>", false );
 
-        E = background;
-        F = pCurData [0];
-        H = background;
+    UINT8 *pSrcData = original->GetData ();
 
-        for ( int x = 0; x < width - 1; x++ ) {
+    int width    = original->Width ();
+    int height   = original->Height ();
+    int srcPitch = original->Pitch ();
 
-            B = pLstData [ x ];
-            D = E;
-            E = F;
-            F = pCurData [ x + 1 ];
+    pDstData += first * 2 * Pitch ();
 
-            CalculateNewPixels ( B, D, E, F, H, pData1, pData2, pData3 );
+    for ( int y = first; y < last; y++ ) {
 
-            pData1 += 3;
-            pData2 += 3;
-            pData3 += 3;
-        }
+        const T *pCur = ( const T * ) ( pSrcData + y * srcPitch );
+        const T *pLst = ( y > 0 ) ? ( const T * ) (( const UINT8 * ) pCur - srcPitch ) : pCur;
+        const T *pNxt = ( y < height - 1 ) ? ( const T * ) (( const UINT8 * ) pCur + srcPitch ) : pCur;
 
-        CalculateNewPixels ( B, E, F, background, pNxtData [ width - 1 ], pData1, pData2, pData3 );
+        Scale2xRow<T> ( sm_ScaleMethod, pLst, pCur, pNxt, left, right, width, ( T * ) pDstData, ( T * ) ( pDstData + Pitch ()));
+
+        pDstData += 2 * Pitch ();
     }
 }
 
-void cBitMap::Scale2X ( cBitMap *original )
+template<class T> void cBitMap::Scale3xImp ( cBitMap *original, UINT8 *pDstData, int left, int right, int first, int last )
 {
-    FUNCTION_ENTRY ( this, "cBitMap::Scale2X", false );
+    FUNCTION_ENTRY ( this, "cBitMap::Scale3xImp<>", false );
 
-    int wDif = Width () - original->Width () * 2;
-    int hDif = Height () - original->Height () * 2;
+    UINT8 *pSrcData = original->GetData ();
 
-    LockSurface ();
-    original->LockSurface ();
+    int width    = original->Width ();
+    int height   = original->Height ();
+    int srcPitch = original->Pitch ();
 
-    UINT8 *pDstData = GetData ();
+    pDstData += first * 3 * Pitch ();
 
-    if ( wDif > 0 ) {
-        pDstData += wDif / 2 * m_pSurface->format->BytesPerPixel;
-    }
+    for ( int y = first; y < last; y++ ) {
+
+        const T *pCur = ( const T * ) ( pSrcData + y * srcPitch );
+        const T *pLst = ( y > 0 ) ? ( const T * ) (( const UINT8 * ) pCur - srcPitch ) : pCur;
+        const T *pNxt = ( y < height - 1 ) ? ( const T * ) (( const UINT8 * ) pCur + srcPitch ) : pCur;
+
+        Scale3xRow<T> ( sm_ScaleMethod, pLst, pCur, pNxt, left, right, width, ( T * ) pDstData, ( T * ) ( pDstData + Pitch ()), ( T * ) ( pDstData + Pitch () * 2 ));
 
-    if ( hDif > 0 ) {
-        pDstData += hDif / 2 * Pitch ();
+        pDstData += 3 * Pitch ();
     }
+}
+
+void cBitMap::ScaleBand ( cBitMap *original, UINT8 *pDstData, int scale, const sRECT &rect )
+{
+    FUNCTION_ENTRY ( this, "cBitMap::ScaleBand", false );
+
+    int l = rect.Left;
+    int r = rect.Right;
+    int t = rect.Top;
+    int b = rect.Bottom;
 
     switch ( m_pSurface->format->BytesPerPixel ) {
         case 1 :
-            Scale2xImp<UINT8> ( original, pDstData );
+            if ( scale == 2 ) {
+                Scale2xImp<UINT8> ( original, pDstData, l, r, t, b );
+            } else {
+                Scale3xImp<UINT8> ( original, pDstData, l, r, t, b );
+            }
             break;
         case 2 :
-            Scale2xImp<UINT16> ( original, pDstData );
+            if ( scale == 2 ) {
+                Scale2xImp<UINT16> ( original, pDstData, l, r, t, b );
+            } else {
+                Scale3xImp<UINT16> ( original, pDstData, l, r, t, b );
+            }
             break;
         case 4 :
-            Scale2xImp<UINT32> ( original, pDstData );
+            if ( scale == 2 ) {
+                Scale2xImp<UINT32> ( original, pDstData, l, r, t, b );
+            } else {
+                Scale3xImp<UINT32> ( original, pDstData, l, r, t, b );
+            }
             break;
     }
-
-    original->UnlockSurface ();
-    UnlockSurface ();
 }
 
-void cBitMap::Scale3X ( cBitMap *original )
+void cBitMap::ScaleBands ( cBitMap *original, UINT8 *pDstData, int scale, const sRECT &rect )
 {
-    FUNCTION_ENTRY ( this, "cBitMap::Scale3X", false );
+    FUNCTION_ENTRY ( this, "cBitMap::ScaleBands", false );
 
-    int wDif = Width () - original->Width () * 3;
-    int hDif = Height () - original->Height () * 3;
+    int height = rect.Bottom - rect.Top;
 
-    LockSurface ();
-    original->LockSurface ();
+    // Small areas (ie: a few characters) aren't worth waking up the workers for
+    int workers = m_WorkerCount;
+    if ( height * ( rect.Right - rect.Left ) < original->Width () * original->Height () / 4 ) {
+        workers = 0;
+    }
+
+    int rows = ( height + workers ) / ( workers + 1 );
 
-    UINT8 *pDstData = GetData ();
+    sRECT band = rect;
 
-    if ( wDif > 0 ) {
-        pDstData += wDif / 2 * m_pSurface->format->BytesPerPixel;
+    // Hand a band of rows to each worker and do the first one ourselves
+    for ( int i = 0; i < workers; i++ ) {
+        sScaleWorker *worker = &m_Worker [i];
+        band.Top    = rect.Top + min (( i + 1 ) * rows, height );
+        band.Bottom = rect.Top + min (( i + 2 ) * rows, height );
+        worker->pOriginal = original;
+        worker->pDstData  = pDstData;
+        worker->Scale     = scale;
+        worker->Band      = band;
+        SDL_SemPost ( worker->StartSem );
     }
 
-    if ( hDif > 0 ) {
-        pDstData += hDif / 2 * Pitch ();
+    band.Top    = rect.Top;
+    band.Bottom = rect.Top + min ( rows, height );
+
+    ScaleBand ( original, pDstData, scale, band );
+
+    for ( int i = 0; i < workers; i++ ) {
+        SDL_SemWait ( m_Worker [i].DoneSem );
     }
+}
 
-    switch ( m_pSurface->format->BytesPerPixel ) {
-        case 1 :
-            Scale3xImp<UINT8> ( original, pDstData );
-            break;
-        case 2 :
-            Scale3xImp<UINT16> ( original, pDstData );
-            break;
-        case 4 :
-            Scale3xImp<UINT32> ( original, pDstData );
+void cBitMap::StartWorkers ()
+{
+    FUNCTION_ENTRY ( this, "cBitMap::StartWorkers", true );
+
+    int threads = ( sm_ScaleThreads > 0 ) ? sm_ScaleThreads : min ( GetProcessorCount (), MAX_SCALE_THREADS );
+
+    if ( threads <= 1 ) return;
+
+    m_Worker = new sScaleWorker [ threads - 1 ];
+
+    for ( int i = 0; i < threads - 1; i++ ) {
+
+        sScaleWorker *worker = &m_Worker [i];
+
+        memset ( worker, 0, sizeof ( sScaleWorker ));
+
+        worker->pBitMap  = this;
+        worker->StartSem = SDL_CreateSemaphore ( 0 );
+        worker->DoneSem  = SDL_CreateSemaphore ( 0 );
+
+        if (( worker->StartSem != NULL ) && ( worker->DoneSem != NULL )) {
+            worker->pThread = SDL_CreateThread ( _ScaleThreadProc, worker );
+        }
+
+        if ( worker->pThread == NULL ) {
+            DBG_WARNING ( "Unable to create scaling thread" );
+            if ( worker->StartSem != NULL ) SDL_DestroySemaphore ( worker->StartSem );
+            if ( worker->DoneSem != NULL ) SDL_DestroySemaphore ( worker->DoneSem );
             break;
+        }
+
+        m_WorkerCount++;
     }
+}
 
-    original->UnlockSurface ();
-    UnlockSurface ();
+void cBitMap::StopWorkers ()
+{
+    FUNCTION_ENTRY ( this, "cBitMap::StopWorkers", true );
+
+    for ( int i = 0; i < m_WorkerCount; i++ ) {
+        sScaleWorker *worker = &m_Worker [i];
+        worker->Quit = true;
+        SDL_SemPost ( worker->StartSem );
+        SDL_WaitThread ( worker->pThread, NULL );
+        SDL_DestroySemaphore ( worker->StartSem );
+        SDL_DestroySemaphore ( worker->DoneSem );
+    }
+
+    delete [] m_Worker;
+
+    m_Worker      = NULL;
+    m_WorkerCount = 0;
+}
+
+int cBitMap::_ScaleThreadProc ( void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "cBitMap::_ScaleThreadProc", true );
+
+    sScaleWorker *worker = ( sScaleWorker * ) ptr;
+
+    for ( EVER ) {
+        SDL_SemWait ( worker->StartSem );
+        if ( worker->Quit == true ) break;
+        worker->pBitMap->ScaleBand ( worker->pOriginal, worker->pDstData, worker->Scale, worker->Band );
+        SDL_SemPost ( worker->DoneSem );
+    }
+
+    return 0;
 }
 
 void cBitMap::Copy ( cBitMap *original )
 {
     FUNCTION_ENTRY ( this, "cBitMap::Copy", false );
 
+    sRECT rect = { 0, original->Width (), 0, original->Height () };
+
+    Copy ( original, &rect, 1, NULL );
+}
+
+int cBitMap::Copy ( cBitMap *original, const sRECT *rects, int count, SDL_Rect *updated )
+{
+    FUNCTION_ENTRY ( this, "cBitMap::Copy", false );
+
     int scaleX = Width () / original->Width ();
     int scaleY = Height () / original->Height ();
 
     int scale = max ( min ( scaleX, scaleY ), 1 );
 
-    int wDif = Width () - original->Width () * scale;
-    int hDif = Height () - original->Height () * scale;
+    // Offset of the scaled image within our surface (negative if it has to be cropped)
+    int xOffset = ( Width () - original->Width () * scale ) / 2;
+    int yOffset = ( Height () - original->Height () * scale ) / 2;
 
-    // See if we can use the SDL blit
-    if ( scale == 1 ) {
+    bool useScale2x = ( m_Scale2x == true ) && (( scale == 2 ) || ( scale == 3 ));
 
-        SDL_Rect srcRect = { 0, 0, original->Width (), original->Height () };
-        SDL_Rect dstRect = { 0, 0, m_Width, m_Height };
+    int bytesPerPixel = m_pSurface->format->BytesPerPixel;
 
-        // Center or crop as necessary
-        if ( wDif != 0 ) {
-            if ( wDif > 0 ) {
-                dstRect.x = wDif / 2;
-            } else {
-                srcRect.x = -wDif / 2;
-                srcRect.w = Width ();
-            }
-        }
+    UINT8 *pDstData = NULL;
 
-        if ( hDif != 0 ) {
-            if ( hDif > 0 ) {
-                dstRect.y = hDif / 2;
-            } else {
-                srcRect.y = -hDif / 2;
-                srcRect.h = Height ();
-            }
+    if ( scale > 1 ) {
+
+        LockSurface ();
+        original->LockSurface ();
+
+        pDstData = GetData () + yOffset * Pitch () + xOffset * bytesPerPixel;
+    }
+
+    int updateCount = 0;
+
+    for ( int i = 0; i < count; i++ ) {
+
+        sRECT rect = rects [i];
+
+        // Scale2x looks at the neighboring pixels, so they need to be redrawn too
+        if ( useScale2x == true ) {
+            rect.Left--;
+            rect.Right++;
+            rect.Top--;
+            rect.Bottom++;
         }
 
-        SDL_BlitSurface ( original->m_pSurface, &srcRect, m_pSurface, &dstRect );
+        rect.Left   = max ( rect.Left, 0 );
+        rect.Top    = max ( rect.Top, 0 );
+        rect.Right  = min ( rect.Right, original->Width ());
+        rect.Bottom = min ( rect.Bottom, original->Height ());
 
-    } else if (( m_Scale2x == true ) && ( scale == 2 )) {
+        if (( rect.Left >= rect.Right ) || ( rect.Top >= rect.Bottom )) continue;
 
-        Scale2X ( original );
+        if ( scale == 1 ) {
 
-    } else if (( m_Scale2x == true ) && ( scale == 3 )) {
+            SDL_Rect srcRect = { ( Sint16 ) rect.Left, ( Sint16 ) rect.Top, ( Uint16 ) ( rect.Right - rect.Left ), ( Uint16 ) ( rect.Bottom - rect.Top ) };
+            SDL_Rect dstRect = { ( Sint16 ) ( rect.Left + xOffset ), ( Sint16 ) ( rect.Top + yOffset ), 0, 0 };
 
-        Scale3X ( original );
+            SDL_BlitSurface ( original->m_pSurface, &srcRect, m_pSurface, &dstRect );
 
-    } else {
+        } else if ( useScale2x == true ) {
 
-        LockSurface ();
-        original->LockSurface ();
+            ScaleBands ( original, pDstData, scale, rect );
 
-        UINT8 *pDstData = GetData ();
+        } else {
 
-        if ( wDif > 0 ) {
-            pDstData += wDif / 2 * m_pSurface->format->BytesPerPixel;
+            switch ( bytesPerPixel ) {
+                case 1 :
+                    Scale<UINT8> ( original, scale, pDstData, rect );
+                    break;
+                case 2 :
+                    Scale<UINT16> ( original, scale, pDstData, rect );
+                    break;
+                case 4 :
+                    Scale<UINT32> ( original, scale, pDstData, rect );
+                    break;
+            }
         }
 
-        if ( hDif > 0 ) {
-            pDstData += hDif / 2 * Pitch ();
-        }
+        if ( updated != NULL ) {
+
+            // Figure out what part of our surface was touched
+            int left   = max ( rect.Left * scale + xOffset, 0 );
+            int top    = max ( rect.Top * scale + yOffset, 0 );
+            int right  = min ( rect.Right * scale + xOffset, Width ());
+            int bottom = min ( rect.Bottom * scale + yOffset, Height ());
 
-        switch ( m_pSurface->format->BytesPerPixel ) {
-            case 1 :
-                Scale<UINT8> ( original, scale, pDstData );
-                break;
-            case 2 :
-                Scale<UINT16> ( original, scale, pDstData );
-                break;
-            case 4 :
-                Scale<UINT32> ( original, scale, pDstData );
-                break;
+            if (( left < right ) && ( top < bottom )) {
+                SDL_Rect *pRect = &updated [ updateCount++ ];
+                pRect->x = ( Sint16 ) left;
+                pRect->y = ( Sint16 ) top;
+                pRect->w = ( Uint16 ) ( right - left );
+                pRect->h = ( Uint16 ) ( bottom - top );
+            }
         }
+    }
 
+    if ( scale > 1 ) {
         original->UnlockSurface ();
         UnlockSurface ();
+    }
+
+    return updateCount;
+}
+
+eScaleMethod cBitMap::BestScaleMethod ()
+{
+    FUNCTION_ENTRY ( NULL, "cBitMap::BestScaleMethod", true );
 
+#if defined ( HAVE_SIMD )
+    __builtin_cpu_init ();
+    if ( __builtin_cpu_supports ( "avx2" )) return SCALE_AVX2;
+    if ( __builtin_cpu_supports ( "sse2" )) return SCALE_SSE2;
+#endif
+
+    return SCALE_SCALAR;
+}
+
+void cBitMap::SetScaleMethod ( eScaleMethod method, int threads )
+{
+    FUNCTION_ENTRY ( NULL, "cBitMap::SetScaleMethod", true );
+
+    // Don't allow anything the CPU can't handle
+    sm_ScaleMethod  = min ( method, BestScaleMethod ());
+    sm_ScaleThreads = threads;
+}
+
+static void FillTestPattern ( SDL_Surface *surface )
+{
+    FUNCTION_ENTRY ( NULL, "FillTestPattern", true );
+
+    int bytesPerPixel = surface->format->BytesPerPixel;
+
+    // Random 8x8 characters using a pair of colors each, similar to a typical TI screen
+    for ( int y = 0; y < surface->h; y += 8 ) {
+        for ( int x = 0; x < surface->w; x += 8 ) {
+            UINT32 fore = ( rand () % 16 ) * 0x11111111;
+            UINT32 back = ( rand () % 16 ) * 0x11111111;
+            for ( int row = y; row < y + 8; row++ ) {
+                UINT8 *pData = ( UINT8 * ) surface->pixels + row * surface->pitch + x * bytesPerPixel;
+                UINT8  bits  = ( UINT8 ) rand ();
+                for ( int col = 0; col < 8; col++, bits <<= 1 ) {
+                    memcpy ( pData, ( bits & 0x80 ) ? &fore : &back, bytesPerPixel );
+                    pData += bytesPerPixel;
+                }
+            }
+        }
     }
 }
+
+void cBitMap::Benchmark ()
+{
+    FUNCTION_ENTRY ( NULL, "cBitMap::Benchmark", true );
+
+    const int FRAMES = 500;
+
+    struct sTest {
+        const char   *Name;
+        eScaleMethod  Method;
+        int           Threads;
+    } test [] = {
+        { "scalar", SCALE_SCALAR, 1 },
+        { "SSE2",   SCALE_SSE2,   1 },
+        { "AVX2",   SCALE_AVX2,   1 },
+        { "best",   SCALE_SCALAR, 0 }
+    };
+
+    eScaleMethod oldMethod  = sm_ScaleMethod;
+    int          oldThreads = sm_ScaleThreads;
+    eScaleMethod bestMethod = BestScaleMethod ();
+
+    fprintf ( stdout, "Scaling %dx%d image, %d frames per test\n\n", VDP_WIDTH, VDP_HEIGHT, FRAMES );
+    fprintf ( stdout, "Depth Scale Method  Threads  ms/frame  Speedup\n" );
+
+    for ( int depth = 8; depth <= 32; depth *= 2 ) {
+
+        SDL_Surface *image = SDL_CreateRGBSurface ( SDL_SWSURFACE, VDP_WIDTH, VDP_HEIGHT, depth, 0, 0, 0, 0 );
+        if ( image == NULL ) continue;
+
+        srand ( 1 );
+        FillTestPattern ( image );
+
+        cBitMap original ( image, false );
+
+        for ( int scale = 2; scale <= 3; scale++ ) {
+
+            int size = VDP_WIDTH * scale * VDP_HEIGHT * scale * depth / 8;
+            UINT8 *reference = new UINT8 [ size ];
+            double baseTime  = 0.0;
+
+            for ( unsigned i = 0; i < SIZE ( test ); i++ ) {
+
+                eScaleMethod method = ( test [i].Threads == 0 ) ? bestMethod : test [i].Method;
+
+                if ( method > bestMethod ) continue;
+
+                SetScaleMethod ( method, test [i].Threads );
+
+                SDL_Surface *surface = SDL_CreateRGBSurface ( SDL_SWSURFACE, VDP_WIDTH * scale, VDP_HEIGHT * scale, depth, 0, 0, 0, 0 );
+                if ( surface == NULL ) continue;
+
+                cBitMap screen ( surface, true );
+
+                Uint32 start = SDL_GetTicks ();
+                for ( int frame = 0; frame < FRAMES; frame++ ) {
+                    screen.Copy ( &original );
+                }
+                double time = ( double ) ( SDL_GetTicks () - start ) / FRAMES;
+
+                // Make sure every implementation produces exactly the same image
+                bool match = true;
+                int rowSize = surface->w * depth / 8;
+                for ( int y = 0; y < surface->h; y++ ) {
+                    UINT8 *pRow = ( UINT8 * ) surface->pixels + y * surface->pitch;
+                    if ( i == 0 ) {
+                        memcpy ( reference + y * rowSize, pRow, rowSize );
+                    } else if ( memcmp ( reference + y * rowSize, pRow, rowSize ) != 0 ) {
+                        match = false;
+                    }
+                }
+
+                if ( i == 0 ) baseTime = time;
+
+                fprintf ( stdout, "%5d %4dx  %-7s %7d  %8.3f  %6.2fx%s\n", depth, scale, test [i].Name,
+                          ( screen.m_WorkerCount + 1 ), time, ( time > 0.0 ) ? baseTime / time : 0.0,
+                          match ? "" : "  ** output differs from scalar **" );
+            }
+
+            delete [] reference;
+        }
+    }
+
+    sm_ScaleMethod  = oldMethod;
+    sm_ScaleThreads = oldThreads;
+}
@@ -35,7 +35,14 @@
 #include "ti994a.hpp"
 #include "ti994a-sdl.hpp"
 #include "tms9918a.hpp"
-#include "tms9918a-sdl.hpp"
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+    #include "tms9918a-sdl2.hpp"
+    typedef cSdl2TMS9918A cSdlVideo;
+#else
+    #include "tms9918a-sdl.hpp"
+    #include "bitmap.hpp"
+    typedef cSdlTMS9918A cSdlVideo;
+#endif
 #include "tms9919.hpp"
 #include "tms9919-sdl.hpp"
 #include "tms5220.hpp"
@@ -112,6 +119,20 @@ static int   joystickIndex [2]    = { 0, 1 };
 static int   framesOn             = 1;
 static int   framesOff            = 0;
 static char *diskImage [3];
+static int   diskSpeed [3]        = { DISK_SPEED_ACCURATE, DISK_SPEED_ACCURATE, DISK_SPEED_ACCURATE };
+
+#if ! SDL_VERSION_ATLEAST ( 2, 0, 0 )
+
+bool BenchmarkScaling ( const char *, void * )
+{
+    FUNCTION_ENTRY ( NULL, "BenchmarkScaling", true );
+
+    cBitMap::Benchmark ();
+
+    exit ( 0 );
+}
+
+#endif
 
 bool ListJoysticks ( const char *, void * )
 {
@@ -129,7 +150,11 @@ bool ListJoysticks ( const char *, void * )
 
     if ( num > 0 ) fprintf ( stdout, "\nThe names of the joysticks are:\n" );
     for ( int i = 0; i < SDL_NumJoysticks (); i++ ) {
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+        fprintf ( stdout, "  %d) %s\n", i + 1, SDL_JoystickNameForIndex ( i ));
+#else
         fprintf ( stdout, "  %d) %s\n", i + 1, SDL_JoystickName ( i ));
+#endif
     }
 
     exit ( 0 );
@@ -144,7 +169,7 @@ bool ListResolutions ( const char *, void * )
     int xDisplay [MAX_RESOLUTIONS];
     int yDisplay [MAX_RESOLUTIONS];
 
-    int n = cSdlTMS9918A::GetFullScreenResolutions ( xDisplay, yDisplay, MAX_RESOLUTIONS );
+    int n = cSdlVideo::GetFullScreenResolutions ( xDisplay, yDisplay, MAX_RESOLUTIONS );
 
     fprintf ( stdout, "Available full screen resolutions:\n" );
 
@@ -205,6 +230,13 @@ bool ParseDisk ( const char *arg, void * )
     return true;
 }
 
+bool ParseDiskSpeed ( const char *arg, void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "ParseDiskSpeed", true );
+
+    return cDiskDevice::ParseSpeed ( strchr ( arg, '=' ) + 1, ( int * ) ptr );
+}
+
 bool ParseSampleRate ( const char *arg, void *ptr )
 {
     FUNCTION_ENTRY ( NULL, "ParseSampleRate", true );
@@ -218,8 +250,8 @@ bool ParseSampleRate ( const char *arg, void *ptr )
         return false;
     }
 
-    if (( freq > 44100 ) || ( freq < 8000 )) {
-        fprintf ( stderr, "Sampling rate must be between 8000 and 44100\n" );
+    if (( freq > 96000 ) || ( freq < 8000 )) {
+        fprintf ( stderr, "Sampling rate must be between 8000 and 96000\n" );
         return false;
     }
 
@@ -283,6 +315,7 @@ int main ( int argc, char *argv [] )
     bool flagSound       = true;
     bool flagSpeech      = true;
     bool flagJoystick    = true;
+    bool flagHighLevel   = false;
     int  colorTableIndex = 0;
     int  fullScreenMode  = -1;
     int  refreshRate     = 60;
@@ -292,9 +325,14 @@ int main ( int argc, char *argv [] )
 
     sOption optList [] = {
         { '4', NULL,                 OPT_VALUE_SET | OPT_SIZE_INT,  2,     &flagSize,        NULL,            "Double width/height window" },
+#if ! SDL_VERSION_ATLEAST ( 2, 0, 0 )
+        {  0,  "benchmark-scale",    OPT_NONE,                      0,     NULL,             BenchmarkScaling, "Time the display scaling routines and exit" },
+#endif
+        {  0,  "disk-speed=*[n:]<mode>", OPT_NONE,                  0,     diskSpeed,        ParseDiskSpeed,  "Disk timing (accurate, fast, or a multiplier) for all drives or DSKn" },
         {  0,  "dsk*n=<filename>",   OPT_NONE,                      0,     NULL,             ParseDisk,       "Use <filename> disk image for DSKn" },
         {  0,  "framerate=*{n/d|p}", OPT_NONE,                      0,     NULL,             ParseFrameRate,  "Reduce frame rate to fraction n/d or percentage p" },
         { 'f', "fullscreen*=n",      OPT_VALUE_PARSE_INT,           0,     &fullScreenMode,  NULL,            "Fullscreen" },
+        {  0,  "hle-disk",           OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &flagHighLevel,   NULL,            "Handle disk DSR calls without running the controller ROM" },
         {  0,  "joystick*n=i",       OPT_NONE,                      0,     NULL,             ParseJoystick,   "Use system joystick i as TI joystick n" },
         {  0,  "list-joysticks",     OPT_NONE,                      0,     NULL,             ListJoysticks,   "Print a list of all detected joysticks" },
         {  0,  "list-resolutions",   OPT_NONE,                      0,     NULL,             ListResolutions, "Print a list of available fullscreen resolutions" },
@@ -319,9 +357,11 @@ int main ( int argc, char *argv [] )
     // Clean up on exit, exit on window close and interrupt
     atexit ( SDL_Quit );
 
+#if ! SDL_VERSION_ATLEAST ( 2, 0, 0 )
     SDL_WM_SetCaption ( "TI-99/sim", NULL );
 
     SDL_EnableUNICODE ( 1 );
+#endif
 
     const char *ctgFile = NULL;
     const char *imgFile = NULL;
@@ -422,7 +462,7 @@ int main ( int argc, char *argv [] )
         const int MAX_RESOLUTIONS = 32;
         int xDisplay [MAX_RESOLUTIONS];
         int yDisplay [MAX_RESOLUTIONS];
-        int n = cSdlTMS9918A::GetFullScreenResolutions ( xDisplay, yDisplay, MAX_RESOLUTIONS );
+        int n = cSdlVideo::GetFullScreenResolutions ( xDisplay, yDisplay, MAX_RESOLUTIONS );
         if (( fullScreenMode > 0 ) && ( fullScreenMode <= n )) {
             geometryX = xDisplay [fullScreenMode-1];
             geometryY = yDisplay [fullScreenMode-1];
@@ -434,7 +474,7 @@ int main ( int argc, char *argv [] )
 
     if ( flagSound == ( int ) false ) flagSpeech = false;
 
-    cSdlTMS9918A *vdp = new cSdlTMS9918A ( ColorTable [colorTableIndex], refreshRate, useScale2x, ( fullScreenMode != -1 ) ? true : false, geometryX, geometryY );
+    cSdlVideo *vdp = new cSdlVideo ( ColorTable [colorTableIndex], refreshRate, useScale2x, ( fullScreenMode != -1 ) ? true : false, geometryX, geometryY );
     cTMS9919 *sound = NULL;
     if ( flagSound == false ) {
         sound = new cTMS9919 ();
@@ -453,6 +493,7 @@ int main ( int argc, char *argv [] )
     if ( diskFile != NULL ) {
         if ( verbose > 0 ) fprintf ( stdout, "Loading disk ROM \"%s\"\n", diskFile );
         cDiskDevice *disk = new cDiskDevice ( diskFile );
+        disk->SetHighLevel ( flagHighLevel );
         // Look for DSKn images
         for ( unsigned i = 0; i < SIZE ( diskImage ); i++ ) {
             char buffer [256];
@@ -469,6 +510,7 @@ int main ( int argc, char *argv [] )
             }
             if ( verbose > 0 ) fprintf ( stdout, "  DSK%d: \"%s\"\n", i+1, validName );
             disk->LoadDisk ( i, validName );
+            disk->SetSpeed ( i, diskSpeed [i] );
         }
         computer.AddDevice ( disk );
     } else {
@@ -497,6 +539,10 @@ int main ( int argc, char *argv [] )
 
     computer.Run ();
 
+    if ( verbose > 1 ) {
+        fprintf ( stdout, "Sprite coincidence checks: %u done, %u skipped\n", ( unsigned ) vdp->GetCoincidenceChecks (), ( unsigned ) vdp->GetCoincidenceSkipped ());
+    }
+
     if ( ctg != NULL ) {
         computer.RemoveCartridge ( ctg );
         delete ctg;
@@ -508,8 +554,8 @@ int main ( int argc, char *argv [] )
         }
     }
 
-    if ( SDL_JoystickOpened ( joystickIndex [0] )) SDL_JoystickClose ( joy1 );
-    if ( SDL_JoystickOpened ( joystickIndex [1] )) SDL_JoystickClose ( joy2 );
+    if ( joy1 != NULL ) SDL_JoystickClose ( joy1 );
+    if ( joy2 != NULL ) SDL_JoystickClose ( joy2 );
 
     if ( ctgFile != NULL ) free (( void * ) ctgFile );
     if ( imgFile != NULL ) free (( void * ) imgFile );
@@ -31,10 +31,44 @@
 #include "common.hpp"
 #include "logger.hpp"
 #include "cartridge.hpp"
-#include "tms9918a-sdl.hpp"
 #include "ti994a-sdl.hpp"
 #include "support.hpp"
 #include "tms9901.hpp"
+#include "tms9919-sdl.hpp"
+#include "ti-disk.hpp"
+
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+
+    #include "tms9918a-sdl2.hpp"
+    typedef cSdl2TMS9918A cSdlVideo;
+
+    // SDL2 keycodes are too large to index the 9901's key table - use scancodes instead
+    #define KEY_ID(keysym)      (( int ) ( keysym ).scancode )
+    #define KEY_CODE(name)      SDL_SCANCODE_##name
+
+    #define SDL_GetKeyState     SDL_GetKeyboardState
+
+    #define SDLK_KP0            SDLK_KP_0
+    #define SDLK_KP1            SDLK_KP_1
+    #define SDLK_KP2            SDLK_KP_2
+    #define SDLK_KP3            SDLK_KP_3
+    #define SDLK_KP4            SDLK_KP_4
+    #define SDLK_KP6            SDLK_KP_6
+    #define SDLK_KP7            SDLK_KP_7
+    #define SDLK_KP8            SDLK_KP_8
+    #define SDLK_KP9            SDLK_KP_9
+    #define SDLK_LMETA          SDLK_LGUI
+    #define SDLK_RMETA          SDLK_RGUI
+
+#else
+
+    #include "tms9918a-sdl.hpp"
+    typedef cSdlTMS9918A cSdlVideo;
+
+    #define KEY_ID(keysym)      (( int ) ( keysym ).sym )
+    #define KEY_CODE(name)      SDLK_##name
+
+#endif
 
 DBG_REGISTER ( __FILE__ );
 
@@ -50,6 +84,8 @@ cSdlTI994A::cSdlTI994A ( cCartridge *ctg, cTMS9918A *vdp, cTMS9919 *sound, cTMS5
     cTI994A ( ctg, vdp, sound, speech ),
     m_StartTime ( 0 ),
     m_StartClock ( 0 ),
+    m_SpeedAdjust ( 0 ),
+    m_AudioClock ( NULL ),
     m_pThread ( NULL ),
     m_SleepSem ( NULL ),
     m_WaitSem ( NULL ),
@@ -62,6 +98,12 @@ cSdlTI994A::cSdlTI994A ( cCartridge *ctg, cTMS9918A *vdp, cTMS9919 *sound, cTMS5
 {
     FUNCTION_ENTRY ( this, "cSdlTI994A ctor", true );
 
+    // Pace the CPU against the sound card if we have one
+    m_AudioClock = dynamic_cast < cSdlTMS9919 * > ( m_SoundGenerator );
+    if (( m_AudioClock != NULL ) && ( m_AudioClock->GetSampleRate () == 0 )) {
+        m_AudioClock = NULL;
+    }
+
     m_SleepSem = SDL_CreateSemaphore ( 0 );
     m_WaitSem  = SDL_CreateSemaphore ( 0 );
 
@@ -228,31 +270,43 @@ void cSdlTI994A::Run ()
     int joystick;
 
     cTMS9901 *pic = m_PIC;
-    cSdlTMS9918A *vdp = dynamic_cast < cSdlTMS9918A * > ( m_VDP );
+    cSdlVideo *vdp = dynamic_cast < cSdlVideo * > ( m_VDP );
 
-    Uint8 *keystate = SDL_GetKeyState ( NULL );
+    const Uint8 *keystate = SDL_GetKeyState ( NULL );
 
 	// Set the initial state for CAPS lock
-    if ( keystate [ SDLK_CAPSLOCK ] != 0 ) pic->VKeyDown ( SDLK_CAPSLOCK, VK_CAPSLOCK );
+    if ( keystate [ KEY_CODE ( CAPSLOCK )] != 0 ) pic->VKeyDown ( KEY_CODE ( CAPSLOCK ), VK_CAPSLOCK );
 
     // Loop waiting for SDL_QUIT
     SDL_Event event;
     while ( SDL_WaitEvent ( &event ) >= 0 ) {
         switch ( event.type ) {
-            case SDL_ACTIVEEVENT :
-                // Track changes in CAPS lock when we regain focus
-                if (( event.active.state & SDL_APPINPUTFOCUS ) && ( event.active.gain != 0 )) {
-                    if (( pic->GetKeyState ( VK_CAPSLOCK ) != 0 ) && ( keystate [ SDLK_CAPSLOCK ] == 0 )) {
-                        pic->VKeyUp ( SDLK_CAPSLOCK );
-                    }
-                    if (( pic->GetKeyState ( VK_CAPSLOCK ) == 0 ) && ( keystate [ SDLK_CAPSLOCK ] != 0 )) {
-                        pic->VKeyDown ( SDLK_CAPSLOCK, VK_CAPSLOCK );
-                    }
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+            case SDL_USEREVENT :
+                if ( event.user.code == VDP_EVENT_PRESENT ) {
+                    vdp->Present ();
                 }
                 break;
+            case SDL_WINDOWEVENT :
+                if ( event.window.event == SDL_WINDOWEVENT_SIZE_CHANGED ) {
+                    vdp->ResizeWindow ( event.window.data1, event.window.data2 );
+                }
+                if ( event.window.event != SDL_WINDOWEVENT_FOCUS_GAINED ) break;
+#else
             case SDL_VIDEORESIZE :
                 vdp->ResizeWindow ( event.resize.w, event.resize.h );
                 break;
+            case SDL_ACTIVEEVENT :
+                if ((( event.active.state & SDL_APPINPUTFOCUS ) == 0 ) || ( event.active.gain == 0 )) break;
+#endif
+                // Track changes in CAPS lock when we regain focus
+                if (( pic->GetKeyState ( VK_CAPSLOCK ) != 0 ) && ( keystate [ KEY_CODE ( CAPSLOCK )] == 0 )) {
+                    pic->VKeyUp ( KEY_CODE ( CAPSLOCK ));
+                }
+                if (( pic->GetKeyState ( VK_CAPSLOCK ) == 0 ) && ( keystate [ KEY_CODE ( CAPSLOCK )] != 0 )) {
+                    pic->VKeyDown ( KEY_CODE ( CAPSLOCK ), VK_CAPSLOCK );
+                }
+                break;
             case SDL_JOYAXISMOTION :
                 joystick = FindJoystick ( event.jaxis.which );
                 if ( joystick != -1 ) {
@@ -290,7 +344,7 @@ void cSdlTI994A::Run ()
                 break;
             case SDL_KEYDOWN :
                 if ( event.key.keysym.sym == SDLK_ESCAPE ) goto done;
-                if (( keystate [ SDLK_LCTRL ] != 0 ) || ( keystate [ SDLK_RCTRL ] != 0 )) {
+                if (( keystate [ KEY_CODE ( LCTRL )] != 0 ) || ( keystate [ KEY_CODE ( RCTRL )] != 0 )) {
                     switch ( event.key.keysym.sym ) {
                         case SDLK_F1 :
                             GK_ToggleEnabled ();
@@ -313,6 +367,9 @@ void cSdlTI994A::Run ()
                         case SDLK_F7 :
                             GK_ToggleLoader ();
                             break;
+                        case SDLK_F8 :
+                            ToggleDiskSpeed ();
+                            break;
                         default :
                             KeyPressed ( event.key.keysym );
                             break;
@@ -382,7 +439,12 @@ bool cSdlTI994A::LoadImage ( const char *filename )
 
 void cSdlTI994A::SetJoystick ( int index, SDL_Joystick *joystick )
 {
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+    // Joystick events report the instance ID rather than the device index
+    m_JoystickMap [index] = SDL_JoystickInstanceID ( joystick );
+#else
     m_JoystickMap [index] = SDL_JoystickIndex ( joystick );
+#endif
 }
 
 int cSdlTI994A::FindJoystick ( int index )
@@ -397,78 +459,110 @@ int cSdlTI994A::FindJoystick ( int index )
     return -1;
 }
 
+static UINT16 GetKeyChar ( const SDL_keysym &keysym )
+{
+    FUNCTION_ENTRY ( NULL, "GetKeyChar", false );
+
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+
+    // SDL2 doesn't translate key presses - apply the shift state for a US layout ourselves
+    static const char unshifted [] = "`1234567890-=[]\\;',./";
+    static const char shifted []   = "~!@#$%^&*()_+{}|:\"<>?";
+
+    int sym = keysym.sym;
+    if (( sym < ' ' ) || ( sym > '~' )) return 0;
+
+    bool shift = ( keysym.mod & KMOD_SHIFT ) ? true : false;
+
+    if ( isalpha ( sym )) {
+        bool caps = ( keysym.mod & KMOD_CAPS ) ? true : false;
+        return ( UINT16 ) (( shift != caps ) ? toupper ( sym ) : sym );
+    }
+
+    const char *ptr = strchr ( unshifted, sym );
+
+    return ( UINT16 ) ((( shift == true ) && ( ptr != NULL )) ? shifted [ ptr - unshifted ] : sym );
+
+#else
+
+    return ( UINT16 ) (( keysym.unicode & 0xFF80 ) ? 0 : keysym.unicode & 0x7F );
+
+#endif
+}
+
 void cSdlTI994A::KeyPressed ( SDL_keysym keysym )
 {
     FUNCTION_ENTRY ( this, "cSdlTI994A::KeyPressed", false );
 
     cTMS9901 *pic = m_PIC;
 
-    UINT16 ch = ( UINT16 ) (( keysym.unicode & 0xFF80 ) ? 0 : keysym.unicode & 0x7F );
+    int key   = KEY_ID ( keysym );
+    UINT16 ch = GetKeyChar ( keysym );
 
     if ( isalpha ( ch )) {
-        pic->VKeysDown ( keysym.sym, ( VIRTUAL_KEY_E ) ( VK_A + ( tolower ( ch ) - 'a' )));
+        pic->VKeysDown ( key, ( VIRTUAL_KEY_E ) ( VK_A + ( tolower ( ch ) - 'a' )));
     } else if ( isdigit ( ch )) {
-        pic->VKeysDown ( keysym.sym, ( VIRTUAL_KEY_E ) ( VK_0 + ( ch - '0' )));
+        pic->VKeysDown ( key, ( VIRTUAL_KEY_E ) ( VK_0 + ( ch - '0' )));
     } else {
         switch ( ch ) {
-            case '\'' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_O );         break;
-            case  ',' : pic->VKeyUp ( SDLK_LSHIFT ); pic->VKeyUp ( SDLK_RSHIFT);
-                        pic->VKeysDown ( keysym.sym, VK_COMMA );               break;
-            case  '<' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_COMMA );     break;
-            case  '.' : pic->VKeyUp ( SDLK_LSHIFT ); pic->VKeyUp ( SDLK_RSHIFT);
-                        pic->VKeysDown ( keysym.sym, VK_PERIOD );              break;
-            case  '>' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_PERIOD );    break;
-            case  ';' : pic->VKeyUp ( SDLK_LSHIFT ); pic->VKeyUp ( SDLK_RSHIFT);
-                        pic->VKeysDown ( keysym.sym, VK_SEMICOLON );           break;
-            case  ':' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_SEMICOLON ); break;
-            case  '_' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_U );         break;
-            case  '|' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_A );         break;
-            case  '=' : pic->VKeyUp ( SDLK_LSHIFT ); pic->VKeyUp ( SDLK_RSHIFT);
-                        pic->VKeysDown ( keysym.sym, VK_EQUALS );              break;
-            case  '+' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_EQUALS );    break;
-            case  '~' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_W );         break;
-            case '\"' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_P );         break;
-            case  '?' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_I );         break;
-            case  '/' : pic->VKeyUp ( SDLK_LSHIFT ); pic->VKeyUp ( SDLK_RSHIFT);
-                        pic->VKeysDown ( keysym.sym, VK_DIVIDE );              break;
-            case  '-' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_DIVIDE );    break;
-            case  '[' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_R );         break;
-            case  ']' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_T );         break;
-            case  '{' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_F );         break;
-            case  '}' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_G );         break;
-            case  ' ' : pic->VKeysDown ( keysym.sym, VK_SPACE );               break;
-            case  '!' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_1 );         break;
-            case  '@' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_2 );         break;
-            case  '#' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_3 );         break;
-            case  '$' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_4 );         break;
-            case  '%' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_5 );         break;
-            case  '^' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_6 );         break;
-            case  '&' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_7 );         break;
-            case  '*' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_8 );         break;
-            case  '(' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_9 );         break;
-            case  ')' : pic->VKeysDown ( keysym.sym, VK_SHIFT, VK_0 );         break;
-            case '\\' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_Z );         break;
-            case  '`' : pic->VKeysDown ( keysym.sym, VK_FCTN,  VK_C );         break;
+            case '\'' : pic->VKeysDown ( key, VK_FCTN,  VK_O );         break;
+            case  ',' : pic->VKeyUp ( KEY_CODE ( LSHIFT )); pic->VKeyUp ( KEY_CODE ( RSHIFT ));
+                        pic->VKeysDown ( key, VK_COMMA );               break;
+            case  '<' : pic->VKeysDown ( key, VK_SHIFT, VK_COMMA );     break;
+            case  '.' : pic->VKeyUp ( KEY_CODE ( LSHIFT )); pic->VKeyUp ( KEY_CODE ( RSHIFT ));
+                        pic->VKeysDown ( key, VK_PERIOD );              break;
+            case  '>' : pic->VKeysDown ( key, VK_SHIFT, VK_PERIOD );    break;
+            case  ';' : pic->VKeyUp ( KEY_CODE ( LSHIFT )); pic->VKeyUp ( KEY_CODE ( RSHIFT ));
+                        pic->VKeysDown ( key, VK_SEMICOLON );           break;
+            case  ':' : pic->VKeysDown ( key, VK_SHIFT, VK_SEMICOLON ); break;
+            case  '_' : pic->VKeysDown ( key, VK_FCTN,  VK_U );         break;
+            case  '|' : pic->VKeysDown ( key, VK_FCTN,  VK_A );         break;
+            case  '=' : pic->VKeyUp ( KEY_CODE ( LSHIFT )); pic->VKeyUp ( KEY_CODE ( RSHIFT ));
+                        pic->VKeysDown ( key, VK_EQUALS );              break;
+            case  '+' : pic->VKeysDown ( key, VK_SHIFT, VK_EQUALS );    break;
+            case  '~' : pic->VKeysDown ( key, VK_FCTN,  VK_W );         break;
+            case '\"' : pic->VKeysDown ( key, VK_FCTN,  VK_P );         break;
+            case  '?' : pic->VKeysDown ( key, VK_FCTN,  VK_I );         break;
+            case  '/' : pic->VKeyUp ( KEY_CODE ( LSHIFT )); pic->VKeyUp ( KEY_CODE ( RSHIFT ));
+                        pic->VKeysDown ( key, VK_DIVIDE );              break;
+            case  '-' : pic->VKeysDown ( key, VK_SHIFT, VK_DIVIDE );    break;
+            case  '[' : pic->VKeysDown ( key, VK_FCTN,  VK_R );         break;
+            case  ']' : pic->VKeysDown ( key, VK_FCTN,  VK_T );         break;
+            case  '{' : pic->VKeysDown ( key, VK_FCTN,  VK_F );         break;
+            case  '}' : pic->VKeysDown ( key, VK_FCTN,  VK_G );         break;
+            case  ' ' : pic->VKeysDown ( key, VK_SPACE );               break;
+            case  '!' : pic->VKeysDown ( key, VK_SHIFT, VK_1 );         break;
+            case  '@' : pic->VKeysDown ( key, VK_SHIFT, VK_2 );         break;
+            case  '#' : pic->VKeysDown ( key, VK_SHIFT, VK_3 );         break;
+            case  '$' : pic->VKeysDown ( key, VK_SHIFT, VK_4 );         break;
+            case  '%' : pic->VKeysDown ( key, VK_SHIFT, VK_5 );         break;
+            case  '^' : pic->VKeysDown ( key, VK_SHIFT, VK_6 );         break;
+            case  '&' : pic->VKeysDown ( key, VK_SHIFT, VK_7 );         break;
+            case  '*' : pic->VKeysDown ( key, VK_SHIFT, VK_8 );         break;
+            case  '(' : pic->VKeysDown ( key, VK_SHIFT, VK_9 );         break;
+            case  ')' : pic->VKeysDown ( key, VK_SHIFT, VK_0 );         break;
+            case '\\' : pic->VKeysDown ( key, VK_FCTN,  VK_Z );         break;
+            case  '`' : pic->VKeysDown ( key, VK_FCTN,  VK_C );         break;
 
             default:
                 switch ( keysym.sym ) {
-                    case SDLK_TAB       : pic->VKeysDown ( keysym.sym, VK_FCTN, VK_7 ); break;
+                    case SDLK_TAB       : pic->VKeysDown ( key, VK_FCTN, VK_7 ); break;
                     case SDLK_BACKSPACE :
-                    case SDLK_LEFT      : pic->VKeysDown ( keysym.sym, VK_FCTN, VK_S ); break;
-                    case SDLK_RIGHT     : pic->VKeysDown ( keysym.sym, VK_FCTN, VK_D ); break;
-                    case SDLK_UP        : pic->VKeysDown ( keysym.sym, VK_FCTN, VK_E ); break;
-                    case SDLK_DOWN      : pic->VKeysDown ( keysym.sym, VK_FCTN, VK_X ); break;
-                    case SDLK_DELETE    : pic->VKeysDown ( keysym.sym, VK_FCTN, VK_1 ); break;
-                    case SDLK_RETURN    : pic->VKeysDown ( keysym.sym, VK_ENTER );      break;
+                    case SDLK_LEFT      : pic->VKeysDown ( key, VK_FCTN, VK_S ); break;
+                    case SDLK_RIGHT     : pic->VKeysDown ( key, VK_FCTN, VK_D ); break;
+                    case SDLK_UP        : pic->VKeysDown ( key, VK_FCTN, VK_E ); break;
+                    case SDLK_DOWN      : pic->VKeysDown ( key, VK_FCTN, VK_X ); break;
+                    case SDLK_DELETE    : pic->VKeysDown ( key, VK_FCTN, VK_1 ); break;
+                    case SDLK_RETURN    : pic->VKeysDown ( key, VK_ENTER );      break;
                     case SDLK_LSHIFT    :
-                    case SDLK_RSHIFT    : pic->VKeysDown ( keysym.sym, VK_SHIFT );      break;
+                    case SDLK_RSHIFT    : pic->VKeysDown ( key, VK_SHIFT );      break;
                     case SDLK_LALT      :
-                    case SDLK_RALT      : pic->VKeysDown ( keysym.sym, VK_FCTN );       break;
+                    case SDLK_RALT      : pic->VKeysDown ( key, VK_FCTN );       break;
                     case SDLK_LMETA     :
-                    case SDLK_RMETA     : pic->VKeysDown ( keysym.sym, VK_FCTN );       break;
+                    case SDLK_RMETA     : pic->VKeysDown ( key, VK_FCTN );       break;
                     case SDLK_LCTRL     :
-                    case SDLK_RCTRL     : pic->VKeysDown ( keysym.sym, VK_CTRL );       break;
-                    case SDLK_CAPSLOCK  : pic->VKeysDown ( keysym.sym, VK_CAPSLOCK );   break;
+                    case SDLK_RCTRL     : pic->VKeysDown ( key, VK_CTRL );       break;
+                    case SDLK_CAPSLOCK  : pic->VKeysDown ( key, VK_CAPSLOCK );   break;
                     default : ;
                 }
         }
@@ -495,11 +589,11 @@ void cSdlTI994A::KeyPressed ( SDL_keysym keysym )
 
 void cSdlTI994A::KeyReleased ( SDL_keysym keysym )
 {
-    Uint8 *keystate = SDL_GetKeyState ( NULL );
+    const Uint8 *keystate = SDL_GetKeyState ( NULL );
 
     cTMS9901 *pic = m_PIC;
 
-    pic->VKeyUp ( keysym.sym );
+    pic->VKeyUp ( KEY_ID ( keysym ));
 
     if (( pic->GetKeyState ( VK_COMMA )     == 0 ) &&
         ( pic->GetKeyState ( VK_PERIOD )    == 0 ) &&
@@ -507,11 +601,11 @@ void cSdlTI994A::KeyReleased ( SDL_keysym keysym )
         ( pic->GetKeyState ( VK_EQUALS )    == 0 ) &&
         ( pic->GetKeyState ( VK_DIVIDE )    == 0 ) &&
         ( pic->GetKeyState ( VK_SHIFT )     == 0 )) {
-        if ( keystate [ SDLK_LSHIFT ]) {
-            pic->VKeysDown ( SDLK_LSHIFT, VK_SHIFT );
+        if ( keystate [ KEY_CODE ( LSHIFT )]) {
+            pic->VKeysDown ( KEY_CODE ( LSHIFT ), VK_SHIFT );
         }
-        if ( keystate [ SDLK_RSHIFT ]) {
-            pic->VKeysDown ( SDLK_RSHIFT, VK_SHIFT );
+        if ( keystate [ KEY_CODE ( RSHIFT )]) {
+            pic->VKeysDown ( KEY_CODE ( RSHIFT ), VK_SHIFT );
         }
     }
 
@@ -543,7 +637,11 @@ void cSdlTI994A::StartThread ()
 
     m_StartTime = SDL_GetTicks ();
 
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+    m_pThread = SDL_CreateThread ( _RunThreadProc, "CPU", this );
+#else
     m_pThread = SDL_CreateThread ( _RunThreadProc, this );
+#endif
 }
 
 void cSdlTI994A::StopThread ()
@@ -740,6 +838,26 @@ void cSdlTI994A::GK_ToggleLoader ()
     memcpy ( &m_GromMemory [ 0x4000 ], m_GromMemoryInfo [2]->CurBank->Data, GROM_BANK_SIZE );
 }
 
+// Switch every drive between real time (300 RPM) and as fast as possible (see cDiskDevice::SetSpeed)
+void cSdlTI994A::ToggleDiskSpeed ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTI994A::ToggleDiskSpeed", true );
+
+    for ( unsigned i = 0; i < SIZE ( m_Device ); i++ ) {
+
+        cDiskDevice *disk = dynamic_cast < cDiskDevice * > ( m_Device [i] );
+        if ( disk == NULL ) continue;
+
+        int speed = ( disk->GetSpeed ( 0 ) == DISK_SPEED_INSTANT ) ? DISK_SPEED_ACCURATE : DISK_SPEED_INSTANT;
+
+        DBG_TRACE ( "Setting disk speed to " << (( speed == DISK_SPEED_INSTANT ) ? "fast" : "accurate" ));
+
+        for ( int drive = 0; drive < 3; drive++ ) {
+            disk->SetSpeed ( drive, speed );
+        }
+    }
+}
+
 int cSdlTI994A::TimerHookProc ()
 {
     FUNCTION_ENTRY ( this, "cSdlTI994A::TimerHookProc", false );
@@ -747,7 +865,21 @@ int cSdlTI994A::TimerHookProc ()
     UINT32 clockCycles    = m_CPU->GetClocks ();
 
     UINT32 ellapsedCycles = clockCycles - m_StartClock;
-    UINT32 estimatedTime  = m_StartTime + ellapsedCycles / CPU_SPEED_KHZ;
+
+    // Let the audio clock speed us up or slow us down slightly
+    int adjust = ( m_AudioClock != NULL ) ? m_AudioClock->GetSpeedAdjust () : 0;
+    if ( adjust != m_SpeedAdjust ) {
+        // Start a new base at the last whole ms so no time is lost
+        double clocksPerMs  = CPU_SPEED_KHZ * ( 1.0 + m_SpeedAdjust / 1000000.0 );
+        UINT32 ellapsedTime = ( UINT32 ) ( ellapsedCycles / clocksPerMs );
+        m_StartTime        += ellapsedTime;
+        m_StartClock       += ( UINT32 ) ( ellapsedTime * clocksPerMs );
+        ellapsedCycles      = clockCycles - m_StartClock;
+        m_SpeedAdjust       = adjust;
+    }
+
+    double clocksPerMs    = CPU_SPEED_KHZ * ( 1.0 + m_SpeedAdjust / 1000000.0 );
+    UINT32 estimatedTime  = m_StartTime + ( UINT32 ) ( ellapsedCycles / clocksPerMs );
 
     // Limit the emulated speed to 3.0MHz
     while ( SDL_GetTicks () < estimatedTime ) {
@@ -45,12 +45,19 @@ cSdlTMS9918A::cSdlTMS9918A ( sRGBQUAD colorTable [17], int refreshRate, bool use
     m_ColorsChanged ( false ),
     m_SpritesChanged ( false ),
     m_NeedsUpdate ( false ),
+    m_FullRefresh ( true ),
+    m_SpriteScreenValid ( false ),
+    m_DirtyAll ( true ),
+    m_DirtyCount ( 0 ),
+    m_SpriteRectCount ( 0 ),
     m_Scale2x ( useScale2x ),
     m_Screen ( NULL ),
     m_BitmapScreen ( NULL ),
     m_BitmapSpriteScreen ( NULL ),
-    m_CharacterPattern ( NULL ),
     m_BytesPerPixel ( 0 ),
+    m_Tile ( NULL ),
+    m_TileData ( NULL ),
+    m_TileVictim ( 0 ),
     m_Mutex ( NULL ),
     m_FullScreen ( false ),
     m_OnFrames ( 1 ),
@@ -70,8 +77,9 @@ cSdlTMS9918A::cSdlTMS9918A ( sRGBQUAD colorTable [17], int refreshRate, bool use
     memset ( m_SpriteCharUse, 0, sizeof ( m_SpriteCharUse ));
     memset ( m_PatternChanged, 0, sizeof ( m_PatternChanged ));
 
-    m_CharacterPattern    = new UINT8 [ 3 * 256 * 8 * 8 ];
-    memset ( m_CharacterPattern, 0, 3 * 256 * 8 * 8 );
+    // Tiles are stored in the screen's pixel format - allow for the largest
+    m_Tile     = new sPatternTile [ TILE_CACHE_SIZE ];
+    m_TileData = new UINT8 [ TILE_CACHE_SIZE * 8 * 8 * 4 ];
 
     // See if we're starting if fullscreen mode
     if ( fullScreen == true ) {
@@ -87,9 +95,11 @@ cSdlTMS9918A::cSdlTMS9918A ( sRGBQUAD colorTable [17], int refreshRate, bool use
     m_BitmapScreen       = CreateBitMap ( VDP_WIDTH, VDP_HEIGHT );
     m_BitmapSpriteScreen = CreateBitMap ( VDP_WIDTH, VDP_HEIGHT );
 
-    SetColorTable ( colorTable );
-
     m_BytesPerPixel = m_Screen->GetSurface ()->format->BitsPerPixel / 8;
+
+    FlushTileCache ();
+
+    SetColorTable ( colorTable );
 }
 
 cSdlTMS9918A::~cSdlTMS9918A ()
@@ -98,7 +108,8 @@ cSdlTMS9918A::~cSdlTMS9918A ()
 
     SDL_DestroyMutex ( m_Mutex );
 
-    delete [] m_CharacterPattern;
+    delete [] m_TileData;
+    delete [] m_Tile;
 
     delete m_BitmapSpriteScreen;
     delete m_BitmapScreen;
@@ -228,6 +239,7 @@ void cSdlTMS9918A::ResizeWindow ( int width, int height )
     // Force a repaint during the next call to Refresh
     m_ChangesMade    = true;
     m_SpritesChanged = true;
+    m_FullRefresh    = true;
     memset ( m_ScreenChanged, true, sizeof ( m_ScreenChanged ));
     memset ( m_PatternChanged, true, sizeof ( m_PatternChanged ));
 
@@ -301,8 +313,12 @@ void cSdlTMS9918A::ConvertColors ()
         }
     }
 
+    // Any cached tiles are in terms of the old colors
+    FlushTileCache ();
+
     m_ChangesMade    = true;
     m_SpritesChanged = true;
+    m_FullRefresh    = true;
     memset ( m_ScreenChanged, true, sizeof ( m_ScreenChanged ));
     memset ( m_PatternChanged, true, sizeof ( m_PatternChanged ));
 
@@ -321,6 +337,7 @@ void cSdlTMS9918A::Reset ()
     m_BlankChanged   = true;
     m_ColorsChanged  = true;
     m_SpritesChanged = false;
+    m_FullRefresh    = true;
 
     memset ( m_ScreenChanged, false, sizeof ( m_ScreenChanged ));
     memset ( m_PatternChanged, false, sizeof ( m_PatternChanged ));
@@ -337,25 +354,146 @@ void cSdlTMS9918A::Reset ()
     m_SpriteCharUse [0] = 32;
 }
 
+void cSdlTMS9918A::FlushTileCache ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::FlushTileCache", true );
+
+    for ( int i = 0; i < TILE_CACHE_SIZE; i++ ) {
+        m_Tile [i].RefCount = 0;
+        m_Tile [i].Next     = -1;
+        m_Tile [i].Valid    = false;
+    }
+
+    for ( unsigned i = 0; i < SIZE ( m_TileHash ); i++ ) {
+        m_TileHash [i] = -1;
+    }
+
+    m_TileVictim = 0;
+
+    // Start every character off pointing at an empty (color 0) tile
+    UINT8 blank [8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    int tile = FindTile ( blank, blank );
+
+    for ( unsigned i = 0; i < SIZE ( m_CharTile ); i++ ) {
+        m_CharTile [i] = tile;
+    }
+
+    m_Tile [ tile ].RefCount = SIZE ( m_CharTile );
+}
+
+static unsigned HashTile ( const UINT8 *pattern, const UINT8 *color )
+{
+    FUNCTION_ENTRY ( NULL, "HashTile", false );
+
+    unsigned hash = 2166136261u;
+
+    for ( int i = 0; i < 8; i++ ) {
+        hash = ( hash ^ pattern [i] ) * 16777619u;
+        hash = ( hash ^ color [i] ) * 16777619u;
+    }
+
+    return ( hash ^ ( hash >> 16 )) % TILE_HASH_SIZE;
+}
+
+int cSdlTMS9918A::FindTile ( const UINT8 *pattern, const UINT8 *color )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::FindTile", false );
+
+    unsigned hash = HashTile ( pattern, color );
+
+    for ( int i = m_TileHash [ hash ]; i != -1; i = m_Tile [i].Next ) {
+        sPatternTile *tile = &m_Tile [i];
+        if (( memcmp ( tile->Pattern, pattern, 8 ) == 0 ) && ( memcmp ( tile->Color, color, 8 ) == 0 )) {
+            return i;
+        }
+    }
+
+    // Not cached - recycle a tile that isn't used by any character
+    //   There are more tiles than characters, so there is always one free
+    int index;
+    for ( EVER ) {
+        index = m_TileVictim;
+        m_TileVictim = ( m_TileVictim + 1 ) % TILE_CACHE_SIZE;
+        if ( m_Tile [ index ].RefCount == 0 ) break;
+    }
+
+    sPatternTile *tile = &m_Tile [ index ];
+
+    if ( tile->Valid == true ) {
+        int *pLink = &m_TileHash [ HashTile ( tile->Pattern, tile->Color )];
+        while ( *pLink != index ) pLink = &m_Tile [ *pLink ].Next;
+        *pLink = tile->Next;
+    }
+
+    memcpy ( tile->Pattern, pattern, 8 );
+    memcpy ( tile->Color, color, 8 );
+
+    tile->Valid = true;
+    tile->Next  = m_TileHash [ hash ];
+    m_TileHash [ hash ] = index;
+
+    ExpandTile ( index );
+
+    return index;
+}
+
+void cSdlTMS9918A::ExpandTile ( int index )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::ExpandTile", false );
+
+    DBG_ASSERT ( index < TILE_CACHE_SIZE );
+
+    sPatternTile *tile = &m_Tile [ index ];
+    UINT8 *pData       = m_TileData + index * 8 * 8 * 4;
+
+    for ( int y = 0; y < 8; y++ ) {
+        UINT8 row  = tile->Pattern [y];
+        UINT8 fore = ( UINT8 ) ( tile->Color [y] >> 4 );
+        UINT8 back = ( UINT8 ) ( tile->Color [y] & 0x0F );
+        for ( int x = 0; x < 8; x++ ) {
+            UINT8 color = ( row & ( 0x80 >> x )) ? fore : back;
+            switch ( m_BytesPerPixel ) {
+                case 1 :
+                    *pData = color;
+                    break;
+                case 2 :
+                    * ( UINT16 * ) pData = * ( UINT16 * ) &m_SDLColorTable [ color ];
+                    break;
+                case 4 :
+                    * ( UINT32 * ) pData = * ( UINT32 * ) &m_SDLColorTable [ color ];
+                    break;
+            }
+            pData += m_BytesPerPixel;
+        }
+    }
+}
+
+void cSdlTMS9918A::SetCharacterTile ( int ch, const UINT8 *pattern, const UINT8 *color )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::SetCharacterTile", false );
+
+    DBG_ASSERT ( ch < 3 * 256 );
+
+    // Release the old tile first so it can be recycled if need be
+    m_Tile [ m_CharTile [ ch ]].RefCount--;
+
+    int tile = FindTile ( pattern, color );
+
+    m_Tile [ tile ].RefCount++;
+    m_CharTile [ ch ] = tile;
+}
+
 void cSdlTMS9918A::UpdateCharacterPatternGraphics ( int ch, UINT8 fore, UINT8 back, UINT8 *pattern )
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9918A::UpdateCharacterPatternGraphics", false );
 
     DBG_ASSERT ( ch < 256 );
 
-    UINT8 *pData = m_CharacterPattern + ch * 8 * 8;
+    UINT8 color = ( UINT8 ) (( fore << 4 ) | back );
+    UINT8 colors [8] = { color, color, color, color, color, color, color, color };
 
-    for ( int y = 0; y < 8; y++ ) {
-        UINT8 row = *pattern++;
-        *pData++ = ( row & 0x80 ) ? fore : back;
-        *pData++ = ( row & 0x40 ) ? fore : back;
-        *pData++ = ( row & 0x20 ) ? fore : back;
-        *pData++ = ( row & 0x10 ) ? fore : back;
-        *pData++ = ( row & 0x08 ) ? fore : back;
-        *pData++ = ( row & 0x04 ) ? fore : back;
-        *pData++ = ( row & 0x02 ) ? fore : back;
-        *pData++ = ( row & 0x01 ) ? fore : back;
-    }
+    SetCharacterTile ( ch, pattern, colors );
 }
 
 void cSdlTMS9918A::UpdateCharacterPatternBitMap ( int ch, UINT8 *pattern )
@@ -364,22 +502,7 @@ void cSdlTMS9918A::UpdateCharacterPatternBitMap ( int ch, UINT8 *pattern )
 
     DBG_ASSERT ( ch < 3 * 256 );
 
-    UINT8 *pColor = m_ColorTable->data + ch * 8;
-    UINT8 *pData  = m_CharacterPattern + ch * 8 * 8;
-
-    for ( int y = 0; y < 8; y++ ) {
-        UINT8 row  = *pattern++;
-        UINT8 fore = ( UINT8 ) ( pColor [y] >> 4 );
-        UINT8 back = ( UINT8 ) ( pColor [y] & 0x0F );
-        *pData++ = ( row & 0x80 ) ? fore : back;
-        *pData++ = ( row & 0x40 ) ? fore : back;
-        *pData++ = ( row & 0x20 ) ? fore : back;
-        *pData++ = ( row & 0x10 ) ? fore : back;
-        *pData++ = ( row & 0x08 ) ? fore : back;
-        *pData++ = ( row & 0x04 ) ? fore : back;
-        *pData++ = ( row & 0x02 ) ? fore : back;
-        *pData++ = ( row & 0x01 ) ? fore : back;
-    }
+    SetCharacterTile ( ch, pattern, m_ColorTable->data + ch * 8 );
 }
 
 void cSdlTMS9918A::UpdateScreenGraphics ( int x, int y, int ch )
@@ -390,43 +513,20 @@ void cSdlTMS9918A::UpdateScreenGraphics ( int x, int y, int ch )
     DBG_ASSERT ( y < 24 );
     DBG_ASSERT ( ch < 3 * 256 );
 
-    UINT8 *pSrcData = m_CharacterPattern + ch * 8 * 8;
+    UINT8 *pSrcData = m_TileData + m_CharTile [ ch ] * 8 * 8 * 4;
     UINT8 *pDstData = m_BitmapScreen->GetData ();
 
     int dstPitch = m_BitmapScreen->Pitch ();
+    int srcPitch = 8 * m_BytesPerPixel;
 
     DBG_ASSERT ( m_BytesPerPixel <= 4 );
 
     pDstData += y * 8 * dstPitch + x * 8 * m_BytesPerPixel;
 
-    switch ( m_BytesPerPixel ) {
-        case 1 :
-            for ( y = 0; y < 8; y++ ) {
-                UINT8 *pDst = ( UINT8 * ) pDstData;
-                for ( x = 0; x < 8; x++ ) {
-                    *pDst++ = *pSrcData++;
-                }
-                pDstData += dstPitch;
-            }
-            break;
-        case 2 :
-            for ( y = 0; y < 8; y++ ) {
-                UINT16 *pDst = ( UINT16 * ) pDstData;
-                for ( x = 0; x < 8; x++ ) {
-                    *pDst++ = * ( UINT16 * ) &m_SDLColorTable [ *pSrcData++ ];
-                }
-                pDstData += dstPitch;
-            }
-            break;
-        case 4 :
-            for ( y = 0; y < 8; y++ ) {
-                UINT32 *pDst = ( UINT32 * ) pDstData;
-                for ( x = 0; x < 8; x++ ) {
-                    *pDst++ = * ( UINT32 * ) &m_SDLColorTable [ *pSrcData++ ];
-                }
-                pDstData += dstPitch;
-            }
-            break;
+    for ( y = 0; y < 8; y++ ) {
+        memcpy ( pDstData, pSrcData, srcPitch );
+        pSrcData += srcPitch;
+        pDstData += dstPitch;
     }
 }
 
@@ -438,44 +538,19 @@ void cSdlTMS9918A::UpdateScreenText ( int x, int y, int ch )
     DBG_ASSERT ( y < 24 );
     DBG_ASSERT ( ch < 256 );
 
-    UINT8 *pSrcData = m_CharacterPattern + ch * 8 * 8;
+    UINT8 *pSrcData = m_TileData + m_CharTile [ ch ] * 8 * 8 * 4;
     UINT8 *pDstData = m_BitmapScreen->GetData ();
 
     int dstPitch = m_BitmapScreen->Pitch ();
+    int srcPitch = 8 * m_BytesPerPixel;
 
     pDstData += y * 8 * dstPitch + x * 6 * m_BytesPerPixel + 8 * m_BytesPerPixel;
 
-    switch ( m_BytesPerPixel ) {
-        case 1 :
-            for ( y = 0; y < 8; y++ ) {
-                UINT8 *pDst = ( UINT8 * ) pDstData;
-                for ( x = 0; x < 6; x++ ) {
-                    *pDst++ = *pSrcData++;
-                }
-                pSrcData += 2;
-                pDstData += dstPitch;
-            }
-            break;
-        case 2 :
-            for ( y = 0; y < 8; y++ ) {
-                UINT16 *pDst = ( UINT16 * ) pDstData;
-                for ( x = 0; x < 6; x++ ) {
-                    *pDst++ = * ( UINT16 * ) &m_SDLColorTable [ *pSrcData++ ];
-                }
-                pSrcData += 2;
-                pDstData += dstPitch;
-            }
-            break;
-        case 4 :
-            for ( y = 0; y < 8; y++ ) {
-                UINT32 *pDst = ( UINT32 * ) pDstData;
-                for ( x = 0; x < 6; x++ ) {
-                    *pDst++ = * ( UINT32 * ) &m_SDLColorTable [ *pSrcData++ ];
-                }
-                pSrcData += 2;
-                pDstData += dstPitch;
-            }
-            break;
+    // Only the left 6 pixels of each character are shown in text mode
+    for ( y = 0; y < 8; y++ ) {
+        memcpy ( pDstData, pSrcData, 6 * m_BytesPerPixel );
+        pSrcData += srcPitch;
+        pDstData += dstPitch;
     }
 }
 
@@ -575,6 +650,95 @@ void cSdlTMS9918A::MarkScreenChanges ( int ch )
     }
 }
 
+void cSdlTMS9918A::AddDirtyRect ( int left, int top, int right, int bottom )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::AddDirtyRect", false );
+
+    if ( m_DirtyAll == true ) return;
+
+    for ( int i = m_DirtyCount - 1; i >= 0; i-- ) {
+
+        sRECT *rect = &m_DirtyRect [i];
+
+        // Extend a rectangle covering the same columns on the row above
+        if (( rect->Left == left ) && ( rect->Right == right ) && ( rect->Bottom == top )) {
+            rect->Bottom = bottom;
+            return;
+        }
+
+        // Combine overlapping rectangles (ie: a sprite's old & new positions)
+        if (( left < rect->Right ) && ( right > rect->Left ) && ( top < rect->Bottom ) && ( bottom > rect->Top )) {
+            rect->Left   = min ( rect->Left, left );
+            rect->Right  = max ( rect->Right, right );
+            rect->Top    = min ( rect->Top, top );
+            rect->Bottom = max ( rect->Bottom, bottom );
+            return;
+        }
+    }
+
+    // Too many pieces - just redraw the whole thing
+    if ( m_DirtyCount == MAX_DIRTY_RECTS ) {
+        m_DirtyAll = true;
+        return;
+    }
+
+    sRECT *rect = &m_DirtyRect [ m_DirtyCount++ ];
+
+    rect->Left   = left;
+    rect->Right  = right;
+    rect->Top    = top;
+    rect->Bottom = bottom;
+}
+
+void cSdlTMS9918A::FindDirtyRects ()
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::FindDirtyRects", false );
+
+    if ( m_DirtyAll == true ) return;
+
+    int width     = GetScreenWidth ();
+    int height    = GetScreenHeight ();
+    int cellWidth = GetCellWidth ();
+    int border    = m_TextMode ? 8 : 0;
+
+    bool *changed = m_ScreenChanged;
+
+    // Turn each run of changed characters on a row into a rectangle
+    for ( int y = 0; y < height; y++ ) {
+        for ( int x = 0; x < width; x++ ) {
+            if ( changed [x] == false ) continue;
+            int start = x;
+            while (( x < width ) && ( changed [x] == true )) x++;
+            AddDirtyRect ( border + start * cellWidth, y * 8, border + x * cellWidth, y * 8 + 8 );
+        }
+        changed += width;
+    }
+}
+
+bool cSdlTMS9918A::GetSpriteRect ( int index, sRECT *rect )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9918A::GetSpriteRect", false );
+
+    sSpriteAttributeEntry *sprite = &m_SpriteAttrTable->data [index];
+
+    int size = ( m_Register [1] & VDP_SPRITE_SIZE ) ? 16 : 8;
+    if ( m_Register [1] & VDP_SPRITE_MAGNIFY ) size *= 2;
+
+    int posX = ( int ) sprite->posX;
+    if ( sprite->earlyClock & 0x80 ) posX -= 32;
+
+    // Sprites near the bottom of the range wrap around to the top of the screen
+    int posY = ( sprite->posY + 1 ) & 0xFF;
+    if ( posY + size > 256 ) posY -= 256;
+
+    rect->Left   = max ( posX, 0 );
+    rect->Right  = min ( posX + size, VDP_WIDTH );
+    rect->Top    = max ( posY, 0 );
+    rect->Bottom = min ( posY + size, VDP_HEIGHT );
+
+    return (( rect->Left < rect->Right ) && ( rect->Top < rect->Bottom )) ? true : false;
+}
+
 void cSdlTMS9918A::DrawSprite ( int index )
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9918A::DrawSprite", false );
@@ -653,6 +817,8 @@ bool cSdlTMS9918A::RefreshGraphics ()
         }
     }
 
+    FindDirtyRects ();
+
     bool needsUpdate = false;
     bool *changed = m_ScreenChanged;
     UINT8 *chr = ( UINT8 * ) m_ImageTable;
@@ -744,6 +910,8 @@ bool cSdlTMS9918A::RefreshBitMap ()
         }
     }
 
+    FindDirtyRects ();
+
     bool needsUpdate = false;
     UINT8 *chr = ( UINT8 * ) m_ImageTable;
 
@@ -771,13 +939,21 @@ bool cSdlTMS9918A::RefreshMultiColor ()
 
     bool needsUpdate = false;
 
-    m_BitmapScreen->LockSurface ();
     UINT8 *chr = ( UINT8 * ) m_ImageTable;
 
     for ( int i = 0; i < m_ImageTableSize; i++ ) {
-        UINT8 index = chr [i];
-        if ( m_ScreenChanged [i] || m_PatternChanged [index] ) {
-            UpdateScreenMultiColor ( i % 32, i / 32, index );
+        if ( m_PatternChanged [ chr [i]] ) {
+            m_ScreenChanged [i] = true;
+        }
+    }
+
+    FindDirtyRects ();
+
+    m_BitmapScreen->LockSurface ();
+
+    for ( int i = 0; i < m_ImageTableSize; i++ ) {
+        if ( m_ScreenChanged [i] ) {
+            UpdateScreenMultiColor ( i % 32, i / 32, chr [i] );
             needsUpdate = true;
         }
     }
@@ -803,18 +979,47 @@ cBitMap *cSdlTMS9918A::UpdateSprites ()
         if ( sprite [i].posY == 0xD0 ) break;
     }
 
+    if ( m_SpritesChanged == true ) {
+
+        // Everything covered by a sprite last time or this time needs to be redrawn
+        for ( int j = 0; j < m_SpriteRectCount; j++ ) {
+            sRECT *rect = &m_SpriteRect [j];
+            AddDirtyRect ( rect->Left, rect->Top, rect->Right, rect->Bottom );
+        }
+
+        m_SpriteRectCount = 0;
+
+        for ( int j = 0; j < i; j++ ) {
+            sRECT *rect = &m_SpriteRect [ m_SpriteRectCount ];
+            if ( GetSpriteRect ( j, rect ) == true ) {
+                AddDirtyRect ( rect->Left, rect->Top, rect->Right, rect->Bottom );
+                m_SpriteRectCount++;
+            }
+        }
+
+        m_SpritesChanged = false;
+    }
+
     // Don't waste our time if ther are no active sprites
-    if ( i == 0 ) return m_BitmapScreen;
+    if ( i == 0 ) {
+        m_SpriteScreenValid = false;
+        return m_BitmapScreen;
+    }
 
-    m_BitmapSpriteScreen->Copy ( m_BitmapScreen );
+    // Bring the sprite screen up to date with the background
+    if (( m_DirtyAll == true ) || ( m_SpriteScreenValid == false )) {
+        m_BitmapSpriteScreen->Copy ( m_BitmapScreen );
+    } else {
+        m_BitmapSpriteScreen->Copy ( m_BitmapScreen, m_DirtyRect, m_DirtyCount, NULL );
+    }
+
+    m_SpriteScreenValid = true;
 
     // Draw sprites in reverse order (ie: lowest numbered sprite is on top)
     while ( --i >= 0 ) {
         DrawSprite ( i );
     }
 
-    m_SpritesChanged = false;
-
     return m_BitmapSpriteScreen;
 }
 
@@ -887,11 +1092,20 @@ void cSdlTMS9918A::UpdateScreen ()
     cBitMap *screen = m_BitmapScreen;
 
     if ( m_TextMode == false ) {
-        screen = m_BitmapSpriteScreen;
         screen = UpdateSprites ();
     }
 
-    m_Screen->Copy ( screen );
+    SDL_Surface *surface = m_Screen->GetSurface ();
+
+    if ( m_DirtyAll == true ) {
+        m_Screen->Copy ( screen );
+        SDL_UpdateRect ( surface, 0, 0, m_Screen->Width (), m_Screen->Height ());
+    } else if ( m_DirtyCount > 0 ) {
+        // Only scale & present the parts of the screen that actually changed
+        SDL_Rect rect [ MAX_DIRTY_RECTS ];
+        int count = m_Screen->Copy ( screen, m_DirtyRect, m_DirtyCount, rect );
+        SDL_UpdateRects ( surface, count, rect );
+    }
 }
 
 void cSdlTMS9918A::Refresh ( bool force )
@@ -913,10 +1127,14 @@ void cSdlTMS9918A::Refresh ( bool force )
         return;
     }
 
-    if ( ! m_ChangesMade && ! m_SpritesChanged ) return;
+    if ( ! m_ChangesMade && ! m_SpritesChanged && ! m_BlankChanged ) return;
 
     bool colorsChanged = m_ColorsChanged;
 
+    // Start a new list of the areas that need to be redrawn
+    m_DirtyAll   = colorsChanged || m_BlankChanged || m_FullRefresh;
+    m_DirtyCount = 0;
+
     if ( m_Mode & VDP_M3 ) {
         m_NeedsUpdate = RefreshBitMap ();
     } else if ( m_Mode & VDP_M2 ) {
@@ -927,14 +1145,15 @@ void cSdlTMS9918A::Refresh ( bool force )
 
     m_ChangesMade   = false;
     m_ColorsChanged = false;
+    m_FullRefresh   = false;
 
     if ( m_NeedsUpdate | m_SpritesChanged | m_BlankChanged ) {
         SDL_mutexP ( m_Mutex );
         if ( colorsChanged == true ) BlankScreen ( true );
         UpdateScreen ();
-        SDL_UpdateRect ( m_Screen->GetSurface (), 0, 0, m_Screen->Width (), m_Screen->Height ());
         SDL_mutexV ( m_Mutex );
-        m_NeedsUpdate = false;
+        m_NeedsUpdate  = false;
+        m_BlankChanged = false;
     }
 }
 
@@ -1009,12 +1228,31 @@ void cSdlTMS9918A::WriteRegister ( size_t reg, UINT8 value )
                 SDL_SetColors ( m_BitmapScreen->GetSurface (), m_SDLColorTable, 0, SIZE ( m_SDLColorTable ));
                 SDL_SetColors ( m_BitmapSpriteScreen->GetSurface (), m_SDLColorTable, 0, SIZE ( m_SDLColorTable ));
             }
+            // Tiles using the transparent color have to be rebuilt
+            FlushTileCache ();
             // Fall through
 
         case 3 :				// Color Table
         case 4 :				// Pattern Table
             patternChanged = true;
             break;
+
+        case 5 :				// Sprite Attribute Table
+            {
+                memset ( m_SpriteCharUse, 0, sizeof ( m_SpriteCharUse ));
+                int count = ( m_Register [1] & VDP_SPRITE_SIZE ) ? 4 : 1;
+                for ( int s = 0; s < 32; s++ ) {
+                    sSpriteAttributeEntry *sprite = &m_SpriteAttrTable->data [s];
+                    for ( int i = 0; i < count; i++ ) {
+                        m_SpriteCharUse [( i + sprite->patternIndex ) % 256 ]++;
+                    }
+                }
+            }
+            // Fall through
+
+        case 6 :				// Sprite Descriptor Table
+            m_SpritesChanged = true;
+            break;
     }
 
     if ( patternChanged ) {
@@ -1109,6 +1347,7 @@ bool cSdlTMS9918A::SetMode ( int mode )
 
     // We changed video modes, force a refresh of the screen
     m_ChangesMade = true;
+    m_FullRefresh = true;
 
     memset ( m_PatternChanged, true, sizeof ( m_PatternChanged ));
     memset ( m_CharUse, 0, sizeof ( m_CharUse ));
@@ -1129,6 +1368,7 @@ bool cSdlTMS9918A::LoadImage ( FILE *file )
 
     m_ChangesMade    = true;
     m_SpritesChanged = true;
+    m_FullRefresh    = true;
 
     memset ( m_ScreenChanged, true, sizeof ( m_ScreenChanged ));
     memset ( m_PatternChanged, true, sizeof ( m_PatternChanged ));
@@ -0,0 +1,482 @@
+//----------------------------------------------------------------------------
+//
+// File:        tms9918a-sdl2.cpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: This file contains SDL2 specific code for the TMS9918A
+//
+//   The VDP image is kept as a 256x192 array of color indices that is
+//   uploaded once per retrace into a streaming texture.  Scaling to the
+//   window size (and vsync) is left to the SDL2 renderer.
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <stdio.h>
+#include <string.h>
+#include "SDL.h"
+#include "common.hpp"
+#include "logger.hpp"
+#include "tms9918a-sdl2.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+cSdl2TMS9918A::cSdl2TMS9918A ( sRGBQUAD colorTable [17], int refreshRate, bool smooth, bool fullScreen, int width, int height ) :
+    cTMS9918A ( refreshRate ),
+    m_TextMode ( false ),
+    m_ChangesMade ( true ),
+    m_FramePending ( false ),
+    m_Window ( NULL ),
+    m_Renderer ( NULL ),
+    m_Texture ( NULL ),
+    m_Mutex ( NULL ),
+    m_FullScreen ( fullScreen ),
+    m_OnFrames ( 1 ),
+    m_OffFrames ( 0 ),
+    m_FrameCycle ( 1 )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A ctor", true );
+
+    m_Mutex = SDL_CreateMutex ();
+
+    memset ( m_RawColorTable, 0, sizeof ( m_RawColorTable ));
+    memset ( m_PixelColor, 0, sizeof ( m_PixelColor ));
+    memset ( m_Frame, 0, sizeof ( m_Frame ));
+
+    Uint32 flags = SDL_WINDOW_RESIZABLE;
+
+    if ( fullScreen == true ) {
+        // Use the desktop resolution unless the caller picked a mode
+        flags = (( width == 0 ) || ( height == 0 )) ? SDL_WINDOW_FULLSCREEN_DESKTOP : SDL_WINDOW_FULLSCREEN;
+    }
+
+    if ( width == 0 ) width = VDP_WIDTH;
+    if ( height == 0 ) height = VDP_HEIGHT;
+
+    DBG_TRACE ( "Geometry: " << width << "x" << height );
+
+    m_Window = SDL_CreateWindow ( "TI-99/sim", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, flags );
+
+    if ( m_Window == NULL ) {
+        fprintf ( stderr, "Unable to create window: %s\n", SDL_GetError ());
+        return;
+    }
+
+    // The renderer does all the scaling - keep the pixels sharp unless asked not to
+    SDL_SetHint ( SDL_HINT_RENDER_SCALE_QUALITY, smooth ? "linear" : "nearest" );
+
+    m_Renderer = SDL_CreateRenderer ( m_Window, -1, SDL_RENDERER_PRESENTVSYNC );
+
+    if ( m_Renderer == NULL ) {
+        DBG_WARNING ( "Unable to create a vsync'd renderer: " << SDL_GetError ());
+        m_Renderer = SDL_CreateRenderer ( m_Window, -1, SDL_RENDERER_SOFTWARE );
+    }
+
+    if ( m_Renderer == NULL ) {
+        fprintf ( stderr, "Unable to create renderer: %s\n", SDL_GetError ());
+        return;
+    }
+
+    // Preserve the aspect ratio when the window is resized
+    SDL_RenderSetLogicalSize ( m_Renderer, VDP_WIDTH, VDP_HEIGHT );
+    SDL_SetRenderDrawColor ( m_Renderer, 0, 0, 0, 255 );
+
+    m_Texture = SDL_CreateTexture ( m_Renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, VDP_WIDTH, VDP_HEIGHT );
+
+    if ( m_Texture == NULL ) {
+        fprintf ( stderr, "Unable to create texture: %s\n", SDL_GetError ());
+    }
+
+    if ( fullScreen == true ) {
+        SDL_ShowCursor ( SDL_DISABLE );
+    }
+
+    SetColorTable ( colorTable );
+}
+
+cSdl2TMS9918A::~cSdl2TMS9918A ()
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A dtor", true );
+
+    if ( m_Texture != NULL ) SDL_DestroyTexture ( m_Texture );
+    if ( m_Renderer != NULL ) SDL_DestroyRenderer ( m_Renderer );
+    if ( m_Window != NULL ) SDL_DestroyWindow ( m_Window );
+
+    SDL_DestroyMutex ( m_Mutex );
+}
+
+int cSdl2TMS9918A::GetFullScreenResolutions ( int *x, int *y, int n )
+{
+    FUNCTION_ENTRY ( NULL, "cSdl2TMS9918A::GetFullScreenResolutions", true );
+
+    if (( x == NULL ) || ( y == NULL ) || ( n == 0 )) return 0;
+
+    int max = SDL_GetNumDisplayModes ( 0 );
+
+    int count = 0;
+    for ( int i = max - 1; i >= 0; i-- ) {
+        SDL_DisplayMode mode;
+        if ( SDL_GetDisplayMode ( 0, i, &mode ) != 0 ) continue;
+        // We don't want to scale down
+        if ( mode.w < VDP_WIDTH ) continue;
+        if ( mode.h < VDP_HEIGHT ) continue;
+        // Modes are listed once per refresh rate/format - skip duplicates
+        if (( count > 0 ) && ( x [count-1] == mode.w ) && ( y [count-1] == mode.h )) continue;
+        x [count] = mode.w;
+        y [count] = mode.h;
+        if ( ++count == n ) break;
+    }
+
+    return count;
+}
+
+void cSdl2TMS9918A::SetCaption ( const char *caption )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::SetCaption", true );
+
+    if ( m_Window != NULL ) SDL_SetWindowTitle ( m_Window, caption );
+}
+
+void cSdl2TMS9918A::SetColorTable ( sRGBQUAD colorTable [17] )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::SetColorTable", true );
+
+    memcpy ( m_RawColorTable, colorTable, sizeof ( m_RawColorTable ));
+
+    for ( unsigned i = 0; i < SIZE ( m_PixelColor ); i++ ) {
+        sRGBQUAD *src = &m_RawColorTable [i];
+        m_PixelColor [i] = 0xFF000000 | ( src->r << 16 ) | ( src->g << 8 ) | src->b;
+    }
+
+    m_ChangesMade = true;
+}
+
+void cSdl2TMS9918A::SetFrameRate ( int onFrames, int offFrames )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::SetFrameRate", true );
+
+    DBG_ASSERT ( onFrames > 0 );
+    DBG_ASSERT ( offFrames >= 0 );
+
+    // Start off on an "on" frame
+    m_FrameCycle = onFrames;
+    m_OnFrames   = onFrames;
+    m_OffFrames  = offFrames;
+}
+
+void cSdl2TMS9918A::ResizeWindow ( int, int )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::ResizeWindow", true );
+
+    // The renderer rescales the texture itself - we just have to redraw it
+    RequestPresent ();
+}
+
+void cSdl2TMS9918A::Reset ()
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::Reset", true );
+
+    cTMS9918A::Reset ();
+
+    m_TextMode    = false;
+    m_ChangesMade = true;
+}
+
+void cSdl2TMS9918A::DrawPattern ( int x, int y, int width, const UINT8 *pattern, const UINT8 *color, int colorStep )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::DrawPattern", false );
+
+    for ( int row = 0; row < 8; row++ ) {
+        UINT8 bits  = pattern [row];
+        UINT8 fore  = ( UINT8 ) ( *color >> 4 );
+        UINT8 back  = ( UINT8 ) ( *color & 0x0F );
+        UINT8 *pDst = &m_Frame [ y + row ][ x ];
+        for ( int col = 0; col < width; col++ ) {
+            *pDst++ = ( bits & 0x80 ) ? fore : back;
+            bits <<= 1;
+        }
+        color += colorStep;
+    }
+}
+
+void cSdl2TMS9918A::DrawGraphics ()
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::DrawGraphics", false );
+
+    UINT8 *chr = ( UINT8 * ) m_ImageTable;
+
+    for ( int y = 0; y < 24; y++ ) {
+        for ( int x = 0; x < 32; x++ ) {
+            UINT8 ch = *chr++;
+            DrawPattern ( x * 8, y * 8, 8, m_PatternTable->data [ch], &m_ColorTable->data [ ch / 8 ], 0 );
+        }
+    }
+}
+
+void cSdl2TMS9918A::DrawText ()
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::DrawText", false );
+
+    UINT8 color = m_Register [7];
+    UINT8 back  = ( UINT8 ) ( color & 0x0F );
+
+    UINT8 *chr = ( UINT8 * ) m_ImageTable;
+
+    for ( int y = 0; y < 24; y++ ) {
+        for ( int x = 0; x < 40; x++ ) {
+            DrawPattern ( 8 + x * 6, y * 8, 6, m_PatternTable->data [ *chr++ ], &color, 0 );
+        }
+    }
+
+    // Fill in the borders on either side of the 240 pixel wide text screen
+    for ( int y = 0; y < VDP_HEIGHT; y++ ) {
+        memset ( &m_Frame [y][0], back, 8 );
+        memset ( &m_Frame [y][ 8 + 40 * 6 ], back, 8 );
+    }
+}
+
+void cSdl2TMS9918A::DrawBitMap ()
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::DrawBitMap", false );
+
+    UINT8 *chr = ( UINT8 * ) m_ImageTable;
+
+    for ( int i = 0; i < m_ImageTableSize; i++ ) {
+        int ch = ( i & 0xFF00 ) + chr [i];
+        DrawPattern (( i % 32 ) * 8, ( i / 32 ) * 8, 8, m_PatternTable->data [ch], m_ColorTable->data + ch * 8, 1 );
+    }
+}
+
+void cSdl2TMS9918A::DrawMultiColor ()
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::DrawMultiColor", false );
+
+    UINT8 *chr = ( UINT8 * ) m_ImageTable;
+
+    for ( int i = 0; i < m_ImageTableSize; i++ ) {
+
+        int x = ( i % 32 ) * 8;
+        int y = ( i / 32 ) * 8;
+
+        UINT8 *pSrcData = &m_PatternTable->data [ chr [i]][(( i / 32 ) & 0x03 ) * 2 ];
+
+        // Each byte is two 4x4 blocks - upper nibble on the left
+        for ( int row = 0; row < 8; row++ ) {
+            UINT8 colors = pSrcData [ row / 4 ];
+            memset ( &m_Frame [ y + row ][ x ], colors >> 4, 4 );
+            memset ( &m_Frame [ y + row ][ x + 4 ], colors & 0x0F, 4 );
+        }
+    }
+}
+
+void cSdl2TMS9918A::DrawSprites ()
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::DrawSprites", false );
+
+    sSpriteAttributeEntry *sprite = m_SpriteAttrTable->data;
+
+    int last;
+    for ( last = 0; last < 32; last++ ) {
+        if ( sprite [last].posY == 0xD0 ) break;
+    }
+
+    int count = ( m_Register [1] & VDP_SPRITE_SIZE ) ? 4 : 1;
+    int size  = ( m_Register [1] & VDP_SPRITE_MAGNIFY ) ? 16 : 8;
+
+    // Draw sprites in reverse order (ie: lowest numbered sprite is on top)
+    for ( int index = last - 1; index >= 0; index-- ) {
+
+        UINT8 colorIndex = ( UINT8 ) ( sprite [index].earlyClock & 0x0F );
+        if ( colorIndex == 0 ) continue;
+
+        for ( int i = 0; i < count; i++ ) {
+
+            int posX = ( int ) sprite [index].posX + ( i / 2 ) * size;
+            if ( sprite [index].earlyClock & 0x80 ) posX -= 32;
+
+            if ( posX >= VDP_WIDTH ) continue;
+
+            UINT8 row      = ( UINT8 ) ( sprite [index].posY + 1 + ( i % 2 ) * size );
+            UINT8 *pattern = m_SpriteDescTable->data [( sprite [index].patternIndex + i ) % 256 ];
+
+            for ( int y = 0; y < size; y++, row++ ) {
+
+                // Make sure the current row and sprite are visible
+                if (( row < VDP_HEIGHT ) && ( index <= m_MaxSprite [row] )) {
+                    UINT8 bits = *pattern;
+                    if ( bits ) for ( int x = 0, col = posX; x < size; x++, col++ ) {
+                        if ( col >= VDP_WIDTH ) break;
+                        if (( bits & 0x80 ) && ( col >= 0 )) {
+                            m_Frame [row][col] = colorIndex;
+                        }
+                        if (( size == 8 ) || ( x & 1 )) bits <<= 1;
+                    }
+                }
+
+                if (( size == 8 ) || ( y & 1 )) pattern++;
+            }
+        }
+    }
+}
+
+void cSdl2TMS9918A::RequestPresent ()
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::RequestPresent", false );
+
+    // Only one frame needs to be queued - Present always shows the latest one
+    if ( m_FramePending == true ) return;
+
+    m_FramePending = true;
+
+    SDL_Event event;
+    memset ( &event, 0, sizeof ( event ));
+
+    event.type      = SDL_USEREVENT;
+    event.user.code = VDP_EVENT_PRESENT;
+
+    if ( SDL_PushEvent ( &event ) < 0 ) {
+        m_FramePending = false;
+    }
+}
+
+void cSdl2TMS9918A::Present ()
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::Present", false );
+
+    if ( m_Texture == NULL ) return;
+
+    // Color 0 is transparent - it shows the backdrop color
+    UINT32 color [16];
+    memcpy ( color, m_PixelColor, sizeof ( color ));
+    color [0] = m_PixelColor [ m_Register [7] & 0x0F ];
+
+    SDL_mutexP ( m_Mutex );
+
+    void *pixels;
+    int pitch;
+
+    if ( SDL_LockTexture ( m_Texture, NULL, &pixels, &pitch ) == 0 ) {
+        for ( int y = 0; y < VDP_HEIGHT; y++ ) {
+            UINT32 *pDst = ( UINT32 * ) (( UINT8 * ) pixels + y * pitch );
+            UINT8 *pSrc  = m_Frame [y];
+            for ( int x = 0; x < VDP_WIDTH; x++ ) {
+                *pDst++ = color [ *pSrc++ & 0x0F ];
+            }
+        }
+        SDL_UnlockTexture ( m_Texture );
+    }
+
+    m_FramePending = false;
+
+    SDL_mutexV ( m_Mutex );
+
+    SDL_RenderClear ( m_Renderer );
+    SDL_RenderCopy ( m_Renderer, m_Texture, NULL, NULL );
+    SDL_RenderPresent ( m_Renderer );
+}
+
+void cSdl2TMS9918A::Refresh ( bool force )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::Refresh", false );
+
+    // See if we should skip a frame
+    if (( force == false ) && ( m_FrameCycle <= 0 )) {
+        m_FrameCycle += m_OnFrames;
+        return;
+    }
+
+    m_FrameCycle -= m_OffFrames;
+
+    if ( m_ChangesMade == false ) return;
+
+    m_ChangesMade = false;
+
+    SDL_mutexP ( m_Mutex );
+
+    if ( BlankEnabled ()) {
+        memset ( m_Frame, 0, sizeof ( m_Frame ));
+    } else {
+        if ( m_Mode & VDP_M3 ) {
+            DrawBitMap ();
+        } else if ( m_Mode & VDP_M2 ) {
+            DrawMultiColor ();
+        } else if ( m_TextMode ) {
+            DrawText ();
+        } else {
+            DrawGraphics ();
+        }
+        if ( m_TextMode == false ) {
+            DrawSprites ();
+        }
+    }
+
+    SDL_mutexV ( m_Mutex );
+
+    // Rendering has to be done on the thread that owns the window
+    RequestPresent ();
+}
+
+void cSdl2TMS9918A::WriteRegister ( size_t reg, UINT8 value )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::WriteRegister", true );
+
+    UINT8 oldReg = m_Register [ reg ];
+    cTMS9918A::WriteRegister ( reg, value );
+
+    if ( oldReg != m_Register [ reg ] ) {
+        m_ChangesMade = true;
+    }
+}
+
+void cSdl2TMS9918A::WriteData ( UINT8 data )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::WriteData", false );
+
+    // Only writes to one of the active tables change the picture
+    if (( data != m_Memory [ m_Address & 0x3FFF ] ) && ( m_MemoryType [ m_Address & 0x3FFF ] != 0 )) {
+        m_ChangesMade = true;
+    }
+
+    cTMS9918A::WriteData ( data );
+}
+
+bool cSdl2TMS9918A::SetMode ( int mode )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::SetMode", true );
+
+    if ( cTMS9918A::SetMode ( mode ) == false ) return false;
+
+    m_TextMode = ( m_Mode & VDP_M1 ) ? true : false;
+
+    // We changed video modes, force a refresh of the screen
+    m_ChangesMade = true;
+
+    return true;
+}
+
+bool cSdl2TMS9918A::LoadImage ( FILE *file )
+{
+    FUNCTION_ENTRY ( this, "cSdl2TMS9918A::LoadImage", true );
+
+    m_ChangesMade = true;
+
+    return cTMS9918A::LoadImage ( file );
+}
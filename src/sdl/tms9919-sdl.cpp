@@ -35,78 +35,74 @@
 #include "logger.hpp"
 #include "SDL.h"
 #include "tms9919-sdl.hpp"
-#include "tms5220.hpp"
+#include "ti994a.hpp"
 
 DBG_REGISTER ( __FILE__ );
 
+extern "C" UINT32 ClockCycleCounter;
+
+#if defined ( __SSE2__ )
+    #include <emmintrin.h>
+#endif
+
 #if defined ( OS_WINDOWS )
     // Windows NT needs a larger buffer
-    const int DEFAULT_SAMPLES = ( GetVersion () & 0x80000000 ) ? 1024 : 2048;
+    const int DEFAULT_SAMPLES = ( GetVersion () & 0x80000000 ) ? 512 : 1024;
 #else
-    const int DEFAULT_SAMPLES = 512;
+    const int DEFAULT_SAMPLES = 256;
 #endif
 
-// NOTE: These numbers were taken from the MESS source code
-#define NOISE_RESET              0x00F35
-#define NOISE_WHITE_GENERATOR    0x12000
-#define NOISE_PERIODIC_GENERATOR 0x08000
+// How far (in ms) the CPU should run ahead of the audio being played
+const int TARGET_LATENCY = 20;
+
+// Largest speed correction (in parts per million) and its granularity
+const int MAX_SPEED_ADJUST  = 5000;
+const int SPEED_ADJUST_STEP = 250;
 
 cSdlTMS9919::cSdlTMS9919 ( int sampleFreq ) :
-    m_VolumeTable (),
-    m_Initialized ( false ),
     m_MasterVolume ( 0 ),
     m_AudioSpec (),
-    m_Info (),
-    m_ShiftRegister ( NOISE_RESET ),
-    m_NoiseGenerator ( 0 ),
-    m_MixBuffer ( NULL )
+    m_MixBuffer ( NULL ),
+    m_SampleClock ( 0 ),
+    m_ClockValid ( false ),
+    m_TargetLead ( CPU_SPEED_HZ / 1000 * TARGET_LATENCY ),
+    m_AverageLead ( 0 ),
+    m_SpeedAdjust ( 0 )
 {
     FUNCTION_ENTRY ( this, "cSdlTMS9919 ctor", true );
 
     SetMasterVolume ( 50 );
 
-    // Set loudest volume to max possible level / 4 (so 4 audio channels won't clip)
-    float volume = 128.0 / 4.0;
-    for ( unsigned int i = 0; i < SIZE ( m_VolumeTable ) - 1; i++ ) {
-        m_VolumeTable [i] = ( int ) volume;
-        volume = ( float ) ( volume / 1.258925412 );    // Reduce volume by 2dB
-    }
-    m_VolumeTable [15] = 0;
-
     SDL_AudioSpec wanted;
     memset ( &wanted, 0, sizeof ( SDL_AudioSpec ));
 
-    if ( sampleFreq > 44100 ) sampleFreq = 44100;
+    if ( sampleFreq > 96000 ) sampleFreq = 96000;
 
-    // Make sure the sample buffer is the right size based on the frequency
-    int ratio   = 44100 / sampleFreq;
-    int samples = DEFAULT_SAMPLES / ratio;
+    // Keep the buffer about as long (in time) as DEFAULT_SAMPLES at 44.1KHz
+    int target  = ( int ) (( INT64 ) DEFAULT_SAMPLES * sampleFreq / 44100 );
+    int samples = 1;
+    while ( samples * 3 < target * 2 ) samples <<= 1;
 
     // Set the audio format
     wanted.freq     = sampleFreq;
-    wanted.format   = AUDIO_U8;
+    wanted.format   = AUDIO_S16SYS;
     wanted.channels = 1;
     wanted.samples  = samples;
     wanted.callback = _AudioCallback;
     wanted.userdata = this;
 
-     // Open the audio device, forcing the desired format
-    if (( SDL_OpenAudio ( &wanted, &m_AudioSpec ) < 0 ) || (( m_AudioSpec.format & 0x000F ) != 8 )) {
+     // Open the audio device - we can convert to signed 16-bit or unsigned 8-bit mono
+    if (( SDL_OpenAudio ( &wanted, &m_AudioSpec ) < 0 ) || ( m_AudioSpec.channels != 1 ) ||
+        (( m_AudioSpec.format != AUDIO_S16SYS ) && ( m_AudioSpec.format != AUDIO_U8 ))) {
         DBG_ERROR ( "Couldn't open audio: " << SDL_GetError ());
     } else {
         DBG_TRACE ( "Using " << (( m_AudioSpec.format & 0x8000 ) ? "signed " : "unsigned " ) << ( m_AudioSpec.format & 0x000F ) << "-bit " << m_AudioSpec.freq << "Hz Audio" );
         DBG_TRACE ( "Buffer size: " << m_AudioSpec.samples );
-        m_Initialized = true;
-        m_MixBuffer   = new Uint8 [ m_AudioSpec.samples ];
-        memset ( m_MixBuffer, m_AudioSpec.silence, sizeof ( Uint8 ) * m_AudioSpec.samples );
+        m_MixBuffer = new INT16 [ m_AudioSpec.samples ];
+        memset ( m_MixBuffer, 0, sizeof ( INT16 ) * m_AudioSpec.samples );
+        InitSynthesizer ( m_AudioSpec.freq, m_AudioSpec.samples );
         SDL_PauseAudio ( false );
     }
-
-    NOISE_COLOR_E color = m_NoiseColor;
-    int type     = m_NoiseType;
-    m_NoiseColor = ( NOISE_COLOR_E ) -1;
-    m_NoiseType  = -1;
-    SetNoise ( color, type );
 }
 
 cSdlTMS9919::~cSdlTMS9919 ()
@@ -128,153 +124,134 @@ void cSdlTMS9919::_AudioCallback ( void *data, Uint8 *stream, int length )
     (( cSdlTMS9919 * ) data)->AudioCallback ( stream, length );
 }
 
-void cSdlTMS9919::AudioCallback ( Uint8 *stream, int length )
-{
-    FUNCTION_ENTRY ( this, "cSdlTMS9919::AudioCallback", false );
+//----------------------------------------------------------------------------
+//
+// Everything is mixed on a signed 16-bit bus at the device rate.  The tone and
+// noise generators are synthesized band-limited directly at that rate, the
+// speech synthesizer resamples its 8KHz output once, and the master volume and
+// conversion to the device format are applied in a single pass at the end.
+//
+//----------------------------------------------------------------------------
 
-    if ( m_MasterVolume == 0 ) return;
-
-    memset ( m_MixBuffer, m_AudioSpec.silence, length );
-
-    bool mix = false;
-
-    for ( int i = 0; i < 4; i++ ) {
-        sVoiceInfo *info = &m_Info [i];
-        if (( m_Attenuation [i] != 15 ) && ( info->period >= 1.0 )) {
-            mix = true;
-            int left = length, j = 0;
-            do {
-                int count = ( info->toggle < left ) ? ( int ) info->toggle : left;
-                left -= count;
-                info->toggle -= count;
-                while ( count-- ) {
-                    m_MixBuffer [j++] += info->setting;
-                }
-                if ( info->toggle < 1.0 ) {
-                    info->toggle += info->period;
-                    if ( i < 3 ) {
-                        // Tone
-                        info->setting = -info->setting;
-                    } else {
-                        // Noise
-                        if ( m_ShiftRegister & 1 ) {
-                            m_ShiftRegister ^= m_NoiseGenerator;
-                            // Protect against 0
-                            if ( m_ShiftRegister == 0 ) {
-                                m_ShiftRegister = NOISE_RESET;
-                            }
-                            info->setting = -info->setting;
-                        }
-                        m_ShiftRegister >>= 1;
-                    }
-                }
-            } while ( left > 0 );
+void cSdlTMS9919::WriteOutput ( Uint8 *stream, int length )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::WriteOutput", false );
+
+    // Master volume as a 2.14 fixed-point gain
+    int gain = ( min ( m_MasterVolume, 100 ) * 16384 ) / 100;
+
+    const INT16 *src = m_MixBuffer;
+    int i = 0;
+
+    if ( m_AudioSpec.format == AUDIO_U8 ) {
+        Uint8 *dst = stream;
+#if defined ( __SSE2__ )
+        __m128i scale = _mm_set1_epi16 (( short ) gain );
+        __m128i bias  = _mm_set1_epi8 (( char ) 0x80 );
+        for ( ; i + 16 <= length; i += 16 ) {
+            __m128i out [2];
+            for ( int j = 0; j < 2; j++ ) {
+                __m128i x  = _mm_loadu_si128 (( const __m128i * ) &src [ i + j * 8 ] );
+                __m128i lo = _mm_mullo_epi16 ( x, scale );
+                __m128i hi = _mm_mulhi_epi16 ( x, scale );
+                __m128i a  = _mm_srai_epi32 ( _mm_unpacklo_epi16 ( lo, hi ), 14 );
+                __m128i b  = _mm_srai_epi32 ( _mm_unpackhi_epi16 ( lo, hi ), 14 );
+                out [j] = _mm_srai_epi16 ( _mm_packs_epi32 ( a, b ), 8 );
+            }
+            _mm_storeu_si128 (( __m128i * ) &dst [i], _mm_xor_si128 ( _mm_packs_epi16 ( out [0], out [1] ), bias ));
+        }
+#endif
+        for ( ; i < length; i++ ) {
+            int sample = ( src [i] * gain ) >> 14;
+            sample = min ( 32767, max ( -32768, sample ));
+            dst [i] = ( Uint8 ) ( 0x80 + ( sample >> 8 ));
+        }
+    } else {
+        INT16 *dst = ( INT16 * ) stream;
+#if defined ( __SSE2__ )
+        __m128i scale = _mm_set1_epi16 (( short ) gain );
+        for ( ; i + 8 <= length; i += 8 ) {
+            __m128i x  = _mm_loadu_si128 (( const __m128i * ) &src [i] );
+            __m128i lo = _mm_mullo_epi16 ( x, scale );
+            __m128i hi = _mm_mulhi_epi16 ( x, scale );
+            __m128i a  = _mm_srai_epi32 ( _mm_unpacklo_epi16 ( lo, hi ), 14 );
+            __m128i b  = _mm_srai_epi32 ( _mm_unpackhi_epi16 ( lo, hi ), 14 );
+            _mm_storeu_si128 (( __m128i * ) &dst [i], _mm_packs_epi32 ( a, b ));
+        }
+#endif
+        for ( ; i < length; i++ ) {
+            int sample = ( src [i] * gain ) >> 14;
+            dst [i] = ( INT16 ) min ( 32767, max ( -32768, sample ));
         }
     }
-
-    if ( m_pSpeechSynthesizer != NULL ) {
-        mix |= m_pSpeechSynthesizer->AudioCallback ( m_MixBuffer, length );
-    }
-
-    if ( mix == true ) {
-        int volume = ( m_MasterVolume * SDL_MIX_MAXVOLUME ) / 100;
-        SDL_MixAudio ( stream, m_MixBuffer, length, volume );
-    }
-}
-
-int cSdlTMS9919::SetSpeechSynthesizer ( cTMS5220 *speech )
-{
-    FUNCTION_ENTRY ( this, "cSdlTMS9919::SetSpeechSynthesizer", true );
-
-    m_pSpeechSynthesizer = speech;
-
-    return m_AudioSpec.freq;
 }
 
-void cSdlTMS9919::SetMasterVolume ( int volume )
+void cSdlTMS9919::AudioCallback ( Uint8 *stream, int length )
 {
-    FUNCTION_ENTRY ( this, "cSdlTMS9919::SetMasterVolume", true );
-
-    if ( volume == m_MasterVolume ) return;
-
-    m_MasterVolume = volume;
-}
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::AudioCallback", false );
 
-void cSdlTMS9919::SetNoise ( NOISE_COLOR_E color, int type )
-{
-    FUNCTION_ENTRY ( this, "cSdlTMS9919::SetNoise", true );
+    int bytes = length;
 
-    if (( color == m_NoiseColor ) && ( type == m_NoiseType )) return;
+    // Convert the buffer size to samples
+    if ( m_AudioSpec.format != AUDIO_U8 ) length /= sizeof ( INT16 );
 
-    // The shift register is reset when the color is changed
-    bool reset = ( color != m_NoiseColor ) ? true : false;
+    // Each buffer covers the next buffer's worth of CPU clocks, which the CPU
+    // should already have run m_TargetLead clocks past.  Small errors are
+    // corrected by nudging the emulated speed, but if the two clocks are way
+    // off (pauses, state loads, or the CPU falling behind) the audio clock is
+    // simply resynced.
+    INT32 bufferClocks = ( INT32 ) (( INT64 ) length * CPU_SPEED_HZ / m_AudioSpec.freq );
+    INT32 lead         = ( INT32 ) ( ClockCycleCounter - ( m_SampleClock + bufferClocks ));
 
-    cTMS9919::SetNoise ( color, type );
+    if (( m_ClockValid == false ) || ( lead < -bufferClocks ) || ( lead > 4 * m_TargetLead + 2 * bufferClocks )) {
+        m_SampleClock = ClockCycleCounter - bufferClocks - m_TargetLead;
+        m_AverageLead = m_TargetLead;
+        m_ClockValid  = true;
+        lead          = m_TargetLead;
+    }
 
-    if ( m_Initialized == true ) {
+    UpdateSpeedAdjust ( lead );
 
-        if ( reset ) m_ShiftRegister = NOISE_RESET;
-        m_NoiseGenerator = ( color == NOISE_WHITE ) ? NOISE_WHITE_GENERATOR : NOISE_PERIODIC_GENERATOR;
+    bool mix = Render ( m_MixBuffer, length, m_SampleClock );
 
-        sVoiceInfo *info = &m_Info [3];
+    m_SampleClock += bufferClocks;
 
-        if ( m_Frequency [3] != 0 ) {
-            int volume = m_VolumeTable [ m_Attenuation [3]];
-            info->period  = ( float ) m_AudioSpec.freq / ( float ) m_Frequency [3];
-            info->setting = ( info->setting > 0 ) ? volume : -volume;
-        } else {
-            info->period = 0.0;
-        }
+    if (( mix == true ) && ( m_MasterVolume != 0 )) {
+        WriteOutput ( stream, length );
+    } else {
+        memset ( stream, m_AudioSpec.silence, bytes );
     }
 }
 
-void cSdlTMS9919::SetFrequency ( int tone, int freq )
-{
-    FUNCTION_ENTRY ( this, "cSdlTMS9919::SetFrequency", true );
-
-    if ( freq == m_Frequency [ tone ] ) return;
+//----------------------------------------------------------------------------
+//
+// The CPU thread paces itself from the wall clock, which drifts from the
+// audio device's clock.  Rather than buffering enough audio to hide the drift,
+// the lead is held at m_TargetLead by asking the CPU to run up to 0.5% faster
+// or slower.  The lead is smoothed since the CPU runs in bursts.
+//
+//----------------------------------------------------------------------------
 
-    cTMS9919::SetFrequency ( tone, freq );
+void cSdlTMS9919::UpdateSpeedAdjust ( INT32 lead )
+{
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::UpdateSpeedAdjust", false );
 
-    if ( m_Initialized == true ) {
+    m_AverageLead += ( lead - m_AverageLead ) / 16;
 
-        sVoiceInfo *info = &m_Info [tone];
+    INT32 error  = m_AverageLead - m_TargetLead;
+    int   adjust = ( int ) (( INT64 ) -error * MAX_SPEED_ADJUST / m_TargetLead );
 
-        if (( freq < m_AudioSpec.freq / 2 ) && ( freq != 0 )) {
-            int volume = m_VolumeTable [ m_Attenuation [ tone ]];
-            info->period  = ( float ) (( float ) m_AudioSpec.freq / ( float ) freq / 2.0 );
-            info->setting = ( info->setting > 0 ) ? volume : -volume;
-        } else {
-            info->period  = m_AudioSpec.samples;
-            info->setting = 0;
-        }
+    adjust = min ( MAX_SPEED_ADJUST, max ( -MAX_SPEED_ADJUST, adjust ));
 
-        // If we changed voice 2, see if the noise channel needs to be updated
-        if (( tone == 2 ) && ( m_NoiseType == 3 )) {
-            m_Frequency [3] = m_Frequency [2];
-            info = &m_Info [3];
-            if ( m_Frequency [3] != 0 ) {
-                int volume = m_VolumeTable [ m_Attenuation [3]];
-                info->period  = ( float ) m_AudioSpec.freq / ( float ) m_Frequency [3];
-                info->setting = ( info->setting > 0 ) ? volume : -volume;
-            } else {
-                info->period = 0.0;
-            }
-        }
-    }
+    // Only report meaningful changes so the CPU doesn't rebase its timer constantly
+    m_SpeedAdjust = ( adjust / SPEED_ADJUST_STEP ) * SPEED_ADJUST_STEP;
 }
 
-void cSdlTMS9919::SetAttenuation ( int tone, int atten )
+void cSdlTMS9919::SetMasterVolume ( int volume )
 {
-    FUNCTION_ENTRY ( this, "cSdlTMS9919::SetAttenuation", true );
-
-    if ( atten == m_Attenuation [ tone ] ) return;
+    FUNCTION_ENTRY ( this, "cSdlTMS9919::SetMasterVolume", true );
 
-    cTMS9919::SetAttenuation ( tone, atten );
+    if ( volume == m_MasterVolume ) return;
 
-    if ( m_Initialized == true ) {
-        sVoiceInfo *info = &m_Info [tone];
-        int volume = m_VolumeTable [ m_Attenuation [ tone ]];
-        info->setting = ( info->setting > 0 ) ? volume : -volume;
-    }
+    m_MasterVolume = volume;
 }
@@ -0,0 +1,866 @@
+//----------------------------------------------------------------------------
+//
+// File:        catalog.cpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: Build and search an index of a collection of disk images
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "SDL.h"
+#include "diskio.hpp"
+#include "diskfs.hpp"
+#include "option.hpp"
+#include "support.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+#define MAX_SCAN_THREADS    32
+
+#define CATALOG_MAGIC       "TI99CTLG"
+#define CATALOG_VERSION     1
+
+// sCatalogImage::Status
+#define IMAGE_OK            0
+#define IMAGE_CORRUPT       1       // CheckDisk found a problem
+#define IMAGE_NO_VIB        2       // Readable media, but no valid VIB
+
+// sCatalogFile::Flags
+#define FILE_HASHED         0x01    // Every sector of the file could be read
+
+//----------------------------------------------------------------------------
+//
+// The index file is written in host byte order and is laid out as:
+//
+//   sCatalogHeader
+//   sCatalogImage [ ImageCount ]
+//   sCatalogFile  [ FileCount ]
+//   char          [ PoolSize ]     - NUL terminated image paths
+//
+// so it can be read back with a single fread and used in place.
+//
+//----------------------------------------------------------------------------
+
+struct sCatalogHeader {
+    char      Magic [ 8 ];
+    UINT32    Version;
+    UINT32    ImageCount;
+    UINT32    FileCount;
+    UINT32    PoolSize;
+};
+
+struct sCatalogImage {
+    UINT32    Path;                 // Offset into the string pool
+    UINT32    FirstFile;
+    UINT16    FileCount;
+    UINT16    TotalSectors;
+    UINT16    FreeSectors;
+    UINT8     Status;
+    UINT8     Format;               // eDiskFormat
+    char      VolumeName [ MAX_FILENAME ];
+    UINT8     TracksPerSide;
+    UINT8     Sides;
+    UINT8     Density;
+    UINT8     reserved [ 3 ];
+};
+
+struct sCatalogFile {
+    UINT64    Hash;                 // FNV-1a of the file's contents
+    UINT32    Image;
+    UINT16    TotalSectors;
+    char      FileName [ MAX_FILENAME ];
+    UINT8     FileStatus;
+    UINT8     RecordLength;
+    UINT8     Flags;
+    UINT8     reserved [ 5 ];
+};
+
+struct sCatalog {
+    UINT8                *data;
+    const sCatalogHeader *header;
+    const sCatalogImage  *image;
+    const sCatalogFile   *file;
+    const char           *pool;
+};
+
+// A disk (or CF7 volume) as it is found by a scanning thread
+struct sScanImage {
+    char          *path;
+    sCatalogImage  info;
+    sCatalogFile  *file;
+};
+
+struct sScanResult {
+    sScanImage    *image;
+    int            count;
+    UINT32         bytes;
+};
+
+struct sScanJob {
+    sPathList     *list;
+    sScanResult   *result;
+    int            next;
+    SDL_mutex     *mutex;
+};
+
+static inline UINT16 GetUINT16 ( const void *_ptr )
+{
+    FUNCTION_ENTRY ( NULL, "GetUINT16", true );
+
+    const UINT8 *ptr = ( const UINT8 * ) _ptr;
+    return ( UINT16 ) (( ptr [0] << 8 ) | ptr [1] );
+}
+
+bool HashFile ( const cDiskFileSystem *disk, const sFileDescriptorRecord *FDR, int formattedSectors, UINT64 *hash )
+{
+    FUNCTION_ENTRY ( NULL, "HashFile", true );
+
+    int totalSectors = GetUINT16 ( &FDR->TotalSectors );
+
+    // Only the used part of the last sector of program and variable length files is hashed
+    int lastSize = DEFAULT_SECTOR_SIZE;
+    if ((( FDR->FileStatus & ( PROGRAM_TYPE | VARIABLE_TYPE )) != 0 ) && ( FDR->EOF_Offset != 0 )) {
+        lastSize = FDR->EOF_Offset;
+    }
+
+    // Follow the chain here rather than through cFile - the disk may not have passed CheckDisk
+    int *sectors = new int [ totalSectors + 1 ];
+
+    bool retVal = cDiskFileSystem::GetDataChain ( FDR, formattedSectors, sectors );
+
+    UINT64 value = FNV1A64_INITIAL;
+
+    for ( int i = 0; ( retVal == true ) && ( i < totalSectors ); i++ ) {
+        UINT8 buffer [ DEFAULT_SECTOR_SIZE ];
+        retVal = disk->ReadSector ( sectors [i], buffer );
+        if ( retVal == true ) {
+            value = HashFNV1a64 ( buffer, ( i == totalSectors - 1 ) ? lastSize : DEFAULT_SECTOR_SIZE, value );
+        }
+    }
+
+    delete [] sectors;
+
+    if ( retVal == true ) {
+        *hash = value;
+    }
+
+    return retVal;
+}
+
+void CatalogVolume ( cDiskFileSystem *disk, cDiskMedia *media, sScanImage *image )
+{
+    FUNCTION_ENTRY ( NULL, "CatalogVolume", true );
+
+    sCatalogImage *info = &image->info;
+
+    memset ( info, 0, sizeof ( sCatalogImage ));
+    memset ( info->VolumeName, ' ', MAX_FILENAME );
+
+    info->Format = ( UINT8 ) media->GetFormat ();
+    info->Status = IMAGE_NO_VIB;
+
+    image->file = NULL;
+
+    UINT8 buffer [ DEFAULT_SECTOR_SIZE ];
+    VIB vib;
+
+    if (( disk->IsValid () == false ) || ( disk->ReadSector ( 0, &vib ) == false )) {
+        return;
+    }
+
+    int formattedSectors = GetUINT16 ( &vib.FormattedSectors );
+    if (( formattedSectors <= 0 ) || ( formattedSectors > ( int ) SIZE ( vib.AllocationMap ) * 8 )) {
+        return;
+    }
+
+    memcpy ( info->VolumeName, vib.VolumeName, MAX_FILENAME );
+    info->TotalSectors  = ( UINT16 ) formattedSectors;
+    info->TracksPerSide = vib.TracksPerSide;
+    info->Sides         = vib.Sides;
+    info->Density       = vib.Density;
+
+    for ( int i = 0; i < formattedSectors; i++ ) {
+        if (( vib.AllocationMap [ i / 8 ] & ( 1 << ( i % 8 ))) == 0 ) {
+            info->FreeSectors++;
+        }
+    }
+
+    info->Status = ( disk->CheckDisk ( false ) == true ) ? IMAGE_OK : IMAGE_CORRUPT;
+
+    // Only files in the root directory are cataloged
+    UINT16 FDI [ DEFAULT_SECTOR_SIZE / 2 ];
+    if ( disk->ReadSector ( 1, FDI ) == false ) {
+        info->Status = IMAGE_CORRUPT;
+        return;
+    }
+
+    sCatalogFile file [ MAX_FILES ];
+    int          count = 0;
+
+    for ( int i = ( FDI [0] == 0 ) ? 1 : 0; ( i < DEFAULT_SECTOR_SIZE / 2 ) && ( FDI [i] != 0 ) && ( count < MAX_FILES ); i++ ) {
+
+        int index = GetUINT16 ( &FDI [i] );
+        if (( index >= formattedSectors ) || ( disk->ReadSector ( index, buffer ) == false )) {
+            continue;
+        }
+
+        const sFileDescriptorRecord *FDR = ( const sFileDescriptorRecord * ) buffer;
+        if ( cFileSystem::IsValidFDR ( FDR ) == false ) {
+            continue;
+        }
+
+        sCatalogFile *entry = &file [ count++ ];
+
+        memset ( entry, 0, sizeof ( sCatalogFile ));
+        memcpy ( entry->FileName, FDR->FileName, MAX_FILENAME );
+        entry->TotalSectors = GetUINT16 ( &FDR->TotalSectors );
+        entry->FileStatus   = FDR->FileStatus;
+        entry->RecordLength = FDR->RecordLength;
+
+        if ( HashFile ( disk, FDR, formattedSectors, &entry->Hash ) == true ) {
+            entry->Flags |= FILE_HASHED;
+        }
+    }
+
+    info->FileCount = ( UINT16 ) count;
+
+    if ( count > 0 ) {
+        image->file = new sCatalogFile [ count ];
+        memcpy ( image->file, file, count * sizeof ( sCatalogFile ));
+    }
+}
+
+void CatalogFile ( const char *path, sScanResult *result )
+{
+    FUNCTION_ENTRY ( NULL, "CatalogFile", true );
+
+    result->image = NULL;
+    result->count = 0;
+    result->bytes = 0;
+
+    struct stat info;
+    if ( stat ( path, &info ) != 0 ) {
+        return;
+    }
+
+    // cDiskMedia is created directly - cDiskFileSystem::Open uses LocateFile, which isn't thread-safe
+    cDiskMedia *media = new cDiskMedia ( path, 0 );
+
+    eDiskFormat format = media->GetFormat ();
+    if (( format == FORMAT_INVALID ) || ( format == FORMAT_UNKNOWN )) {
+        media->Release ( NULL );
+        return;
+    }
+
+    result->bytes = ( UINT32 ) info.st_size;
+
+    // A CF7+ card holds a whole series of disks
+    int volumes = ( format == FORMAT_CF7 ) ? ( int ) ( info.st_size / CF7_DISK_SIZE ) : 1;
+    if ( volumes < 1 ) volumes = 1;
+
+    result->image = new sScanImage [ volumes ];
+
+    for ( int i = 0; i < volumes; i++ ) {
+
+        if ( i > 0 ) {
+            media = new cDiskMedia ( path, i );
+        }
+
+        cDiskFileSystem *disk = new cDiskFileSystem ( media );
+        media->Release ( NULL );
+
+        sScanImage *image = &result->image [ result->count ];
+
+        CatalogVolume ( disk, media, image );
+
+        disk->Release ( NULL );
+
+        // Unformatted volumes are normal on a CF7+ card - don't report them
+        if (( format == FORMAT_CF7 ) && ( image->info.Status == IMAGE_NO_VIB )) {
+            continue;
+        }
+
+        if ( format == FORMAT_CF7 ) {
+            image->path = new char [ strlen ( path ) + 8 ];
+            sprintf ( image->path, "%s#%d", path, i + 1 );
+        } else {
+            image->path = new char [ strlen ( path ) + 1 ];
+            strcpy ( image->path, path );
+        }
+
+        result->count++;
+    }
+}
+
+int _ScanThreadProc ( void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "_ScanThreadProc", true );
+
+    sScanJob *job = ( sScanJob * ) ptr;
+
+    for ( EVER ) {
+        SDL_mutexP ( job->mutex );
+        int index = job->next++;
+        SDL_mutexV ( job->mutex );
+        if ( index >= job->list->count ) break;
+        CatalogFile ( job->list->path [ index ], &job->result [ index ] );
+        if ( verbose >= 2 ) {
+            fprintf ( stdout, "%s\n", job->list->path [ index ] );
+        }
+    }
+
+    return 0;
+}
+
+void ScanImages ( sScanJob *job, int threads )
+{
+    FUNCTION_ENTRY ( NULL, "ScanImages", true );
+
+    SDL_Thread *thread [ MAX_SCAN_THREADS ];
+    int         started = 0;
+
+    // Files are handed out one at a time so a slow one doesn't hold up the rest
+    for ( int i = 1; i < threads; i++ ) {
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+        thread [ started ] = SDL_CreateThread ( _ScanThreadProc, "Scan", job );
+#else
+        thread [ started ] = SDL_CreateThread ( _ScanThreadProc, job );
+#endif
+        if ( thread [ started ] == NULL ) {
+            DBG_WARNING ( "Unable to create scan thread" );
+            break;
+        }
+        started++;
+    }
+
+    // Do our share too
+    _ScanThreadProc ( job );
+
+    for ( int i = 0; i < started; i++ ) {
+        SDL_WaitThread ( thread [i], NULL );
+    }
+}
+
+bool WriteCatalog ( const char *filename, const sScanJob &job )
+{
+    FUNCTION_ENTRY ( NULL, "WriteCatalog", true );
+
+    sCatalogHeader header;
+    memset ( &header, 0, sizeof ( header ));
+    memcpy ( header.Magic, CATALOG_MAGIC, sizeof ( header.Magic ));
+    header.Version = CATALOG_VERSION;
+
+    for ( int i = 0; i < job.list->count; i++ ) {
+        for ( int j = 0; j < job.result [i].count; j++ ) {
+            const sScanImage &image = job.result [i].image [j];
+            header.ImageCount++;
+            header.FileCount += image.info.FileCount;
+            header.PoolSize  += ( UINT32 ) strlen ( image.path ) + 1;
+        }
+    }
+
+    FILE *file = fopen ( filename, "wb" );
+    if ( file == NULL ) {
+        fprintf ( stderr, "Unable to create index file \"%s\"\n", filename );
+        return false;
+    }
+
+    bool ok = ( fwrite ( &header, sizeof ( header ), 1, file ) == 1 );
+
+    UINT32 pathOffset = 0;
+    UINT32 firstFile  = 0;
+
+    for ( int i = 0; i < job.list->count; i++ ) {
+        for ( int j = 0; j < job.result [i].count; j++ ) {
+            sCatalogImage info = job.result [i].image [j].info;
+            info.Path      = pathOffset;
+            info.FirstFile = firstFile;
+            ok = ok && ( fwrite ( &info, sizeof ( info ), 1, file ) == 1 );
+            pathOffset += ( UINT32 ) strlen ( job.result [i].image [j].path ) + 1;
+            firstFile  += info.FileCount;
+        }
+    }
+
+    UINT32 imageIndex = 0;
+
+    for ( int i = 0; i < job.list->count; i++ ) {
+        for ( int j = 0; j < job.result [i].count; j++, imageIndex++ ) {
+            const sScanImage &image = job.result [i].image [j];
+            for ( int k = 0; k < image.info.FileCount; k++ ) {
+                image.file [k].Image = imageIndex;
+            }
+            if ( image.info.FileCount > 0 ) {
+                ok = ok && ( fwrite ( image.file, sizeof ( sCatalogFile ), image.info.FileCount, file ) == image.info.FileCount );
+            }
+        }
+    }
+
+    for ( int i = 0; i < job.list->count; i++ ) {
+        for ( int j = 0; j < job.result [i].count; j++ ) {
+            const char *path = job.result [i].image [j].path;
+            ok = ok && ( fwrite ( path, strlen ( path ) + 1, 1, file ) == 1 );
+        }
+    }
+
+    if ( fclose ( file ) != 0 ) ok = false;
+
+    if ( ok == false ) {
+        fprintf ( stderr, "Error writing to index file \"%s\"\n", filename );
+    }
+
+    return ok;
+}
+
+bool ReadCatalog ( const char *filename, sCatalog *catalog )
+{
+    FUNCTION_ENTRY ( NULL, "ReadCatalog", true );
+
+    memset ( catalog, 0, sizeof ( sCatalog ));
+
+    FILE *file = fopen ( filename, "rb" );
+    if ( file == NULL ) {
+        fprintf ( stderr, "Unable to open index file \"%s\"\n", filename );
+        return false;
+    }
+
+    fseek ( file, 0, SEEK_END );
+    long size = ftell ( file );
+    fseek ( file, 0, SEEK_SET );
+
+    UINT8 *data = new UINT8 [ ( size > 0 ) ? size : 1 ];
+
+    bool ok = ( size >= ( long ) sizeof ( sCatalogHeader )) && ( fread ( data, size, 1, file ) == 1 );
+
+    fclose ( file );
+
+    const sCatalogHeader *header = ( const sCatalogHeader * ) data;
+
+    if (( ok == true ) && (( memcmp ( header->Magic, CATALOG_MAGIC, sizeof ( header->Magic )) != 0 ) || ( header->Version != CATALOG_VERSION ))) {
+        ok = false;
+    }
+
+    if (( ok == true ) && ( sizeof ( sCatalogHeader ) + header->ImageCount * sizeof ( sCatalogImage ) +
+                            header->FileCount * sizeof ( sCatalogFile ) + header->PoolSize != ( size_t ) size )) {
+        ok = false;
+    }
+
+    if ( ok == false ) {
+        fprintf ( stderr, "\"%s\" is not a valid index file\n", filename );
+        delete [] data;
+        return false;
+    }
+
+    catalog->data   = data;
+    catalog->header = header;
+    catalog->image  = ( const sCatalogImage * ) ( data + sizeof ( sCatalogHeader ));
+    catalog->file   = ( const sCatalogFile * ) ( catalog->image + header->ImageCount );
+    catalog->pool   = ( const char * ) ( catalog->file + header->FileCount );
+
+    return true;
+}
+
+const char *FileType ( const sCatalogFile &file, char *buffer )
+{
+    FUNCTION_ENTRY ( NULL, "FileType", true );
+
+    if ( file.FileStatus & PROGRAM_TYPE ) {
+        strcpy ( buffer, "PROGRAM" );
+    } else {
+        sprintf ( buffer, "%s/%s %3d", ( file.FileStatus & INTERNAL_TYPE ) ? "INT" : "DIS",
+                  ( file.FileStatus & VARIABLE_TYPE ) ? "VAR" : "FIX", file.RecordLength ? file.RecordLength : 256 );
+    }
+
+    return buffer;
+}
+
+const char *HashText ( const sCatalogFile &file, char *buffer )
+{
+    FUNCTION_ENTRY ( NULL, "HashText", true );
+
+    if ( file.Flags & FILE_HASHED ) {
+        sprintf ( buffer, "%08X%08X", ( UINT32 ) ( file.Hash >> 32 ), ( UINT32 ) file.Hash );
+    } else {
+        strcpy ( buffer, "----------------" );
+    }
+
+    return buffer;
+}
+
+void PrintFile ( const sCatalog &catalog, const sCatalogFile &file )
+{
+    FUNCTION_ENTRY ( NULL, "PrintFile", true );
+
+    char type [ 16 ], hash [ 20 ];
+
+    const sCatalogImage &image = catalog.image [ file.Image ];
+
+    fprintf ( stdout, "  %-10.10s %5d %-11s %s  %s\n", file.FileName, file.TotalSectors + 1, FileType ( file, type ),
+              HashText ( file, hash ), catalog.pool + image.Path );
+}
+
+void FindName ( const sCatalog &catalog, const char *name )
+{
+    FUNCTION_ENTRY ( NULL, "FindName", true );
+
+    char fileName [ MAX_FILENAME ];
+    memset ( fileName, ' ', MAX_FILENAME );
+    for ( int i = 0; ( i < MAX_FILENAME ) && ( name [i] != '\0' ); i++ ) {
+        fileName [i] = ( char ) toupper (( UINT8 ) name [i] );
+    }
+
+    int found = 0;
+
+    for ( UINT32 i = 0; i < catalog.header->FileCount; i++ ) {
+        const sCatalogFile &file = catalog.file [i];
+        int j = 0;
+        while (( j < MAX_FILENAME ) && ( toupper (( UINT8 ) file.FileName [j] ) == fileName [j] )) j++;
+        if ( j == MAX_FILENAME ) {
+            PrintFile ( catalog, file );
+            found++;
+        }
+    }
+
+    fprintf ( stdout, "\n%7d Match%s for %s\n", found, ( found == 1 ) ? "" : "es", name );
+}
+
+void FindHash ( const sCatalog &catalog, UINT64 hash )
+{
+    FUNCTION_ENTRY ( NULL, "FindHash", true );
+
+    int found = 0;
+
+    for ( UINT32 i = 0; i < catalog.header->FileCount; i++ ) {
+        const sCatalogFile &file = catalog.file [i];
+        if (( file.Flags & FILE_HASHED ) && ( file.Hash == hash )) {
+            PrintFile ( catalog, file );
+            found++;
+        }
+    }
+
+    fprintf ( stdout, "\n%7d Match%s for %08X%08X\n", found, ( found == 1 ) ? "" : "es", ( UINT32 ) ( hash >> 32 ), ( UINT32 ) hash );
+}
+
+int sortByHash ( const void *ptr1, const void *ptr2 )
+{
+    FUNCTION_ENTRY ( NULL, "sortByHash", false );
+
+    const sCatalogFile *file1 = * ( const sCatalogFile ** ) ptr1;
+    const sCatalogFile *file2 = * ( const sCatalogFile ** ) ptr2;
+
+    if ( file1->Hash != file2->Hash ) return ( file1->Hash < file2->Hash ) ? -1 : 1;
+    if ( file1->Image != file2->Image ) return ( file1->Image < file2->Image ) ? -1 : 1;
+
+    return memcmp ( file1->FileName, file2->FileName, MAX_FILENAME );
+}
+
+void ShowDuplicates ( const sCatalog &catalog )
+{
+    FUNCTION_ENTRY ( NULL, "ShowDuplicates", true );
+
+    const sCatalogFile **list = new const sCatalogFile * [ catalog.header->FileCount + 1 ];
+    int count = 0;
+
+    for ( UINT32 i = 0; i < catalog.header->FileCount; i++ ) {
+        if (( catalog.file [i].Flags & FILE_HASHED ) && ( catalog.file [i].TotalSectors > 0 )) {
+            list [ count++ ] = &catalog.file [i];
+        }
+    }
+
+    qsort ( list, count, sizeof ( const sCatalogFile * ), sortByHash );
+
+    int groups = 0;
+    int copies = 0;
+
+    for ( int i = 0; i < count; ) {
+        int j = i + 1;
+        while (( j < count ) && ( list [j]->Hash == list [i]->Hash )) j++;
+        if ( j - i > 1 ) {
+            char hash [ 20 ];
+            fprintf ( stdout, "%s  %d copies\n", HashText ( *list [i], hash ), j - i );
+            for ( int k = i; k < j; k++ ) {
+                PrintFile ( catalog, *list [k] );
+            }
+            fprintf ( stdout, "\n" );
+            groups++;
+            copies += j - i - 1;
+        }
+        i = j;
+    }
+
+    fprintf ( stdout, "%7d Files with duplicates (%d extra copies)\n", groups, copies );
+
+    delete [] list;
+}
+
+void ShowCorrupt ( const sCatalog &catalog )
+{
+    FUNCTION_ENTRY ( NULL, "ShowCorrupt", true );
+
+    int found = 0;
+
+    for ( UINT32 i = 0; i < catalog.header->ImageCount; i++ ) {
+        const sCatalogImage &image = catalog.image [i];
+        if ( image.Status == IMAGE_OK ) continue;
+        fprintf ( stdout, "  %-12s %s\n", ( image.Status == IMAGE_NO_VIB ) ? "No VIB" : "Check failed", catalog.pool + image.Path );
+        found++;
+    }
+
+    fprintf ( stdout, "\n%7d Corrupt disk image%s\n", found, ( found == 1 ) ? "" : "s" );
+}
+
+void ShowSummary ( const sCatalog &catalog )
+{
+    FUNCTION_ENTRY ( NULL, "ShowSummary", true );
+
+    int corrupt = 0;
+    for ( UINT32 i = 0; i < catalog.header->ImageCount; i++ ) {
+        if ( catalog.image [i].Status != IMAGE_OK ) corrupt++;
+    }
+
+    fprintf ( stdout, "%7u Disk images (%d corrupt)\n", catalog.header->ImageCount, corrupt );
+    fprintf ( stdout, "%7u Files\n", catalog.header->FileCount );
+}
+
+bool ParseText ( const char *arg, void *buffer )
+{
+    FUNCTION_ENTRY ( NULL, "ParseText", true );
+
+    const char *ptr = strchr ( arg, '=' );
+
+    if (( ptr == NULL ) || ( ptr [1] == '\0' )) {
+        fprintf ( stderr, "A value needs to be specified: '%s'\n", arg );
+        return false;
+    }
+
+    strncpy (( char * ) buffer, ptr + 1, 255 );
+    (( char * ) buffer ) [255] = '\0';
+
+    return true;
+}
+
+// A hash of 0 is valid, so --hash has to say whether it was given
+struct sHashOption {
+    bool      valid;
+    UINT64    hash;
+};
+
+bool ParseHash ( const char *arg, void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "ParseHash", true );
+
+    UINT64 hash = 0;
+    int    digits = 0;
+
+    arg = strchr ( arg, '=' ) + 1;
+
+    for ( const char *text = arg; *text != '\0'; text++, digits++ ) {
+        if (( isxdigit (( UINT8 ) *text ) == 0 ) || ( digits == 16 )) {
+            fprintf ( stderr, "Invalid hash '%s'\n", arg );
+            return false;
+        }
+        int value = isdigit (( UINT8 ) *text ) ? *text - '0' : toupper (( UINT8 ) *text ) - 'A' + 10;
+        hash = ( hash << 4 ) | value;
+    }
+
+    if ( digits == 0 ) {
+        fprintf ( stderr, "A hash needs to be specified\n" );
+        return false;
+    }
+
+    sHashOption *option = ( sHashOption * ) ptr;
+
+    option->valid = true;
+    option->hash  = hash;
+
+    return true;
+}
+
+void PrintUsage ()
+{
+    FUNCTION_ENTRY ( NULL, "PrintUsage", true );
+
+    fprintf ( stdout, "Usage: catalog [options] index [directory|image ...]\n" );
+    fprintf ( stdout, "\n" );
+}
+
+int main ( int argc, char *argv[] )
+{
+    FUNCTION_ENTRY ( NULL, "main", true );
+
+    char        findName [256]  = "";
+    sHashOption findHash        = { false, 0 };
+    bool        showDuplicates  = false;
+    bool        showCorrupt     = false;
+    int         threads         = 0;
+
+    sOption optList [] = {
+        { 'c', "corrupt",            OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &showCorrupt,    NULL,      "List the disk images that failed the disk check" },
+        { 'd', "duplicates",         OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &showDuplicates, NULL,      "List files found more than once (by contents)" },
+        { 'f', "find=*<filename>",   OPT_NONE,                      0,     findName,        ParseText, "List the disk images holding <filename>" },
+        {  0,  "hash=*<hash>",       OPT_NONE,                      0,     &findHash,       ParseHash, "List the files whose contents have hash <hash>" },
+        { 't', "threads=*n",         OPT_VALUE_PARSE_INT,           0,     &threads,        NULL,      "Number of scanning threads (default is one per CPU)" },
+        { 'v', "verbose*=n",         OPT_VALUE_PARSE_INT,           1,     &verbose,        NULL,      "Display extra information" }
+    };
+
+    if ( argc == 1 ) {
+        PrintHelp ( SIZE ( optList ), optList );
+        return 0;
+    }
+
+    printf ( "TI-99/4A Disk Image Catalog\n\n" );
+
+    const char *indexName = NULL;
+    sPathList   roots     = { NULL, 0, 0 };
+
+    int index = 1;
+    while ( index < argc ) {
+        index = ParseArgs ( index, argc, argv, SIZE ( optList ), optList );
+        if ( index < argc ) {
+            if ( indexName == NULL ) {
+                indexName = argv [index++];
+            } else {
+                AddPath ( &roots, argv [index++] );
+            }
+        }
+    }
+
+    if ( indexName == NULL ) {
+        fprintf ( stderr, "No index file specified\n" );
+        return -1;
+    }
+
+    // Build a new index if we were given something to scan
+    if ( roots.count > 0 ) {
+
+        if ( SDL_Init ( SDL_INIT_NOPARACHUTE ) < 0 ) {
+            fprintf ( stderr, "Couldn't initialize SDL: %s\n", SDL_GetError ());
+            return -1;
+        }
+
+        atexit ( SDL_Quit );
+
+        UINT32 startTime = SDL_GetTicks ();
+
+        sPathList list = { NULL, 0, 0 };
+        for ( int i = 0; i < roots.count; i++ ) {
+            FindFiles ( roots.path [i], &list );
+        }
+
+        sScanJob job;
+        job.list   = &list;
+        job.result = new sScanResult [ list.count + 1 ];
+        job.next   = 0;
+        job.mutex  = SDL_CreateMutex ();
+
+        if ( threads <= 0 ) {
+            threads = GetProcessorCount ();
+        }
+        threads = max ( 1, min ( threads, min ( list.count, MAX_SCAN_THREADS )));
+
+        ScanImages ( &job, threads );
+
+        UINT32 elapsed = SDL_GetTicks () - startTime;
+
+        SDL_DestroyMutex ( job.mutex );
+
+        if ( WriteCatalog ( indexName, job ) == false ) {
+            return -1;
+        }
+
+        int    images  = 0;
+        int    corrupt = 0;
+        int    files   = 0;
+        double bytes   = 0;
+
+        for ( int i = 0; i < list.count; i++ ) {
+            sScanResult &result = job.result [i];
+            bytes += result.bytes;
+            for ( int j = 0; j < result.count; j++ ) {
+                images++;
+                files += result.image [j].info.FileCount;
+                if ( result.image [j].info.Status != IMAGE_OK ) corrupt++;
+                delete [] result.image [j].file;
+                delete [] result.image [j].path;
+            }
+            delete [] result.image;
+            delete [] list.path [i];
+        }
+
+        delete [] job.result;
+        delete [] list.path;
+
+        fprintf ( stdout, "%7d Files scanned\n", list.count );
+        fprintf ( stdout, "%7d Disk images cataloged (%d corrupt)\n", images, corrupt );
+        fprintf ( stdout, "%7d Files indexed\n", files );
+        fprintf ( stdout, "%7u ms elapsed using %d thread%s (%.1f MB/s)\n", elapsed, threads, ( threads == 1 ) ? "" : "s",
+                  bytes / ( 1024.0 * 1024.0 ) / (( elapsed > 0 ) ? elapsed / 1000.0 : 0.001 ));
+
+        for ( int i = 0; i < roots.count; i++ ) {
+            delete [] roots.path [i];
+        }
+        delete [] roots.path;
+    }
+
+    if (( findName [0] == '\0' ) && ( findHash.valid == false ) && ( showDuplicates == false ) && ( showCorrupt == false )) {
+        if ( roots.count == 0 ) {
+            sCatalog catalog;
+            if ( ReadCatalog ( indexName, &catalog ) == false ) return -1;
+            ShowSummary ( catalog );
+            delete [] catalog.data;
+        }
+        return 0;
+    }
+
+    sCatalog catalog;
+    if ( ReadCatalog ( indexName, &catalog ) == false ) {
+        return -1;
+    }
+
+    if ( roots.count > 0 ) fprintf ( stdout, "\n" );
+
+    if ( findName [0] != '\0' ) {
+        FindName ( catalog, findName );
+    }
+
+    if ( findHash.valid == true ) {
+        FindHash ( catalog, findHash.hash );
+    }
+
+    if ( showDuplicates == true ) {
+        ShowDuplicates ( catalog );
+    }
+
+    if ( showCorrupt == true ) {
+        ShowCorrupt ( catalog );
+    }
+
+    delete [] catalog.data;
+
+    return 0;
+}
@@ -32,27 +32,39 @@
 //----------------------------------------------------------------------------
 
 #include <ctype.h>
+#include <errno.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include "common.hpp"
 #include "logger.hpp"
+#include "SDL.h"
 #include "diskio.hpp"
 #include "diskfs.hpp"
 #include "arcfs.hpp"
+#include "pseudofs.hpp"
 #include "fileio.hpp"
 #include "option.hpp"
 #include "support.hpp"
 
 DBG_REGISTER ( __FILE__ );
 
+#if defined ( OS_OS2 ) || defined ( OS_WINDOWS ) || defined ( OS_AMIGAOS )
+    #include <direct.h>
+    #define MKDIR(x,y) mkdir ( x )
+#else
+    #define MKDIR(x,y) mkdir ( x, y )
+#endif
+
 void ConvertFilename ( char *buffer )
 {
     FUNCTION_ENTRY ( NULL, "ConvertFilename", true );
 
     char *end = buffer;
     while ( *end ) end++;
-    while ( *--end == ' ' ) ;
-    *++end = '\0';
+    while (( end > buffer ) && ( end [-1] == ' ' )) end--;
+    *end = '\0';
     if ( *buffer == '-' ) *buffer = '_';
     for ( ; *buffer; buffer++ ) {
         if ( isalnum ( *buffer )) continue;
@@ -70,16 +82,24 @@ static inline UINT16 GetUINT16 ( const void *_ptr )
     return ( UINT16 ) (( ptr [0] << 8 ) | ptr [1] );
 }
 
-void DumpFile ( cFile *file, bool convertFiles )
+static inline UINT16 GetUINT16_LE ( const void *_ptr )
 {
-    FUNCTION_ENTRY ( NULL, "DumpFile", true );
+    FUNCTION_ENTRY ( NULL, "GetUINT16_LE", true );
 
-    sFileDescriptorRecord *FDR = file->GetFDR ();
+    const UINT8 *ptr = ( const UINT8 * ) _ptr;
+    return ( UINT16 ) (( ptr [1] << 8 ) | ptr [0] );
+}
 
-    char name [ 32 ];
-    strcpy ( name, FDR->FileName );
+void MakeFileName ( const sFileDescriptorRecord *FDR, bool convertFiles, char *name )
+{
+    FUNCTION_ENTRY ( NULL, "MakeFileName", true );
+
+    memcpy ( name, FDR->FileName, MAX_FILENAME );
+    name [ MAX_FILENAME ] = '\0';
     ConvertFilename ( name );
 
+    if ( name [0] == '\0' ) strcpy ( name, "_" );
+
     // Decorate the name to match the file's type
     if ( convertFiles == true ) {
         if ( FDR->FileStatus & PROGRAM_TYPE ) {
@@ -91,17 +111,41 @@ void DumpFile ( cFile *file, bool convertFiles )
                 FDR->RecordLength ? FDR->RecordLength : 256 );
         }
     }
+}
+
+// Find a unique filename to use
+void MakeUniqueName ( char *filename, const char *name )
+{
+    FUNCTION_ENTRY ( NULL, "MakeUniqueName", true );
 
-    // Find a unique filename to use
-    char filename [ 80 ];
     for ( int i = 0; i < 255; i++ ) {
         sprintf ( filename, i ? "%s.%03d" : "%s", name, i );
         FILE *testFile = fopen ( filename, "rb" );
         if ( testFile == NULL ) break;
         fclose ( testFile );
     }
+}
+
+const char *FileMode ( const sFileDescriptorRecord *FDR, bool convertFiles )
+{
+    FUNCTION_ENTRY ( NULL, "FileMode", true );
+
+    return (( convertFiles == true ) && (( FDR->FileStatus & ( INTERNAL_TYPE | PROGRAM_TYPE )) == 0 )) ? "wt" : "wb";
+}
+
+void DumpFile ( cFile *file, bool convertFiles )
+{
+    FUNCTION_ENTRY ( NULL, "DumpFile", true );
+
+    sFileDescriptorRecord *FDR = file->GetFDR ();
 
-    const char *mode = (( convertFiles == true ) && (( FDR->FileStatus & ( INTERNAL_TYPE | PROGRAM_TYPE )) == 0 )) ? "wt" : "wb";
+    char name [ 32 ];
+    MakeFileName ( FDR, convertFiles, name );
+
+    char filename [ 80 ];
+    MakeUniqueName ( filename, name );
+
+    const char *mode = FileMode ( FDR, convertFiles );
 
     // Open the file
     FILE *outFile = fopen ( filename, mode );
@@ -109,10 +153,10 @@ void DumpFile ( cFile *file, bool convertFiles )
 
     // Write the file header (v9t9 FIAD)
     if ( convertFiles == false ) {
-        char header [128];
-        memset ( header, 0, 128 );
+        char header [ HOST_HEADER_SIZE ];
+        memset ( header, 0, HOST_HEADER_SIZE );
         memcpy ( header, FDR, 20 );
-        fwrite ( header, 128, 1, outFile );
+        fwrite ( header, HOST_HEADER_SIZE, 1, outFile );
     }
 
     if ( convertFiles == true ) {
@@ -219,6 +263,12 @@ void PrintDiskInfo ( cDiskMedia *disk )
         case FORMAT_CF7 :
             strFormat = "CF7+";
             break;
+        case FORMAT_DIRECTORY :
+            strFormat = "Directory";
+            break;
+        case FORMAT_COMPRESSED :
+            strFormat = "Compressed";
+            break;
         default :
             break;
     }
@@ -288,11 +338,429 @@ bool ParseFileName ( const char *arg, void *base )
     return false;
 }
 
+//----------------------------------------------------------------------------
+//
+// Batch extraction pulls every file off a whole collection of disk images.
+// Each image gets its own directory under the output directory.  Images are
+// handed out to a pool of threads one at a time.  Each file's sectors are read
+// straight into a single buffer (which each thread keeps for the next file),
+// converted there if need be, and written out with one fwrite.
+//
+//----------------------------------------------------------------------------
+
+#define MAX_BATCH_THREADS   32
+
+struct sBatchJob {
+    const sPathList *list;
+    const char      *outputDir;
+    bool             convertFiles;
+    bool             verbose;
+    int              next;
+    SDL_mutex       *mutex;
+    int              images;
+    int              badImages;
+    int              files;
+    int              badFiles;
+    double           bytesRead;
+    double           bytesWritten;
+};
+
+// A buffer that's reused for every file a thread extracts
+struct sBuffer {
+    UINT8         *data;
+    size_t         size;
+};
+
+UINT8 *ReserveBuffer ( sBuffer *buffer, size_t size )
+{
+    FUNCTION_ENTRY ( NULL, "ReserveBuffer", true );
+
+    if ( buffer->size < size ) {
+        size_t newSize = ( buffer->size == 0 ) ? 64 * 1024 : buffer->size;
+        while ( newSize < size ) newSize *= 2;
+        delete [] buffer->data;
+        buffer->data = new UINT8 [ newSize ];
+        buffer->size = newSize;
+    }
+
+    return buffer->data;
+}
+
+// Read all of a file's sectors - the disk may be damaged, so nothing in the FDR is trusted
+bool ReadFileSectors ( const cDiskFileSystem *disk, const sFileDescriptorRecord *FDR, int formattedSectors, UINT8 *data )
+{
+    FUNCTION_ENTRY ( NULL, "ReadFileSectors", true );
+
+    int totalSectors = GetUINT16 ( &FDR->TotalSectors );
+    int *sectors     = new int [ totalSectors + 1 ];
+
+    bool retVal = cDiskFileSystem::GetDataChain ( FDR, formattedSectors, sectors );
+
+    for ( int i = 0; ( retVal == true ) && ( i < totalSectors ); i++ ) {
+        retVal = disk->ReadSector ( sectors [i], data + i * DEFAULT_SECTOR_SIZE );
+    }
+
+    delete [] sectors;
+
+    return retVal;
+}
+
+// Turn the records in a file into a host file (the same way DumpFile does)
+size_t ConvertRecords ( const sFileDescriptorRecord *FDR, const UINT8 *data, UINT8 *output )
+{
+    FUNCTION_ENTRY ( NULL, "ConvertRecords", true );
+
+    int totalSectors = GetUINT16 ( &FDR->TotalSectors );
+
+    if ( FDR->FileStatus & PROGRAM_TYPE ) {
+        size_t size = ( totalSectors - 1 ) * DEFAULT_SECTOR_SIZE + (( FDR->EOF_Offset != 0 ) ? FDR->EOF_Offset : DEFAULT_SECTOR_SIZE );
+        memcpy ( output, data, size );
+        return size;
+    }
+
+    bool display  = (( FDR->FileStatus & INTERNAL_TYPE ) == 0 ) ? true : false;
+    bool variable = (( FDR->FileStatus & VARIABLE_TYPE ) != 0 ) ? true : false;
+
+    UINT8 *ptr = output;
+
+    if ( variable == true ) {
+        // For variable length files NoFixedRecords is the number of sectors used
+        int sectors = GetUINT16_LE ( &FDR->NoFixedRecords );
+        if ( sectors > totalSectors ) sectors = totalSectors;
+        for ( int i = 0; i < sectors; i++ ) {
+            const UINT8 *record = data + i * DEFAULT_SECTOR_SIZE;
+            const UINT8 *end    = record + DEFAULT_SECTOR_SIZE;
+            for ( EVER ) {
+                int length = *record++;
+                if ( record + length >= end ) break;
+                if ( display == false ) *ptr++ = ( UINT8 ) length;
+                memcpy ( ptr, record, length );
+                ptr += length;
+                if ( display == true ) *ptr++ = '\n';
+                record += length;
+                if ( *record == 0xFF ) break;
+            }
+        }
+    } else {
+        int records   = GetUINT16_LE ( &FDR->NoFixedRecords );
+        int perSector = FDR->RecordsPerSector;
+        int length    = FDR->RecordLength;
+        for ( int i = 0; ( i < records ) && ( perSector != 0 ); i++ ) {
+            int sector = i / perSector;
+            int offset = ( i % perSector ) * length;
+            if (( sector >= totalSectors ) || ( offset + length > DEFAULT_SECTOR_SIZE )) break;
+            memcpy ( ptr, data + sector * DEFAULT_SECTOR_SIZE + offset, length );
+            ptr += length;
+            if ( display == true ) *ptr++ = '\n';
+        }
+    }
+
+    return ptr - output;
+}
+
+// Create a new directory for an image - if the name is taken, add a suffix to it
+char *MakeImageDirectory ( const char *outputDir, const char *path )
+{
+    FUNCTION_ENTRY ( NULL, "MakeImageDirectory", true );
+
+    const char *base = strrchr ( path, SEPERATOR );
+    base = ( base != NULL ) ? base + 1 : path;
+
+    char *dirName = new char [ strlen ( outputDir ) + strlen ( base ) + 6 ];
+
+    for ( int i = 0; i < 1000; i++ ) {
+        sprintf ( dirName, i ? "%s%c%s.%03d" : "%s%c%s", outputDir, SEPERATOR, base, i );
+        // mkdir fails if it's already there, so two threads can't end up with the same one
+        if ( MKDIR ( dirName, 0777 ) == 0 ) return dirName;
+        if ( errno != EEXIST ) break;
+    }
+
+    fprintf ( stderr, "Unable to create directory \"%s\"\n", dirName );
+
+    delete [] dirName;
+
+    return NULL;
+}
+
+void ExtractVolume ( const cDiskFileSystem *disk, const char *dirName, sBatchJob *job, sBuffer *buffer, int *files, int *badFiles, double *bytes )
+{
+    FUNCTION_ENTRY ( NULL, "ExtractVolume", true );
+
+    VIB vib;
+    if ( disk->ReadSector ( 0, &vib ) == false ) return;
+
+    int formattedSectors = GetUINT16 ( &vib.FormattedSectors );
+
+    UINT16 FDI [ DEFAULT_SECTOR_SIZE / 2 ];
+    if ( disk->ReadSector ( 1, FDI ) == false ) return;
+
+    char *fileName = new char [ strlen ( dirName ) + 40 ];
+    char *hostName = new char [ strlen ( dirName ) + 48 ];
+
+    for ( int i = ( FDI [0] == 0 ) ? 1 : 0; ( i < DEFAULT_SECTOR_SIZE / 2 ) && ( FDI [i] != 0 ); i++ ) {
+
+        int index = GetUINT16 ( &FDI [i] );
+
+        UINT8 sector [ DEFAULT_SECTOR_SIZE ];
+        if (( index >= formattedSectors ) || ( disk->ReadSector ( index, sector ) == false )) {
+            ( *badFiles )++;
+            continue;
+        }
+
+        const sFileDescriptorRecord *FDR = ( const sFileDescriptorRecord * ) sector;
+        if ( cFileSystem::IsValidFDR ( FDR ) == false ) {
+            ( *badFiles )++;
+            continue;
+        }
+
+        int    totalSectors = GetUINT16 ( &FDR->TotalSectors );
+        size_t dataSize     = totalSectors * DEFAULT_SECTOR_SIZE;
+
+        // Room for the header and the file's sectors, with the converted file after them
+        UINT8 *data = ReserveBuffer ( buffer, HOST_HEADER_SIZE + dataSize + 3 * dataSize + DEFAULT_SECTOR_SIZE );
+
+        if ( ReadFileSectors ( disk, FDR, formattedSectors, data + HOST_HEADER_SIZE ) == false ) {
+            fprintf ( stderr, "  Unable to read all of file %10.10s in \"%s\"\n", FDR->FileName, dirName );
+            ( *badFiles )++;
+            continue;
+        }
+
+        const UINT8 *output = data;
+        size_t       size   = HOST_HEADER_SIZE + dataSize;
+
+        if ( job->convertFiles == true ) {
+            UINT8 *converted = data + HOST_HEADER_SIZE + dataSize;
+            size   = ( totalSectors > 0 ) ? ConvertRecords ( FDR, data + HOST_HEADER_SIZE, converted ) : 0;
+            output = converted;
+        } else {
+            cPseudoFileSystem::MakeHeader ( FDR, data );
+        }
+
+        char name [ 32 ];
+        MakeFileName ( FDR, job->convertFiles, name );
+        sprintf ( fileName, "%s%c%s", dirName, SEPERATOR, name );
+        MakeUniqueName ( hostName, fileName );
+
+        FILE *file = fopen ( hostName, FileMode ( FDR, job->convertFiles ));
+        if (( file == NULL ) || (( size > 0 ) && ( fwrite ( output, size, 1, file ) != 1 ))) {
+            fprintf ( stderr, "  Unable to write file \"%s\"\n", hostName );
+            ( *badFiles )++;
+        } else {
+            ( *files )++;
+            *bytes += size;
+        }
+
+        if ( file != NULL ) fclose ( file );
+    }
+
+    delete [] hostName;
+    delete [] fileName;
+}
+
+void ExtractImage ( const char *path, sBatchJob *job, sBuffer *buffer )
+{
+    FUNCTION_ENTRY ( NULL, "ExtractImage", true );
+
+    int    volumes  = 0;
+    int    files    = 0;
+    int    badFiles = 0;
+    double read     = 0;
+    double written  = 0;
+
+    struct stat info;
+
+    // cDiskMedia is created directly - cDiskFileSystem::Open uses LocateFile, which isn't thread-safe
+    cDiskMedia *media = new cDiskMedia ( path, 0 );
+
+    // Skip anything that isn't a disk image (README files, TIFILES, etc.)
+    eDiskFormat format = media->GetFormat ();
+    if (( format == FORMAT_INVALID ) || ( format == FORMAT_UNKNOWN )) {
+        media->Release ( NULL );
+        return;
+    }
+
+    if ( stat ( path, &info ) == 0 ) {
+
+        read = info.st_size;
+
+        // A CF7+ card holds a whole series of disks
+        int count = ( format == FORMAT_CF7 ) ? ( int ) ( info.st_size / CF7_DISK_SIZE ) : 1;
+        if ( count < 1 ) count = 1;
+
+        for ( int i = 0; i < count; i++ ) {
+
+            if ( i > 0 ) {
+                media = new cDiskMedia ( path, i );
+            }
+
+            cDiskFileSystem *disk = new cDiskFileSystem ( media );
+            media->Release ( NULL );
+            media = NULL;
+
+            // Unformatted volumes are normal on a CF7+ card
+            if ( disk->IsValid () == true ) {
+                char *volumeName = new char [ strlen ( path ) + 8 ];
+                sprintf ( volumeName, ( format == FORMAT_CF7 ) ? "%s#%d" : "%s", path, i + 1 );
+                char *dirName = MakeImageDirectory ( job->outputDir, volumeName );
+                if ( dirName != NULL ) {
+                    ExtractVolume ( disk, dirName, job, buffer, &files, &badFiles, &written );
+                    volumes++;
+                    delete [] dirName;
+                }
+                delete [] volumeName;
+            }
+
+            disk->Release ( NULL );
+        }
+    }
+
+    if ( media != NULL ) {
+        media->Release ( NULL );
+    }
+
+    if ( job->verbose == true ) {
+        fprintf ( stdout, "  %s: %d file%s\n", path, files, ( files == 1 ) ? "" : "s" );
+    }
+
+    SDL_mutexP ( job->mutex );
+
+    if ( volumes == 0 ) {
+        job->badImages++;
+    }
+    job->images       += volumes;
+    job->files        += files;
+    job->badFiles     += badFiles;
+    job->bytesRead    += read;
+    job->bytesWritten += written;
+
+    SDL_mutexV ( job->mutex );
+}
+
+int _BatchThreadProc ( void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "_BatchThreadProc", true );
+
+    sBatchJob *job = ( sBatchJob * ) ptr;
+
+    sBuffer buffer = { NULL, 0 };
+
+    for ( EVER ) {
+        SDL_mutexP ( job->mutex );
+        int index = job->next++;
+        SDL_mutexV ( job->mutex );
+        if ( index >= job->list->count ) break;
+        ExtractImage ( job->list->path [ index ], job, &buffer );
+    }
+
+    delete [] buffer.data;
+
+    return 0;
+}
+
+int ExtractAll ( const sPathList *roots, const char *outputDir, bool convertFiles, bool verbose, int threads )
+{
+    FUNCTION_ENTRY ( NULL, "ExtractAll", true );
+
+    if ( SDL_Init ( SDL_INIT_NOPARACHUTE ) < 0 ) {
+        fprintf ( stderr, "Couldn't initialize SDL: %s\n", SDL_GetError ());
+        return -1;
+    }
+
+    atexit ( SDL_Quit );
+
+    if (( MKDIR ( outputDir, 0777 ) != 0 ) && ( errno != EEXIST )) {
+        fprintf ( stderr, "Unable to create directory \"%s\"\n", outputDir );
+        return -1;
+    }
+
+    UINT32 startTime = SDL_GetTicks ();
+
+    sPathList list = { NULL, 0, 0 };
+    for ( int i = 0; i < roots->count; i++ ) {
+        FindFiles ( roots->path [i], &list );
+    }
+
+    sBatchJob job;
+    memset ( &job, 0, sizeof ( job ));
+    job.list         = &list;
+    job.outputDir    = outputDir;
+    job.convertFiles = convertFiles;
+    job.verbose      = verbose;
+    job.mutex        = SDL_CreateMutex ();
+
+    if ( threads <= 0 ) {
+        threads = GetProcessorCount ();
+    }
+    threads = max ( 1, min ( threads, min ( list.count, MAX_BATCH_THREADS )));
+
+    if ( verbose == true ) fprintf ( stdout, "\n" );
+    if ( verbose == true ) fprintf ( stdout, "Extracting files:\n" );
+
+    SDL_Thread *thread [ MAX_BATCH_THREADS ];
+    int         started = 0;
+
+    for ( int i = 1; i < threads; i++ ) {
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+        thread [ started ] = SDL_CreateThread ( _BatchThreadProc, "Extract", &job );
+#else
+        thread [ started ] = SDL_CreateThread ( _BatchThreadProc, &job );
+#endif
+        if ( thread [ started ] == NULL ) {
+            DBG_WARNING ( "Unable to create extraction thread" );
+            break;
+        }
+        started++;
+    }
+
+    // Do our share too
+    _BatchThreadProc ( &job );
+
+    for ( int i = 0; i < started; i++ ) {
+        SDL_WaitThread ( thread [i], NULL );
+    }
+
+    UINT32 elapsed = SDL_GetTicks () - startTime;
+
+    SDL_DestroyMutex ( job.mutex );
+
+    double seconds = ( elapsed > 0 ) ? elapsed / 1000.0 : 0.001;
+
+    fprintf ( stdout, "\n" );
+    fprintf ( stdout, "%7d Files scanned\n", list.count );
+    fprintf ( stdout, "%7d Disk images extracted (%d unreadable)\n", job.images, job.badImages );
+    fprintf ( stdout, "%7d Files extracted (%d unreadable)\n", job.files, job.badFiles );
+    fprintf ( stdout, "%7u ms elapsed using %d thread%s\n", elapsed, threads, ( threads == 1 ) ? "" : "s" );
+    fprintf ( stdout, "%7.1f MB read (%.1f MB/s)\n", job.bytesRead / ( 1024.0 * 1024.0 ), job.bytesRead / ( 1024.0 * 1024.0 ) / seconds );
+    fprintf ( stdout, "%7.1f MB written (%.1f MB/s)\n", job.bytesWritten / ( 1024.0 * 1024.0 ), job.bytesWritten / ( 1024.0 * 1024.0 ) / seconds );
+
+    FreePaths ( &list );
+
+    return (( job.badImages == 0 ) && ( job.badFiles == 0 )) ? 0 : -1;
+}
+
+bool ParseDirectory ( const char *arg, void *buffer )
+{
+    FUNCTION_ENTRY ( NULL, "ParseDirectory", true );
+
+    const char *ptr = strchr ( arg, '=' );
+
+    if (( ptr == NULL ) || ( ptr [1] == '\0' )) {
+        fprintf ( stderr, "A directory needs to be specified: '%s'\n", arg );
+        return false;
+    }
+
+    strncpy (( char * ) buffer, ptr + 1, 255 );
+    (( char * ) buffer ) [255] = '\0';
+
+    return true;
+}
+
 void PrintUsage ()
 {
     FUNCTION_ENTRY ( NULL, "PrintUsage", true );
 
     fprintf ( stdout, "Usage: disk [options] file\n" );
+    fprintf ( stdout, "       disk --batch=<directory> [options] directory|image ...\n" );
     fprintf ( stdout, "\n" );
 }
 
@@ -305,10 +773,13 @@ int main ( int argc, char *argv[] )
     bool convertFiles = false;
     bool verboseMode  = false;
     bool showLayout   = false;
+    char batchDir [256] = "";
+    int  threads      = 0;
     eDiskFormat outputFormat = FORMAT_UNKNOWN;
 
     sOption optList [] = {
         { 'a', "add=*<filename>",     OPT_NONE,                      true,              addFiles,      ParseFileName,  "Add <filename> to the disk image" },
+        { 'b', "batch=*<directory>",  OPT_NONE,                      0,                 batchDir,      ParseDirectory, "Extract all files from every image given to <directory>" },
         {  0,  "check",               OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &checkDisk,    NULL,           "Check the integrity of the disk structures" },
         { 'c', "convert",             OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &convertFiles, NULL,           "Convert extracted files to DOS files" },
         { 'd', "dump",                OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &dumpFiles,    NULL,           "Extract all files to FIAD files" },
@@ -316,7 +787,9 @@ int main ( int argc, char *argv[] )
         {  0,  "output=PC99",         OPT_VALUE_SET | OPT_SIZE_INT,  FORMAT_RAW_TRACK,  &outputFormat, NULL,           "Convert disk to PC99 format" },
         {  0,  "output=v9t9",         OPT_VALUE_SET | OPT_SIZE_INT,  FORMAT_RAW_SECTOR, &outputFormat, NULL,           "Convert disk to v9t9 DOAD format" },
         {  0,  "output=anadisk",      OPT_VALUE_SET | OPT_SIZE_INT,  FORMAT_ANADISK,    &outputFormat, NULL,           "Convert disk to AnaDisk format /w headers" },
+        {  0,  "output=compressed",   OPT_VALUE_SET | OPT_SIZE_INT,  FORMAT_COMPRESSED, &outputFormat, NULL,           "Convert disk to compressed PC99 format" },
         { 'r', "remove=*<filename>",  OPT_NONE,                      true,              delFiles,      ParseFileName,  "Remove <filename> from the disk image" },
+        { 't', "threads=*n",          OPT_VALUE_PARSE_INT,           0,                 &threads,      NULL,           "Number of threads used by --batch (default is one per CPU)" },
         { 'v', "verbose",             OPT_VALUE_SET | OPT_SIZE_BOOL, true,              &verboseMode,  NULL,           "Display information about the disk image" },
         { 'e', "extract*=<filename>", OPT_NONE,                      true,              extFiles,      ParseFileName,  "Extract <filename> to v9t9 FIAD file" }
     };
@@ -334,7 +807,7 @@ int main ( int argc, char *argv[] )
 
     printf ( "TI-99/4A Diskette Viewer\n" );
 
-    cFileSystem *disk = NULL;
+    sPathList roots = { NULL, 0, 0 };
 
     int index = 1;
     while ( index < argc ) {
@@ -342,23 +815,34 @@ int main ( int argc, char *argv[] )
         index = ParseArgs ( index, argc, argv, SIZE ( optList ), optList );
 
         if ( index < argc ) {
-            if ( disk != NULL ) {
-                fprintf ( stderr, "Only one disk image file can be specified\n" );
-                return -1;
-            }
-            disk = cFileSystem::Open ( argv [index++], "disks" );
-            if ( disk == NULL ) {
-                fprintf ( stderr, "Unable to open disk image file \"%s\"\n", argv [index-1] );
-                return -1;
-            }
+            AddPath ( &roots, argv [index++] );
         }
     }
 
-    if ( disk == NULL ) {
+    if ( roots.count == 0 ) {
         fprintf ( stderr, "No disk image file specified\n" );
         return -1;
     }
 
+    if ( batchDir [0] != '\0' ) {
+        int retVal = ExtractAll ( &roots, batchDir, convertFiles, verboseMode, threads );
+        FreePaths ( &roots );
+        return retVal;
+    }
+
+    if ( roots.count > 1 ) {
+        fprintf ( stderr, "Only one disk image file can be specified\n" );
+        return -1;
+    }
+
+    cFileSystem *disk = cFileSystem::Open ( roots.path [0], "disks" );
+    if ( disk == NULL ) {
+        fprintf ( stderr, "Unable to open disk image file \"%s\"\n", roots.path [0] );
+        return -1;
+    }
+
+    FreePaths ( &roots );
+
     if ( disk->IsValid () == false ) {
         char name [MAX_FILENAME+1];
         disk->GetPath ( name, sizeof ( name ));
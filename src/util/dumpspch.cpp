@@ -32,21 +32,10 @@
 #include "common.hpp"
 #include "logger.hpp"
 #include "option.hpp"
+#include "spchindex.hpp"
 
 DBG_REGISTER ( __FILE__ );
 
-struct sNode {
-    int          p_length;
-    const char  *phrase;
-    sNode       *prev;
-    sNode       *next;
-    int          d_length;
-    const UINT8 *data;
-    bool         copy;
-    int          phrase_offset;
-    int          data_offset;
-};
-
 static int          dataFormat;
 
 static const UINT8 *vsmDataPtr;
@@ -54,41 +43,6 @@ static int          vsmBytesLeft;
 static int          vsmBitsLeft;
 static int          vsmData;
 
-static inline UINT16 GetUINT16 ( const void *_ptr )
-{
-    FUNCTION_ENTRY ( NULL, "GetUINT16", true );
-
-    const UINT8 *ptr = ( const UINT8 * ) _ptr;
-    return ( UINT16 ) (( ptr [0] << 8 ) | ptr [1] );
-}
-
-sNode *ReadNode ( const UINT8 *rom, int offset )
-{
-    FUNCTION_ENTRY ( NULL, "ReadNode", true );
-
-    sNode *node = new sNode;
-    memset ( node, 0, sizeof ( sNode ));
-
-    int length = rom [ offset ];
-
-    const UINT8 *ptr = &rom [ offset + length + 1 ];
-
-    int prevOffset = GetUINT16 ( ptr );
-    int nextOffset = GetUINT16 ( ptr + 2 );
-    int dataOffset = GetUINT16 ( ptr + 5 );
-
-    node->p_length = length;
-    node->phrase   = ( char * ) rom + offset + 1;
-    node->data     = rom + dataOffset;
-    node->d_length = ptr [7];
-    node->copy     = false;
-
-    if ( prevOffset ) node->prev   = ReadNode ( rom, prevOffset );
-    if ( nextOffset ) node->next   = ReadNode ( rom, nextOffset );
-
-    return node;
-}
-
 int ReadBits ( int count )
 {
     FUNCTION_ENTRY ( NULL, "ReadBits", false );
@@ -174,12 +128,12 @@ bool DumpFrame ( FILE *file )
     return false;
 }
 
-int DumpSpeechData ( FILE *file, sNode *node )
+int DumpSpeechData ( FILE *file, const UINT8 *rom, const sSpeechPhrase *phrase )
 {
     FUNCTION_ENTRY ( NULL, "DumpSpeechData", true );
 
-    vsmBytesLeft = node->d_length;
-    vsmDataPtr   = node->data;
+    vsmBytesLeft = phrase->DataLength;
+    vsmDataPtr   = rom + phrase->Address;
     vsmBitsLeft  = 0;
 
     try {
@@ -190,102 +144,80 @@ int DumpSpeechData ( FILE *file, sNode *node )
     }
 
     catch ( const char *msg ) {
-        fprintf ( stderr, "Phrase: \"%*.*s\" - %s\n", node->p_length, node->p_length, node->phrase, msg );
+        fprintf ( stderr, "Phrase: \"%s\" - %s\n", phrase->Text, msg );
     }
 
     return vsmBytesLeft;
 }
 
-void DumpPhrase ( sNode *node, FILE *spchFile )
+void DumpPhrase ( const UINT8 *rom, const sSpeechPhrase *phrase, FILE *spchFile )
 {
     FUNCTION_ENTRY ( NULL, "DumpPhrase", true );
 
-    if ( node->prev ) DumpPhrase ( node->prev, spchFile );
-
-    fprintf ( spchFile, "\"%*.*s\"%*.*s -", node->p_length, node->p_length, node->phrase, 20 - node->p_length, 20 - node->p_length, "" );
+    fprintf ( spchFile, "\"%s\"%*.*s -", phrase->Text, 20 - ( int ) phrase->Length, 20 - ( int ) phrase->Length, "" );
 
     if ( dataFormat == 0 ) {
-        for ( int i = 0; i < node->d_length; i++ ) {
-            fprintf ( spchFile, " %02X", node->data [i] );
+        for ( int i = 0; i < phrase->DataLength; i++ ) {
+            fprintf ( spchFile, " %02X", rom [ phrase->Address + i ] );
         }
     } else if ( dataFormat == 1 ) {
-        DumpSpeechData ( spchFile, node );
+        DumpSpeechData ( spchFile, rom, phrase );
     } else {
         DBG_ERROR ( "Unrecognized data format (" << dataFormat << ")" );
     }
 
     fprintf ( spchFile, "\n" );
-
-    if ( node->next ) DumpPhrase ( node->next, spchFile );
 }
 
-void DumpROM ( sNode *root, FILE *spchFile )
+void DumpROM ( const UINT8 *rom, const cSpeechIndex &index, FILE *spchFile )
 {
     FUNCTION_ENTRY ( NULL, "DumpROM", true );
 
     fprintf ( spchFile, "# TMS5220 Speech ROM data file\n" );
     fprintf ( spchFile, "\n" );
 
-    DumpPhrase ( root, spchFile );
+    for ( int i = 0; i < index.GetCount (); i++ ) {
+        DumpPhrase ( rom, index.GetPhrase ( i ), spchFile );
+    }
 }
 
-int CheckData ( sNode *node, int *phrases, int *unique, int *data_used, const UINT8 *rom, UINT8 *flags )
+void PrintStats ( const UINT8 *rom, const cSpeechIndex &index )
 {
-    FUNCTION_ENTRY ( NULL, "CheckData", true );
+    UINT8 flags [ SPEECH_ROM_SIZE ];
+    memset ( flags, 0, sizeof ( flags ));
 
-    int wasted = 0;
+    int phrases     = 0;
+    int unique      = 0;
+    int data_used   = 1;
+    int data_wasted = 0;
 
-    if ( node->prev ) wasted += CheckData ( node->prev, phrases, unique, data_used, rom, flags );
+    for ( int i = 0; i < index.GetCount (); i++ ) {
 
-    *phrases   += 1;
-    *data_used += 1 + node->p_length + 6;
+        const sSpeechPhrase *phrase = index.GetPhrase ( i );
 
-    int offset = node->data - rom;
+        phrases   += 1;
+        data_used += 1 + ( int ) phrase->Length + 6;
 
-    if ( flags [offset] == 0 ) {
-        *unique    += 1;
-        *data_used += node->d_length;
-        wasted     += DumpSpeechData ( NULL, node );
-        memset ( flags + offset, 1, node->d_length );
+        if ( flags [ phrase->Address ] == 0 ) {
+            unique      += 1;
+            data_used   += phrase->DataLength;
+            data_wasted += DumpSpeechData ( NULL, rom, phrase );
+            memset ( flags + phrase->Address, 1, phrase->DataLength );
 
-        if (( vsmBytesLeft > 0 ) && ( verbose != 0 )) {
-            fprintf ( stderr, "%d bytes left processing phrase %*.*s\n", vsmBytesLeft, node->p_length, node->p_length, node->phrase );
+            if (( vsmBytesLeft > 0 ) && ( verbose != 0 )) {
+                fprintf ( stderr, "%d bytes left processing phrase %s\n", vsmBytesLeft, phrase->Text );
+            }
         }
-
     }
 
-    if ( node->next ) wasted += CheckData ( node->next, phrases, unique, data_used, rom, flags );
-
-    return wasted;
-}
-
-void PrintStats ( sNode *root, const UINT8 *rom )
-{
-    UINT8 flags [ 0x8000 ];
-    memset ( flags, 0, sizeof ( flags ));
-
-    int phrases     = 0;
-    int unique      = 0;
-    int data_used   = 1;
-
-    int data_wasted = CheckData ( root, &phrases, &unique, &data_used, rom, flags );
-
     if (( data_wasted > 0 ) && ( verbose != 0 )) fprintf ( stdout, "\n" );
 
     fprintf ( stdout, "%7d Phrases (%d unique)\n", phrases, unique );
     fprintf ( stdout, "%7d Bytes used (%d bytes excess)\n", data_used, data_wasted );
-    fprintf ( stdout, "%7d Bytes free (potentially %d bytes)\n", 0x8000 - data_used, 0x8000 - data_used + data_wasted );
+    fprintf ( stdout, "%7d Bytes free (potentially %d bytes)\n", SPEECH_ROM_SIZE - data_used, SPEECH_ROM_SIZE - data_used + data_wasted );
     fprintf ( stdout, "\n" );
 }
 
-void FreeTree ( sNode *node )
-{
-    if ( node->prev != NULL ) FreeTree ( node->prev );
-    if ( node->next != NULL ) FreeTree ( node->next );
-
-    delete node;
-}
-
 bool ParseFileName ( const char *arg, void *filename )
 {
     FUNCTION_ENTRY ( NULL, "ParseFileName", true );
@@ -303,6 +235,22 @@ bool ParseFileName ( const char *arg, void *filename )
     return true;
 }
 
+bool ParsePhrase ( const char *arg, void *phrase )
+{
+    FUNCTION_ENTRY ( NULL, "ParsePhrase", true );
+
+    const char *ptr = strchr ( arg, '=' );
+
+    if (( ptr == NULL ) || ( strlen ( ptr + 1 ) > 255 )) {
+        fprintf ( stderr, "A phrase needs to be specified: '%s'\n", arg );
+        return false;
+    }
+
+    strcpy (( char * ) phrase, ptr + 1 );
+
+    return true;
+}
+
 void PrintUsage ()
 {
     FUNCTION_ENTRY ( NULL, "PrintUsage", true );
@@ -316,11 +264,13 @@ int main ( int argc, char *argv[] )
     FUNCTION_ENTRY ( NULL, "main", true );
 
     char outputFile [256] = "spchrom.dat";
+    char phraseText [256] = "";
 
     sOption optList [] = {
         {  0,  "format=hex",          OPT_VALUE_SET | OPT_SIZE_INT,  0,    &dataFormat,   NULL,           "Speech data listed in hexadecimal" },
         {  0,  "format=spch",         OPT_VALUE_SET | OPT_SIZE_INT,  1,    &dataFormat,   NULL,           "Decoded speech data" },
         { 'o', "output=*<filename>",  OPT_NONE,                      true, outputFile,    ParseFileName,  "Create output file <filename>" },
+        { 'p', "phrase=*<text>",      OPT_NONE,                      true, phraseText,    ParsePhrase,    "Only list the speech data for <text>" },
         { 'v', "verbose",             OPT_VALUE_SET | OPT_SIZE_BOOL, true, &verbose,      NULL,           "Display extra information" }
     };
 
@@ -345,7 +295,7 @@ int main ( int argc, char *argv[] )
         return -1;
     }
 
-    UINT8 ROM [ 0x8000 ];
+    UINT8 ROM [ SPEECH_ROM_SIZE ];
     memset ( ROM, 0, sizeof ( ROM ));
 
     if ( fread ( ROM, sizeof ( ROM ), 1, romFile ) != 1 ) {
@@ -356,24 +306,32 @@ int main ( int argc, char *argv[] )
 
     fclose ( romFile );
 
-    sNode *root = ReadNode ( ROM, 1 );
+    cSpeechIndex phraseIndex ( ROM );
+
+    if ( phraseText [0] != '\0' ) {
+        const sSpeechPhrase *phrase = phraseIndex.Find ( phraseText );
+        if ( phrase == NULL ) {
+            fprintf ( stderr, "Phrase \"%s\" was not found\n", phraseText );
+            return -1;
+        }
+        fprintf ( stdout, "\n" );
+        DumpPhrase ( ROM, phrase, stdout );
+        return 0;
+    }
 
     FILE *datFile = fopen ( outputFile, "wt" );
     if ( datFile == NULL ) {
         fprintf ( stderr, "Unable to open output file \"%s\"\n", outputFile );
-        FreeTree ( root );
         return -1;
     }
 
-    DumpROM ( root, datFile );
+    DumpROM ( ROM, phraseIndex, datFile );
 
     fclose ( datFile );
 
     fprintf ( stdout, "\n" );
 
-    PrintStats ( root, ROM );
-
-    FreeTree ( root );
+    PrintStats ( ROM, phraseIndex );
 
     return 0;
 }
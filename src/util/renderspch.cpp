@@ -0,0 +1,500 @@
+//----------------------------------------------------------------------------
+//
+// File:        renderspch.cpp
+// Date:        19-Oct-2026
+// Programmer:  agent
+//
+// Description: Render every phrase in a speech ROM to a WAV file
+//
+// Copyright (c) 2026 agent, All Rights Reserved.
+//
+// This program is free software; you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation; either version 2 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program; if not, write to the Free Software
+// Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307, USA.
+//
+// Revision History:
+//
+//----------------------------------------------------------------------------
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "common.hpp"
+#include "logger.hpp"
+#include "SDL.h"
+#include "option.hpp"
+#include "support.hpp"
+#include "spchindex.hpp"
+#include "tms5220.hpp"
+#include "tms9919-wave.hpp"
+#include "ti994a.hpp"
+
+DBG_REGISTER ( __FILE__ );
+
+#define MAX_RENDER_THREADS  32
+
+// Emulated time covered by each rendering step (10 ms)
+const int RENDER_STEP_CLOCKS = CPU_SPEED_HZ / 100;
+
+// Keep going after the STOP frame long enough for the queued speech to be played
+const int RENDER_TAIL_STEPS  = 5;
+
+// Give up on phrases that don't reach a STOP frame within 30 seconds
+const int MAX_RENDER_STEPS   = 30 * 100;
+
+struct sPhrase {
+    const sSpeechPhrase *info;
+    bool      stopped;
+    int       duration;
+    UINT32    waveSize;
+    UINT32    renderTime;
+};
+
+// Largest difference (in output LSBs) allowed between any pair of samples from
+// the integer and floating-point lattice filters
+const int MAX_SAMPLE_ERROR   = 2;
+
+struct sRenderJob {
+    const UINT8 *rom;
+    const char  *directory;
+    int          sampleRate;
+    sPhrase     *phrase;
+    int          count;
+    int          next;
+    SDL_mutex   *mutex;
+};
+
+void StartPhrase ( cTMS5220 *speech, UINT32 address )
+{
+    FUNCTION_ENTRY ( NULL, "StartPhrase", true );
+
+    speech->WriteData (( UINT8 ) ( 0x40 | (( address >>  0 ) & 0x000F )));
+    speech->WriteData (( UINT8 ) ( 0x40 | (( address >>  4 ) & 0x000F )));
+    speech->WriteData (( UINT8 ) ( 0x40 | (( address >>  8 ) & 0x000F )));
+    speech->WriteData (( UINT8 ) ( 0x40 | (( address >> 12 ) & 0x000F )));
+    speech->WriteData (( UINT8 ) ( 0x40 | (( address >> 16 ) & 0x000F )));
+    speech->WriteData ( 0x50 );
+}
+
+void RenderPhrase ( const sRenderJob *job, int index )
+{
+    FUNCTION_ENTRY ( NULL, "RenderPhrase", true );
+
+    sPhrase *phrase = &job->phrase [ index ];
+
+    UINT32 startTime = SDL_GetTicks ();
+
+    // Number the files so phrases that differ only in punctuation don't collide
+    char filename [ 512 ];
+    int  used = sprintf ( filename, "%s%c%04d-", job->directory, SEPERATOR, index );
+    for ( size_t i = 0; i < phrase->info->Length; i++ ) {
+        char ch = phrase->info->Text [i];
+        filename [ used++ ] = ( char ) ( isalnum (( UINT8 ) ch ) ? ch : '_' );
+    }
+    strcpy ( filename + used, ".wav" );
+
+    cWaveTMS9919 wave ( job->sampleRate, filename );
+
+    if ( wave.IsOpen () == false ) {
+        fprintf ( stderr, "Unable to create \"%s\"\n", filename );
+        return;
+    }
+
+    cTMS5220 speech ( &wave, job->rom );
+
+    // The CPU clock never moves in this program, so the commands all happen
+    // at time 0 and emulated time is then advanced by hand for each phrase
+    StartPhrase ( &speech, phrase->info->Address );
+
+    UINT32 clock = 0;
+    wave.EndFrame ( clock );
+
+    int steps = 0;
+    for ( ; ( speech.IsTalking () == true ) && ( steps < MAX_RENDER_STEPS ); steps++ ) {
+        clock += RENDER_STEP_CLOCKS;
+        speech.Update ( clock );
+        wave.EndFrame ( clock );
+    }
+
+    phrase->stopped  = ( speech.IsTalking () == false );
+    phrase->duration = steps * 10;
+
+    for ( int i = 0; i < RENDER_TAIL_STEPS; i++ ) {
+        clock += RENDER_STEP_CLOCKS;
+        wave.EndFrame ( clock );
+    }
+
+    phrase->waveSize   = wave.GetDataLength ();
+    phrase->renderTime = SDL_GetTicks () - startTime;
+}
+
+//----------------------------------------------------------------------------
+//
+// Drives the synthesizer one 3.125 ms block at a time so the output of the
+// integer lattice filter can be compared against the floating-point one.
+//
+//----------------------------------------------------------------------------
+
+class cCompareTMS5220 : public cTMS5220 {
+
+public:
+
+    cCompareTMS5220 ( const UINT8 *rom, bool reference ) :
+        cTMS5220 ( NULL, rom )
+    {
+        SetReferenceFilter ( reference );
+    }
+
+    const INT16 *NextBlock ()
+    {
+        return ( CreateNextBuffer () == true ) ? m_RawDataBuffer : NULL;
+    }
+
+    int GetOverflows () const	{ return m_ReferenceOverflows; }
+
+};
+
+struct sFilterStats {
+    int       samples;
+    int       mismatched;
+    int       maxError;
+    int       firstSample;
+    int       firstActual;
+    int       firstExpected;
+    int       overflows;
+    double    signal;
+    double    noise;
+};
+
+void ComparePhrase ( const UINT8 *rom, const sSpeechPhrase *info, sFilterStats *stats )
+{
+    FUNCTION_ENTRY ( NULL, "ComparePhrase", true );
+
+    memset ( stats, 0, sizeof ( sFilterStats ));
+
+    stats->firstSample = -1;
+
+    cCompareTMS5220 lattice ( rom, false );
+    cCompareTMS5220 reference ( rom, true );
+
+    StartPhrase ( &lattice, info->Address );
+    StartPhrase ( &reference, info->Address );
+
+    // 320 blocks per second
+    for ( int blocks = 0; ( lattice.IsTalking () == true ) && ( blocks < MAX_RENDER_STEPS * 320 / 100 ); blocks++ ) {
+        const INT16 *actual   = lattice.NextBlock ();
+        const INT16 *expected = reference.NextBlock ();
+        if (( actual == NULL ) || ( expected == NULL )) break;
+        for ( int i = 0; i < INTERPOLATION_INTERVAL; i++ ) {
+            int error = abs ( actual [i] - expected [i] );
+            if ( error != 0 ) {
+                if ( stats->mismatched++ == 0 ) {
+                    stats->firstSample   = stats->samples + i;
+                    stats->firstActual   = actual [i];
+                    stats->firstExpected = expected [i];
+                }
+            }
+            if ( error > stats->maxError ) stats->maxError = error;
+            stats->signal += ( double ) expected [i] * ( double ) expected [i];
+            stats->noise  += ( double ) error * ( double ) error;
+        }
+        stats->samples += INTERPOLATION_INTERVAL;
+    }
+
+    stats->overflows = reference.GetOverflows ();
+}
+
+int CompareFilters ( const UINT8 *rom, const cSpeechIndex &phraseIndex )
+{
+    FUNCTION_ENTRY ( NULL, "CompareFilters", true );
+
+    sFilterStats total;
+    memset ( &total, 0, sizeof ( total ));
+
+    int failed     = 0;
+    int overloaded = 0;
+
+    for ( int i = 0; i < phraseIndex.GetCount (); i++ ) {
+        const sSpeechPhrase *info = phraseIndex.GetPhrase ( i );
+        sFilterStats stats;
+        ComparePhrase ( rom, info, &stats );
+        double      error  = ( stats.signal > 0.0 ) ? sqrt ( stats.noise / stats.signal ) : 0.0;
+        const char *result = "";
+        // Phrases that drive the lattice past 15 bits wrap on the chip and are only reported
+        if ( stats.overflows != 0 ) {
+            result = "  (overloaded)";
+            overloaded++;
+        } else if ( stats.maxError > MAX_SAMPLE_ERROR ) {
+            result = "  ** FAILED **";
+            failed++;
+        }
+        if (( verbose >= 1 ) || ( *result != '\0' )) {
+            fprintf ( stdout, "%4d %-20s %7d samples %6d differ  max %3d  error %6.2f%%%s\n", i, info->Text, stats.samples,
+                      stats.mismatched, stats.maxError, error * 100.0, result );
+            if ( stats.firstSample >= 0 ) {
+                fprintf ( stdout, "     first difference at sample %d: %d (expected %d)\n", stats.firstSample, stats.firstActual, stats.firstExpected );
+            }
+        }
+        if ( stats.overflows != 0 ) continue;
+        total.samples    += stats.samples;
+        total.mismatched += stats.mismatched;
+        total.maxError    = max ( total.maxError, stats.maxError );
+        total.signal     += stats.signal;
+        total.noise      += stats.noise;
+    }
+
+    double error = ( total.signal > 0.0 ) ? sqrt ( total.noise / total.signal ) : 0.0;
+
+    fprintf ( stdout, "\n" );
+    fprintf ( stdout, "%7d Phrases compared (%d overloaded, %d off by more than %d)\n", phraseIndex.GetCount (), overloaded, failed, MAX_SAMPLE_ERROR );
+    fprintf ( stdout, "%7d Samples (%d differ, largest difference %d)\n", total.samples, total.mismatched, total.maxError );
+    fprintf ( stdout, "%7.2f%% RMS difference between the integer and floating-point filters\n", error * 100.0 );
+
+    return ( failed == 0 ) ? 0 : -1;
+}
+
+int _RenderThreadProc ( void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "_RenderThreadProc", true );
+
+    sRenderJob *job = ( sRenderJob * ) ptr;
+
+    for ( EVER ) {
+        SDL_mutexP ( job->mutex );
+        int index = job->next++;
+        SDL_mutexV ( job->mutex );
+        if ( index >= job->count ) break;
+        RenderPhrase ( job, index );
+    }
+
+    return 0;
+}
+
+void RenderPhrases ( sRenderJob *job, int threads )
+{
+    FUNCTION_ENTRY ( NULL, "RenderPhrases", true );
+
+    SDL_Thread *thread [ MAX_RENDER_THREADS ];
+    int         started = 0;
+
+    // Hand out phrases one at a time - they vary too much in length to split the list up front
+    for ( int i = 1; i < threads; i++ ) {
+#if SDL_VERSION_ATLEAST ( 2, 0, 0 )
+        thread [ started ] = SDL_CreateThread ( _RenderThreadProc, "Render", job );
+#else
+        thread [ started ] = SDL_CreateThread ( _RenderThreadProc, job );
+#endif
+        if ( thread [ started ] == NULL ) {
+            DBG_WARNING ( "Unable to create render thread" );
+            break;
+        }
+        started++;
+    }
+
+    // Do our share too
+    _RenderThreadProc ( job );
+
+    for ( int i = 0; i < started; i++ ) {
+        SDL_WaitThread ( thread [i], NULL );
+    }
+}
+
+void PrintReport ( const sRenderJob &job, int threads, UINT32 elapsed )
+{
+    FUNCTION_ENTRY ( NULL, "PrintReport", true );
+
+    int    failed    = 0;
+    int    dataBytes = 0;
+    int    duration  = 0;
+    UINT32 waveBytes = 0;
+    UINT32 busyTime  = 0;
+
+    fprintf ( stdout, "   # Phrase                Address  Bytes  Speech ms  WAV bytes  Render ms\n" );
+
+    for ( int i = 0; i < job.count; i++ ) {
+        const sPhrase &phrase = job.phrase [i];
+        fprintf ( stdout, "%4d %-20s   %04X  %5d  %9d  %9u  %9u%s\n", i, phrase.info->Text, phrase.info->Address, phrase.info->DataLength,
+                  phrase.duration, phrase.waveSize, phrase.renderTime, ( phrase.stopped == true ) ? "" : "  ** no STOP frame **" );
+        if ( phrase.stopped == false ) failed++;
+        dataBytes += phrase.info->DataLength;
+        duration  += phrase.duration;
+        waveBytes += phrase.waveSize;
+        busyTime  += phrase.renderTime;
+    }
+
+    fprintf ( stdout, "\n" );
+    fprintf ( stdout, "%7d Phrases rendered (%d without a STOP frame)\n", job.count, failed );
+    fprintf ( stdout, "%7d Bytes of speech data\n", dataBytes );
+    fprintf ( stdout, "%7.1f Seconds of speech (%u bytes of WAV data at %d Hz)\n", duration / 1000.0, waveBytes, job.sampleRate );
+    fprintf ( stdout, "%7u ms elapsed using %d thread%s (%u ms of rendering, %.1fx real time)\n", elapsed, threads, ( threads == 1 ) ? "" : "s",
+              busyTime, ( double ) duration / ( double ) (( elapsed > 0 ) ? elapsed : 1 ));
+}
+
+bool ParseSampleRate ( const char *arg, void *ptr )
+{
+    FUNCTION_ENTRY ( NULL, "ParseSampleRate", true );
+
+    int freq = 0;
+
+    arg = strchr ( arg, '=' ) + 1;
+
+    if ( sscanf ( arg, "%d", &freq ) != 1 ) {
+        fprintf ( stderr, "Invalid sampling rate '%s'\n", arg );
+        return false;
+    }
+
+    if (( freq > 96000 ) || ( freq < 8000 )) {
+        fprintf ( stderr, "Sampling rate must be between 8000 and 96000\n" );
+        return false;
+    }
+
+    * ( int * ) ptr = freq;
+
+    return true;
+}
+
+bool ParseFileName ( const char *arg, void *filename )
+{
+    FUNCTION_ENTRY ( NULL, "ParseFileName", true );
+
+    const char *ptr = strchr ( arg, '=' );
+
+    if ( ptr == NULL ) {
+        fprintf ( stderr, "A directory needs to be specified: '%s'\n", arg );
+        return false;
+    }
+
+    strcpy (( char * ) filename, ptr + 1 );
+
+    return true;
+}
+
+void PrintUsage ()
+{
+    FUNCTION_ENTRY ( NULL, "PrintUsage", true );
+
+    fprintf ( stdout, "Usage: renderspch [options] [file]\n" );
+    fprintf ( stdout, "\n" );
+}
+
+int main ( int argc, char *argv[] )
+{
+    FUNCTION_ENTRY ( NULL, "main", true );
+
+    char outputDir [256] = ".";
+    int  samplingRate    = 44100;
+    int  threads         = 0;
+    bool compareFilters  = false;
+
+    sOption optList [] = {
+        { 'c', "compare",             OPT_VALUE_SET | OPT_SIZE_BOOL, true,  &compareFilters, NULL,            "Compare the integer lattice filter against the floating-point one" },
+        { 'o', "output=*<directory>", OPT_NONE,                      true,  outputDir,       ParseFileName,   "Write the WAV files to <directory>" },
+        { 's', "sample=*<freq>",      OPT_NONE,                      0,     &samplingRate,   ParseSampleRate, "Select sampling frequency for the WAV files" },
+        { 't', "threads=*n",          OPT_VALUE_PARSE_INT,           0,     &threads,        NULL,            "Number of rendering threads (default is one per CPU)" },
+        { 'v', "verbose*=n",          OPT_VALUE_PARSE_INT,           1,     &verbose,        NULL,            "Display extra information" }
+    };
+
+    printf ( "TI-99/4A Speech ROM Render Utility\n" );
+
+    int index = 1;
+    index = ParseArgs ( index, argc, argv, SIZE ( optList ), optList );
+
+    const char *romName = ( index < argc ) ? argv [index] : LocateFile ( "spchrom.bin", "roms" );
+
+    if ( romName == NULL ) {
+        fprintf ( stderr, "No speech ROM specified and spchrom.bin could not be found\n" );
+        return -1;
+    }
+
+    FILE *romFile = fopen ( romName, "rb" );
+    if ( romFile == NULL ) {
+        fprintf ( stderr, "Unable to open input file \"%s\"\n", romName );
+        return -1;
+    }
+
+    UINT8 ROM [ SPEECH_ROM_SIZE ];
+    memset ( ROM, 0, sizeof ( ROM ));
+
+    if ( fread ( ROM, sizeof ( ROM ), 1, romFile ) != 1 ) {
+        fprintf ( stderr, "Error reading from file \"%s\"\n", romName );
+        fclose ( romFile );
+        return -1;
+    }
+
+    fclose ( romFile );
+
+    if ( ROM [0] != 0xAA ) {
+        fprintf ( stderr, "\"%s\" is not a valid speech ROM\n", romName );
+        return -1;
+    }
+
+    if ( SDL_Init ( SDL_INIT_NOPARACHUTE ) < 0 ) {
+        fprintf ( stderr, "Couldn't initialize SDL: %s\n", SDL_GetError ());
+        return -1;
+    }
+
+    atexit ( SDL_Quit );
+
+    cSpeechIndex phraseIndex ( ROM );
+
+    if ( compareFilters == true ) {
+        fprintf ( stdout, "\n" );
+        return CompareFilters ( ROM, phraseIndex );
+    }
+
+    sPhrase *phrases = new sPhrase [ phraseIndex.GetCount () + 1 ];
+
+    for ( int i = 0; i < phraseIndex.GetCount (); i++ ) {
+        memset ( &phrases [i], 0, sizeof ( sPhrase ));
+        phrases [i].info = phraseIndex.GetPhrase ( i );
+    }
+
+    sRenderJob job;
+    job.rom        = ROM;
+    job.directory  = outputDir;
+    job.sampleRate = samplingRate;
+    job.phrase     = phrases;
+    job.count      = phraseIndex.GetCount ();
+    job.next       = 0;
+    job.mutex      = SDL_CreateMutex ();
+
+    if ( threads <= 0 ) {
+        threads = GetProcessorCount ();
+    }
+    threads = max ( 1, min ( threads, min ( job.count, MAX_RENDER_THREADS )));
+
+    if ( verbose >= 1 ) {
+        fprintf ( stdout, "Rendering %d phrases from \"%s\" into \"%s\"\n", job.count, romName, outputDir );
+    }
+    fprintf ( stdout, "\n" );
+
+    // The synthesizer's band-limited step table is shared and built on first use - get it
+    // done here rather than in every thread at once
+    {
+        cWaveTMS9919 warmup ( samplingRate, NULL );
+    }
+
+    UINT32 startTime = SDL_GetTicks ();
+
+    RenderPhrases ( &job, threads );
+
+    PrintReport ( job, threads, SDL_GetTicks () - startTime );
+
+    SDL_DestroyMutex ( job.mutex );
+
+    delete [] phrases;
+
+    return 0;
+}
@@ -35,91 +35,36 @@
 #include "logger.hpp"
 #include "SDL.h"
 #include "tms5220.hpp"
+#include "spchindex.hpp"
 #include "tms9919.hpp"
 #include "tms9919-sdl.hpp"
+#include "ti994a.hpp"
 #include "option.hpp"
 
 DBG_REGISTER ( __FILE__ );
 
-struct sNode {
-    char      string [64];
-    UINT32    prevAddr;
-    UINT32    nextAddr;
-    UINT32    dataAddr;
-    int       dataLength;
-};
+extern "C" UINT32 ClockCycleCounter;
 
-bool ReadNode ( cTMS5220 *speech, UINT32 address, sNode *node )
-{
-    FUNCTION_ENTRY ( NULL, "ReadNode", true );
-
-    memset ( node, 0, sizeof ( sNode ));
-
-    speech->WriteData (( UINT8 ) ( 0x40 | (( address >>  0 ) & 0x000F )));  // Load Address
-    speech->WriteData (( UINT8 ) ( 0x40 | (( address >>  4 ) & 0x000F )));  // Load Address
-    speech->WriteData (( UINT8 ) ( 0x40 | (( address >>  8 ) & 0x000F )));  // Load Address
-    speech->WriteData (( UINT8 ) ( 0x40 | (( address >> 12 ) & 0x000F )));  // Load Address
-    speech->WriteData (( UINT8 ) ( 0x40 | (( address >> 16 ) & 0x000F )));  // Load Address
-
-    speech->WriteData ( 0x10 );  // Read byte
-    int length = speech->ReadData ( 0 );
-    for ( int i = 0; i < length; i++ ) {
-        speech->WriteData ( 0x10 );
-        node->string [i] = speech->ReadData ( 0 );
-    }
-    node->string [length] = '\0';
-
-    speech->WriteData ( 0x10 );
-    node->prevAddr = speech->ReadData ( 0 ) << 8;
-    speech->WriteData ( 0x10 );
-    node->prevAddr |= speech->ReadData ( 0 );
-
-    speech->WriteData ( 0x10 );
-    node->nextAddr = speech->ReadData ( 0 ) << 8;
-    speech->WriteData ( 0x10 );
-    node->nextAddr |= speech->ReadData ( 0 );
-
-    speech->WriteData ( 0x10 );
-    speech->ReadData ( 0 );
+// Keep the emulated clock this far ahead of the audio so speech is ready before it's needed
+const int SPEECH_LEAD_MS = 50;
 
-    speech->WriteData ( 0x10 );
-    node->dataAddr = speech->ReadData ( 0 ) << 8;
-    speech->WriteData ( 0x10 );
-    node->dataAddr |= speech->ReadData ( 0 );
+static UINT32 startTicks;
 
-    speech->WriteData ( 0x10 );
-    node->dataLength = speech->ReadData ( 0 );
+void RunClock ()
+{
+    FUNCTION_ENTRY ( NULL, "RunClock", false );
 
-    return true;
+    // There's no CPU running, so let emulated time follow real time
+    ClockCycleCounter = ( SDL_GetTicks () - startTicks + SPEECH_LEAD_MS ) * ( CPU_SPEED_HZ / 1000 );
 }
 
 UINT32 LocateString ( cTMS5220 *speech, const char *string, size_t length )
 {
-    // Reset the LoadPointer
-    speech->WriteData ( 0x40 );  // Load Address
-    speech->WriteData ( 0x40 );  // Load Address
-    speech->WriteData ( 0x40 );  // Load Address
-    speech->WriteData ( 0x40 );  // Load Address
-    speech->WriteData ( 0x40 );  // Load Address
-
-    speech->WriteData ( 0x10 );  // Read byte
-    if ( speech->ReadData ( 0 ) != 0xAA ) {
-        fprintf ( stderr, "Speech rom is invalid!\n" );
-        return 0;
-    }
+    FUNCTION_ENTRY ( NULL, "LocateString", true );
 
-    sNode node;
-    UINT32 addr = 1;
+    const sSpeechPhrase *phrase = speech->GetPhraseIndex ()->Find ( string, length );
 
-    for ( EVER ) {
-        ReadNode ( speech, addr, &node );
-        int delta = strnicmp ( string, node.string, length );
-        if (( strlen ( node.string ) == length ) && ( delta == 0 )) break;
-        addr = ( delta <= 0 ) ? node.prevAddr : node.nextAddr;
-        if ( addr == 0 ) return 0;
-    }
-
-    return node.dataAddr;
+    return ( phrase != NULL ) ? phrase->Address : 0;
 }
 
 void SayPhrase ( cTMS5220 *speech, const char *text, size_t length )
@@ -162,9 +107,10 @@ void SayPhrase ( cTMS5220 *speech, const char *text, size_t length )
     // Wait for the phrase to complete
     UINT8 status = 0;
     do {
-        SDL_Delay ( 200 );
+        SDL_Delay ( 10 );
+        RunClock ();
         status = speech->ReadData ( 0 );
-    } while ( status == 0xE0 );
+    } while (( status & TMS5220_TS ) != 0 );
 }
 
 void Say ( cTMS5220 *speech, const char *text )
@@ -187,8 +133,8 @@ bool ParseSampleRate ( const char *arg, void *ptr )
         return false;
     }
 
-    if (( freq > 44100 ) || ( freq < 8000 )) {
-        fprintf ( stderr, "Sampling rate must be between 8000 and 44100\n" );
+    if (( freq > 96000 ) || ( freq < 8000 )) {
+        fprintf ( stderr, "Sampling rate must be between 8000 and 96000\n" );
         return false;
     }
 
@@ -238,11 +184,16 @@ int main ( int argc, char *argv[] )
 
     cTMS5220 speech ( &sound );
 
+    startTicks = SDL_GetTicks ();
+
     speech.WriteData ( 0x70 );  // Reset
 
     for ( int i = index; i < argc; i++ ) {
         Say ( &speech, argv [i] );
     }
 
+    // Let the audio thread play whatever is still queued
+    SDL_Delay ( SPEECH_LEAD_MS * 2 );
+
     return 0;
 }